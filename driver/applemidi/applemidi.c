@@ -12,6 +12,7 @@
 #include "driver/common/rtpmidi.h"
 #include "midi/runloop.h"
 #include "midi/clock.h"
+#include "midi/clock_sync.h"
 #include "midi/driver.h"
 #include "midi/message.h"
 #include "midi/message_queue.h"
@@ -23,12 +24,14 @@
 #define APPLEMIDI_RTP_SOCKET     1
 
 #define APPLEMIDI_MAX_MESSAGES_PER_PACKET 16
+#define APPLEMIDI_MAX_PACKETS_PER_READ    16
 #define APPLEMIDI_MSG_BUFFER_SIZE 16
 
 struct AppleMIDICommand {
   struct RTPPeer * peer; /* use peers sockaddr instead .. we get initialization problems otherwise */
   struct sockaddr_storage addr;
   socklen_t size;
+  MIDITimestamp arrival;
 /*unsigned short channel;*/
   unsigned short type;
   union {
@@ -79,6 +82,8 @@ struct MIDIDriverAppleMIDI {
   struct AppleMIDICommand  command;
 
   struct RTPPeer * peer;
+  struct MIDIClockSync * clock_sync;
+  unsigned long  clock_sync_ssrc;
   struct RTPSession * rtp_session;
   struct RTPMIDISession * rtpmidi_session;
 
@@ -309,8 +314,13 @@ struct MIDIDriverAppleMIDI * MIDIDriverAppleMIDICreate( char * name, unsigned sh
 
   driver->peer = NULL;
   driver->rtp_session     = RTPSessionCreate( driver->rtp_socket );  
+  RTPSessionSetClockRate( driver->rtp_session, APPLEMIDI_CLOCK_RATE );
+  RTPSessionSetKernelTimestamps( driver->rtp_session, 1 );
   driver->rtpmidi_session = RTPMIDISessionCreate( driver->rtp_session );
 
+  driver->clock_sync      = MIDIClockSyncCreate( driver->base.clock, APPLEMIDI_CLOCK_RATE );
+  driver->clock_sync_ssrc = 0;
+
   MIDIClockGetNow( driver->base.clock, &timestamp );
   MIDILog( DEBUG, "initial timestamp: %lli\n", timestamp );
   driver->token = timestamp;
@@ -333,6 +343,7 @@ void MIDIDriverAppleMIDIDestroy( struct MIDIDriverAppleMIDI * driver ) {
   _applemidi_disconnect( driver, 0 );
   RTPMIDISessionRelease( driver->rtpmidi_session );
   RTPSessionRelease( driver->rtp_session );
+  MIDIClockSyncRelease( driver->clock_sync );
   MIDIMessageQueueRelease( driver->in_queue );
   MIDIMessageQueueRelease( driver->out_queue );
 }
@@ -418,6 +429,23 @@ int MIDIDriverAppleMIDIGetControlSocket( struct MIDIDriverAppleMIDI * driver, in
   return 0;
 }
 
+/**
+ * @brief Get the clock synchronization with the current peer.
+ * The clock sync is fed by the AppleMIDI synchronization exchanges
+ * and maps the driver's clock to the clock of the peer that was
+ * synchronized with last.
+ * @public @memberof MIDIDriverAppleMIDI
+ * @param driver The driver.
+ * @param sync   The clock sync.
+ * @retval 0 on success.
+ */
+int MIDIDriverAppleMIDIGetClockSync( struct MIDIDriverAppleMIDI * driver, struct MIDIClockSync ** sync ) {
+  MIDIPrecond( driver != NULL, EFAULT );
+  MIDIPrecond( sync != NULL, EINVAL );
+  *sync = driver->clock_sync;
+  return 0;
+}
+
 /**
  * @brief Handle incoming MIDI messages.
  * This is called by the RTP-MIDI payload parser whenever it encounters a new MIDI message.
@@ -572,28 +600,33 @@ static int _applemidi_send_command( struct MIDIDriverAppleMIDI * driver, int fd,
 }
 
 /**
- * @brief Receive an AppleMIDI command.
- * Receive a datagram and decompose the message into the message structure.
+ * @brief Decode an AppleMIDI command.
+ * Decompose a received datagram into the message structure. The sender's
+ * address must already be stored in the command.
  * @private @memberof MIDIDriverAppleMIDI
  * @param driver The driver.
- * @param fd The file descriptor to use for communication.
+ * @param fd The file descriptor the datagram was received on.
+ * @param size The size of the datagram.
+ * @param data The datagram.
  * @param command The command.
  * @retval 0 On success.
- * @retval >0 If the packet could not be sent.
+ * @retval >0 If the datagram is not a valid AppleMIDI command.
  */
-static int _applemidi_recv_command( struct MIDIDriverAppleMIDI * driver, int fd, struct AppleMIDICommand * command ) {
+static int _applemidi_decode_command( struct MIDIDriverAppleMIDI * driver, int fd, size_t size, void * data,
+                                      struct AppleMIDICommand * command ) {
   unsigned int ssrc;
   unsigned int msg[16];
   int len;
-  
-  command->size = sizeof(command->addr);
-  len = recvfrom( fd, &msg[0], sizeof(msg), 0,
-                  (struct sockaddr *) &(command->addr), &(command->size) );
-  if( len > sizeof(msg) ) {
+
+  if( size > sizeof(msg) ) {
     /* received more bytes than we can store in msg[].
      * ignore the remaining bytes, truncate the name */
-    len = sizeof(msg);
+    size = sizeof(msg);
   }
+  len = size;
+  if( len < 4 ) return 1;
+  memcpy( &msg[0], data, len );
+
   if( command->addr.ss_family == AF_INET ) {
     struct sockaddr_in * a = (struct sockaddr_in *) &(command->addr);
     MIDILog( DEBUG, "recv %i bytes from %s:%i on s(%i)\n", len, inet_ntoa( a->sin_addr ), ntohs( a->sin_port ), fd );
@@ -608,6 +641,8 @@ static int _applemidi_recv_command( struct MIDIDriverAppleMIDI * driver, int fd,
     MIDILog( DEBUG, "recv %i bytes from <unknown addr family> on s(%i)\n", len, fd );
   }
 
+  if( ( ntohl( msg[0] ) >> 16 ) != APPLEMIDI_PROTOCOL_SIGNATURE ) return 1;
+
   command->type = ntohl( msg[0] ) & 0xffff;
   
   switch( command->type ) {
@@ -654,6 +689,47 @@ static int _applemidi_recv_command( struct MIDIDriverAppleMIDI * driver, int fd,
   return 0;
 }
 
+/**
+ * @brief Receive an AppleMIDI command.
+ * Receive a datagram and decompose the message into the message structure.
+ * @private @memberof MIDIDriverAppleMIDI
+ * @param driver The driver.
+ * @param fd The file descriptor to use for communication.
+ * @param command The command.
+ * @retval 0 On success.
+ * @retval >0 If the packet could not be received.
+ */
+static int _applemidi_recv_command( struct MIDIDriverAppleMIDI * driver, int fd, struct AppleMIDICommand * command ) {
+  unsigned int msg[16];
+  ssize_t len;
+  
+  command->size = sizeof(command->addr);
+  len = recvfrom( fd, &msg[0], sizeof(msg), 0,
+                  (struct sockaddr *) &(command->addr), &(command->size) );
+  if( len < 0 ) return 1;
+  MIDIClockGetNow( driver->base.clock, &(command->arrival) );
+  return _applemidi_decode_command( driver, fd, len, &msg[0], command );
+}
+
+/**
+ * @brief Feed a finished sync exchange into the clock sync.
+ * Reset the clock sync first if the exchange was made with a different
+ * peer than the last one.
+ * @param driver The driver.
+ * @param ssrc   The SSRC of the remote peer.
+ * @param local  The local timestamp.
+ * @param remote The remote timestamp valid at the same time.
+ */
+static void _applemidi_sync_sample( struct MIDIDriverAppleMIDI * driver, unsigned long ssrc,
+                                    MIDITimestamp local, MIDITimestamp remote ) {
+  if( driver->clock_sync == NULL ) return;
+  if( driver->clock_sync_ssrc != ssrc ) {
+    MIDIClockSyncReset( driver->clock_sync );
+    driver->clock_sync_ssrc = ssrc;
+  }
+  MIDIClockSyncAddSample( driver->clock_sync, local, remote );
+}
+
 /**
  * @brief Start or continue a synchronization session.
  * Continue a synchronization session identified by a given command.
@@ -666,7 +742,7 @@ static int _applemidi_recv_command( struct MIDIDriverAppleMIDI * driver, int fd,
  */
 static int _applemidi_sync( struct MIDIDriverAppleMIDI * driver, int fd, struct AppleMIDICommand * command ) {
   unsigned long ssrc;
-  MIDITimestamp timestamp, diff;
+  MIDITimestamp timestamp;
   RTPSessionGetSSRC( driver->rtp_session, &ssrc );
   MIDIClockGetNow( driver->base.clock, &timestamp );
 
@@ -685,12 +761,10 @@ static int _applemidi_sync( struct MIDIDriverAppleMIDI * driver, int fd, struct
 
     /* received packet from other peer */
     if( command->data.sync.count == 2 ) {
-      /* compute media delay */
-      diff = ( command->data.sync.timestamp3 - command->data.sync.timestamp1 ) / 2;
-      /* approximate time difference between peer and self */
-      diff = command->data.sync.timestamp3 + diff - timestamp;
+      /* our timestamp2 was taken half way between the peer's timestamp1 and timestamp3 */
+      _applemidi_sync_sample( driver, command->data.sync.ssrc, command->data.sync.timestamp2,
+        command->data.sync.timestamp1 + ( command->data.sync.timestamp3 - command->data.sync.timestamp1 ) / 2 );
 
-      /* RTPPeerSetTimestampDiff( command->peer, diff ) */
       /* finished sync */
       command->data.sync.ssrc  = ssrc;
       command->data.sync.count = 3;
@@ -699,12 +773,10 @@ static int _applemidi_sync( struct MIDIDriverAppleMIDI * driver, int fd, struct
       return 0;
     }
     if( command->data.sync.count == 1 ) {
-      /* compute media delay */
-      diff = ( command->data.sync.timestamp3 - command->data.sync.timestamp1 ) / 2;
-      /* approximate time difference between peer and self */
-      diff = command->data.sync.timestamp2 + diff - timestamp;
-
-      /* RTPPeerSetTimestampDiff( command->peer, diff ) */
+      /* the peer's timestamp2 was taken half way between our timestamp1 and the arrival */
+      _applemidi_sync_sample( driver, command->data.sync.ssrc,
+        command->data.sync.timestamp1 + ( command->arrival - command->data.sync.timestamp1 ) / 2,
+        command->data.sync.timestamp2 );
 
       command->data.sync.ssrc       = ssrc;
       command->data.sync.count      = 2;
@@ -716,7 +788,7 @@ static int _applemidi_sync( struct MIDIDriverAppleMIDI * driver, int fd, struct
     if( command->data.sync.count == 0 ) {
       command->data.sync.ssrc       = ssrc;
       command->data.sync.count      = 1;
-      command->data.sync.timestamp2 = timestamp;
+      command->data.sync.timestamp2 = command->arrival;
       
       driver->sync = 2;
       return _applemidi_send_command( driver, fd, command );
@@ -987,26 +1059,71 @@ int MIDIDriverAppleMIDIRemovePeer( struct MIDIDriverAppleMIDI * driver, char * a
   return result;
 }
 
-static int _applemidi_receive_rtpmidi( struct MIDIDriverAppleMIDI * driver ) {
-  struct MIDIMessageList messages[APPLEMIDI_MAX_MESSAGES_PER_PACKET];
+/**
+ * @brief Receive everything that is queued on the RTP socket.
+ * Drain the socket with one batched receive, answer AppleMIDI commands
+ * (like synchronization) that arrive on the RTP port and deliver the MIDI
+ * messages of all RTP-MIDI packets in a single batch.
+ * @private @memberof MIDIDriverAppleMIDI
+ * @param driver The driver.
+ * @retval 0 On success.
+ * @retval >0 If the packets could not be received or processed.
+ */
+static int _applemidi_playout( struct MIDIDriverAppleMIDI * driver ) {
+  struct MIDIMessageList messages[APPLEMIDI_MAX_MESSAGES_PER_PACKET*APPLEMIDI_MAX_PACKETS_PER_READ];
+  struct MIDIMessageBatch * batch;
   int i, result;
 
-  for( i=0; i<APPLEMIDI_MAX_MESSAGES_PER_PACKET; i++ ) {
+  for( i=0; i<APPLEMIDI_MAX_MESSAGES_PER_PACKET*APPLEMIDI_MAX_PACKETS_PER_READ; i++ ) {
     messages[i].message = NULL;
     messages[i].next = &(messages[i+1]);
   }
   messages[i-1].next = NULL;
 
-  result = RTPMIDISessionReceive( driver->rtpmidi_session, &(messages[0]) );
-  if( result != 0 ) return result;
+  result = RTPMIDISessionPlayout( driver->rtpmidi_session, &(messages[0]) );
 
-  for( i=0; i<APPLEMIDI_MAX_MESSAGES_PER_PACKET && messages[i].message != NULL; i++ ) {
+  /* deliver all messages that are due at once */
+  batch = MIDIMessageBatchCreate( APPLEMIDI_MAX_MESSAGES_PER_PACKET*APPLEMIDI_MAX_PACKETS_PER_READ );
+  for( i=0; i<APPLEMIDI_MAX_MESSAGES_PER_PACKET*APPLEMIDI_MAX_PACKETS_PER_READ && messages[i].message != NULL; i++ ) {
   /*MIDIMessageQueuePush( driver->in_queue, messages[i].message );
     MIDIMessageRelease( messages[i].message );*/
-    MIDIDriverAppleMIDIReceiveMessage( driver, messages[i].message ); /* fixme: add scheduling! */
+    if( batch != NULL ) MIDIMessageBatchAppend( batch, messages[i].message );
+    else MIDIDriverAppleMIDIReceiveMessage( driver, messages[i].message );
   }
-  
-  return 0;
+  if( batch != NULL ) {
+    if( i > 0 ) result += MIDIDriverReceiveBatch( &(driver->base), batch );
+    MIDIMessageBatchRelease( batch );
+  }
+
+  return result;
+}
+
+static int _applemidi_receive_rtp( struct MIDIDriverAppleMIDI * driver ) {
+  struct RTPPacketInfo infos[APPLEMIDI_MAX_PACKETS_PER_READ];
+  struct AppleMIDICommand * command = &(driver->command);
+  int result;
+  size_t p, received;
+
+  result = RTPSessionReceivePackets( driver->rtp_session, APPLEMIDI_MAX_PACKETS_PER_READ, &(infos[0]), &received );
+  if( result != 0 ) return result;
+
+  for( p=0; p<received; p++ ) {
+    if( infos[p].peer == NULL ) {
+      /* not RTP, probably an AppleMIDI command sent to the RTP port */
+      if( infos[p].addr_size > sizeof(command->addr) ) continue;
+      command->size = infos[p].addr_size;
+      memcpy( &(command->addr), infos[p].addr, infos[p].addr_size );
+      MIDIClockTimestampFromWallclock( driver->base.clock, &(command->arrival), &(infos[p].arrival) );
+      if( _applemidi_decode_command( driver, driver->rtp_socket, infos[p].iov[0].iov_len,
+                                     infos[p].iov[0].iov_base, command ) == 0 ) {
+        result += _applemidi_respond( driver, driver->rtp_socket, command );
+      }
+    } else {
+      RTPSessionPushPacket( driver->rtp_session, &(infos[p]) );
+    }
+  }
+
+  return result + _applemidi_playout( driver );
 }
 
 static int _applemidi_send_rtpmidi( struct MIDIDriverAppleMIDI * driver ) {
@@ -1049,14 +1166,7 @@ static int _applemidi_read_fds( void * drv, int nfds, fd_set * readfds ) {
   }
   
   if( FD_ISSET( driver->rtp_socket, readfds ) ) {
-    fd = driver->rtp_socket;
-    if( _test_applemidi( fd ) == 0 ) {
-      if( _applemidi_recv_command( driver, fd, &(driver->command) ) == 0 ) {
-        result += _applemidi_respond( driver, fd, &(driver->command) );
-      }
-    } else {
-      result += _applemidi_receive_rtpmidi( driver );
-    }
+    result += _applemidi_receive_rtp( driver );
   }
   
   _applemidi_update_runloop_source( driver );
@@ -1091,6 +1201,9 @@ static int _applemidi_idle_timeout( void * drv, struct timespec * ts ) {
 
   _applemidi_update_runloop_source( driver );
 
+  /* deliver packets held back by the playout delay */
+  _applemidi_playout( driver );
+
   RTPSessionNextPeer( driver->rtp_session, &(driver->peer) );
   if( driver->peer != NULL ) {
     /* check if receiver feedback needs to be sent */
@@ -1101,10 +1214,7 @@ static int _applemidi_idle_timeout( void * drv, struct timespec * ts ) {
     }
   }
 
-  /* check for messages in dispatch (incoming) queue:
-   *   if message needs to be dispatched (timestamp >= now+latency)
-   *   call MIDIDriverAppleMIDIReceiveMessage
-   * send receiver feedback
+  /* send receiver feedback
    * if the last synchronization happened a certain time ago, synchronize again */
 
   return 0;
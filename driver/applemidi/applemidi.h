@@ -11,6 +11,7 @@
 #endif
 
 struct MIDIMessage;
+struct MIDIClockSync;
 struct MIDIDriverAppleMIDI;
 
 #define APPLEMIDI_PROTOCOL_SIGNATURE          0xffff
@@ -46,6 +47,8 @@ int MIDIDriverAppleMIDIGetRTPSocket( struct MIDIDriverAppleMIDI * driver, int *
 int MIDIDriverAppleMIDISetControlSocket( struct MIDIDriverAppleMIDI * driver, int socket );
 int MIDIDriverAppleMIDIGetControlSocket( struct MIDIDriverAppleMIDI * driver, int * socket );
 
+int MIDIDriverAppleMIDIGetClockSync( struct MIDIDriverAppleMIDI * driver, struct MIDIClockSync ** sync );
+
 /*
 int MIDIDriverAppleMIDIReceiveMessage( struct MIDIDriverAppleMIDI * driver, struct MIDIMessage * message );
 int MIDIDriverAppleMIDISendMessage( struct MIDIDriverAppleMIDI * driver, struct MIDIMessage * message );
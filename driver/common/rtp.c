@@ -1,25 +1,101 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
 #include "rtp.h"
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
 #include <sys/time.h>
+#include <netinet/in.h>
 #include <arpa/inet.h>
+#ifdef __linux__
+#include <linux/filter.h>
+#endif
 
 #ifndef NO_LOG
 #include "midi/midi.h"
 #endif
 
-#define RTP_MAX_PEERS 16
+#define RTP_PEER_TABLE_LEN 16
 #define RTP_BUF_LEN   512
 #define RTP_IOV_LEN   16
+#define RTP_MMSG_LEN  16
+
+#define RTP_PEER_NONE ((size_t) -1)
+
+#define RTP_PACKET_LEN     1500
+#define RTP_PACKET_MAX_LEN 65535
+#define RTP_POOL_LEN       64
+
+#define RTP_DEFAULT_CLOCK_RATE 10000
+#define RTP_REORDER_LEN  32
+#define RTP_MAX_DROPOUT  3000
+#define RTP_MAX_MISORDER 100
+#define RTP_JITTER_FACTOR 4
+
+#define RTCP_SR 200
+#define RTCP_RR 201
+#define RTCP_MAX_BLOCKS ( ( RTP_BUF_LEN - 28 ) / 24 )
+#define NTP_UNIX_OFFSET 2208988800UL
 
 #define USEC_PER_SEC 1000000
 
+#ifndef MSG_WAITFORONE
+struct mmsghdr {
+  struct msghdr msg_hdr;
+  unsigned int  msg_len;
+};
+#endif
+
 struct RTPAddress {
   unsigned long ssrc;
   socklen_t size;
   struct sockaddr_storage addr;
 };
 
+struct RTPPacketPool {
+  size_t refs;
+  size_t size;
+  size_t length;
+  struct RTPPacketBuffer * free;
+};
+
+struct RTPPacketBuffer {
+  size_t refs;
+  struct RTPPacketPool * pool;
+  struct RTPPacketBuffer * next;
+  size_t size;
+  unsigned char * data;
+};
+
+struct RTPImpairState {
+  struct RTPImpairment config;
+  unsigned long random;
+  int           bursting;
+};
+
+struct RTPImpairedPacket {
+  struct RTPImpairedPacket * next;
+  struct RTPPacketBuffer   * buffer;
+  size_t          size;
+  struct timespec arrival;
+  socklen_t       addr_size;
+  struct sockaddr_storage addr;
+};
+
+struct RTPBufferedPacket {
+  struct RTPBufferedPacket * next;
+  unsigned long ext_seqnum;
+  struct RTPPacketInfo info;
+  struct iovec iov[2];
+};
+
+struct RTCPReportTime {
+  unsigned long sec;
+  unsigned long frac;
+  unsigned long timestamp;
+};
+
 struct RTPPeer {
   size_t refs;
   struct RTPAddress address;
@@ -27,21 +103,95 @@ struct RTPPeer {
   unsigned long out_timestamp;
   unsigned long in_seqnum;
   unsigned long out_seqnum;
+  unsigned long in_cycles;
+  unsigned long in_base_seqnum;
+  unsigned long in_bad_seqnum;
+  unsigned long in_received;
+  unsigned long in_octets;
+  unsigned long in_expected_prior;
+  unsigned long in_received_prior;
+  unsigned long in_lsr;
+  unsigned long in_lsr_arrival;
+  unsigned long in_transit;
+  unsigned long in_base_transit;
+  unsigned long in_jitter;
+  unsigned long in_played;
+  unsigned long in_played_mask;
+  unsigned char in_playing;
+  size_t buffered_length;
+  struct RTPBufferedPacket * buffered;
+  unsigned long out_packets;
+  unsigned long out_octets;
+  unsigned long rtt;
+  unsigned char remote_fraction_lost;
+  long          remote_packets_lost;
+  unsigned long remote_jitter;
   void * info;
 };
 
+struct RTPPeerTable {
+  size_t count;
+  size_t length;
+  size_t capacity;
+  size_t mask;
+  struct RTPPeer ** list;
+  size_t * by_ssrc;
+  size_t * by_addr;
+  struct RTPPeer * removed;
+  size_t removed_next;
+};
+
+union RTPControlBuffer {
+  struct cmsghdr header;
+  char buffer[CMSG_SPACE(sizeof(struct timespec))];
+};
+
+struct RTPPacketSlot {
+  struct RTPPeer * peer;
+  unsigned short   seqnum;
+  unsigned long    timestamp;
+  size_t           payload_size;
+  struct sockaddr_storage addr;
+  struct iovec iov[2];
+  struct iovec msg_iov[RTP_IOV_LEN+3];
+  union RTPControlBuffer control;
+  struct RTPPacketBuffer * packet;
+  unsigned char buffer[RTP_BUF_LEN];
+};
+
 struct RTPSession {
   size_t refs;
   
   int socket;
   
   struct RTPAddress self;
-  struct RTPPeer *  peers[RTP_MAX_PEERS];
+  struct RTPPeerTable peers;
   struct RTPPacketInfo info;
   
   struct iovec iov[RTP_IOV_LEN];
   size_t buflen;
   void * buffer;
+  struct RTPPacketPool   * pool;
+  struct RTPPacketBuffer * received;
+
+  struct RTPPeer * group;
+  unsigned int     group_interface;
+
+  unsigned long rate;
+  int           kernel_timestamps;
+  unsigned long min_delay;
+  unsigned long max_delay;
+  size_t pending_length;
+  size_t pending_size;
+  struct RTPPeer ** pending;
+  struct RTPBufferedPacket * popped;
+
+  struct RTPImpairState    * impair_send;
+  struct RTPImpairState    * impair_receive;
+  struct RTPImpairedPacket * impaired;
+
+  struct mmsghdr       mmsg[RTP_MMSG_LEN];
+  struct RTPPacketSlot slots[RTP_MMSG_LEN];
 };
 
 /**
@@ -170,6 +320,62 @@ struct RTPSession {
  * @brief A control structure to manage the connection to an RTP peer.
  */
 
+/**
+ * @struct RTPBufferedPacket
+ * @brief A received packet waiting in a peer's reorder buffer.
+ * The packet keeps a reference to the pooled buffer it was received in.
+ * Packets that were not received into a pooled buffer are copied and
+ * their payload is stored directly behind the structure.
+ */
+
+/**
+ * @struct RTPPacketPool
+ * @brief A free list of packet buffers of one size.
+ * The pool is referenced by its session and by every buffer that is
+ * in use, so buffers may outlive the session.
+ */
+
+/**
+ * @struct RTPPacketBuffer
+ * @brief A reference counted buffer holding one received datagram.
+ * Released buffers go back to the free list of their pool.
+ */
+
+/**
+ * @struct RTPImpairment rtp.h
+ * @brief The behaviour of an emulated unreliable network.
+ * Probabilities range from 0 to 1, delays are given in microseconds.
+ * A zeroed structure (apart from the seed) leaves datagrams untouched.
+ * Delays and reordering only apply to received datagrams.
+ */
+
+/**
+ * @struct RTPImpairState
+ * @brief A network impairment with its random generator and loss state.
+ */
+
+/**
+ * @struct RTPImpairedPacket
+ * @brief A received datagram held back until its emulated arrival time.
+ */
+
+/**
+ * @struct RTPPeerTable
+ * @brief The peers of a session, indexed by SSRC and by address.
+ * Peers are kept in a list in the order they were added, removed peers
+ * leave a @c NULL entry until the list is compacted. Two open-addressing
+ * indices map SSRCs and socket addresses to positions in the list.
+ */
+
+/**
+ * @struct RTPPacketSlot
+ * @brief Per-packet storage for batched sending and receiving.
+ * Holds the send buffer, the pooled receive buffer, source address and
+ * @c iovec elements of one packet in a batch. The contents stay valid
+ * until the next batch call on the same session, unless the receive
+ * buffer is retained.
+ */
+
 /**
  * @struct RTPSession
  * @brief An RTP session that may be connected to multiple peers.
@@ -271,6 +477,16 @@ struct RTPSession {
  * @property RTPPacketInfo::iov
  * @brief A number of iovec elements that belong to the packet.
  */
+/**
+ * @property RTPPacketInfo::addr_size
+ * @brief The size of the address pointed to by @c addr.
+ */
+/**
+ * @property RTPPacketInfo::addr
+ * @brief The address a received packet originated from.
+ * Only filled out by RTPSessionReceivePackets. Points into storage owned
+ * by the session that is valid until the next batch receive.
+ */
 
 /**
  * @brief Create an RTPPeer instance.
@@ -293,6 +509,29 @@ struct RTPPeer * RTPPeerCreate( unsigned long ssrc, socklen_t size, struct socka
   peer->in_timestamp   = 0;
   peer->out_seqnum     = 0;
   peer->out_timestamp  = 0;
+  peer->in_cycles       = 0;
+  peer->in_base_seqnum  = 0;
+  peer->in_bad_seqnum   = 0x10001; /* matches no sequence number */
+  peer->in_received     = 0;
+  peer->in_octets       = 0;
+  peer->in_expected_prior = 0;
+  peer->in_received_prior = 0;
+  peer->in_lsr          = 0;
+  peer->in_lsr_arrival  = 0;
+  peer->in_transit      = 0;
+  peer->in_base_transit = 0;
+  peer->in_jitter       = 0;
+  peer->in_played       = 0;
+  peer->in_played_mask  = 0;
+  peer->in_playing      = 0;
+  peer->buffered_length = 0;
+  peer->buffered        = NULL;
+  peer->out_packets     = 0;
+  peer->out_octets      = 0;
+  peer->rtt             = 0;
+  peer->remote_fraction_lost = 0;
+  peer->remote_packets_lost  = 0;
+  peer->remote_jitter        = 0;
   peer->info = NULL;
   return peer;
 }
@@ -360,6 +599,63 @@ int RTPPeerGetAddress( struct RTPPeer * peer, socklen_t * size, struct sockaddr
   return 0;
 }
 
+/**
+ * @brief Get the sequence number of the last packet sent to a peer.
+ * @public @memberof RTPPeer
+ * @param peer The peer.
+ * @param seqnum The sequence number.
+ * @retval 0 on success.
+ * @retval >0 if the sequence number could not be obtained.
+ */
+int RTPPeerGetOutSequenceNumber( struct RTPPeer * peer, unsigned long * seqnum ) {
+  if( seqnum == NULL ) return 1;
+  *seqnum = peer->out_seqnum;
+  return 0;
+}
+
+/**
+ * @brief Get the interarrival jitter of packets received from a peer.
+ * The jitter is estimated as described in RFC 3550, section 6.4.1.
+ * @public @memberof RTPPeer
+ * @param peer The peer.
+ * @param jitter The jitter in timestamp units.
+ * @retval 0 on success.
+ * @retval >0 if the jitter could not be obtained.
+ */
+int RTPPeerGetJitter( struct RTPPeer * peer, unsigned long * jitter ) {
+  if( jitter == NULL ) return 1;
+  *jitter = peer->in_jitter >> 4;
+  return 0;
+}
+
+/**
+ * @brief Get the network statistics of a peer.
+ * Counters of sent and received packets and payload bytes, loss and
+ * jitter are maintained for every packet. The round-trip time and the
+ * peer's view of our stream are only known once the peer sent RTCP
+ * reports that refer to one of our sender reports.
+ * @public @memberof RTPPeer
+ * @param peer  The peer.
+ * @param stats The statistics.
+ * @retval 0 on success.
+ * @retval >0 if the statistics could not be obtained.
+ */
+int RTPPeerGetStats( struct RTPPeer * peer, struct RTPPeerStats * stats ) {
+  if( stats == NULL ) return 1;
+  stats->packets_sent     = peer->out_packets;
+  stats->bytes_sent       = peer->out_octets;
+  stats->packets_received = peer->in_received;
+  stats->bytes_received   = peer->in_octets;
+  stats->packets_lost     = ( peer->in_received == 0 ) ? 0 :
+    (long) ( peer->in_cycles + peer->in_seqnum - peer->in_base_seqnum + 1 ) - (long) peer->in_received;
+  stats->jitter           = peer->in_jitter >> 4;
+  stats->round_trip_time  = peer->rtt;
+  stats->remote_fraction_lost = peer->remote_fraction_lost;
+  stats->remote_packets_lost  = peer->remote_packets_lost;
+  stats->remote_jitter        = peer->remote_jitter;
+  return 0;
+}
+
 /**
  * @brief Set the internal info pointer.
  * @public @memberof RTPPeer
@@ -387,6 +683,409 @@ int RTPPeerGetInfo( struct RTPPeer * peer, void ** info ) {
   return 0;
 }
 
+/* MARK: Peer table *//**
+ * @name Peer table
+ * Hash-indexed storage of the peers connected to a session.
+ * @{
+ */
+
+static unsigned long _hash_bytes( unsigned long hash, size_t size, const void * data ) {
+  const unsigned char * bytes = data;
+  size_t i;
+  for( i=0; i<size; i++ ) {
+    hash = ( hash ^ bytes[i] ) * 16777619UL;
+  }
+  return hash;
+}
+
+static unsigned long _hash_ssrc( unsigned long ssrc ) {
+  return ssrc;
+}
+
+/**
+ * @brief Hash the identifying parts of a socket address.
+ * Only the family, port and host address are used so that any two
+ * addresses that compare equal also hash equal.
+ */
+static unsigned long _hash_addr( socklen_t size, struct sockaddr * addr ) {
+  unsigned long hash = 2166136261UL;
+  if( addr->sa_family == AF_INET && size >= sizeof(struct sockaddr_in) ) {
+    struct sockaddr_in * in = (struct sockaddr_in *) addr;
+    hash = _hash_bytes( hash, sizeof(in->sin_port), &(in->sin_port) );
+    hash = _hash_bytes( hash, sizeof(in->sin_addr), &(in->sin_addr) );
+#if (defined(AF_INET6))
+  } else if( addr->sa_family == AF_INET6 && size >= sizeof(struct sockaddr_in6) ) {
+    struct sockaddr_in6 * in6 = (struct sockaddr_in6 *) addr;
+    hash = _hash_bytes( hash, sizeof(in6->sin6_port), &(in6->sin6_port) );
+    hash = _hash_bytes( hash, sizeof(in6->sin6_addr), &(in6->sin6_addr) );
+#endif
+  } else {
+    hash = _hash_bytes( hash, size, addr );
+  }
+  return hash;
+}
+
+static size_t _peer_table_slot( struct RTPPeerTable * table, unsigned long hash ) {
+  /* mix all bits into the low ones, SSRCs may differ in their high bits only */
+  hash &= 0xffffffff;
+  hash ^= hash >> 16;
+  hash  = ( hash * 0x85ebca6bUL ) & 0xffffffff;
+  hash ^= hash >> 13;
+  hash  = ( hash * 0xc2b2ae35UL ) & 0xffffffff;
+  hash ^= hash >> 16;
+  return hash & table->mask;
+}
+
+static void _peer_table_index( struct RTPPeerTable * table, size_t * index, unsigned long hash, size_t i ) {
+  size_t s = _peer_table_slot( table, hash );
+  while( index[s] != RTP_PEER_NONE ) {
+    s = (s+1) & table->mask;
+  }
+  index[s] = i;
+}
+
+/**
+ * @brief Resize the peer table.
+ * Compact the peer list (dropping removed entries but keeping the order
+ * of the remaining peers) and rebuild both indices.
+ * @private @memberof RTPSession
+ */
+static int _peer_table_resize( struct RTPPeerTable * table, size_t capacity ) {
+  struct RTPPeer ** list;
+  size_t * by_ssrc, * by_addr;
+  size_t i, length, next, slots = capacity * 2;
+  struct RTPPeer * peer;
+
+  list    = malloc( sizeof(struct RTPPeer *) * capacity );
+  by_ssrc = malloc( sizeof(size_t) * slots );
+  by_addr = malloc( sizeof(size_t) * slots );
+  if( list == NULL || by_ssrc == NULL || by_addr == NULL ) {
+    free( list );
+    free( by_ssrc );
+    free( by_addr );
+    return 1;
+  }
+  for( i=0; i<slots; i++ ) {
+    by_ssrc[i] = RTP_PEER_NONE;
+    by_addr[i] = RTP_PEER_NONE;
+  }
+
+  /* move the position after the last removed peer along */
+  next = table->length;
+  for( i=0, length=0; i<table->length; i++ ) {
+    if( i == table->removed_next ) {
+      next = length;
+    }
+    if( table->list[i] != NULL ) {
+      list[length++] = table->list[i];
+    }
+  }
+  table->removed_next = ( next == table->length ) ? length : next;
+  free( table->list );
+  free( table->by_ssrc );
+  free( table->by_addr );
+  table->list     = list;
+  table->by_ssrc  = by_ssrc;
+  table->by_addr  = by_addr;
+  table->length   = length;
+  table->capacity = capacity;
+  table->mask     = slots - 1;
+
+  for( i=0; i<length; i++ ) {
+    peer = list[i];
+    _peer_table_index( table, by_ssrc, _hash_ssrc( peer->address.ssrc ), i );
+    _peer_table_index( table, by_addr, _hash_addr( peer->address.size, (struct sockaddr *) &(peer->address.addr) ), i );
+  }
+  return 0;
+}
+
+static void _peer_table_init( struct RTPPeerTable * table ) {
+  table->count    = 0;
+  table->length   = 0;
+  table->capacity = 0;
+  table->mask     = 0;
+  table->list     = NULL;
+  table->by_ssrc  = NULL;
+  table->by_addr  = NULL;
+  table->removed  = NULL;
+  table->removed_next = 0;
+}
+
+static void _peer_table_destroy( struct RTPPeerTable * table ) {
+  size_t i;
+  for( i=0; i<table->length; i++ ) {
+    if( table->list[i] != NULL ) {
+      RTPPeerRelease( table->list[i] );
+    }
+  }
+  free( table->list );
+  free( table->by_ssrc );
+  free( table->by_addr );
+  _peer_table_init( table );
+}
+
+static int _peer_table_add( struct RTPPeerTable * table, struct RTPPeer * peer ) {
+  size_t capacity, i;
+  if( table->length == table->capacity ) {
+    /* compact removed entries away, grow if the table is half full */
+    for( capacity = RTP_PEER_TABLE_LEN; capacity < table->count * 2; capacity *= 2 ) {}
+    if( _peer_table_resize( table, capacity ) ) return 1;
+  }
+  if( peer == table->removed ) {
+    table->removed = NULL;
+  }
+  i = table->length++;
+  table->list[i] = peer;
+  table->count++;
+  _peer_table_index( table, table->by_ssrc, _hash_ssrc( peer->address.ssrc ), i );
+  _peer_table_index( table, table->by_addr, _hash_addr( peer->address.size, (struct sockaddr *) &(peer->address.addr) ), i );
+  return 0;
+}
+
+/**
+ * @brief Find the position of a peer in the peer list.
+ * @private @memberof RTPSession
+ * @retval 0 if the peer was found.
+ * @retval 1 if the peer is not part of the table.
+ */
+static int _peer_table_find( struct RTPPeerTable * table, struct RTPPeer * peer, size_t * i ) {
+  size_t s;
+  if( table->count == 0 ) return 1;
+  s = _peer_table_slot( table, _hash_ssrc( peer->address.ssrc ) );
+  while( table->by_ssrc[s] != RTP_PEER_NONE ) {
+    if( table->list[table->by_ssrc[s]] == peer ) {
+      *i = table->by_ssrc[s];
+      return 0;
+    }
+    s = (s+1) & table->mask;
+  }
+  return 1;
+}
+
+/** @} */
+
+/* MARK: Packet buffers *//**
+ * @name Packet buffers
+ * Pooled, reference counted buffers for received datagrams. A received
+ * packet references the buffer it was read into, so its data can be
+ * handed on without copying and stays valid as long as a reference is
+ * held. Pools are not thread-safe, buffers must be released on the
+ * thread of the session that received them.
+ * @{
+ */
+
+static struct RTPPacketPool * _pool_create( size_t size ) {
+  struct RTPPacketPool * pool = malloc( sizeof(struct RTPPacketPool) );
+  if( pool == NULL ) return NULL;
+  pool->refs   = 1;
+  pool->size   = size;
+  pool->length = 0;
+  pool->free   = NULL;
+  return pool;
+}
+
+static void _pool_release( struct RTPPacketPool * pool ) {
+  struct RTPPacketBuffer * buffer;
+  if( --pool->refs ) return;
+  while( pool->free != NULL ) {
+    buffer     = pool->free;
+    pool->free = buffer->next;
+    free( buffer );
+  }
+  free( pool );
+}
+
+/**
+ * @brief Take a buffer from a pool, allocating a new one if the pool is empty.
+ * @private @memberof RTPPacketPool
+ */
+static struct RTPPacketBuffer * _pool_take( struct RTPPacketPool * pool ) {
+  struct RTPPacketBuffer * buffer = pool->free;
+  if( buffer != NULL ) {
+    pool->free = buffer->next;
+    pool->length--;
+  } else {
+    buffer = malloc( sizeof(struct RTPPacketBuffer) + pool->size );
+    if( buffer == NULL ) return NULL;
+    buffer->pool = pool;
+    buffer->size = pool->size;
+    buffer->data = (unsigned char *) (buffer + 1);
+  }
+  buffer->refs = 1;
+  buffer->next = NULL;
+  pool->refs++;
+  return buffer;
+}
+
+/**
+ * @brief Retain a packet buffer.
+ * Keep the data of a received packet valid after the session moved on.
+ * @public @memberof RTPPacketBuffer
+ * @param buffer The buffer.
+ */
+void RTPPacketBufferRetain( struct RTPPacketBuffer * buffer ) {
+  buffer->refs++;
+}
+
+/**
+ * @brief Release a packet buffer.
+ * Decrement the reference counter of a buffer. If it reaches zero the
+ * buffer is returned to its pool.
+ * @public @memberof RTPPacketBuffer
+ * @param buffer The buffer.
+ */
+void RTPPacketBufferRelease( struct RTPPacketBuffer * buffer ) {
+  struct RTPPacketPool * pool;
+  if( --buffer->refs ) return;
+  pool = buffer->pool;
+  if( pool->length < RTP_POOL_LEN ) {
+    buffer->next = pool->free;
+    pool->free   = buffer;
+    pool->length++;
+  } else {
+    free( buffer );
+  }
+  _pool_release( pool );
+}
+
+/**
+ * @brief Get the data of a packet buffer.
+ * @public @memberof RTPPacketBuffer
+ * @param buffer The buffer.
+ * @param size   The size of the buffer.
+ * @param data   The data.
+ * @retval 0 on success.
+ * @retval >0 if the data could not be obtained.
+ */
+int RTPPacketBufferGetData( struct RTPPacketBuffer * buffer, size_t * size, void ** data ) {
+  if( size == NULL || data == NULL ) return 1;
+  *size = buffer->size;
+  *data = buffer->data;
+  return 0;
+}
+
+/**
+ * @brief Make sure a receive buffer is not shared with anyone else.
+ * Reuse the buffer if the session holds the only reference, otherwise
+ * (or if the buffer is too small) replace it with a fresh one.
+ * @private @memberof RTPSession
+ * @param session The session.
+ * @param buffer  The session's reference to a receive buffer.
+ * @retval 0 on success.
+ * @retval >0 if no buffer could be obtained.
+ */
+static int _pool_renew( struct RTPSession * session, struct RTPPacketBuffer ** buffer ) {
+  if( *buffer != NULL ) {
+    if( (*buffer)->refs == 1 && (*buffer)->pool == session->pool ) return 0;
+    RTPPacketBufferRelease( *buffer );
+    *buffer = NULL;
+  }
+  if( session->pool == NULL ) return 1;
+  *buffer = _pool_take( session->pool );
+  return ( *buffer == NULL ) ? 1 : 0;
+}
+
+/**
+ * @brief Set the size of the buffers packets are received into.
+ * Datagrams larger than this are dropped. The default of RTP_PACKET_LEN
+ * bytes fits any packet on a standard Ethernet link, use a larger size
+ * for jumbo frames or large reassembled datagrams. Buffers of the
+ * previous size that are still referenced stay valid.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @param size    The buffer size in bytes.
+ * @retval 0 on success.
+ * @retval >0 if the size is invalid or the pool could not be created.
+ */
+int RTPSessionSetPacketSize( struct RTPSession * session, size_t size ) {
+  struct RTPPacketPool * pool;
+  if( size < 12 || size > RTP_PACKET_MAX_LEN ) return 1;
+  if( session->pool != NULL && session->pool->size == size ) return 0;
+  pool = _pool_create( size );
+  if( pool == NULL ) return 1;
+  if( session->pool != NULL ) {
+    _pool_release( session->pool );
+  }
+  session->pool = pool;
+  return 0;
+}
+
+static void _pool_clear( struct RTPSession * session ) {
+  int i;
+  if( session->received != NULL ) {
+    RTPPacketBufferRelease( session->received );
+    session->received = NULL;
+  }
+  for( i=0; i<RTP_MMSG_LEN; i++ ) {
+    if( session->slots[i].packet != NULL ) {
+      RTPPacketBufferRelease( session->slots[i].packet );
+      session->slots[i].packet = NULL;
+    }
+  }
+}
+
+/** @} */
+
+/* MARK: Reorder buffer *//**
+ * @name Reorder buffer
+ * Storage of received packets that wait for their playout time.
+ * @{
+ */
+
+static void _buffered_free( struct RTPBufferedPacket * packet ) {
+  if( packet->info.buffer != NULL ) {
+    RTPPacketBufferRelease( packet->info.buffer );
+  }
+  RTPPeerRelease( packet->info.peer );
+  free( packet );
+}
+
+static void _buffered_free_list( struct RTPBufferedPacket * packet ) {
+  struct RTPBufferedPacket * next;
+  while( packet != NULL ) {
+    next = packet->next;
+    _buffered_free( packet );
+    packet = next;
+  }
+}
+
+static int _pending_add( struct RTPSession * session, struct RTPPeer * peer ) {
+  size_t size;
+  struct RTPPeer ** pending;
+  if( session->pending_length == session->pending_size ) {
+    size    = ( session->pending_size == 0 ) ? 8 : session->pending_size * 2;
+    pending = realloc( session->pending, sizeof(struct RTPPeer *) * size );
+    if( pending == NULL ) return 1;
+    session->pending      = pending;
+    session->pending_size = size;
+  }
+  session->pending[session->pending_length++] = peer;
+  return 0;
+}
+
+static void _pending_remove( struct RTPSession * session, size_t i ) {
+  session->pending[i] = session->pending[--session->pending_length];
+}
+
+static void _playout_clear( struct RTPSession * session ) {
+  size_t i;
+  struct RTPBufferedPacket * list;
+  for( i=0; i<session->pending_length; i++ ) {
+    list = session->pending[i]->buffered;
+    session->pending[i]->buffered        = NULL;
+    session->pending[i]->buffered_length = 0;
+    _buffered_free_list( list );
+  }
+  free( session->pending );
+  session->pending        = NULL;
+  session->pending_length = 0;
+  session->pending_size   = 0;
+  _buffered_free_list( session->popped );
+  session->popped = NULL;
+}
+
+/** @} */
+
 /* MARK: Creation and destruction *//**
  * @name Creation and destruction
  * Creating, destroying and reference counting of RTPSession objects.
@@ -439,18 +1138,41 @@ struct RTPSession * RTPSessionCreate( int socket ) {
   session->socket = socket;
 
   _init_addr_with_socket( &(session->self), socket );
-  for( i=0; i<RTP_MAX_PEERS; i++ ) {
-    session->peers[i] = NULL;
-  }
-  
+  _peer_table_init( &(session->peers) );
+  session->group = NULL;
+
+  session->rate           = RTP_DEFAULT_CLOCK_RATE;
+  session->kernel_timestamps = 0;
+  session->min_delay      = 0;
+  session->max_delay      = 0;
+  session->pending_length = 0;
+  session->pending_size   = 0;
+  session->pending        = NULL;
+  session->popped         = NULL;
+
+  session->impair_send    = NULL;
+  session->impair_receive = NULL;
+  session->impaired       = NULL;
   
+  session->pool     = _pool_create( RTP_PACKET_LEN );
+  if( session->pool == NULL ) {
+    free( session );
+    return NULL;
+  }
+  session->received = NULL;
+  for( i=0; i<RTP_MMSG_LEN; i++ ) {
+    session->slots[i].packet = NULL;
+  }
+
   session->buflen = RTP_BUF_LEN;
   session->buffer = malloc( session->buflen );
   if( session->buffer == NULL ) {
-    session->buflen = 0;
+    _pool_release( session->pool );
+    free( session );
+    return NULL;
   }
   session->iov[0].iov_base = session->buffer;
-  session->iov[9].iov_len  = session->buflen;
+  session->iov[0].iov_len  = session->buflen;
   for( i=1; i<RTP_IOV_LEN; i++ ) {
     session->iov[i].iov_base = NULL;
     session->iov[i].iov_len  = 0;
@@ -467,6 +1189,9 @@ struct RTPSession * RTPSessionCreate( int socket ) {
   session->info.ssrc         = session->self.ssrc;
   session->info.iovlen       = RTP_IOV_LEN;
   session->info.iov          = &(session->iov[0]);
+  session->info.addr_size    = 0;
+  session->info.addr         = NULL;
+  session->info.buffer       = NULL;
 
   return session;
 }
@@ -478,11 +1203,15 @@ struct RTPSession * RTPSessionCreate( int socket ) {
  * @param session The session.
  */
 void RTPSessionDestroy( struct RTPSession * session ) {
-  int i;
-  for( i=0; i<RTP_MAX_PEERS; i++ ) {
-    if( session->peers[i] != NULL ) {
-      RTPPeerRelease( session->peers[i] );
-    }
+  _playout_clear( session );
+  RTPSessionSetImpairment( session, NULL, NULL );
+  _pool_clear( session );
+  if( session->pool != NULL ) {
+    _pool_release( session->pool );
+  }
+  _peer_table_destroy( &(session->peers) );
+  if( session->group != NULL ) {
+    RTPPeerRelease( session->group );
   }
   free( session->buffer );
   close( session->socket );
@@ -565,57 +1294,347 @@ int RTPSessionGetSocket( struct RTPSession * session, int * socket ) {
   return 0;
 }
 
-/**
- * @brief Add an RTPPeer to the session.
- * Lookup the peer using the (pseudo) hash-table, add it to the list and retain it.
- * The peer will be included when data is sent via RTPSessionSendPayload.
- * @public @memberof RTPSession
- * @param session The session.
- * @param peer The peer to add.
- * @retval 0 on success.
- * @retval >0 if the peer could not be added.
+/* MARK: Multicast *//**
+ * @name Multicast
+ * Sending to and receiving from an IP multicast group.
+ * In multicast mode packets that are broadcast to "all peers" are sent
+ * to the group address exactly once. Received packets are still
+ * attributed to peers by their SSRC.
+ * @{
  */
-int RTPSessionAddPeer( struct RTPSession * session, struct RTPPeer * peer ) {
-  int i, off, p;
-  off = peer->address.ssrc % RTP_MAX_PEERS;
-  for( i=0; i < RTP_MAX_PEERS; i++ ) {
-    p = (i+off)%RTP_MAX_PEERS;
-    if( session->peers[p] == NULL ) {
-      session->peers[p] = peer;
-      RTPPeerRetain( peer );
-      return 0;
+
+static int _multicast_level( int family ) {
+  switch( family ) {
+    case AF_INET:
+      return IPPROTO_IP;
+#if (defined(AF_INET6))
+    case AF_INET6:
+      return IPPROTO_IPV6;
+#endif
+    default:
+      return -1;
+  }
+}
+
+static int _multicast_membership( struct RTPSession * session, int option, socklen_t size,
+                                  struct sockaddr * group, unsigned int interface ) {
+  struct group_req req;
+  int level = _multicast_level( group->sa_family );
+  if( level < 0 || size > sizeof(req.gr_group) ) return 1;
+  memset( &req, 0, sizeof(req) );
+  req.gr_interface = interface;
+  memcpy( &(req.gr_group), group, size );
+  return ( setsockopt( session->socket, level, option, &req, sizeof(req) ) == 0 ) ? 0 : 1;
+}
+
+static int _multicast_interface( struct RTPSession * session, int family, unsigned int interface ) {
+  if( interface == 0 ) return 0;
+  switch( family ) {
+#ifdef __linux__
+    case AF_INET: {
+      struct ip_mreqn req;
+      memset( &req, 0, sizeof(req) );
+      req.imr_ifindex = interface;
+      return setsockopt( session->socket, IPPROTO_IP, IP_MULTICAST_IF, &req, sizeof(req) ) ? 1 : 0;
     }
+#else
+    case AF_INET:
+      /* IP_MULTICAST_IF takes an interface address here, not an index */
+      return 1;
+#endif
+#if (defined(AF_INET6))
+    case AF_INET6:
+      return setsockopt( session->socket, IPPROTO_IPV6, IPV6_MULTICAST_IF, &interface, sizeof(interface) ) ? 1 : 0;
+#endif
+    default:
+      return 0;
   }
-  return 1;
 }
 
 /**
- * @brief Remove an RTPPeer from the session.
- * Lookup the peer using the (pseudo) hash-table, remove it from the list and release it.
+ * @brief Join an IP multicast group.
+ * Subscribe the session's socket to the group and send all broadcast
+ * packets to the group instead of to each peer. The socket must be
+ * bound to the group's port. A previously joined group is left.
  * @public @memberof RTPSession
- * @param session The session.
- * @param peer The peer to remove.
+ * @param session   The session.
+ * @param size      The size of the address pointed to by @c group.
+ * @param group     The IPv4 or IPv6 group address including the port.
+ * @param interface The index of the network interface to use, or 0 for the default.
+ *                  Selecting an interface for IPv4 groups is only supported on Linux.
  * @retval 0 on success.
- * @retval >0 if the peer could not be removed.
+ * @retval >0 if the group could not be joined.
  */
-int RTPSessionRemovePeer( struct RTPSession * session, struct RTPPeer * peer ) {
-  int i, off, p;
-  off = peer->address.ssrc % RTP_MAX_PEERS;
-  for( i=0; i < RTP_MAX_PEERS; i++ ) {
-    p = (i+off)%RTP_MAX_PEERS;
-    if( session->peers[p] == peer ) {
-      session->peers[p] = NULL;
-      RTPPeerRelease( peer );
-      return 0;
-    }
+int RTPSessionJoinGroup( struct RTPSession * session, socklen_t size, struct sockaddr * group,
+                         unsigned int interface ) {
+  struct RTPPeer * peer;
+  if( group == NULL ) return 1;
+  if( session->group != NULL ) {
+    RTPSessionLeaveGroup( session );
   }
-  return 1;
+  peer = RTPPeerCreate( session->self.ssrc, size, group );
+  if( peer == NULL ) return 1;
+  if( _multicast_membership( session, MCAST_JOIN_GROUP, size, group, interface ) ) {
+    RTPPeerRelease( peer );
+    return 1;
+  }
+  if( _multicast_interface( session, group->sa_family, interface ) ) {
+    _multicast_membership( session, MCAST_LEAVE_GROUP, size, group, interface );
+    RTPPeerRelease( peer );
+    return 1;
+  }
+  session->group           = peer;
+  session->group_interface = interface;
+  return 0;
 }
 
 /**
- * @brief Advance the pointer to the next peer.
+ * @brief Leave the IP multicast group.
+ * Unsubscribe from the group and return to sending to each peer.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @retval 0 on success.
+ * @retval >0 if the session is not part of a group.
+ */
+int RTPSessionLeaveGroup( struct RTPSession * session ) {
+  struct RTPPeer * peer = session->group;
+  if( peer == NULL ) return 1;
+  _multicast_membership( session, MCAST_LEAVE_GROUP, peer->address.size,
+                         (struct sockaddr *) &(peer->address.addr), session->group_interface );
+  session->group = NULL;
+  RTPPeerRelease( peer );
+  return 0;
+}
+
+/**
+ * @brief Get the multicast group of the session.
+ * The group is represented by a peer that is not part of the session's
+ * peer list. It can be used to send packets to the group.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @param group   The group peer.
+ * @retval 0 on success.
+ * @retval >0 if the session is not part of a group.
+ */
+int RTPSessionGetGroup( struct RTPSession * session, struct RTPPeer ** group ) {
+  if( group == NULL || session->group == NULL ) return 1;
+  *group = session->group;
+  return 0;
+}
+
+/**
+ * @brief Set the time-to-live (hop limit) of sent multicast packets.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @param ttl     The number of hops, 1 restricts packets to the local network.
+ * @retval 0 on success.
+ * @retval >0 if the option could not be set.
+ */
+int RTPSessionSetMulticastTTL( struct RTPSession * session, int ttl ) {
+  switch( session->self.addr.ss_family ) {
+    case AF_INET:
+      return setsockopt( session->socket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl) ) ? 1 : 0;
+#if (defined(AF_INET6))
+    case AF_INET6:
+      return setsockopt( session->socket, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &ttl, sizeof(ttl) ) ? 1 : 0;
+#endif
+    default:
+      return 1;
+  }
+}
+
+/**
+ * @brief Enable or disable the local delivery of sent multicast packets.
+ * Packets the session receives from itself are never attributed to a peer.
+ * @public @memberof RTPSession
+ * @param session  The session.
+ * @param loopback Non-zero to deliver sent packets to group members on this host.
+ * @retval 0 on success.
+ * @retval >0 if the option could not be set.
+ */
+int RTPSessionSetMulticastLoopback( struct RTPSession * session, int loopback ) {
+  unsigned int loop = loopback ? 1 : 0;
+  switch( session->self.addr.ss_family ) {
+    case AF_INET:
+      return setsockopt( session->socket, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop) ) ? 1 : 0;
+#if (defined(AF_INET6))
+    case AF_INET6:
+      return setsockopt( session->socket, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, &loop, sizeof(loop) ) ? 1 : 0;
+#endif
+    default:
+      return 1;
+  }
+}
+
+/** @} */
+
+/* MARK: Sharding *//**
+ * @name Sharding
+ * Spreading the receive work of one RTP endpoint over several sockets
+ * that share the same address using @c SO_REUSEPORT. Every shard is a
+ * session of its own, with its own socket, peers and buffers, so it can
+ * be driven by its own runloop thread without any locking. As long as
+ * the packets of a peer always arrive on the same shard, per-peer state
+ * is only ever touched by one thread.
+ * @{
+ */
+
+/**
+ * @brief Create a shard of a session.
+ * Open a new socket with @c SO_REUSEPORT, bind it to the session's address
+ * and create a session for it that shares the SSRC, clock rate and playout
+ * delay of @c session. The session's socket must have been bound with
+ * @c SO_REUSEPORT enabled.
+ * Without steering (see RTPSessionSetShardSteering) the kernel distributes
+ * datagrams by a hash of their source and destination addresses, which
+ * already keeps each peer on one shard.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @param shard   The created shard. Release it when it is no longer needed.
+ * @retval 0 on success.
+ * @retval >0 if the shard could not be created.
+ */
+int RTPSessionCreateShard( struct RTPSession * session, struct RTPSession ** shard ) {
+#ifdef SO_REUSEPORT
+  struct sockaddr_storage addr;
+  socklen_t size = sizeof(addr);
+  socklen_t optlen = sizeof(int);
+  int fd, reuse = 0;
+#if (defined(AF_INET6))
+  int v6only = 0;
+#endif
+
+  if( shard == NULL ) return 1;
+  if( getsockopt( session->socket, SOL_SOCKET, SO_REUSEPORT, &reuse, &optlen ) || !reuse ) return 1;
+  if( getsockname( session->socket, (struct sockaddr *) &addr, &size ) ) return 1;
+
+  fd = socket( addr.ss_family, SOCK_DGRAM, 0 );
+  if( fd == -1 ) return 1;
+#if (defined(AF_INET6))
+  if( addr.ss_family == AF_INET6 ) {
+    optlen = sizeof(v6only);
+    getsockopt( session->socket, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, &optlen );
+    setsockopt( fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only) );
+  }
+#endif
+  if( setsockopt( fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse) ) ||
+      bind( fd, (struct sockaddr *) &addr, size ) ) {
+    close( fd );
+    return 1;
+  }
+
+  *shard = RTPSessionCreate( fd );
+  if( *shard == NULL ) {
+    close( fd );
+    return 1;
+  }
+  RTPSessionSetSSRC( *shard, session->self.ssrc );
+  (*shard)->rate      = session->rate;
+  (*shard)->min_delay = session->min_delay;
+  (*shard)->max_delay = session->max_delay;
+  if( session->pool != NULL ) {
+    RTPSessionSetPacketSize( *shard, session->pool->size );
+  }
+  return 0;
+#else
+  return 1;
+#endif
+}
+
+/**
+ * @brief Steer datagrams to shards by the SSRC of their sender.
+ * Attach a classic BPF program to the socket group of the session that
+ * picks the shard with index SSRC modulo @c shards. This keeps a peer on
+ * the same shard even if its address changes. RTCP packets are steered
+ * by their sender SSRC as well. Other datagrams (like session protocol
+ * commands) are steered by whatever is at the SSRC position.
+ * Shard indices follow the order in which the sockets were bound: the
+ * session's own socket is 0, its shards follow in creation order. The
+ * kernel renumbers the group when a socket is closed, so the steering
+ * must be set up again after destroying a shard.
+ * Only available on Linux.
+ * @public @memberof RTPSession
+ * @param session The session (or any of its shards).
+ * @param shards  The total number of sockets in the group.
+ * @retval 0 on success.
+ * @retval >0 if the steering program could not be attached.
+ */
+int RTPSessionSetShardSteering( struct RTPSession * session, size_t shards ) {
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+  struct sock_filter code[] = {
+    BPF_STMT( BPF_LD  | BPF_B   | BPF_ABS, 1 ),       /* A = payload type */
+    BPF_JUMP( BPF_JMP | BPF_JGE | BPF_K,   192, 0, 3 ),
+    BPF_JUMP( BPF_JMP | BPF_JGT | BPF_K,   223, 2, 0 ),
+    BPF_STMT( BPF_LD  | BPF_W   | BPF_ABS, 4 ),       /* A = RTCP sender SSRC */
+    BPF_STMT( BPF_JMP | BPF_JA,            1 ),
+    BPF_STMT( BPF_LD  | BPF_W   | BPF_ABS, 8 ),       /* A = RTP SSRC */
+    BPF_STMT( BPF_ALU | BPF_MOD | BPF_K,   0 ),
+    BPF_STMT( BPF_RET | BPF_A,             0 )
+  };
+  struct sock_fprog program;
+
+  if( shards == 0 ) return 1;
+  code[6].k = shards;
+  program.len    = sizeof(code) / sizeof(code[0]);
+  program.filter = &(code[0]);
+  if( setsockopt( session->socket, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program) ) ) {
+    return 1;
+  }
+  return 0;
+#else
+  return 1;
+#endif
+}
+
+/** @} */
+
+/**
+ * @brief Add an RTPPeer to the session.
+ * Append the peer to the peer list, index it by SSRC and address and retain it.
+ * The peer will be included when data is sent via RTPSessionSendPayload.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @param peer The peer to add.
+ * @retval 0 on success.
+ * @retval >0 if the peer could not be added.
+ */
+int RTPSessionAddPeer( struct RTPSession * session, struct RTPPeer * peer ) {
+  if( _peer_table_add( &(session->peers), peer ) ) return 1;
+  RTPPeerRetain( peer );
+  return 0;
+}
+
+/**
+ * @brief Remove an RTPPeer from the session.
+ * Lookup the peer using the SSRC index, remove it from the list and release it.
+ * The peer may be the one that RTPSessionNextPeer returned last. If it is
+ * the last peer removed before the next call, iteration continues with
+ * the peer that followed it.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @param peer The peer to remove.
+ * @retval 0 on success.
+ * @retval >0 if the peer could not be removed.
+ */
+int RTPSessionRemovePeer( struct RTPSession * session, struct RTPPeer * peer ) {
+  size_t i;
+  if( _peer_table_find( &(session->peers), peer, &i ) ) return 1;
+  /* leave the index entries, they are skipped until the next resize */
+  session->peers.list[i] = NULL;
+  session->peers.count--;
+  session->peers.removed      = peer;
+  session->peers.removed_next = i+1;
+  RTPPeerRelease( peer );
+  return 0;
+}
+
+/**
+ * @brief Advance the pointer to the next peer.
  * Given a @c NULL pointer the first peer will be returned. When the
  * last peer was reached a @c NULL pointer will be returned.
+ * Peers are iterated in the order they were added, adding or removing
+ * other peers while iterating does not affect the position. The given
+ * peer may have been removed just before, see RTPSessionRemovePeer.
  * @public @memberof RTPSession
  * @param session The session.
  * @param peer The peer.
@@ -623,26 +1642,25 @@ int RTPSessionRemovePeer( struct RTPSession * session, struct RTPPeer * peer ) {
  * @retval >0 if the given peer does not exist.
  */
 int RTPSessionNextPeer( struct RTPSession * session, struct RTPPeer ** peer ) {
-  int i;
+  size_t i;
   if( peer == NULL ) return 1;
   if( *peer == NULL ) {
-    i=-1;
+    i = 0;
+  } else if( *peer == session->peers.removed ) {
+    /* don't touch the peer, it may be gone with its last reference */
+    i = session->peers.removed_next;
   } else {
-    for( i=0; i < RTP_MAX_PEERS; i++ ) {
-      if( session->peers[i] == *peer ) {
-        break;
-      }
-    }
-    if( i == RTP_MAX_PEERS ) return 1;
+    if( _peer_table_find( &(session->peers), *peer, &i ) ) return 1;
+    i++;
   }
 
-  do {
-     i++;
-  } while( i < RTP_MAX_PEERS && session->peers[i] == NULL );
-  if( i == RTP_MAX_PEERS ) {
+  while( i < session->peers.length && session->peers.list[i] == NULL ) {
+    i++;
+  }
+  if( i == session->peers.length ) {
     *peer = NULL;
   } else {
-    *peer = session->peers[i];
+    *peer = session->peers.list[i];
   }
   return 0;
 }
@@ -658,16 +1676,18 @@ int RTPSessionNextPeer( struct RTPSession * session, struct RTPPeer ** peer ) {
  */
 int RTPSessionFindPeerBySSRC( struct RTPSession * session, struct RTPPeer ** peer,
                               unsigned long ssrc ) {
-  int i, off, p;
-  off = ssrc % RTP_MAX_PEERS;
-  for( i=0; i < RTP_MAX_PEERS; i++ ) {
-    p = (i+off)%RTP_MAX_PEERS;
-    if( session->peers[p] != NULL ) {
-      if( session->peers[p]->address.ssrc == ssrc ) {
-        *peer = session->peers[p];
-        return 0;
-      }
+  struct RTPPeerTable * table = &(session->peers);
+  struct RTPPeer * p;
+  size_t s;
+  if( table->count == 0 ) return 1;
+  s = _peer_table_slot( table, _hash_ssrc( ssrc ) );
+  while( table->by_ssrc[s] != RTP_PEER_NONE ) {
+    p = table->list[table->by_ssrc[s]];
+    if( p != NULL && p->address.ssrc == ssrc ) {
+      *peer = p;
+      return 0;
     }
+    s = (s+1) & table->mask;
   }
   return 1;
 }
@@ -684,17 +1704,18 @@ int RTPSessionFindPeerBySSRC( struct RTPSession * session, struct RTPPeer ** pee
  */
 int RTPSessionFindPeerByAddress( struct RTPSession * session, struct RTPPeer ** peer,
                                  socklen_t size, struct sockaddr * addr ) {
-  int i;
-  socklen_t s;
-  struct sockaddr * a;
-  for( i=0; i < RTP_MAX_PEERS; i++ ) {
-    if( session->peers[i] != NULL ) {
-      RTPPeerGetAddress( session->peers[i], &s, &a );
-      if( s == size && memcmp( a, addr, s ) == 0 ) {
-        *peer = session->peers[i];
-        return 0;
-      }
+  struct RTPPeerTable * table = &(session->peers);
+  struct RTPPeer * p;
+  size_t s;
+  if( table->count == 0 ) return 1;
+  s = _peer_table_slot( table, _hash_addr( size, addr ) );
+  while( table->by_addr[s] != RTP_PEER_NONE ) {
+    p = table->list[table->by_addr[s]];
+    if( p != NULL && p->address.size == size && memcmp( &(p->address.addr), addr, size ) == 0 ) {
+      *peer = p;
+      return 0;
     }
+    s = (s+1) & table->mask;
   }
   return 1;
 }
@@ -756,12 +1777,12 @@ static int _rtp_decode_header( struct RTPPacketInfo * info, size_t size, void *
   info->sequence_number = ( buffer[2] << 8 )
                         |   buffer[3];
 
-  info->timestamp       = ( buffer[4] << 24 )
+  info->timestamp       = ( (unsigned long) buffer[4] << 24 )
                         | ( buffer[5] << 16 )
                         | ( buffer[6] << 8 )
                         |   buffer[7];
 
-  info->ssrc            = ( buffer[8] << 24 )
+  info->ssrc            = ( (unsigned long) buffer[8] << 24 )
                         | ( buffer[9] << 16 )
                         | ( buffer[10] << 8 )
                         |   buffer[11];
@@ -771,7 +1792,7 @@ static int _rtp_decode_header( struct RTPPacketInfo * info, size_t size, void *
   if( size < header_size ) return 1;
 
   for( i=0, j=0; i<info->csrc_count; i++, j+=4 ) {
-    info->csrc[i] = ( buffer[12+j] << 24 )
+    info->csrc[i] = ( (unsigned long) buffer[12+j] << 24 )
                   | ( buffer[13+j] << 16 )
                   | ( buffer[14+j] << 8 )
                   |   buffer[15+j];
@@ -793,6 +1814,7 @@ static int _rtp_encode_extension( struct RTPPacketInfo * info, size_t size, void
       /* fill up to whole 4 bytes words */
       ext_header_size += 4 - (info->iov[0].iov_len % 4);
     }
+    if( size < ext_header_size ) return 1;
 
     memcpy( buffer, info->iov[0].iov_base, info->iov[0].iov_len );
     i = ext_header_size / 4;
@@ -813,9 +1835,11 @@ static int _rtp_decode_extension( struct RTPPacketInfo * info, size_t size, void
 
   if( info->extension ) {
     if( info->iovlen < 1 ) return 1;
+    if( size < 4 ) return 1;
     i = ( buffer[2] << 8 )
       |   buffer[3];
     ext_header_size = 4 + (i*4);
+    if( size < ext_header_size ) return 1;
     info->iov[0].iov_base = buffer;
     info->iov[0].iov_len  = ext_header_size;
   } else {
@@ -847,186 +1871,1173 @@ static void _append_iov( size_t * iovlen, struct iovec * iov, size_t size, void
   *iovlen += 1;
 }
 
+static void _init_msghdr( struct msghdr * msg, socklen_t size, void * addr, size_t iovlen, struct iovec * iov ) {
+  msg->msg_name       = addr;
+  msg->msg_namelen    = size;
+  msg->msg_iov        = iov;
+  msg->msg_iovlen     = iovlen;
+  msg->msg_control    = NULL;
+  msg->msg_controllen = 0;
+  msg->msg_flags      = 0;
+}
+
+static void _rtp_log_iov( const char * action, size_t iovlen, struct iovec * iov ) {
+#ifndef NO_LOG
+  int i, j;
+  MIDILogLocation( DEBUG, "%s RTP message consisting of %i iovecs.\n", action, (int) iovlen );
+  for( i=0; i<iovlen; i++ ) {
+    MIDILog( DEBUG, "[%i] iov_len: %i, iov_base: %p\n", i, (int) iov[i].iov_len, iov[i].iov_base );
+    for( j=0; j<iov[i].iov_len; j++ ) {
+      unsigned char c = *((unsigned char*)iov[i].iov_base+j);
+      if( (j+1) % 8 == 0 || j+1 == iov[i].iov_len ) {
+        MIDILog( DEBUG, "0x%02x\n", c );
+      } else {
+        MIDILog( DEBUG, "0x%02x ", c );
+      }
+    }
+  }
+#endif
+}
+
 /**
- * @brief Send an RTP packet.
- * @public @memberof RTPSession
+ * @brief Encode an RTP packet into a list of iovecs.
+ * Write the header, extension and padding to @c data and compose the
+ * @c iovec list that makes up the datagram.
+ * @private @memberof RTPSession
  * @param session The session.
- * @param info The packet info.
+ * @param info    The packet info.
+ * @param size    The number of bytes available in @c data.
+ * @param data    The buffer to encode header, extension and padding into.
+ * @param iovlen  The number of used elements in @c iov.
+ * @param iov     The @c iovec list, at least RTP_IOV_LEN+3 elements long.
  * @retval 0 On success.
- * @retval >0 If the message could not be sent.
+ * @retval >0 If the packet could not be encoded.
  */
-int RTPSessionSendPacket( struct RTPSession * session, struct RTPPacketInfo * info ) {
-  size_t size, written = 0, iovlen = 0;
-  void * buffer;
-  struct msghdr msg;
-  struct iovec  iov[RTP_IOV_LEN+3];
-  ssize_t bytes_sent;
-  
-  if( info == NULL || info->peer == NULL ) return 1;
-  if( info->iovlen > RTP_IOV_LEN ) return 1;
-  
-  size   = session->buflen;
-  buffer = session->buffer;
+static int _rtp_encode_packet( struct RTPSession * session, struct RTPPacketInfo * info,
+                               size_t size, void * data, size_t * iovlen, struct iovec * iov ) {
+  int i = 0;
+  size_t written = 0;
+  void * buffer = data;
 
-  info->ssrc            = session->self.ssrc;
-  info->sequence_number = info->peer->out_seqnum + 1;
+  if( info->iovlen > RTP_IOV_LEN ) return 1;
 
+  info->ssrc       = session->self.ssrc;
   info->total_size = 0;
-  _rtp_encode_header( info, size, buffer, &written );
-  _append_iov( &iovlen, &(iov[0]), written, buffer );
+  *iovlen = 0;
+
+  if( _rtp_encode_header( info, size, buffer, &written ) ) return 1;
+  _append_iov( iovlen, iov, written, buffer );
   _advance_buffer( &size, &buffer, written );
   info->total_size += written;
   if( info->extension ) {
-    _rtp_encode_extension( info, size, &buffer, &written );
-    _append_iov( &iovlen, &(iov[0]), written, buffer );
+    if( _rtp_encode_extension( info, size, buffer, &written ) ) return 1;
+    _append_iov( iovlen, iov, written, buffer );
     _advance_buffer( &size, &buffer, written );
     info->total_size += written;
+    i = 1;
   }
   info->payload_size = 0;
-  while( (iovlen-1)<info->iovlen ) {
-    info->payload_size += info->iov[iovlen-1].iov_len;
-    _append_iov( &iovlen, &(iov[0]), info->iov[iovlen-1].iov_len, info->iov[iovlen-1].iov_base );
+  for( ; i<info->iovlen; i++ ) {
+    info->payload_size += info->iov[i].iov_len;
+    _append_iov( iovlen, iov, info->iov[i].iov_len, info->iov[i].iov_base );
   }
   info->total_size += info->payload_size;
   if( info->padding ) {
-    _rtp_encode_padding( info, size, &buffer, &written );
-    _append_iov( &iovlen, &(iov[0]), written, buffer );
+    if( _rtp_encode_padding( info, size, buffer, &written ) ) return 1;
+    _append_iov( iovlen, iov, written, buffer );
     _advance_buffer( &size, &buffer, written );
     info->total_size += written;
   }
 
-#ifndef NO_LOG
-  MIDILogLocation( DEBUG, "Sending RTP message consisting of %i iovecs.\n", (int) iovlen );
-  int i, j;
-  for( i=0; i<iovlen; i++ ) {
-    MIDILog( DEBUG, "[%i] iov_len: %i, iov_base: %p\n", i, (int) iov[i].iov_len, iov[i].iov_base );
-    for( j=0; j<iov[i].iov_len; j++ ) {
-      unsigned char c = *((unsigned char*)iov[i].iov_base+j);
-      if( (j+1) % 8 == 0 || j+1 == iov[i].iov_len ) {
-        MIDILog( DEBUG, "0x%02x\n", c );
-      } else {
-        MIDILog( DEBUG, "0x%02x ", c );
-      }
-    }
-  }
-#endif
+  _rtp_log_iov( "Sending", *iovlen, iov );
+  return 0;
+}
 
-  msg.msg_name       = &(info->peer->address.addr);
-  msg.msg_namelen    = info->peer->address.size;
-  msg.msg_iov        = &(iov[0]);
-  msg.msg_iovlen     = iovlen;
-  msg.msg_control    = NULL;
-  msg.msg_controllen = 0;
-  msg.msg_flags      = 0;
+/**
+ * @brief Convert a time of day to timestamp units of the session's clock.
+ * @private @memberof RTPSession
+ */
+static unsigned long _rtp_timeval( struct RTPSession * session, struct timeval * tv ) {
+  return ( (unsigned long) tv->tv_sec * session->rate
+         + (unsigned long) tv->tv_usec * session->rate / 1000000 ) & 0xffffffff;
+}
 
-  bytes_sent = sendmsg( session->socket, &msg, 0 );
+/**
+ * @brief Get the current time in timestamp units of the session's clock.
+ * @private @memberof RTPSession
+ */
+static unsigned long _rtp_now( struct RTPSession * session ) {
+  struct timeval tv;
+  gettimeofday( &tv, NULL );
+  return _rtp_timeval( session, &tv );
+}
 
-  if( bytes_sent != info->total_size ) {
-    return bytes_sent;
-  } else if( msg.msg_flags != 0 ) {
-    return 1;
-  } else {
-    info->peer->out_seqnum    = info->sequence_number;
-    info->peer->out_timestamp = info->timestamp;
-    return 0;
-  }
+/**
+ * @brief Convert a wallclock time to timestamp units of the session's clock.
+ * @private @memberof RTPSession
+ */
+static unsigned long _rtp_wallclock( struct RTPSession * session, struct timespec * ts ) {
+  return ( (unsigned long) ts->tv_sec * session->rate
+         + (unsigned long) ( (double) ts->tv_nsec * session->rate / 1000000000 ) ) & 0xffffffff;
 }
 
 /**
- * @brief Receive an RTP packet.
- * @public @memberof RTPSession
- * @param session The session.
- * @param info The packet info.
- * @retval 0 On success.
- * @retval >0 If the message could not be received.
+ * @brief Prepare a message header to receive the kernel arrival time.
+ * @private @memberof RTPSession
  */
-int RTPSessionReceivePacket( struct RTPSession * session, struct RTPPacketInfo * info ) {
-  size_t size, read = 0;
-  void * buffer;
-  struct sockaddr_storage name;
-  struct msghdr msg;
-  struct iovec  iov;
-  ssize_t bytes_received;
+static void _rtp_init_control( struct RTPSession * session, struct msghdr * msg, union RTPControlBuffer * control ) {
+  if( session->kernel_timestamps ) {
+    msg->msg_control    = control;
+    msg->msg_controllen = sizeof(*control);
+  }
+}
 
-  iov.iov_base = session->buffer;
-  iov.iov_len  = session->buflen;
+/**
+ * @brief Get the arrival time of a received datagram.
+ * Use the kernel timestamp if one was received with the datagram,
+ * otherwise the given fallback time.
+ * @private @memberof RTPSession
+ * @param msg      The message header of the received datagram.
+ * @param fallback The time to use without kernel timestamp.
+ * @param arrival  The arrival time.
+ */
+static void _rtp_get_arrival( struct msghdr * msg, struct timeval * fallback, struct timespec * arrival ) {
+#ifdef SO_TIMESTAMPNS
+  struct cmsghdr * cmsg;
+  for( cmsg = CMSG_FIRSTHDR( msg ); cmsg != NULL; cmsg = CMSG_NXTHDR( msg, cmsg ) ) {
+    if( cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS ) {
+      memcpy( arrival, CMSG_DATA( cmsg ), sizeof(struct timespec) );
+      return;
+    }
+  }
+#endif
+  arrival->tv_sec  = fallback->tv_sec;
+  arrival->tv_nsec = fallback->tv_usec * 1000;
+}
 
-  msg.msg_name       = &name;
-  msg.msg_namelen    = sizeof(name);
-  msg.msg_iov        = &iov;
-  msg.msg_iovlen     = 1;
-  msg.msg_control    = NULL;
-  msg.msg_controllen = 0;
-  msg.msg_flags      = 0;
+/**
+ * @brief Get the signed difference of two 32-bit RTP timestamps.
+ */
+static long _ts_diff( unsigned long a, unsigned long b ) {
+  unsigned long d = ( a - b ) & 0xffffffff;
+  return ( d & 0x80000000 ) ? (long) d - 0x100000000L : (long) d;
+}
 
-  bytes_received = recvmsg( session->socket, &msg, 0 );
+/**
+ * @brief Extend a 16-bit sequence number received from a peer.
+ * The extended number is relative to the highest sequence number seen.
+ * @private @memberof RTPPeer
+ */
+static unsigned long _rtp_extend_seqnum( struct RTPPeer * peer, unsigned long seqnum ) {
+  return peer->in_cycles + peer->in_seqnum + (short) ( seqnum - peer->in_seqnum );
+}
 
-  if( bytes_received == -1 ) return -1;
-  if( msg.msg_flags != 0  )  return 1;
-  if( bytes_received < 12 )  return 1;
+/**
+ * @brief Start counting lost packets of a peer from a sequence number.
+ * Only the base of the loss statistics moves, extended sequence numbers
+ * keep growing across restarts of the peer.
+ * @private @memberof RTPPeer
+ */
+static void _rtp_init_seqnum( struct RTPPeer * peer, unsigned long seqnum ) {
+  peer->in_seqnum         = seqnum;
+  peer->in_base_seqnum    = peer->in_cycles + seqnum;
+  peer->in_received       = 0;
+  peer->in_expected_prior = 0;
+  peer->in_received_prior = 0;
+}
 
-  size   = bytes_received;
-  buffer = session->buffer;
-  info->total_size = bytes_received;
-  _rtp_decode_header( info, size, buffer, &read );
-  _advance_buffer( &size, &buffer, read );
-  if( info->extension ) {
-    _rtp_decode_extension( info, size, buffer, &read );
-    _advance_buffer( &size, &buffer, read );
-  }
-  info->payload_size = size - info->padding;
-  if( info->extension ) {
-    info->iovlen = 2;
-    info->iov[1].iov_base = buffer;
-    info->iov[1].iov_len  = info->payload_size;
-  } else {
-    info->iovlen = 1;
-    info->iov[0].iov_base = buffer;
-    info->iov[0].iov_len  = info->payload_size;
+/**
+ * @brief Update the reception statistics of a peer with a decoded packet.
+ * Track the highest sequence number and its wrap-arounds (RFC 3550, A.1),
+ * the interarrival jitter (RFC 3550, 6.4.1) and the lowest observed
+ * transit time that serves as the base of the playout schedule.
+ * A packet that jumps far ahead of the highest sequence number is only
+ * taken as a restart of the peer if the next packet follows it.
+ * @private @memberof RTPPeer
+ * @param peer    The peer.
+ * @param info    The packet info.
+ * @param arrival The arrival time of the packet in timestamp units.
+ * @retval 0 If the packet was accepted.
+ * @retval >0 If the packet was dropped as a stray.
+ */
+static int _rtp_update_peer( struct RTPPeer * peer, struct RTPPacketInfo * info, unsigned long arrival ) {
+  unsigned long seqnum  = info->sequence_number & 0xffff;
+  unsigned long transit = ( arrival - info->timestamp ) & 0xffffffff;
+  unsigned short udelta;
+  long d;
+
+  if( peer->in_received == 0 ) {
+    /* start one cycle up so that early reordered packets don't underflow */
+    peer->in_cycles = 0x10000;
+    _rtp_init_seqnum( peer, seqnum );
+    peer->in_timestamp    = info->timestamp;
+    peer->in_transit      = transit;
+    peer->in_base_transit = transit;
+    peer->in_received     = 1;
+    peer->in_octets       = info->payload_size;
+    return 0;
   }
-  
-#ifndef NO_LOG
-  int i, j;
-  MIDILogLocation( DEBUG, "Received RTP message consisting of %i iovecs.\n", (int) info->iovlen );
-  for( i=0; i<info->iovlen; i++ ) {
-    MIDILog( DEBUG, "[%i] iov_len: %i, iov_base: %p\n", i, (int) info->iov[i].iov_len, info->iov[i].iov_base );
-    for( j=0; j<info->iov[i].iov_len; j++ ) {
-      unsigned char c = *((unsigned char*)info->iov[i].iov_base+j);
-      if( (j+1) % 8 == 0 || j+1 == info->iov[i].iov_len ) {
-        MIDILog( DEBUG, "0x%02x\n", c );
-      } else {
-        MIDILog( DEBUG, "0x%02x ", c );
-      }
+
+  udelta = seqnum - peer->in_seqnum;
+  if( udelta < RTP_MAX_DROPOUT ) {
+    if( seqnum < peer->in_seqnum ) {
+      peer->in_cycles += 0x10000;
+    }
+    peer->in_seqnum    = seqnum;
+    peer->in_timestamp = info->timestamp;
+  } else if( udelta <= 0x10000 - RTP_MAX_MISORDER ) {
+    if( seqnum != peer->in_bad_seqnum ) {
+      peer->in_bad_seqnum = ( seqnum + 1 ) & 0xffff;
+      return 1;
     }
+    /* the peer restarted, don't hold new packets back for the old ones */
+    peer->in_cycles += 0x10000;
+    _rtp_init_seqnum( peer, seqnum );
+    peer->in_timestamp = info->timestamp;
+    peer->in_playing   = 0;
   }
-#endif
 
-  info->peer = NULL;
-  RTPSessionFindPeerBySSRC( session, &(info->peer), info->ssrc );
-  if( info->peer == NULL ) {
-    info->peer = RTPPeerCreate( info->ssrc, msg.msg_namelen, msg.msg_name );
-    RTPSessionAddPeer( session, info->peer );
-    RTPPeerRelease( info->peer );
-  }
-  if( info->sequence_number == info->peer->in_seqnum + 1 ) {
-    info->peer->in_seqnum    = info->sequence_number;
-    info->peer->in_timestamp = info->timestamp;
+  d = _ts_diff( transit, peer->in_transit );
+  if( d < 0 ) d = -d;
+  peer->in_transit = transit;
+  peer->in_jitter += d - ( ( peer->in_jitter + 8 ) >> 4 );
+
+  d = _ts_diff( transit, peer->in_base_transit );
+  if( d < 0 ) {
+    peer->in_base_transit = transit;
+  } else {
+    peer->in_base_transit = ( peer->in_base_transit + ( d >> 8 ) ) & 0xffffffff;
   }
+  peer->in_received++;
+  peer->in_octets += info->payload_size;
   return 0;
 }
 
+static void _rtcp_write32( unsigned char * buffer, unsigned long value ) {
+  buffer[0] = ( value >> 24 ) & 0xff;
+  buffer[1] = ( value >> 16 ) & 0xff;
+  buffer[2] = ( value >> 8 )  & 0xff;
+  buffer[3] =   value         & 0xff;
+}
+
+static unsigned long _rtcp_read32( unsigned char * buffer ) {
+  return ( (unsigned long) buffer[0] << 24 ) | ( (unsigned long) buffer[1] << 16 )
+       | ( (unsigned long) buffer[2] << 8 )  |   (unsigned long) buffer[3];
+}
+
 /**
- * @brief Send an RTP packet.
- * @public @memberof RTPSession
- * @param session The session.
- * @param size    The number of bytes in the @c payload buffer.
- * @param payload The buffer to read the payload from.
- * @param info    The packet info.
- * @retval 0 On success.
- * @retval >0 If the message could not be sent.
+ * @brief Convert a time of day to an NTP timestamp.
+ * @param tv   The time of day.
+ * @param sec  The seconds since 1900.
+ * @param frac The fraction of the second in units of 1/2^32.
  */
-int RTPSessionSend( struct RTPSession * session, size_t size, void * payload,
-                    struct RTPPacketInfo * info ) {
+static void _ntp_timeval( struct timeval * tv, unsigned long * sec, unsigned long * frac ) {
+  *sec  = ( (unsigned long) tv->tv_sec + NTP_UNIX_OFFSET ) & 0xffffffff;
+  *frac = (unsigned long) ( tv->tv_usec * 4294.967296 );
+}
+
+/**
+ * @brief Get the current wallclock time as NTP timestamp.
+ * @param sec  The seconds since 1900.
+ * @param frac The fraction of the second in units of 1/2^32.
+ */
+static void _ntp_now( unsigned long * sec, unsigned long * frac ) {
+  struct timeval tv;
+  gettimeofday( &tv, NULL );
+  _ntp_timeval( &tv, sec, frac );
+}
+
+/**
+ * @brief Get the middle 32 bits of an NTP timestamp, in units of 1/65536 seconds.
+ */
+static unsigned long _ntp_middle( unsigned long sec, unsigned long frac ) {
+  return ( ( sec & 0xffff ) << 16 ) | ( ( frac >> 16 ) & 0xffff );
+}
+
+/**
+ * @brief Decode an RTCP report block that describes our stream.
+ * Store the peer's view of our stream and, if the block refers to one
+ * of our sender reports, the round-trip time.
+ * @private @memberof RTPPeer
+ */
+static void _rtcp_decode_block( struct RTPPeer * peer, unsigned long now, unsigned char * buffer ) {
+  long lost = ( buffer[5] << 16 ) | ( buffer[6] << 8 ) | buffer[7];
+  unsigned long lsr  = _rtcp_read32( buffer+16 );
+  unsigned long dlsr = _rtcp_read32( buffer+20 );
+  unsigned long rtt;
+
+  if( lost & 0x800000 ) lost -= 0x1000000;
+  peer->remote_fraction_lost = buffer[4];
+  peer->remote_packets_lost  = lost;
+  peer->remote_jitter        = _rtcp_read32( buffer+12 );
+  if( lsr != 0 ) {
+    rtt = ( now - lsr - dlsr ) & 0xffffffff;
+    if( ( rtt & 0x80000000 ) == 0 ) {
+      peer->rtt = (unsigned long) ( rtt * 15.2587890625 ); /* 1/65536 s to usec */
+    }
+  }
+}
+
+/**
+ * @brief Decode a compound RTCP packet.
+ * Sender and receiver reports of known peers are used to update their
+ * statistics, all other RTCP packets are skipped.
+ * @private @memberof RTPSession
+ * @param session The session.
+ * @param size    The size of the packet.
+ * @param data    The packet.
+ */
+static void _rtcp_decode_packet( struct RTPSession * session, size_t size, void * data ) {
+  unsigned char * buffer = data;
+  unsigned long sec, frac, now;
+  struct RTPPeer * peer;
+  size_t i, count, length, offset;
+
+  _ntp_now( &sec, &frac );
+  now = _ntp_middle( sec, frac );
+  while( size >= 8 ) {
+    if( ( buffer[0] & 0xc0 ) != 0x80 ) return;
+    length = ( ( ( buffer[2] << 8 ) | buffer[3] ) + 1 ) * 4;
+    if( length > size ) return;
+    count  = buffer[0] & 0x1f;
+    offset = 8;
+    peer   = NULL;
+    if( buffer[1] == RTCP_SR || buffer[1] == RTCP_RR ) {
+      RTPSessionFindPeerBySSRC( session, &peer, _rtcp_read32( buffer+4 ) );
+    }
+    if( peer != NULL && buffer[1] == RTCP_SR ) {
+      if( length < 28 ) return;
+      peer->in_lsr = _ntp_middle( _rtcp_read32( buffer+8 ), _rtcp_read32( buffer+12 ) );
+      peer->in_lsr_arrival = now;
+      offset = 28;
+    }
+    for( i=0; peer != NULL && i<count && offset+24 <= length; i++, offset+=24 ) {
+      if( _rtcp_read32( buffer+offset ) == session->self.ssrc ) {
+        _rtcp_decode_block( peer, now, buffer+offset );
+      }
+    }
+    buffer += length;
+    size   -= length;
+  }
+}
+
+/**
+ * @brief Check if a datagram is an RTCP packet multiplexed with RTP.
+ * RTCP packet types 192-223 collide with RTP payload types 64-95 with the
+ * marker bit set, which are not used for that reason (RFC 5761).
+ */
+static int _rtcp_is_packet( size_t size, unsigned char * buffer ) {
+  return size >= 8 && ( buffer[0] & 0xc0 ) == 0x80 && buffer[1] >= 192 && buffer[1] <= 223;
+}
+
+/**
+ * @brief Decode a received RTP datagram.
+ * Interpret the header, point the @c iovec elements of @c info to the
+ * extension and payload and look up (or create) the sending peer.
+ * @private @memberof RTPSession
+ * @param session The session.
+ * @param info    The packet info.
+ * @param size    The size of the datagram.
+ * @param data    The datagram.
+ * @param addr_size The size of the address pointed to by @c addr.
+ * @param addr    The address the datagram was received from.
+ * @param arrival The arrival time of the datagram in timestamp units.
+ * @retval 0 On success.
+ * @retval >0 If the datagram is not a valid RTP packet or was dropped as a stray.
+ */
+static int _rtp_decode_packet( struct RTPSession * session, struct RTPPacketInfo * info,
+                               size_t size, void * data, socklen_t addr_size, struct sockaddr * addr,
+                               unsigned long arrival ) {
+  size_t read = 0;
+  void * buffer = data;
+
+  if( _rtcp_is_packet( size, data ) ) {
+    _rtcp_decode_packet( session, size, data );
+    return 1; /* consumed, not an RTP packet */
+  }
+  if( size < 12 ) return 1;
+
+  info->total_size = size;
+  if( _rtp_decode_header( info, size, buffer, &read ) ) return 1;
+  _advance_buffer( &size, &buffer, read );
+  if( info->extension ) {
+    if( _rtp_decode_extension( info, size, buffer, &read ) ) return 1;
+    _advance_buffer( &size, &buffer, read );
+  }
+  if( size < info->padding ) return 1;
+  info->payload_size = size - info->padding;
+  if( info->extension ) {
+    info->iovlen = 2;
+    info->iov[1].iov_base = buffer;
+    info->iov[1].iov_len  = info->payload_size;
+  } else {
+    info->iovlen = 1;
+    info->iov[0].iov_base = buffer;
+    info->iov[0].iov_len  = info->payload_size;
+  }
+
+  _rtp_log_iov( "Received", info->iovlen, info->iov );
+
+  if( session->group != NULL && info->ssrc == session->self.ssrc ) {
+    return 1; /* our own packet, looped back by the group */
+  }
+
+  info->peer = NULL;
+  RTPSessionFindPeerBySSRC( session, &(info->peer), info->ssrc );
+  if( info->peer == NULL ) {
+    info->peer = RTPPeerCreate( info->ssrc, addr_size, addr );
+    if( info->peer == NULL ) return 1;
+    if( RTPSessionAddPeer( session, info->peer ) ) {
+      RTPPeerRelease( info->peer );
+      info->peer = NULL;
+      return 1;
+    }
+    RTPPeerRelease( info->peer );
+  }
+  if( _rtp_update_peer( info->peer, info, arrival ) ) {
+    info->peer = NULL;
+    return 1; /* stray packet, dropped */
+  }
+  return 0;
+}
+
+/**
+ * @brief Send a number of prepared datagrams with as few syscalls as possible.
+ * @param fd   The socket.
+ * @param n    The number of messages.
+ * @param mmsg The messages.
+ * @return the number of messages sent, or -1 if not even the first could be sent.
+ */
+static int _rtp_sendmmsg( int fd, size_t n, struct mmsghdr * mmsg ) {
+#ifdef MSG_WAITFORONE
+  return sendmmsg( fd, mmsg, n, 0 );
+#else
+  int i;
+  ssize_t bytes;
+  for( i=0; i<n; i++ ) {
+    bytes = sendmsg( fd, &(mmsg[i].msg_hdr), 0 );
+    if( bytes == -1 ) break;
+    mmsg[i].msg_len = bytes;
+  }
+  return ( i == 0 && n > 0 ) ? -1 : i;
+#endif
+}
+
+/**
+ * @brief Receive up to @c n datagrams with as few syscalls as possible.
+ * Block until the first datagram arrives, then drain whatever else is
+ * already queued on the socket without blocking again.
+ * @param fd   The socket.
+ * @param n    The maximum number of messages.
+ * @param mmsg The messages.
+ * @return the number of messages received, or -1 on error.
+ */
+static int _rtp_recvmmsg( int fd, size_t n, struct mmsghdr * mmsg ) {
+#ifdef MSG_WAITFORONE
+  return recvmmsg( fd, mmsg, n, MSG_WAITFORONE, NULL );
+#else
+  int i;
+  ssize_t bytes;
+  for( i=0; i<n; i++ ) {
+    bytes = recvmsg( fd, &(mmsg[i].msg_hdr), ( i == 0 ) ? 0 : MSG_DONTWAIT );
+    if( bytes == -1 ) break;
+    mmsg[i].msg_len = bytes;
+  }
+  return ( i == 0 && n > 0 ) ? -1 : i;
+#endif
+}
+
+/* MARK: Impairment *//**
+ * @name Impairment
+ * Emulating an unreliable network on top of a reliable one (like the
+ * loopback interface) to test and benchmark loss recovery, jitter
+ * buffers and throughput reproducibly. All random decisions are drawn
+ * from a generator seeded by the configuration, so the same seed and
+ * the same sequence of datagrams always give the same impairments.
+ * @{
+ */
+
+/**
+ * @brief Draw the next pseudo-random number of an impairment (xorshift32).
+ * @private @memberof RTPSession
+ */
+static unsigned long _impair_random( struct RTPImpairState * state ) {
+  unsigned long x = state->random;
+  x ^= ( x << 13 ) & 0xffffffff;
+  x ^= x >> 17;
+  x ^= ( x << 5 ) & 0xffffffff;
+  state->random = x;
+  return x;
+}
+
+static int _impair_chance( struct RTPImpairState * state, double p ) {
+  if( p <= 0 ) return 0;
+  return ( _impair_random( state ) < p * 4294967296.0 ) ? 1 : 0;
+}
+
+/**
+ * @brief Count the copies of a datagram that make it through the network.
+ * Loss follows a simple Gilbert model: a datagram is lost with probability
+ * @c loss, a datagram following a lost one with probability @c burst_loss
+ * (if set).
+ * @private @memberof RTPSession
+ * @return 0 if the datagram is lost, 2 if it is duplicated, 1 otherwise.
+ */
+static int _impair_copies( struct RTPImpairState * state ) {
+  double loss = state->config.loss;
+  if( state->bursting && state->config.burst_loss > 0 ) {
+    loss = state->config.burst_loss;
+  }
+  state->bursting = _impair_chance( state, loss );
+  if( state->bursting ) return 0;
+  return _impair_chance( state, state->config.duplicate ) ? 2 : 1;
+}
+
+/**
+ * @brief Draw the extra transit time of a datagram in microseconds.
+ * @private @memberof RTPSession
+ */
+static unsigned long _impair_delay( struct RTPImpairState * state ) {
+  struct RTPImpairment * config = &(state->config);
+  unsigned long delay = config->delay;
+  if( config->delay_jitter > 0 ) {
+    delay += _impair_random( state ) % ( config->delay_jitter + 1 );
+  }
+  if( _impair_chance( state, config->spike ) ) {
+    delay += config->spike_delay;
+  }
+  if( _impair_chance( state, config->reorder ) ) {
+    delay += config->reorder_delay;
+  }
+  return delay;
+}
+
+static void _timespec_add( struct timespec * ts, unsigned long usec ) {
+  ts->tv_sec  += usec / USEC_PER_SEC;
+  ts->tv_nsec += ( usec % USEC_PER_SEC ) * 1000;
+  if( ts->tv_nsec >= 1000000000 ) {
+    ts->tv_sec++;
+    ts->tv_nsec -= 1000000000;
+  }
+}
+
+static int _timespec_before( struct timespec * a, struct timespec * b ) {
+  return ( a->tv_sec < b->tv_sec || ( a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec ) ) ? 1 : 0;
+}
+
+static int _timespec_passed( struct timespec * ts ) {
+  struct timeval  tv;
+  struct timespec now;
+  gettimeofday( &tv, NULL );
+  now.tv_sec  = tv.tv_sec;
+  now.tv_nsec = tv.tv_usec * 1000;
+  return _timespec_before( &now, ts ) ? 0 : 1;
+}
+
+/**
+ * @brief Pass a received datagram through the receive impairment.
+ * Every copy that is not lost is held back until its emulated arrival
+ * time. The queue is ordered by arrival, copies with the same arrival
+ * stay in the order they were received.
+ * @private @memberof RTPSession
+ */
+static void _impair_receive( struct RTPSession * session, struct RTPPacketBuffer * buffer, size_t size,
+                             socklen_t addr_size, struct sockaddr * addr, struct timespec * arrival ) {
+  struct RTPImpairedPacket ** p;
+  struct RTPImpairedPacket * packet;
+  int copies = _impair_copies( session->impair_receive );
+
+  while( copies-- > 0 ) {
+    packet = malloc( sizeof(struct RTPImpairedPacket) );
+    if( packet == NULL ) return;
+    RTPPacketBufferRetain( buffer );
+    packet->buffer    = buffer;
+    packet->size      = size;
+    packet->arrival   = *arrival;
+    packet->addr_size = addr_size;
+    memcpy( &(packet->addr), addr, addr_size );
+    _timespec_add( &(packet->arrival), _impair_delay( session->impair_receive ) );
+    for( p = &(session->impaired); *p != NULL; p = &((*p)->next) ) {
+      if( _timespec_before( &(packet->arrival), &((*p)->arrival) ) ) break;
+    }
+    packet->next = *p;
+    *p = packet;
+  }
+}
+
+/**
+ * @brief Pass the datagrams queued on the socket through the receive impairment.
+ * Read up to RTP_MMSG_LEN datagrams without blocking.
+ * @private @memberof RTPSession
+ * @retval 0 on success.
+ * @retval >0 if no buffer could be obtained.
+ * @retval -1 if the socket could not be read.
+ */
+static int _impair_drain( struct RTPSession * session ) {
+  struct sockaddr_storage name;
+  struct msghdr msg;
+  struct iovec  iov;
+  struct timeval  now;
+  struct timespec arrival;
+  union RTPControlBuffer control;
+  struct RTPPacketBuffer * buffer;
+  ssize_t bytes;
+  int i;
+
+  for( i=0; i<RTP_MMSG_LEN; i++ ) {
+    if( session->pool == NULL ) return 1;
+    buffer = _pool_take( session->pool );
+    if( buffer == NULL ) return 1;
+    iov.iov_base = buffer->data;
+    iov.iov_len  = buffer->size;
+    _init_msghdr( &msg, sizeof(name), &name, 1, &iov );
+    _rtp_init_control( session, &msg, &control );
+
+    bytes = recvmsg( session->socket, &msg, MSG_DONTWAIT );
+    if( bytes == -1 ) {
+      RTPPacketBufferRelease( buffer );
+      if( errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ) return 0;
+      return -1;
+    }
+    if( ( msg.msg_flags & ~MSG_CTRUNC ) == 0 ) {
+      gettimeofday( &now, NULL );
+      _rtp_get_arrival( &msg, &now, &arrival );
+      _impair_receive( session, buffer, bytes, msg.msg_namelen, msg.msg_name, &arrival );
+    }
+    RTPPacketBufferRelease( buffer );
+  }
+  return 0;
+}
+
+/**
+ * @brief Take the first held datagram off the queue if it is due.
+ * @private @memberof RTPSession
+ * @return the datagram, or @c NULL if none is due.
+ */
+static struct RTPImpairedPacket * _impair_pop( struct RTPSession * session ) {
+  struct RTPImpairedPacket * packet = session->impaired;
+  if( packet == NULL || !_timespec_passed( &(packet->arrival) ) ) return NULL;
+  session->impaired = packet->next;
+  return packet;
+}
+
+/**
+ * @brief Get the emulated arrival time of the next held datagram.
+ * With a receive impairment the receive functions never block: they
+ * return what is due and leave the rest queued. Held datagrams do not
+ * make the socket readable, so a caller driven by a runloop should
+ * schedule a wakeup at this time.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @param arrival The time the next held datagram is due.
+ * @retval 0 on success.
+ * @retval >0 if no datagram is held back.
+ */
+int RTPSessionGetImpairedArrival( struct RTPSession * session, struct timespec * arrival ) {
+  if( arrival == NULL || session->impaired == NULL ) return 1;
+  *arrival = session->impaired->arrival;
+  return 0;
+}
+
+/**
+ * @brief Send a datagram through the send impairment.
+ * Lost datagrams count as sent, as on a real network.
+ * @private @memberof RTPSession
+ * @return the number of bytes sent, or -1 on error.
+ */
+static ssize_t _impair_sendmsg( struct RTPSession * session, struct msghdr * msg ) {
+  ssize_t bytes = 0;
+  size_t i;
+  int copies = ( session->impair_send != NULL ) ? _impair_copies( session->impair_send ) : 1;
+
+  if( copies == 0 ) {
+    for( i=0; i<msg->msg_iovlen; i++ ) {
+      bytes += msg->msg_iov[i].iov_len;
+    }
+    return bytes;
+  }
+  bytes = sendmsg( session->socket, msg, 0 );
+  if( bytes != -1 && copies > 1 ) {
+    sendmsg( session->socket, msg, 0 );
+  }
+  return bytes;
+}
+
+/**
+ * @brief Send a number of prepared datagrams through the send impairment.
+ * Without impairment this is a plain _rtp_sendmmsg.
+ * @private @memberof RTPSession
+ * @return the number of messages sent, or -1 if not even the first could be sent.
+ */
+static int _impair_sendmmsg( struct RTPSession * session, size_t n, struct mmsghdr * mmsg ) {
+  int i;
+  ssize_t bytes;
+  if( session->impair_send == NULL ) {
+    return _rtp_sendmmsg( session->socket, n, mmsg );
+  }
+  for( i=0; i<n; i++ ) {
+    bytes = _impair_sendmsg( session, &(mmsg[i].msg_hdr) );
+    if( bytes == -1 ) break;
+    mmsg[i].msg_len = bytes;
+  }
+  return ( i == 0 && n > 0 ) ? -1 : i;
+}
+
+static int _impair_valid( struct RTPImpairment * config ) {
+  if( config == NULL ) return 1;
+  return ( config->loss >= 0 && config->loss <= 1 &&
+           config->burst_loss >= 0 && config->burst_loss <= 1 &&
+           config->duplicate >= 0 && config->duplicate <= 1 &&
+           config->reorder >= 0 && config->reorder <= 1 &&
+           config->spike >= 0 && config->spike <= 1 ) ? 1 : 0;
+}
+
+static int _impair_configure( struct RTPImpairState ** state, struct RTPImpairment * config ) {
+  if( config == NULL ) {
+    free( *state );
+    *state = NULL;
+    return 0;
+  }
+  if( *state == NULL ) {
+    *state = malloc( sizeof(struct RTPImpairState) );
+    if( *state == NULL ) return 1;
+  }
+  (*state)->config   = *config;
+  (*state)->random   = config->seed & 0xffffffff;
+  (*state)->bursting = 0;
+  if( (*state)->random == 0 ) {
+    (*state)->random = 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Emulate an unreliable network for the datagrams of a session.
+ * Sent datagrams can be lost (with bursts) and duplicated. Received
+ * datagrams can additionally be delayed by a base delay, a uniformly
+ * distributed jitter and occasional spikes, and be held back for a while
+ * so that later datagrams overtake them. Delayed datagrams get their
+ * emulated @c arrival time and are returned once it has passed. The
+ * receive functions do not block while a receive impairment is set (see
+ * RTPSessionGetImpairedArrival).
+ * The generator is reseeded whenever a configuration is set. Disabling
+ * the receive impairment discards any held datagrams.
+ * This affects every datagram on the socket, including RTCP and other
+ * protocols sharing it. Each shard needs its own configuration.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @param send    The impairment of sent datagrams, or @c NULL for none.
+ * @param receive The impairment of received datagrams, or @c NULL for none.
+ * @retval 0 on success.
+ * @retval >0 if a probability is out of range or memory could not be allocated.
+ */
+int RTPSessionSetImpairment( struct RTPSession * session, struct RTPImpairment * send,
+                             struct RTPImpairment * receive ) {
+  struct RTPImpairedPacket * packet;
+  if( !_impair_valid( send ) || !_impair_valid( receive ) ) return 1;
+  if( _impair_configure( &(session->impair_send), send ) ) return 1;
+  if( _impair_configure( &(session->impair_receive), receive ) ) return 1;
+  if( receive == NULL ) {
+    while( session->impaired != NULL ) {
+      packet = session->impaired;
+      session->impaired = packet->next;
+      RTPPacketBufferRelease( packet->buffer );
+      free( packet );
+    }
+  }
+  return 0;
+}
+
+/** @} */
+
+/**
+ * @brief Prepare a batch slot for sending a packet to a peer.
+ * Assign the next sequence number of the peer and point the message
+ * header of the slot to the peer's address and the slot's @c iovec list.
+ * @private @memberof RTPSession
+ */
+static void _rtp_prepare_slot( struct RTPSession * session, size_t i, struct RTPPeer * peer,
+                               unsigned long timestamp, size_t payload_size, size_t iovlen ) {
+  struct RTPPacketSlot * slot = &(session->slots[i]);
+  slot->peer      = peer;
+  slot->seqnum    = peer->out_seqnum + 1;
+  slot->timestamp = timestamp;
+  slot->payload_size = payload_size;
+  peer->out_seqnum = slot->seqnum;
+  _init_msghdr( &(session->mmsg[i].msg_hdr), peer->address.size, &(peer->address.addr),
+                iovlen, &(slot->msg_iov[0]) );
+  session->mmsg[i].msg_len = 0;
+}
+
+/**
+ * @brief Submit prepared batch slots.
+ * Send the first @c n slots and give the sequence numbers of packets that
+ * could not be sent back to their peers, last packet first.
+ * @private @memberof RTPSession
+ * @return the number of packets that were sent.
+ */
+static size_t _rtp_submit_slots( struct RTPSession * session, size_t n ) {
+  struct RTPPacketSlot * slot;
+  size_t i;
+  int count = _impair_sendmmsg( session, n, &(session->mmsg[0]) );
+  if( count < 0 ) count = 0;
+  for( i=n; i>count; i-- ) {
+    slot = &(session->slots[i-1]);
+    slot->peer->out_seqnum = (unsigned short) ( slot->seqnum - 1 );
+  }
+  for( i=0; i<count; i++ ) {
+    slot = &(session->slots[i]);
+    slot->peer->out_timestamp = slot->timestamp;
+    slot->peer->out_packets++;
+    slot->peer->out_octets   += slot->payload_size;
+  }
+  return count;
+}
+
+/**
+ * @brief Send an RTP packet.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @param info The packet info.
+ * @retval 0 On success.
+ * @retval >0 If the message could not be sent.
+ */
+int RTPSessionSendPacket( struct RTPSession * session, struct RTPPacketInfo * info ) {
+  size_t iovlen = 0;
+  struct msghdr msg;
+  struct iovec  iov[RTP_IOV_LEN+3];
+  ssize_t bytes_sent;
+  
+  if( info == NULL || info->peer == NULL ) return 1;
+
+  info->sequence_number = info->peer->out_seqnum + 1;
+  if( _rtp_encode_packet( session, info, session->buflen, session->buffer, &iovlen, &(iov[0]) ) ) {
+    return 1;
+  }
+
+  _init_msghdr( &msg, info->peer->address.size, &(info->peer->address.addr), iovlen, &(iov[0]) );
+
+  bytes_sent = _impair_sendmsg( session, &msg );
+
+  if( bytes_sent != info->total_size ) {
+    return bytes_sent;
+  } else if( msg.msg_flags != 0 ) {
+    return 1;
+  } else {
+    info->peer->out_seqnum    = info->sequence_number;
+    info->peer->out_timestamp = info->timestamp;
+    info->peer->out_packets++;
+    info->peer->out_octets   += info->payload_size;
+    return 0;
+  }
+}
+
+/**
+ * @brief Receive an RTP packet.
+ * The datagram is received into a pooled @c buffer that is reused by the
+ * next call unless it is retained.
+ * With a receive impairment the call does not block and fails with
+ * @c errno set to @c EAGAIN if no datagram is due.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @param info The packet info.
+ * @retval 0 On success.
+ * @retval >0 If the message could not be received.
+ */
+int RTPSessionReceivePacket( struct RTPSession * session, struct RTPPacketInfo * info ) {
+  struct sockaddr_storage name;
+  struct msghdr msg;
+  struct iovec  iov;
+  struct timeval now;
+  union RTPControlBuffer control;
+  struct RTPImpairedPacket * packet;
+  ssize_t bytes_received;
+  int result;
+
+  if( session->impair_receive != NULL ) {
+    result = _impair_drain( session );
+    if( result ) return result;
+    packet = _impair_pop( session );
+    if( packet == NULL ) {
+      errno = EAGAIN;
+      return -1;
+    }
+    if( session->received != NULL ) {
+      RTPPacketBufferRelease( session->received );
+    }
+    session->received = packet->buffer;
+    info->arrival = packet->arrival;
+    info->buffer  = packet->buffer;
+    result = _rtp_decode_packet( session, info, packet->size, packet->buffer->data, packet->addr_size,
+                                 (struct sockaddr *) &(packet->addr), _rtp_wallclock( session, &(info->arrival) ) );
+    free( packet );
+    return result;
+  }
+
+  if( _pool_renew( session, &(session->received) ) ) return 1;
+  iov.iov_base = session->received->data;
+  iov.iov_len  = session->received->size;
+
+  _init_msghdr( &msg, sizeof(name), &name, 1, &iov );
+  _rtp_init_control( session, &msg, &control );
+
+  bytes_received = recvmsg( session->socket, &msg, 0 );
+
+  if( bytes_received == -1 ) return -1;
+  if( ( msg.msg_flags & ~MSG_CTRUNC ) != 0 ) return 1;
+
+  gettimeofday( &now, NULL );
+  _rtp_get_arrival( &msg, &now, &(info->arrival) );
+  info->buffer = session->received;
+  return _rtp_decode_packet( session, info, bytes_received, session->received->data,
+                             msg.msg_namelen, msg.msg_name, _rtp_wallclock( session, &(info->arrival) ) );
+}
+
+/**
+ * @brief Send a number of RTP packets at once.
+ * Encode each packet and hand the whole batch to the kernel using as
+ * few syscalls as possible (one @c sendmmsg per RTP_MMSG_LEN packets
+ * where available). Every info must specify the peer to send to.
+ * Sequence numbers are assigned in order, so multiple packets for the
+ * same peer are numbered consecutively.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @param n       The number of packets in @c infos.
+ * @param infos   The packet infos.
+ * @param sent    The number of packets that were sent.
+ * @retval 0 On success.
+ * @retval >0 If not all packets could be sent.
+ */
+int RTPSessionSendPackets( struct RTPSession * session, size_t n, struct RTPPacketInfo * infos, size_t * sent ) {
+  int result = 0;
+  size_t i, count, iovlen, offset;
+  struct RTPPacketInfo * info;
+  struct RTPPacketSlot * slot;
+
+  if( infos == NULL || sent == NULL ) return 1;
+  *sent = 0;
+
+  for( offset=0; offset<n && result == 0; offset+=count ) {
+    for( i=0; i<RTP_MMSG_LEN && offset+i<n; i++ ) {
+      info = &(infos[offset+i]);
+      slot = &(session->slots[i]);
+      if( info->peer == NULL ) {
+        result = 1;
+        break;
+      }
+      info->sequence_number = info->peer->out_seqnum + 1;
+      if( _rtp_encode_packet( session, info, sizeof(slot->buffer), &(slot->buffer[0]),
+                              &iovlen, &(slot->msg_iov[0]) ) ) {
+        result = 1;
+        break;
+      }
+      _rtp_prepare_slot( session, i, info->peer, info->timestamp, info->payload_size, iovlen );
+    }
+    if( i == 0 ) break;
+
+    count = _rtp_submit_slots( session, i );
+    if( count < i ) result = 1;
+    *sent += count;
+  }
+  return result;
+}
+
+/**
+ * @brief Send the same RTP packet to a number of peers.
+ * Encode the header, extension and padding once and only patch the
+ * sequence number for each peer. An optional per-peer trailer (like an
+ * RTP-MIDI journal) is inserted between payload and padding. The packets
+ * are handed to the kernel in batches of RTP_MMSG_LEN.
+ * The @c peer and @c sequence_number fields of @c info are ignored.
+ * @public @memberof RTPSession
+ * @param session  The session.
+ * @param info     The packet info describing the shared packet.
+ * @param n        The number of peers.
+ * @param peers    The peers to send the packet to.
+ * @param trailers An array of @c n iovecs appended to each peer's payload, or @c NULL.
+ * @param sent     The number of peers the packet was sent to.
+ * @retval 0 On success.
+ * @retval >0 If the packet could not be sent to all peers.
+ */
+int RTPSessionSendPacketToPeers( struct RTPSession * session, struct RTPPacketInfo * info,
+                                 size_t n, struct RTPPeer ** peers, struct iovec * trailers, size_t * sent ) {
+  int result = 0;
+  size_t i, k, tail, count, iovlen, offset, header_size, payload_size;
+  unsigned char * header;
+  struct iovec iov[RTP_IOV_LEN+3];
+  struct RTPPacketSlot * slot;
+  struct RTPPeer * peer;
+
+  if( info == NULL || sent == NULL ) return 1;
+  *sent = 0;
+  if( n == 0 ) return 0;
+  if( peers == NULL ) return 1;
+
+  info->peer = NULL;
+  info->sequence_number = 0;
+  if( _rtp_encode_packet( session, info, session->buflen, session->buffer, &iovlen, &(iov[0]) ) ) {
+    return 1;
+  }
+  header      = iov[0].iov_base;
+  header_size = iov[0].iov_len;
+  tail        = ( info->padding ) ? iovlen-1 : iovlen;
+
+  for( offset=0; offset<n && result == 0; offset+=count ) {
+    for( i=0; i<RTP_MMSG_LEN && offset+i<n; i++ ) {
+      peer = peers[offset+i];
+      slot = &(session->slots[i]);
+      if( peer == NULL ) {
+        result = 1;
+        break;
+      }
+      memcpy( &(slot->buffer[0]), header, header_size );
+      memcpy( &(slot->msg_iov[0]), &(iov[0]), sizeof(struct iovec) * tail );
+      slot->msg_iov[0].iov_base = &(slot->buffer[0]);
+      k = tail;
+      payload_size = info->payload_size;
+      if( trailers != NULL && trailers[offset+i].iov_len > 0 ) {
+        slot->msg_iov[k++] = trailers[offset+i];
+        payload_size += trailers[offset+i].iov_len;
+      }
+      if( info->padding ) {
+        slot->msg_iov[k++] = iov[iovlen-1];
+      }
+      _rtp_prepare_slot( session, i, peer, info->timestamp, payload_size, k );
+      slot->buffer[2] = ( slot->seqnum >> 8 ) & 0xff;
+      slot->buffer[3] =   slot->seqnum        & 0xff;
+    }
+    if( i == 0 ) break;
+
+    count = _rtp_submit_slots( session, i );
+    if( count < i ) result = 1;
+    *sent += count;
+  }
+  return result;
+}
+
+/**
+ * @brief Fill out the info of a datagram received into a batch slot.
+ * Datagrams that are truncated or not valid RTP packets are returned
+ * whole with a @c NULL peer.
+ * @private @memberof RTPSession
+ */
+static void _rtp_receive_slot( struct RTPSession * session, struct RTPPacketInfo * info, size_t i,
+                               size_t size, socklen_t addr_size, int truncated ) {
+  struct RTPPacketSlot * slot = &(session->slots[i]);
+  info->addr_size = addr_size;
+  info->addr      = (struct sockaddr *) &(slot->addr);
+  info->iovlen    = 2;
+  info->iov       = &(slot->iov[0]);
+  info->buffer    = slot->packet;
+  if( truncated ||
+      _rtp_decode_packet( session, info, size, slot->packet->data,
+                          addr_size, info->addr, _rtp_wallclock( session, &(info->arrival) ) ) ) {
+    info->peer         = NULL;
+    info->padding      = 0;
+    info->extension    = 0;
+    info->total_size   = size;
+    info->payload_size = size;
+    info->iovlen       = 1;
+    info->iov[0].iov_base = slot->packet->data;
+    info->iov[0].iov_len  = size;
+  }
+}
+
+/**
+ * @brief Receive a number of RTP packets at once.
+ * Wait for at least one packet and drain up to @c n (at most RTP_MMSG_LEN)
+ * queued packets from the socket with as few syscalls as possible.
+ * The payload, @c iovec elements and source address of each packet are
+ * stored in buffers owned by the session and stay valid until the next
+ * call to RTPSessionReceivePackets.
+ * Datagrams that are not valid RTP packets are still returned, with a
+ * @c NULL peer and the whole datagram in the first @c iovec element, so
+ * that protocols sharing the socket can handle them.
+ * The @c arrival time of every datagram is set as well, taken by the
+ * kernel if enabled with RTPSessionSetKernelTimestamps.
+ * Every datagram is received into its own pooled @c buffer. Retain it
+ * to keep the datagram valid beyond the next call, for example to
+ * decode it later.
+ * With a receive impairment the call does not block and returns only
+ * the datagrams that are due, possibly none.
+ * @public @memberof RTPSession
+ * @param session  The session.
+ * @param n        The number of available packet infos.
+ * @param infos    The packet infos.
+ * @param received The number of packets that were received.
+ * @retval 0 On success.
+ * @retval >0 If no packets could be received.
+ */
+int RTPSessionReceivePackets( struct RTPSession * session, size_t n, struct RTPPacketInfo * infos, size_t * received ) {
+  int i, count;
+  struct timeval now;
+  struct RTPPacketSlot * slot;
+  struct RTPImpairedPacket * packet;
+  struct msghdr * msg;
+
+  if( infos == NULL || received == NULL ) return 1;
+  *received = 0;
+  if( n > RTP_MMSG_LEN ) n = RTP_MMSG_LEN;
+  if( n == 0 ) return 0;
+
+  if( session->impair_receive != NULL ) {
+    count = _impair_drain( session );
+    if( count ) return count;
+    for( i=0; i<n && ( packet = _impair_pop( session ) ) != NULL; i++ ) {
+      slot = &(session->slots[i]);
+      if( slot->packet != NULL ) {
+        RTPPacketBufferRelease( slot->packet );
+      }
+      slot->packet = packet->buffer;
+      memcpy( &(slot->addr), &(packet->addr), packet->addr_size );
+      infos[i].arrival = packet->arrival;
+      _rtp_receive_slot( session, &(infos[i]), i, packet->size, packet->addr_size, 0 );
+      free( packet );
+    }
+    *received = i;
+    return 0;
+  }
+
+  for( i=0; i<n; i++ ) {
+    slot = &(session->slots[i]);
+    if( _pool_renew( session, &(slot->packet) ) ) {
+      if( i == 0 ) return 1;
+      n = i;
+      break;
+    }
+    slot->msg_iov[0].iov_base = slot->packet->data;
+    slot->msg_iov[0].iov_len  = slot->packet->size;
+    _init_msghdr( &(session->mmsg[i].msg_hdr), sizeof(slot->addr), &(slot->addr), 1, &(slot->msg_iov[0]) );
+    _rtp_init_control( session, &(session->mmsg[i].msg_hdr), &(slot->control) );
+    session->mmsg[i].msg_len = 0;
+  }
+
+  count = _rtp_recvmmsg( session->socket, n, &(session->mmsg[0]) );
+  if( count < 0 ) return -1;
+  gettimeofday( &now, NULL );
+
+  for( i=0; i<count; i++ ) {
+    msg = &(session->mmsg[i].msg_hdr);
+    _rtp_get_arrival( msg, &now, &(infos[i].arrival) );
+    _rtp_receive_slot( session, &(infos[i]), i, session->mmsg[i].msg_len, msg->msg_namelen,
+                       ( msg->msg_flags & ~MSG_CTRUNC ) != 0 );
+  }
+  *received = count;
+  return 0;
+}
+
+/**
+ * @brief Send an RTP packet.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @param size    The number of bytes in the @c payload buffer.
+ * @param payload The buffer to read the payload from.
+ * @param info    The packet info.
+ * @retval 0 On success.
+ * @retval >0 If the message could not be sent.
+ */
+int RTPSessionSend( struct RTPSession * session, size_t size, void * payload,
+                    struct RTPPacketInfo * info ) {
   int i, result = 0;
   struct iovec iov;
   
@@ -1040,10 +3051,14 @@ int RTPSessionSend( struct RTPSession * session, size_t size, void * payload,
   info->iovlen    = 1;
   info->iov       = &iov;
   
-  if( info->peer == NULL ) {
-    for( i=0; i<RTP_MAX_PEERS; i++ ) {
-      if( session->peers[i] != NULL ) {
-        info->peer = session->peers[i];
+  if( info->peer == NULL && session->group != NULL ) {
+    info->peer = session->group;
+    result = RTPSessionSendPacket( session, info );
+    info->peer = NULL;
+  } else if( info->peer == NULL ) {
+    for( i=0; i<session->peers.length; i++ ) {
+      if( session->peers.list[i] != NULL ) {
+        info->peer = session->peers.list[i];
         result += RTPSessionSendPacket( session, info );
       }
     }
@@ -1082,3 +3097,400 @@ int RTPSessionReceive( struct RTPSession * session, size_t size, void * payload,
   }
   return result;
 }
+
+/* MARK: Playout *//**
+ * @name Playout
+ * Reordering received packets and releasing them on a schedule that
+ * adapts to the interarrival jitter of each peer.
+ * @{
+ */
+
+/**
+ * @brief Set the clock rate of the session's RTP timestamps.
+ * The rate is used to measure arrival times in timestamp units, so it
+ * must match the clock of the payload format.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @param rate    The number of timestamp units per second.
+ * @retval 0 on success.
+ * @retval >0 if the rate is invalid.
+ */
+int RTPSessionSetClockRate( struct RTPSession * session, unsigned long rate ) {
+  if( rate == 0 ) return 1;
+  session->rate = rate;
+  return 0;
+}
+
+/**
+ * @brief Let the kernel timestamp received packets.
+ * With kernel timestamps the @c arrival time of received packets is the
+ * time the datagram reached the socket instead of the time it was read,
+ * which keeps scheduling delays out of the jitter estimate and of any
+ * clock synchronization based on arrival times.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @param enable  Whether to enable (1) or disable (0) kernel timestamps.
+ * @retval 0 on success.
+ * @retval >0 if kernel timestamps are not supported.
+ */
+int RTPSessionSetKernelTimestamps( struct RTPSession * session, int enable ) {
+#ifdef SO_TIMESTAMPNS
+  enable = enable ? 1 : 0;
+  if( setsockopt( session->socket, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable) ) ) return 1;
+  session->kernel_timestamps = enable;
+  return 0;
+#else
+  return ( enable ) ? 1 : 0;
+#endif
+}
+
+/**
+ * @brief Set the bounds of the adaptive playout delay.
+ * Packets are held back for a multiple of the peer's interarrival jitter
+ * measured from the fastest observed transit, clamped to the given bounds.
+ * With both bounds at zero (the default) packets are only reordered and
+ * never held back.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @param min_delay The minimum playout delay in microseconds.
+ * @param max_delay The maximum playout delay in microseconds.
+ * @retval 0 on success.
+ * @retval >0 if the bounds are invalid.
+ */
+int RTPSessionSetPlayoutDelay( struct RTPSession * session, unsigned long min_delay, unsigned long max_delay ) {
+  if( min_delay > max_delay ) return 1;
+  session->min_delay = min_delay;
+  session->max_delay = max_delay;
+  return 0;
+}
+
+static unsigned long _playout_delay( struct RTPSession * session, struct RTPPeer * peer ) {
+  unsigned long delay = RTP_JITTER_FACTOR * ( peer->in_jitter >> 4 ) * 1000000 / session->rate;
+  if( delay < session->min_delay ) delay = session->min_delay;
+  if( delay > session->max_delay ) delay = session->max_delay;
+  return delay;
+}
+
+/**
+ * @brief Get the current playout delay of a peer.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @param peer    The peer.
+ * @param delay   The playout delay in microseconds.
+ * @retval 0 on success.
+ * @retval >0 if the delay could not be obtained.
+ */
+int RTPSessionGetPlayoutDelay( struct RTPSession * session, struct RTPPeer * peer, unsigned long * delay ) {
+  if( peer == NULL || delay == NULL ) return 1;
+  *delay = _playout_delay( session, peer );
+  return 0;
+}
+
+/**
+ * @brief Check whether a packet was already played out.
+ * The last RTP_REORDER_LEN sequence numbers up to the highest one played
+ * are remembered, anything older counts as played.
+ * @private @memberof RTPPeer
+ */
+static int _playout_played( struct RTPPeer * peer, unsigned long ext_seqnum ) {
+  unsigned long age;
+  if( !peer->in_playing || ext_seqnum > peer->in_played ) return 0;
+  age = peer->in_played - ext_seqnum;
+  if( age >= RTP_REORDER_LEN ) return 1;
+  return ( peer->in_played_mask >> age ) & 1;
+}
+
+/**
+ * @brief Remember that a packet was played out.
+ * @private @memberof RTPPeer
+ */
+static void _playout_mark( struct RTPPeer * peer, unsigned long ext_seqnum ) {
+  unsigned long shift;
+  if( !peer->in_playing || ext_seqnum > peer->in_played ) {
+    shift = ext_seqnum - peer->in_played;
+    if( !peer->in_playing || shift >= RTP_REORDER_LEN ) {
+      peer->in_played_mask = 1;
+    } else {
+      peer->in_played_mask = ( ( peer->in_played_mask << shift ) | 1 ) & 0xffffffff;
+    }
+    peer->in_played  = ext_seqnum;
+    peer->in_playing = 1;
+  } else {
+    peer->in_played_mask |= 1UL << ( peer->in_played - ext_seqnum );
+  }
+}
+
+/**
+ * @brief Store a received packet in the reorder buffer of its peer.
+ * The packet keeps a reference to the pooled buffer it was received in,
+ * or gets a copy of its extension and payload if it has none, so the
+ * packet info may be reused once this returns. Late packets (overtaken
+ * by a packet that was already played out) are still accepted and played
+ * out as soon as possible, as payloads like MIDI can not afford to lose
+ * them. Duplicates and packets older than the last RTP_REORDER_LEN played
+ * ones are rejected.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @param info    The packet info as returned by RTPSessionReceivePacket.
+ * @retval 0 on success.
+ * @retval >0 if the packet is a duplicate, too late or could not be stored.
+ */
+int RTPSessionPushPacket( struct RTPSession * session, struct RTPPacketInfo * info ) {
+  struct RTPPeer * peer;
+  struct RTPBufferedPacket * packet, ** pos;
+  unsigned long ext_seqnum;
+  unsigned char * data;
+  size_t i, size = 0;
+
+  if( info == NULL || info->peer == NULL ) return 1;
+  if( info->iovlen > 2 ) return 1;
+  peer = info->peer;
+
+  ext_seqnum = _rtp_extend_seqnum( peer, info->sequence_number );
+  if( _playout_played( peer, ext_seqnum ) ) return 1;
+  for( pos = &(peer->buffered); *pos != NULL && (*pos)->ext_seqnum < ext_seqnum; pos = &((*pos)->next) );
+  if( *pos != NULL && (*pos)->ext_seqnum == ext_seqnum ) return 1;
+
+  if( info->buffer == NULL ) {
+    for( i=0; i<info->iovlen; i++ ) {
+      size += info->iov[i].iov_len;
+    }
+  }
+  packet = malloc( sizeof(struct RTPBufferedPacket) + size );
+  if( packet == NULL ) return 1;
+  if( peer->buffered == NULL && _pending_add( session, peer ) ) {
+    free( packet );
+    return 1;
+  }
+
+  packet->ext_seqnum     = ext_seqnum;
+  packet->info           = *info;
+  packet->info.iov       = &(packet->iov[0]);
+  packet->info.addr_size = 0;
+  packet->info.addr      = NULL;
+  if( info->buffer != NULL ) {
+    /* the data stays in the pooled buffer it was received in */
+    RTPPacketBufferRetain( info->buffer );
+    for( i=0; i<info->iovlen; i++ ) {
+      packet->iov[i] = info->iov[i];
+    }
+  } else {
+    data = (unsigned char *) (packet + 1);
+    for( i=0; i<info->iovlen; i++ ) {
+      memcpy( data, info->iov[i].iov_base, info->iov[i].iov_len );
+      packet->iov[i].iov_base = data;
+      packet->iov[i].iov_len  = info->iov[i].iov_len;
+      data += info->iov[i].iov_len;
+    }
+  }
+
+  RTPPeerRetain( peer );
+  packet->next = *pos;
+  *pos = packet;
+  peer->buffered_length++;
+  return 0;
+}
+
+/**
+ * @brief Take the next packet that is due for playout.
+ * Each peer's packets are played in sequence number order. The head of a
+ * peer's buffer is due once the current time has passed its timestamp
+ * plus the peer's base transit time and playout delay, or when the
+ * buffer is full. Of all due packets the one scheduled first is returned.
+ * The returned info (including its payload) stays valid until the next
+ * call to RTPSessionPopPacket. Retain its @c buffer to keep the payload
+ * around for longer.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @param info    The packet info to fill.
+ * @retval 0 on success.
+ * @retval >0 if no packet is due.
+ */
+int RTPSessionPopPacket( struct RTPSession * session, struct RTPPacketInfo * info ) {
+  struct RTPBufferedPacket * packet;
+  struct RTPPeer * peer;
+  unsigned long now, due;
+  long wait, best_wait = 0;
+  size_t i, best = RTP_PEER_NONE;
+
+  if( info == NULL ) return 1;
+  _buffered_free_list( session->popped );
+  session->popped = NULL;
+
+  now = _rtp_now( session );
+  for( i=0; i<session->pending_length; i++ ) {
+    peer   = session->pending[i];
+    packet = peer->buffered;
+    due    = packet->info.timestamp + peer->in_base_transit
+           + _playout_delay( session, peer ) * session->rate / 1000000;
+    wait   = _ts_diff( due, now );
+    if( peer->buffered_length >= RTP_REORDER_LEN && wait > 0 ) wait = 0;
+    if( wait <= 0 && ( best == RTP_PEER_NONE || wait < best_wait ) ) {
+      best      = i;
+      best_wait = wait;
+    }
+  }
+  if( best == RTP_PEER_NONE ) return 1;
+
+  peer   = session->pending[best];
+  packet = peer->buffered;
+  peer->buffered = packet->next;
+  peer->buffered_length--;
+  if( peer->buffered == NULL ) {
+    _pending_remove( session, best );
+  }
+  _playout_mark( peer, packet->ext_seqnum );
+
+  packet->next    = NULL;
+  session->popped = packet;
+  *info = packet->info;
+  return 0;
+}
+
+/** @} */
+
+/* MARK: Control protocol *//**
+ * @name Control protocol
+ * Exchanging RTCP sender and receiver reports with peers. RTCP packets
+ * are multiplexed on the RTP socket (RFC 5761) and processed whenever
+ * packets are received.
+ * @{
+ */
+
+/**
+ * @brief Encode an RTCP report block that describes a peer's stream.
+ * @private @memberof RTPPeer
+ */
+static void _rtcp_encode_block( struct RTPPeer * peer, unsigned long now, unsigned char * buffer ) {
+  unsigned long expected = peer->in_cycles + peer->in_seqnum - peer->in_base_seqnum + 1;
+  long lost          = (long) expected - (long) peer->in_received;
+  long lost_interval = (long) ( expected - peer->in_expected_prior )
+                     - (long) ( peer->in_received - peer->in_received_prior );
+  unsigned long expected_interval = expected - peer->in_expected_prior;
+
+  peer->in_expected_prior = expected;
+  peer->in_received_prior = peer->in_received;
+  if( lost >  0x7fffff ) lost =  0x7fffff;
+  if( lost < -0x800000 ) lost = -0x800000;
+
+  _rtcp_write32( buffer, peer->address.ssrc );
+  buffer[4] = ( expected_interval == 0 || lost_interval <= 0 ) ? 0 : ( lost_interval << 8 ) / expected_interval;
+  buffer[5] = ( lost >> 16 ) & 0xff;
+  buffer[6] = ( lost >> 8 )  & 0xff;
+  buffer[7] =   lost         & 0xff;
+  _rtcp_write32( buffer+8,  peer->in_cycles - 0x10000 + peer->in_seqnum );
+  _rtcp_write32( buffer+12, peer->in_jitter >> 4 );
+  _rtcp_write32( buffer+16, peer->in_lsr );
+  _rtcp_write32( buffer+20, ( peer->in_lsr == 0 ) ? 0 : ( now - peer->in_lsr_arrival ) & 0xffffffff );
+}
+
+/**
+ * @brief Encode an RTCP sender or receiver report.
+ * A sender report is generated if any packets were sent to @c to,
+ * otherwise a receiver report.
+ * @private @memberof RTPSession
+ * @param session The session.
+ * @param to      The peer (or group) the report is sent to.
+ * @param n       The number of peers to add report blocks for.
+ * @param about   The peers to add report blocks for.
+ * @param time    The report time.
+ * @param buffer  The buffer to encode into, at least RTP_BUF_LEN bytes.
+ * @return the size of the encoded report.
+ */
+static size_t _rtcp_encode_report( struct RTPSession * session, struct RTPPeer * to, size_t n,
+                                   struct RTPPeer ** about, struct RTCPReportTime * time,
+                                   unsigned char * buffer ) {
+  size_t i, size = 8;
+
+  buffer[0] = 0x80 | ( n & 0x1f );
+  buffer[1] = ( to->out_packets > 0 ) ? RTCP_SR : RTCP_RR;
+  _rtcp_write32( buffer+4, session->self.ssrc );
+  if( to->out_packets > 0 ) {
+    _rtcp_write32( buffer+8,  time->sec );
+    _rtcp_write32( buffer+12, time->frac );
+    _rtcp_write32( buffer+16, time->timestamp );
+    _rtcp_write32( buffer+20, to->out_packets );
+    _rtcp_write32( buffer+24, to->out_octets );
+    size = 28;
+  }
+  for( i=0; i<n; i++, size+=24 ) {
+    _rtcp_encode_block( about[i], _ntp_middle( time->sec, time->frac ), buffer+size );
+  }
+  buffer[2] = ( ( size / 4 - 1 ) >> 8 ) & 0xff;
+  buffer[3] =   ( size / 4 - 1 )        & 0xff;
+  return size;
+}
+
+/**
+ * @brief Send all queued reports.
+ * @private @memberof RTPSession
+ */
+static int _rtcp_flush( struct RTPSession * session, size_t * n ) {
+  int count = ( *n > 0 ) ? _impair_sendmmsg( session, *n, &(session->mmsg[0]) ) : 0;
+  int result = ( count < (int) *n ) ? 1 : 0;
+  *n = 0;
+  return result;
+}
+
+/**
+ * @brief Encode a report into the next batch slot, flushing the batch when full.
+ * @private @memberof RTPSession
+ */
+static int _rtcp_queue( struct RTPSession * session, size_t * i, struct RTPPeer * to, size_t n,
+                        struct RTPPeer ** about, struct RTCPReportTime * time ) {
+  struct RTPPacketSlot * slot = &(session->slots[*i]);
+  slot->msg_iov[0].iov_base = &(slot->buffer[0]);
+  slot->msg_iov[0].iov_len  = _rtcp_encode_report( session, to, n, about, time, &(slot->buffer[0]) );
+  _init_msghdr( &(session->mmsg[*i].msg_hdr), to->address.size, &(to->address.addr), 1, &(slot->msg_iov[0]) );
+  session->mmsg[*i].msg_len = 0;
+  if( ++(*i) == RTP_MMSG_LEN ) return _rtcp_flush( session, i );
+  return 0;
+}
+
+/**
+ * @brief Send RTCP reports to all peers.
+ * Each peer gets a sender report (if we sent it any packets) or receiver
+ * report with a report block about its own stream. In multicast mode a
+ * single report with blocks for all peers is sent to the group instead.
+ * Reports are handed to the kernel in batches of RTP_MMSG_LEN and reuse
+ * the session's batch buffers, so packets returned by
+ * RTPSessionReceivePackets must be handled before calling this.
+ * @public @memberof RTPSession
+ * @param session The session.
+ * @retval 0 on success.
+ * @retval >0 if not all reports could be sent.
+ */
+int RTPSessionSendReports( struct RTPSession * session ) {
+  struct RTPPeer * about[RTCP_MAX_BLOCKS];
+  struct RTPPeer * peer;
+  struct RTCPReportTime time;
+  struct timeval tv;
+  size_t p, i = 0, n = 0, queued = 0;
+  int result = 0;
+
+  /* the RTP and NTP timestamps of a sender report describe the same instant */
+  gettimeofday( &tv, NULL );
+  _ntp_timeval( &tv, &(time.sec), &(time.frac) );
+  time.timestamp = _rtp_timeval( session, &tv );
+  for( p=0; p<session->peers.length; p++ ) {
+    peer = session->peers.list[p];
+    if( peer == NULL ) continue;
+    if( session->group == NULL ) {
+      result += _rtcp_queue( session, &i, peer, ( peer->in_received > 0 ) ? 1 : 0, &peer, &time );
+    } else if( peer->in_received > 0 ) {
+      about[n++] = peer;
+      if( n == RTCP_MAX_BLOCKS ) {
+        result += _rtcp_queue( session, &i, session->group, n, &(about[0]), &time );
+        queued++;
+        n = 0;
+      }
+    }
+  }
+  if( session->group != NULL && ( n > 0 || queued == 0 ) ) {
+    result += _rtcp_queue( session, &i, session->group, n, &(about[0]), &time );
+  }
+  result += _rtcp_flush( session, &i );
+  return ( result > 0 ) ? 1 : 0;
+}
+
+/** @} */
@@ -1,11 +1,13 @@
 #ifndef MIDIKIT_DRIVER_RTP_H
 #define MIDIKIT_DRIVER_RTP_H
 #include <stdlib.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 
 struct RTPPeer;
 struct RTPSession;
+struct RTPPacketBuffer;
 
 struct RTPPacketInfo {
   struct RTPPeer * peer;
@@ -22,8 +24,42 @@ struct RTPPacketInfo {
   size_t payload_size;
   size_t iovlen;
   struct iovec * iov;
+  socklen_t addr_size;
+  struct sockaddr * addr;
+  struct timespec arrival;
+  struct RTPPacketBuffer * buffer;
 };
 
+struct RTPPeerStats {
+  unsigned long packets_sent;
+  unsigned long bytes_sent;
+  unsigned long packets_received;
+  unsigned long bytes_received;
+  long          packets_lost;
+  unsigned long jitter;
+  unsigned long round_trip_time;
+  unsigned char remote_fraction_lost;
+  long          remote_packets_lost;
+  unsigned long remote_jitter;
+};
+
+struct RTPImpairment {
+  unsigned long seed;
+  double        loss;
+  double        burst_loss;
+  double        duplicate;
+  unsigned long delay;
+  unsigned long delay_jitter;
+  double        spike;
+  unsigned long spike_delay;
+  double        reorder;
+  unsigned long reorder_delay;
+};
+
+void RTPPacketBufferRetain( struct RTPPacketBuffer * buffer );
+void RTPPacketBufferRelease( struct RTPPacketBuffer * buffer );
+int RTPPacketBufferGetData( struct RTPPacketBuffer * buffer, size_t * size, void ** data );
+
 struct RTPPeer * RTPPeerCreate( unsigned long ssrc, socklen_t size, struct sockaddr * addr );
 void RTPPeerDestroy( struct RTPPeer * peer );
 void RTPPeerRetain( struct RTPPeer * peer );
@@ -31,6 +67,9 @@ void RTPPeerRelease( struct RTPPeer * peer );
 
 int RTPPeerGetSSRC( struct RTPPeer * peer, unsigned long * ssrc );
 int RTPPeerGetAddress( struct RTPPeer * peer, socklen_t * size, struct sockaddr ** addr );
+int RTPPeerGetOutSequenceNumber( struct RTPPeer * peer, unsigned long * seqnum );
+int RTPPeerGetJitter( struct RTPPeer * peer, unsigned long * jitter );
+int RTPPeerGetStats( struct RTPPeer * peer, struct RTPPeerStats * stats );
 int RTPPeerSetInfo( struct RTPPeer * peer, void * info );
 int RTPPeerGetInfo( struct RTPPeer * peer, void ** info );
 
@@ -43,6 +82,17 @@ int RTPSessionSetSSRC( struct RTPSession * session, unsigned long ssrc );
 int RTPSessionGetSSRC( struct RTPSession * session, unsigned long * ssrc );
 int RTPSessionSetSocket( struct RTPSession * session, int socket );
 int RTPSessionGetSocket( struct RTPSession * session, int * socket );
+int RTPSessionSetPacketSize( struct RTPSession * session, size_t size );
+
+int RTPSessionJoinGroup( struct RTPSession * session, socklen_t size, struct sockaddr * group,
+                         unsigned int interface );
+int RTPSessionLeaveGroup( struct RTPSession * session );
+int RTPSessionGetGroup( struct RTPSession * session, struct RTPPeer ** group );
+int RTPSessionSetMulticastTTL( struct RTPSession * session, int ttl );
+int RTPSessionSetMulticastLoopback( struct RTPSession * session, int loopback );
+
+int RTPSessionCreateShard( struct RTPSession * session, struct RTPSession ** shard );
+int RTPSessionSetShardSteering( struct RTPSession * session, size_t shards );
 
 int RTPSessionAddPeer( struct RTPSession * session, struct RTPPeer * peer );
 int RTPSessionRemovePeer( struct RTPSession * session, struct RTPPeer * peer );
@@ -54,7 +104,24 @@ int RTPSessionFindPeerByAddress( struct RTPSession * session, struct RTPPeer **
 
 int RTPSessionSendPacket( struct RTPSession * session, struct RTPPacketInfo * info );
 int RTPSessionReceivePacket( struct RTPSession * session, struct RTPPacketInfo * info );
+int RTPSessionSendPackets( struct RTPSession * session, size_t n, struct RTPPacketInfo * infos, size_t * sent );
+int RTPSessionSendPacketToPeers( struct RTPSession * session, struct RTPPacketInfo * info,
+                                 size_t n, struct RTPPeer ** peers, struct iovec * trailers, size_t * sent );
+int RTPSessionReceivePackets( struct RTPSession * session, size_t n, struct RTPPacketInfo * infos, size_t * received );
 int RTPSessionSend( struct RTPSession * session, size_t size, void * payload, struct RTPPacketInfo * info );
 int RTPSessionReceive( struct RTPSession * session, size_t size, void * payload, struct RTPPacketInfo * info );
 
+int RTPSessionSetClockRate( struct RTPSession * session, unsigned long rate );
+int RTPSessionSetKernelTimestamps( struct RTPSession * session, int enable );
+int RTPSessionSetPlayoutDelay( struct RTPSession * session, unsigned long min_delay, unsigned long max_delay );
+int RTPSessionGetPlayoutDelay( struct RTPSession * session, struct RTPPeer * peer, unsigned long * delay );
+int RTPSessionPushPacket( struct RTPSession * session, struct RTPPacketInfo * info );
+int RTPSessionPopPacket( struct RTPSession * session, struct RTPPacketInfo * info );
+
+int RTPSessionSendReports( struct RTPSession * session );
+
+int RTPSessionSetImpairment( struct RTPSession * session, struct RTPImpairment * send,
+                             struct RTPImpairment * receive );
+int RTPSessionGetImpairedArrival( struct RTPSession * session, struct timespec * arrival );
+
 #endif
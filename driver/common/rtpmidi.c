@@ -95,6 +95,10 @@ struct RTPMIDISession {
 
   size_t size;
   void * buffer;
+
+  size_t peers_size;
+  struct RTPPeer ** peers;
+  struct iovec    * journals;
 /** @endcond */
 };
 
@@ -132,6 +136,10 @@ struct RTPMIDISession * RTPMIDISessionCreate( struct RTPSession * rtp_session )
   if( session->buffer == NULL ) {
     session->size = 0;
   }
+
+  session->peers_size = 0;
+  session->peers      = NULL;
+  session->journals   = NULL;
   return session;
 }
 
@@ -147,6 +155,8 @@ void RTPMIDISessionDestroy( struct RTPMIDISession * session ) {
   if( session->size > 0 && session->buffer != NULL ) {
     free( session->buffer );
   }
+  free( session->peers );
+  free( session->journals );
   free( session );
 }
 
@@ -466,11 +476,34 @@ static int _rtpmidi_decode_messages( struct RTPMIDIInfo * info, MIDITimestamp ti
   return result;
 }
 
+/**
+ * @brief Make room for more peers in the fan-out lists.
+ * @private @memberof RTPMIDISession
+ * @param session The session.
+ * @retval 0 on success.
+ * @retval >0 if the lists could not be grown.
+ */
+static int _rtpmidi_grow_peers( struct RTPMIDISession * session ) {
+  size_t size = ( session->peers_size == 0 ) ? 16 : session->peers_size * 2;
+  struct RTPPeer ** peers;
+  struct iovec    * journals;
+
+  peers = realloc( session->peers, sizeof(struct RTPPeer *) * size );
+  if( peers == NULL ) return 1;
+  session->peers = peers;
+  journals = realloc( session->journals, sizeof(struct iovec) * size );
+  if( journals == NULL ) return 1;
+  session->journals   = journals;
+  session->peers_size = size;
+  return 0;
+}
+
 /**
  * @brief Send MIDI messages over an RTPSession.
- * Broadcast the messages to all connected peers. Store the number of sent messages
- * in @c count, if the @c info argument was specified it will be populated with the
- * packet info of the last sent packet.
+ * Broadcast the messages to all connected peers. The payload is encoded
+ * once and sent to all peers in one batch, only the sequence number and
+ * the journal differ between peers. If the RTP session joined a multicast
+ * group, a single packet is sent to the group instead.
  * The peer's control structures will be updated with the required journalling
  * information.
  * @public @memberof RTPMIDISession
@@ -481,12 +514,15 @@ static int _rtpmidi_decode_messages( struct RTPMIDIInfo * info, MIDITimestamp ti
  */
 int RTPMIDISessionSend( struct RTPMIDISession * session, struct MIDIMessageList * messages ) {
   int result = 0;
-  struct iovec iov[3];
+  struct iovec iov[2];
+  size_t i, n, sent;
   size_t written = 0;
   size_t size    = session->size;
   void * buffer  = session->buffer;
+  unsigned long seqnum;
 
   struct RTPPeer        * peer    = NULL;
+  struct RTPPeer        * group   = NULL;
   struct RTPMIDIJournal * journal = NULL;
   struct RTPMIDIInfo    * minfo   = &(session->midi_info);
   struct RTPPacketInfo  * info    = &(session->rtp_info);
@@ -518,33 +554,45 @@ int RTPMIDISessionSend( struct RTPMIDISession * session, struct MIDIMessageList
   iov[0].iov_len  = written;
   _advance_buffer( &size, &buffer, written );
 
-  /* send encoded messages to each peer
-   * each peer has its own journal */
-  result = RTPSessionNextPeer( session->rtp_session, &peer );
+  /* collect the peers to send the encoded messages to,
+   * each peer has its own journal. in multicast mode the
+   * group is the only peer. */
+  n = 0;
+  if( RTPSessionGetGroup( session->rtp_session, &group ) == 0 ) {
+    peer = group;
+  } else {
+    RTPSessionNextPeer( session->rtp_session, &peer );
+  }
   while( peer != NULL ) {
+    if( n == session->peers_size && _rtpmidi_grow_peers( session ) ) return 1;
+    session->peers[n] = peer;
     if( minfo->journal ) {
       journal = NULL; /* peer out journal */
       _rtpmidi_journal_encode( session, journal, size, buffer, &written );
-      iov[2].iov_base = buffer;
-      iov[2].iov_len  = written;
+      session->journals[n].iov_base = buffer;
+      session->journals[n].iov_len  = written;
       _advance_buffer( &size, &buffer, written );
     } else {
-      iov[2].iov_base = NULL;
-      iov[2].iov_len  = 0;
+      session->journals[n].iov_base = NULL;
+      session->journals[n].iov_len  = 0;
     }
+    n++;
+    if( peer == group ) break;
+    RTPSessionNextPeer( session->rtp_session, &peer );
+  }
 
-    info->peer   = peer;
-    info->iovlen = ( minfo->journal ) ? 3 : 2;
-    info->iov    = &(iov[0]);
-    info->payload_size = iov[0].iov_len + iov[1].iov_len + iov[2].iov_len;
+  info->iovlen = 2;
+  info->iov    = &(iov[0]);
 
-    result = RTPSessionSendPacket( session->rtp_session, info );
+  result = RTPSessionSendPacketToPeers( session->rtp_session, info, n, session->peers,
+                                        ( minfo->journal ) ? session->journals : NULL, &sent );
 
-    if( result == 0 && minfo->journal ) {
-      _rtpmidi_journal_encode_messages( journal, info->sequence_number, messages );
+  if( minfo->journal ) {
+    for( i=0; i<sent; i++ ) {
+      journal = NULL; /* peer out journal */
+      RTPPeerGetOutSequenceNumber( session->peers[i], &seqnum );
+      _rtpmidi_journal_encode_messages( journal, seqnum, messages );
     }
-
-    RTPSessionNextPeer( session->rtp_session, &peer );
   }
 
   return result;
@@ -552,41 +600,36 @@ int RTPMIDISessionSend( struct RTPMIDISession * session, struct MIDIMessageList
 
 
 /**
- * @brief Receive MIDI messages over an RTPSession.
- * Receive messages from any connected peer. Store the number of received messages
- * in @c count, if the @c info argument was specified it will be populated with the
- * packet info of the last received packet.
+ * @brief Decode the MIDI messages contained in a received RTP packet.
+ * Interpret the RTP-MIDI payload of a packet that was received via the
+ * underlying RTPSession (for example by RTPSessionReceivePackets) and
+ * store the messages in the list.
  * If lost packets are detected the required information is recovered from the
  * journal.
  * @public @memberof RTPMIDISession
  * @param session  The session.
+ * @param info     The packet info of the received packet.
  * @param messages A pointer to a list of midi messages.
  * @retval 0 on success.
- * @retval >0 If the message was corrupted or could not be received.
+ * @retval >0 If the packet was corrupted.
  */
-int RTPMIDISessionReceive( struct RTPMIDISession * session, struct MIDIMessageList * messages ) {
+int RTPMIDISessionDecodePacket( struct RTPMIDISession * session, struct RTPPacketInfo * info,
+                                struct MIDIMessageList * messages ) {
   int result = 0;
-  struct iovec iov[3];
   size_t read = 0;
   size_t size;
   void * buffer;
   MIDITimestamp timestamp;
 
-  struct RTPPeer        * peer    = NULL;
   struct RTPMIDIJournal * journal = NULL;
   struct RTPMIDIInfo    * minfo   = &(session->midi_info);
-  struct RTPPacketInfo  * info    = &(session->rtp_info);
 
-  info->iovlen = 3;
-  info->iov    = &(iov[0]);
-  
-  if( messages == NULL ) return 1;
-  result = RTPSessionReceivePacket( session->rtp_session, info );
-  if( result != 0 ) return result;
+  if( info == NULL || messages == NULL ) return 1;
+  if( info->peer == NULL || info->iovlen < 1 ) return 1;
   
   timestamp = info->timestamp;
-  size      = info->iov[0].iov_len;
-  buffer    = info->iov[0].iov_base;
+  size      = info->iov[info->iovlen-1].iov_len;
+  buffer    = info->iov[info->iovlen-1].iov_base;
 
   _rtpmidi_decode_header( minfo, size, buffer, &read );
   _advance_buffer( &size, &buffer, read );
@@ -607,16 +650,63 @@ int RTPMIDISessionReceive( struct RTPMIDISession * session, struct MIDIMessageLi
       }
     }
   }
-  /* - clear the internal packet buffer
-   * - repeat as long as the socket holds packets:
-   *   - if the packet is not currupted sort it into the internal packet buffer
-   *     using it's sequence number (first sent, first dispatched)
-   *   - if the packet is corrupted, omit it
-   * - write messages from the internal packet buffer to the message
-   *   list and recover lost packets on the way
-   * - store messages that don't fit into the supplied buffer in the
-   *   internal message buffer
-   */
+  return result;
+}
+
+/**
+ * @brief Receive MIDI messages over an RTPSession.
+ * Receive messages from any connected peer. Store the number of received messages
+ * in @c count, if the @c info argument was specified it will be populated with the
+ * packet info of the last received packet.
+ * If lost packets are detected the required information is recovered from the
+ * journal.
+ * @public @memberof RTPMIDISession
+ * @param session  The session.
+ * @param messages A pointer to a list of midi messages.
+ * @retval 0 on success.
+ * @retval >0 If the message was corrupted or could not be received.
+ */
+int RTPMIDISessionReceive( struct RTPMIDISession * session, struct MIDIMessageList * messages ) {
+  int result = 0;
+  struct iovec iov[3];
+  struct RTPPacketInfo * info = &(session->rtp_info);
+
+  info->iovlen = 3;
+  info->iov    = &(iov[0]);
+  
+  if( messages == NULL ) return 1;
+  result = RTPSessionReceivePacket( session->rtp_session, info );
+  if( result != 0 ) return result;
+
+  RTPSessionPushPacket( session->rtp_session, info );
+  return RTPMIDISessionPlayout( session, messages );
+}
+
+/**
+ * @brief Decode all packets that are due for playout.
+ * Packets of each peer are decoded in sequence number order once their
+ * playout time has come. Messages are appended to the first unused
+ * elements of the message list.
+ * @public @memberof RTPMIDISession
+ * @param session  The session.
+ * @param messages The message list.
+ * @retval 0 on success.
+ * @retval >0 if a packet could not be decoded.
+ */
+int RTPMIDISessionPlayout( struct RTPMIDISession * session, struct MIDIMessageList * messages ) {
+  int result = 0;
+  struct RTPPacketInfo info;
+
+  if( messages == NULL ) return 1;
+  while( messages != NULL && messages->message != NULL ) {
+    messages = messages->next;
+  }
+  while( messages != NULL && RTPSessionPopPacket( session->rtp_session, &info ) == 0 ) {
+    result += RTPMIDISessionDecodePacket( session, &info, messages );
+    while( messages != NULL && messages->message != NULL ) {
+      messages = messages->next;
+    }
+  }
   return result;
 }
 
@@ -5,6 +5,7 @@
 
 struct RTPPeer;
 struct RTPSession;
+struct RTPPacketInfo;
 
 struct RTPMIDISession;
 
@@ -24,5 +25,8 @@ int RTPMIDIPeerGetInfo( struct RTPPeer * peer, void ** info );
 
 int RTPMIDISessionSend( struct RTPMIDISession * session, struct MIDIMessageList * messages );
 int RTPMIDISessionReceive( struct RTPMIDISession * session, struct MIDIMessageList * messages );
+int RTPMIDISessionPlayout( struct RTPMIDISession * session, struct MIDIMessageList * messages );
+int RTPMIDISessionDecodePacket( struct RTPMIDISession * session, struct RTPPacketInfo * info,
+                                struct MIDIMessageList * messages );
 
 #endif
@@ -1,6 +1,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
 
 #include "clock.h"
 
@@ -25,7 +27,14 @@
 #define _MIDI_CLOCK_POSIX { &_init_clock_posix, &_timestamp_posix }
 #endif
 
-#if !defined(_MIDI_CLOCK_MACH) && !defined(_MIDI_CLOCK_POSIX)
+/* Opt-in: only enable this on machines with an invariant TSC. */
+#if defined(MIDI_CLOCK_TSC) && ( defined(__x86_64__) || defined(__i386__) )
+#include <sys/time.h>
+#include <x86intrin.h>
+#define _MIDI_CLOCK_TSC { &_init_clock_tsc, &_timestamp_tsc }
+#endif
+
+#if !defined(_MIDI_CLOCK_MACH) && !defined(_MIDI_CLOCK_POSIX) && !defined(_MIDI_CLOCK_TSC)
 #include <sys/time.h>
 #define _MIDI_CLOCK_SYS { &_init_clock_sys, &_timestamp_sys }
 #endif
@@ -34,6 +43,34 @@
 #define USEC_PER_SEC 1000000
 #define NSEC_PER_SEC 1000000000
 
+#define TSC_CALIBRATION_USEC 20000
+
+/**
+ * @brief Precomputed conversion by a constant fraction.
+ * Scaling a value @c v by @c numer/denom is done by multiplying with
+ * the numerator and dividing by a multiplication with the reciprocal
+ * of the denominator in 64.64 fixed point (or a shift if the denominator
+ * is a power of two). A single correction step makes the result exactly
+ * equal to <tt>(v*numer)/denom</tt>.
+ * Only the distance of @c v to a base is multiplied, so that it does not
+ * overflow while @c v grows, like the raw counter of a clock source does.
+ * The base is kept as a count of whole denominators, so it scales
+ * exactly, and is moved when the distance gets too large.
+ */
+struct MIDIClockScale {
+/**
+ * @privatesection
+ * @cond INTERNALS
+ */
+  unsigned long long numer;
+  unsigned long long denom;
+  unsigned long long recip;
+  unsigned long long limit;
+  unsigned long long base;
+  int                shift;
+/** @endcond */
+};
+
 /**
  * @ingroup MIDI
  * @struct MIDIClock clock.h
@@ -52,6 +89,7 @@ struct MIDIClock {
   MIDISamplingRate rate;
   unsigned long long numer;
   unsigned long long denom;
+  struct MIDIClockScale real;
 /** @endcond */
 };
 
@@ -121,6 +159,99 @@ static void _multiply_frac( unsigned long long * numer, unsigned long long * den
   _divide_frac( denom, numer, fac );
 }
 
+/**
+ * @brief Get the upper 64 bits of a 64x64 bit multiplication.
+ * @private @memberof MIDIClock
+ * @param a The first factor.
+ * @param b The second factor.
+ * @return the upper half of the 128 bit product.
+ */
+static unsigned long long _mulhi( unsigned long long a, unsigned long long b ) {
+#ifdef __SIZEOF_INT128__
+  return (unsigned long long) ( ( (unsigned __int128) a * b ) >> 64 );
+#else
+  unsigned long long a_lo = a & 0xffffffffULL, a_hi = a >> 32;
+  unsigned long long b_lo = b & 0xffffffffULL, b_hi = b >> 32;
+  unsigned long long lo_lo = a_lo * b_lo;
+  unsigned long long hi_lo = a_hi * b_lo;
+  unsigned long long lo_hi = a_lo * b_hi;
+  unsigned long long cross = ( lo_lo >> 32 ) + ( hi_lo & 0xffffffffULL ) + lo_hi;
+  return a_hi * b_hi + ( hi_lo >> 32 ) + ( cross >> 32 );
+#endif
+}
+
+/**
+ * @brief Precompute the conversion by a fraction.
+ * @private @memberof MIDIClock
+ * @param scale The scale to initialize.
+ * @param numer The numerator.
+ * @param denom The denominator.
+ */
+static void _scale_init( struct MIDIClockScale * scale, unsigned long long numer, unsigned long long denom ) {
+  int shift;
+  scale->numer = numer;
+  scale->denom = denom;
+  scale->limit = ( numer > 1 ) ? ( ~0ULL / numer ) : ~0ULL;
+  scale->recip = 0;
+  scale->base  = 0;
+  scale->shift = -1;
+  if( denom == 0 ) return;
+  if( ( denom & ( denom - 1 ) ) == 0 ) {
+    for( shift=0; ( 1ULL << shift ) != denom; shift++ );
+    scale->shift = shift;
+  } else {
+    /* floor(2^64/denom), denom is no power of two */
+    scale->recip = ~0ULL / denom;
+  }
+}
+
+/**
+ * @brief Scale a value by a precomputed fraction.
+ * The result is exactly <tt>(value*numer)/denom</tt>, rounded towards zero.
+ * The value is split into the base, a multiple of the denominator, and
+ * the distance to it. If the distance would overflow the multiplication
+ * the base is moved to the multiple right below the value.
+ * @private @memberof MIDIClock
+ * @param scale The scale.
+ * @param value The value.
+ * @return the scaled value.
+ */
+static unsigned long long _scale_apply( struct MIDIClockScale * scale, unsigned long long value ) {
+  unsigned long long base = scale->base, n, q;
+  if( value < base * scale->denom || value - base * scale->denom > scale->limit ) {
+    base = value / scale->denom;
+    if( value - base * scale->denom > scale->limit ) {
+      return base * scale->numer + ( ( value - base * scale->denom ) * scale->numer ) / scale->denom;
+    }
+    scale->base = base;
+  }
+  n = ( value - base * scale->denom ) * scale->numer;
+  if( scale->shift >= 0 ) {
+    return base * scale->numer + ( n >> scale->shift );
+  }
+  q = _mulhi( n, scale->recip );
+  if( n - q * scale->denom >= scale->denom ) {
+    q++;
+  }
+  return base * scale->numer + q;
+}
+
+/**
+ * @brief Scale a signed value by a precomputed fraction.
+ * @see _scale_apply
+ * @private @memberof MIDIClock
+ * @param scale The scale.
+ * @param value The value.
+ * @return the scaled value.
+ */
+static long long _scale_apply_signed( struct MIDIClockScale * scale, long long value ) {
+  if( value < 0 ) {
+    return -(long long) _scale_apply( scale, -(unsigned long long) value );
+  } else {
+    return (long long) _scale_apply( scale, value );
+  }
+}
+
 #ifdef _MIDI_CLOCK_MACH
 /**
  * Initialize a clock to be used with @c mach_absolute_time().
@@ -171,6 +302,43 @@ static unsigned long long _timestamp_posix( void ) {
 }
 #endif
 
+#ifdef _MIDI_CLOCK_TSC
+/**
+ * Initialize a clock to be used with the CPU's time stamp counter.
+ * The TSC frequency is calibrated once against @c gettimeofday().
+ * @private @memberof MIDIClock
+ * @param clock The clock.
+ */
+static void _init_clock_tsc( struct MIDIClock * clock ) {
+  static unsigned long long tsc_hz = 0;
+  struct timeval start, end;
+  unsigned long long tsc_start, tsc_end, usec;
+  if( tsc_hz == 0 ) {
+    gettimeofday( &start, NULL );
+    tsc_start = __rdtsc();
+    do {
+      gettimeofday( &end, NULL );
+      usec = (unsigned long long) ( end.tv_sec - start.tv_sec ) * USEC_PER_SEC
+           + ( end.tv_usec - start.tv_usec );
+    } while( usec < TSC_CALIBRATION_USEC );
+    tsc_end = __rdtsc();
+    tsc_hz  = ( ( tsc_end - tsc_start ) * USEC_PER_SEC ) / usec;
+    MIDILog( DEBUG, "TSC frequency: %llu Hz\n", tsc_hz );
+  }
+  clock->numer = 1;
+  clock->denom = tsc_hz;
+}
+
+/**
+ * Get a timestamp by reading the time stamp counter.
+ * @private @memberof MIDIClock
+ * @return a timestamp in TSC ticks.
+ */
+static unsigned long long _timestamp_tsc( void ) {
+  return __rdtsc();
+}
+#endif
+
 #ifdef _MIDI_CLOCK_SYS
 /**
  * Initialize a clock to be used with good old @c gettimeofday().
@@ -204,6 +372,9 @@ static struct {
 #ifdef _MIDI_CLOCK_POSIX
   _MIDI_CLOCK_POSIX,
 #endif
+#ifdef _MIDI_CLOCK_TSC
+  _MIDI_CLOCK_TSC,
+#endif
 #ifdef _MIDI_CLOCK_SYS
   _MIDI_CLOCK_SYS,
 #endif
@@ -223,7 +394,34 @@ static struct MIDIClock * _midi_global_clock = NULL;
  * @param clock The clock.
  */
 static MIDITimestamp _get_real_time( struct MIDIClock * clock ) {
-  return ((*_midi_clock[0].timestamp)() * clock->numer) / clock->denom;
+  return _scale_apply( &(clock->real), (*_midi_clock[0].timestamp)() );
+}
+
+/**
+ * @brief Update the precomputed conversions.
+ * Must be called whenever the clock's fraction changes.
+ * @private @memberof MIDIClock
+ * @param clock The clock.
+ */
+static void _update_scale( struct MIDIClock * clock ) {
+  _scale_init( &(clock->real), clock->numer, clock->denom );
+}
+
+/**
+ * @brief Get the conversion from another clock's timebase.
+ * The conversion is computed into a caller provided scale, neither
+ * clock is modified. Batch conversions compute it once per call.
+ * @private @memberof MIDIClock
+ * @param clock  The clock to convert to.
+ * @param source The clock to convert from.
+ * @param scale  The conversion.
+ */
+static void _get_convert_scale( struct MIDIClock * clock, struct MIDIClock * source, struct MIDIClockScale * scale ) {
+  unsigned long long numer, denom;
+  numer = clock->numer * source->denom;
+  denom = clock->denom * source->numer;
+  _normalize_frac( &numer, &denom );
+  _scale_init( scale, numer, denom );
 }
 
 /**
@@ -326,6 +524,7 @@ struct MIDIClock * MIDIClockCreate( MIDISamplingRate rate ) {
   if( rate == 0 ) rate = ( clock->denom / clock->numer );
   _multiply_frac( &(clock->numer), &(clock->denom), rate );
   _normalize_frac( &(clock->numer), &(clock->denom) );
+  _update_scale( clock );
   clock->rate   = rate;
   clock->offset = -1 * _get_real_time( clock );
   MIDILogLocation( DEVELOP, "Initialized clock:\n  rate: %u, offset: %lli\n  numer: %llu / denom: %llu\n",
@@ -420,7 +619,10 @@ int MIDIClockGetNow( struct MIDIClock * clock, MIDITimestamp * now ) {
 int MIDIClockSetSamplingRate( struct MIDIClock * clock, MIDISamplingRate rate ) {
   if( clock == NULL ) clock = _get_global_clock();
   MIDIPrecond( clock->refs == 1, EFAULT );
-  clock->numer = ( clock->numer / clock->rate ) * rate;
+  _divide_frac( &(clock->numer), &(clock->denom), clock->rate );
+  _multiply_frac( &(clock->numer), &(clock->denom), rate );
+  _normalize_frac( &(clock->numer), &(clock->denom) );
+  _update_scale( clock );
   clock->rate  = rate;
   return 0;
 }
@@ -452,7 +654,7 @@ int MIDIClockGetSamplingRate( struct MIDIClock * clock, MIDISamplingRate * rate
 int MIDIClockTimestampToSeconds( struct MIDIClock * clock, MIDITimestamp timestamp, double * seconds ) {
   MIDIPrecond( seconds != NULL, EINVAL );
   if( clock == NULL ) clock = _get_global_clock();
-  *seconds = timestamp / clock->rate;
+  *seconds = (double) timestamp / clock->rate;
   return 0;
 }
 
@@ -471,6 +673,30 @@ int MIDIClockTimestampFromSeconds( struct MIDIClock * clock, MIDITimestamp * tim
   return 0;
 }
 
+/**
+ * @brief Convert a wallclock time to a clock's timestamp.
+ * Map a recent time of the system's realtime clock (like the kernel
+ * arrival time of a datagram) into the clock's domain by subtracting
+ * its age from the current time of the clock.
+ * @public @memberof MIDIClock
+ * @param clock     The clock (pass @c NULL for global clock)
+ * @param timestamp The timestamp corresponding to the wallclock time.
+ * @param wallclock The wallclock time.
+ * @retval 0 on success.
+ */
+int MIDIClockTimestampFromWallclock( struct MIDIClock * clock, MIDITimestamp * timestamp, struct timespec * wallclock ) {
+  struct timeval tv;
+  double age;
+  MIDIPrecond( timestamp != NULL, EINVAL );
+  MIDIPrecond( wallclock != NULL, EINVAL );
+  if( clock == NULL ) clock = _get_global_clock();
+  gettimeofday( &tv, NULL );
+  age = (double) ( tv.tv_sec - wallclock->tv_sec )
+      + (double) ( tv.tv_usec * 1000L - wallclock->tv_nsec ) / 1000000000.0;
+  *timestamp = _get_real_time( clock ) + clock->offset - (MIDITimestamp) ( age * clock->rate );
+  return 0;
+}
+
 /**
  * @brief Convert between different clocks.
  * Convert a timestamp that was created by a given clock to the timestamp of another clock.
@@ -482,24 +708,107 @@ int MIDIClockTimestampFromSeconds( struct MIDIClock * clock, MIDITimestamp * tim
  * @retval 0 on success.
  */
 int MIDIClockConvertTimestamp( struct MIDIClock * clock, struct MIDIClock * source, MIDITimestamp * timestamp ) {
-  long long tmp;
-  unsigned long long numer, denom;
-
+  struct MIDIClockScale scale;
   MIDIPrecond( timestamp != NULL, EINVAL );
   if( clock == NULL )   clock  = _get_global_clock();
   if( source == NULL )  source = _get_global_clock();
   if( clock == source ) return 0;
 
-  numer = clock->numer * source->denom;
-  denom = clock->denom * source->numer;
-  _normalize_frac( &numer, &denom );
+  _get_convert_scale( clock, source, &scale );
+  *timestamp = _scale_apply_signed( &scale, *timestamp - source->offset ) + clock->offset;
+  return 0;
+}
+
+/** @} */
+
+/* MARK: Batch functions *//**
+ * @name Batch functions
+ * Convert arrays of timestamps at once.
+ * The results are exactly the same as those of the corresponding
+ * single-value functions. Input and output arrays may be the same.
+ * @{
+ */
 
-  /* printf( "Rate: %u->%u, *%llu/%llu\n", source->rate, clock->rate, numer, denom ); */
-  tmp = ( *timestamp - source->offset );
-  /* printf( "tmp:%lli\n", tmp ); */
-  tmp = ( tmp * numer ) / denom;
-  /* printf( "tmp:%lli\n", tmp ); */
-  *timestamp = ( tmp + clock->offset );
+/**
+ * @brief Convert many timestamps between different clocks.
+ * @see MIDIClockConvertTimestamp
+ * @public @memberof MIDIClock
+ * @param clock  The clock to convert to (pass @c NULL for global clock)
+ * @param source The clock that created the timestamps (pass @c NULL for global clock)
+ * @param n      The number of timestamps.
+ * @param in     The timestamps to convert.
+ * @param out    The converted timestamps.
+ * @retval 0 on success.
+ */
+int MIDIClockConvertTimestamps( struct MIDIClock * clock, struct MIDIClock * source, size_t n,
+                                MIDITimestamp * in, MIDITimestamp * out ) {
+  struct MIDIClockScale scale;
+  MIDITimestamp in_offset, out_offset;
+  size_t i;
+
+  MIDIPrecond( n == 0 || ( in != NULL && out != NULL ), EINVAL );
+  if( clock == NULL )   clock  = _get_global_clock();
+  if( source == NULL )  source = _get_global_clock();
+  if( clock == source ) {
+    if( in != out ) {
+      for( i=0; i<n; i++ ) out[i] = in[i];
+    }
+    return 0;
+  }
+
+  _get_convert_scale( clock, source, &scale );
+  in_offset  = source->offset;
+  out_offset = clock->offset;
+  for( i=0; i<n; i++ ) {
+    out[i] = _scale_apply_signed( &scale, in[i] - in_offset ) + out_offset;
+  }
+  return 0;
+}
+
+/**
+ * @brief Convert many timestamps to seconds.
+ * @see MIDIClockTimestampToSeconds
+ * @public @memberof MIDIClock
+ * @param clock   The clock (pass @c NULL for global clock)
+ * @param n       The number of timestamps.
+ * @param in      The timestamps to convert.
+ * @param seconds The timestamps converted to seconds.
+ * @retval 0 on success.
+ */
+int MIDIClockTimestampsToSeconds( struct MIDIClock * clock, size_t n, MIDITimestamp * in, double * seconds ) {
+  double rate;
+  size_t i;
+
+  MIDIPrecond( n == 0 || ( in != NULL && seconds != NULL ), EINVAL );
+  if( clock == NULL ) clock = _get_global_clock();
+  rate = clock->rate;
+  /* simple enough to be vectorized by the compiler */
+  for( i=0; i<n; i++ ) {
+    seconds[i] = (double) in[i] / rate;
+  }
+  return 0;
+}
+
+/**
+ * @brief Convert many seconds to timestamps.
+ * @see MIDIClockTimestampFromSeconds
+ * @public @memberof MIDIClock
+ * @param clock     The clock (pass @c NULL for global clock)
+ * @param n         The number of values.
+ * @param seconds   The seconds to convert.
+ * @param out       The seconds converted to timestamps.
+ * @retval 0 on success.
+ */
+int MIDIClockTimestampsFromSeconds( struct MIDIClock * clock, size_t n, double * seconds, MIDITimestamp * out ) {
+  double rate;
+  size_t i;
+
+  MIDIPrecond( n == 0 || ( seconds != NULL && out != NULL ), EINVAL );
+  if( clock == NULL ) clock = _get_global_clock();
+  rate = clock->rate;
+  for( i=0; i<n; i++ ) {
+    out[i] = seconds[i] * rate;
+  }
   return 0;
 }
 
@@ -1,5 +1,6 @@
 #ifndef MIDIKIT_MIDI_CLOCK_H
 #define MIDIKIT_MIDI_CLOCK_H
+#include <stddef.h>
 #include "midi.h"
 
 #define MIDI_SAMPLING_RATE_8KHZ      8000
@@ -13,6 +14,7 @@
 #define MIDI_SAMPLING_RATE_DEFAULT      0
 
 struct MIDIClock;
+struct timespec;
 
 int MIDIClockSetGlobalClock( struct MIDIClock * clock );
 int MIDIClockGetGlobalClock( struct MIDIClock ** clock );
@@ -31,7 +33,13 @@ int MIDIClockGetSamplingRate( struct MIDIClock * clock, MIDISamplingRate * rate
 
 int MIDIClockTimestampToSeconds( struct MIDIClock * clock, MIDITimestamp timestamp, double * seconds );
 int MIDIClockTimestampFromSeconds( struct MIDIClock * clock, MIDITimestamp * timestamp, double seconds );
+int MIDIClockTimestampFromWallclock( struct MIDIClock * clock, MIDITimestamp * timestamp, struct timespec * wallclock );
 
 int MIDIClockConvertTimestamp( struct MIDIClock * clock, struct MIDIClock * source, MIDITimestamp * timestamp );
 
+int MIDIClockConvertTimestamps( struct MIDIClock * clock, struct MIDIClock * source, size_t n,
+                                MIDITimestamp * in, MIDITimestamp * out );
+int MIDIClockTimestampsToSeconds( struct MIDIClock * clock, size_t n, MIDITimestamp * in, double * seconds );
+int MIDIClockTimestampsFromSeconds( struct MIDIClock * clock, size_t n, double * seconds, MIDITimestamp * out );
+
 #endif
@@ -0,0 +1,464 @@
+#include <stdlib.h>
+#include "clock_sync.h"
+#include "clock.h"
+
+#define MIDI_CLOCK_SYNC_MAX_SLEW_DEFAULT 0.0005
+#define MIDI_CLOCK_SYNC_MAX_SKEW         0.01
+#define MIDI_CLOCK_SYNC_OUTLIER_SIGMA    2.5
+
+/**
+ * @ingroup MIDI
+ * @struct MIDIClockSync clock_sync.h
+ * @brief Synchronize a MIDIClock with a remote clock.
+ * The MIDIClockSync takes pairs of local and remote timestamps that
+ * were taken at about the same time (for example by a network sync
+ * exchange) and estimates the offset and the rate difference (skew)
+ * between both clocks with a least-squares fit over a sliding window
+ * of samples. Samples that deviate too much from the fit are ignored.
+ * When a new estimate differs from the previous one, the converted
+ * time is slewed towards the new estimate at a limited rate instead
+ * of jumping, so that it always stays monotonic.
+ */
+struct MIDIClockSync {
+/**
+ * @privatesection
+ * @cond INTERNALS
+ */
+  int    refs;
+  struct MIDIClock * clock;
+  double nominal;
+  double max_slew;
+  MIDITimestamp step_threshold;
+
+  int    count;
+  int    next;
+  int    size;
+  MIDITimestamp local[MIDI_CLOCK_SYNC_WINDOW];
+  MIDITimestamp remote[MIDI_CLOCK_SYNC_WINDOW];
+
+  MIDITimestamp origin_local;
+  MIDITimestamp origin_remote;
+  double base;
+  double rate;
+
+  MIDITimestamp slew_local;
+  MIDITimestamp slew_remote;
+  MIDITimestamp slew_end;
+  double slew_rate;
+
+  MIDITimestamp last;
+/** @endcond */
+};
+
+/* MARK: Internals *//**
+ * @name Internals
+ * @cond INTERNALS
+ * Internal functions for estimating and slewing.
+ * @{
+ */
+
+/**
+ * @brief Round a value down to the next integer.
+ * @private @memberof MIDIClockSync
+ * @param v The value.
+ * @return the largest integer not greater than @c v.
+ */
+static MIDITimestamp _floor( double v ) {
+  MIDITimestamp i = (MIDITimestamp) v;
+  return ( (double) i > v ) ? i - 1 : i;
+}
+
+/**
+ * @brief Get the absolute value.
+ * @private @memberof MIDIClockSync
+ * @param v The value.
+ * @return the absolute value of @c v.
+ */
+static double _abs( double v ) {
+  return ( v < 0 ) ? -v : v;
+}
+
+/**
+ * @brief Evaluate the current estimate relative to an anchor.
+ * @private @memberof MIDIClockSync
+ * @param sync   The clock sync.
+ * @param local  The local timestamp.
+ * @param anchor The remote timestamp the result is relative to.
+ * @return the estimated remote time minus @c anchor.
+ */
+static double _sync_estimate( struct MIDIClockSync * sync, MIDITimestamp local, MIDITimestamp anchor ) {
+  return (double) ( sync->origin_remote - anchor )
+       + sync->base + sync->rate * (double) ( local - sync->origin_local );
+}
+
+/**
+ * @brief Convert a local timestamp to the slewed remote time.
+ * @private @memberof MIDIClockSync
+ * @param sync  The clock sync.
+ * @param local The local timestamp.
+ * @return the remote timestamp.
+ */
+static MIDITimestamp _sync_output( struct MIDIClockSync * sync, MIDITimestamp local ) {
+  if( local < sync->slew_end ) {
+    return sync->slew_remote + _floor( sync->slew_rate * (double) ( local - sync->slew_local ) );
+  } else {
+    return sync->origin_remote + _floor( _sync_estimate( sync, local, sync->origin_remote ) );
+  }
+}
+
+/**
+ * @brief Fit a line through the samples in the window.
+ * All values are taken relative to the most recent sample to keep the
+ * floating point calculations precise. Samples with an index set in
+ * @c skip are not used.
+ * @private @memberof MIDIClockSync
+ * @param sync  The clock sync.
+ * @param skip  Flags for samples that should be ignored.
+ * @param base  The fitted remote time at the most recent local time.
+ * @param rate  The fitted rate of remote ticks per local tick.
+ * @return the number of samples used.
+ */
+static int _sync_fit( struct MIDIClockSync * sync, char * skip, double * base, double * rate ) {
+  int i, j, n = 0;
+  int newest = ( sync->next + MIDI_CLOCK_SYNC_WINDOW - 1 ) % MIDI_CLOCK_SYNC_WINDOW;
+  double x, y, sx = 0, sy = 0, sxx = 0, sxy = 0;
+
+  for( j=0; j<sync->size; j++ ) {
+    i = ( newest + MIDI_CLOCK_SYNC_WINDOW - j ) % MIDI_CLOCK_SYNC_WINDOW;
+    if( skip[i] ) continue;
+    x = (double) ( sync->local[i]  - sync->local[newest] );
+    y = (double) ( sync->remote[i] - sync->remote[newest] );
+    sx += x; sy += y; sxx += x*x; sxy += x*y;
+    n++;
+  }
+  *rate = sync->nominal;
+  if( n > 1 && ( n * sxx - sx * sx ) > 0 ) {
+    *rate = ( n * sxy - sx * sy ) / ( n * sxx - sx * sx );
+    if( _abs( *rate / sync->nominal - 1.0 ) > MIDI_CLOCK_SYNC_MAX_SKEW ) {
+      *rate = sync->nominal;
+    }
+  }
+  *base = ( n > 0 ) ? ( sy - *rate * sx ) / n : 0;
+  return n;
+}
+
+/**
+ * @brief Update the estimate from the samples in the window.
+ * Fit once, drop samples that are far off the fitted line and fit
+ * again with the remaining samples.
+ * @private @memberof MIDIClockSync
+ * @param sync The clock sync.
+ */
+static void _sync_update_estimate( struct MIDIClockSync * sync ) {
+  char skip[MIDI_CLOCK_SYNC_WINDOW] = { 0 };
+  int i, newest = ( sync->next + MIDI_CLOCK_SYNC_WINDOW - 1 ) % MIDI_CLOCK_SYNC_WINDOW;
+  double base, rate, r, var = 0;
+
+  _sync_fit( sync, skip, &base, &rate );
+  if( sync->size > 4 ) {
+    for( i=0; i<sync->size; i++ ) {
+      r = (double) ( sync->remote[i] - sync->remote[newest] )
+        - ( base + rate * (double) ( sync->local[i] - sync->local[newest] ) );
+      var += r * r;
+    }
+    var /= sync->size;
+    for( i=0; i<sync->size; i++ ) {
+      r = (double) ( sync->remote[i] - sync->remote[newest] )
+        - ( base + rate * (double) ( sync->local[i] - sync->local[newest] ) );
+      skip[i] = ( r * r > MIDI_CLOCK_SYNC_OUTLIER_SIGMA * MIDI_CLOCK_SYNC_OUTLIER_SIGMA * var );
+    }
+    _sync_fit( sync, skip, &base, &rate );
+  }
+  sync->origin_local  = sync->local[newest];
+  sync->origin_remote = sync->remote[newest];
+  sync->base = base;
+  sync->rate = rate;
+}
+
+/**
+ * @}
+ * @endcond
+ */
+
+/* MARK: -
+ * MARK: Creation and destruction *//**
+ * @name Creation and destruction
+ * Creating, destroying and reference counting of MIDIClockSync objects.
+ * @{
+ */
+
+/**
+ * @brief Create a MIDIClockSync instance.
+ * Allocate space and initialize a MIDIClockSync instance.
+ * @public @memberof MIDIClockSync
+ * @param clock       The local clock (pass @c NULL for global clock)
+ * @param remote_rate The nominal sampling rate of the remote clock.
+ * @return a pointer to the created clock sync structure on success.
+ * @return a @c NULL pointer if the clock sync could not created.
+ */
+struct MIDIClockSync * MIDIClockSyncCreate( struct MIDIClock * clock, MIDISamplingRate remote_rate ) {
+  struct MIDIClockSync * sync;
+  MIDISamplingRate local_rate;
+
+  MIDIPrecondReturn( remote_rate > 0, EINVAL, NULL );
+  if( clock == NULL ) MIDIClockGetGlobalClock( &clock );
+  MIDIClockGetSamplingRate( clock, &local_rate );
+  MIDIPrecondReturn( local_rate > 0, EINVAL, NULL );
+
+  sync = malloc( sizeof( struct MIDIClockSync ) );
+  MIDIPrecondReturn( sync != NULL, ENOMEM, NULL );
+
+  sync->refs  = 1;
+  sync->clock = clock;
+  MIDIClockRetain( clock );
+  sync->nominal        = (double) remote_rate / local_rate;
+  sync->max_slew       = MIDI_CLOCK_SYNC_MAX_SLEW_DEFAULT;
+  sync->step_threshold = remote_rate / 10;
+  MIDIClockSyncReset( sync );
+  return sync;
+}
+
+/**
+ * @brief Destroy a MIDIClockSync instance.
+ * Free all resources occupied by the clock sync and release the clock.
+ * @public @memberof MIDIClockSync
+ * @param sync The clock sync.
+ */
+void MIDIClockSyncDestroy( struct MIDIClockSync * sync ) {
+  MIDIPrecondReturn( sync != NULL, EFAULT, (void)0 );
+  MIDIClockRelease( sync->clock );
+  free( sync );
+}
+
+/**
+ * @brief Retain a MIDIClockSync instance.
+ * Increment the reference counter of a clock sync so that it won't be destroyed.
+ * @public @memberof MIDIClockSync
+ * @param sync The clock sync.
+ */
+void MIDIClockSyncRetain( struct MIDIClockSync * sync ) {
+  MIDIPrecondReturn( sync != NULL, EFAULT, (void)0 );
+  sync->refs++;
+}
+
+/**
+ * @brief Release a MIDIClockSync instance.
+ * Decrement the reference counter of a clock sync. If the reference count
+ * reached zero, destroy the clock sync.
+ * @public @memberof MIDIClockSync
+ * @param sync The clock sync.
+ */
+void MIDIClockSyncRelease( struct MIDIClockSync * sync ) {
+  MIDIPrecondReturn( sync != NULL, EFAULT, (void)0 );
+  if( ! --sync->refs ) {
+    MIDIClockSyncDestroy( sync );
+  }
+}
+
+/** @} */
+
+/* MARK: Configuration *//**
+ * @name Configuration
+ * @{
+ */
+
+/**
+ * @brief Forget all samples.
+ * The next sample will set the offset directly.
+ * @public @memberof MIDIClockSync
+ * @param sync The clock sync.
+ * @retval 0 on success.
+ */
+int MIDIClockSyncReset( struct MIDIClockSync * sync ) {
+  MIDIPrecond( sync != NULL, EFAULT );
+  sync->count = 0;
+  sync->next  = 0;
+  sync->size  = 0;
+  sync->origin_local  = 0;
+  sync->origin_remote = 0;
+  sync->base = 0;
+  sync->rate = sync->nominal;
+  sync->slew_local  = 0;
+  sync->slew_remote = 0;
+  sync->slew_end    = 0;
+  sync->slew_rate   = sync->nominal;
+  sync->last = 0;
+  return 0;
+}
+
+/**
+ * @brief Set the maximum slew rate.
+ * The slew rate limits how much faster or slower than the estimated
+ * rate the converted time may run while it catches up with a new
+ * estimate. The default is 0.0005 (500 ppm).
+ * @public @memberof MIDIClockSync
+ * @param sync     The clock sync.
+ * @param max_slew The maximum relative rate correction.
+ * @retval 0 on success.
+ */
+int MIDIClockSyncSetMaxSlew( struct MIDIClockSync * sync, double max_slew ) {
+  MIDIPrecond( sync != NULL, EFAULT );
+  MIDIPrecond( max_slew > 0 && max_slew < 0.5, EINVAL );
+  sync->max_slew = max_slew;
+  return 0;
+}
+
+/**
+ * @brief Set the step threshold.
+ * If a new estimate is off by more than the given number of remote
+ * ticks, the converted time jumps instead of slewing. Time returned
+ * by MIDIClockSyncGetNow still never runs backwards.
+ * The default is a tenth of a second.
+ * @public @memberof MIDIClockSync
+ * @param sync      The clock sync.
+ * @param threshold The threshold in remote ticks.
+ * @retval 0 on success.
+ */
+int MIDIClockSyncSetStepThreshold( struct MIDIClockSync * sync, MIDITimestamp threshold ) {
+  MIDIPrecond( sync != NULL, EFAULT );
+  MIDIPrecond( threshold >= 0, EINVAL );
+  sync->step_threshold = threshold;
+  return 0;
+}
+
+/** @} */
+
+/* MARK: Synchronization *//**
+ * @name Synchronization
+ * @{
+ */
+
+/**
+ * @brief Add a pair of timestamps.
+ * Add a local timestamp and the remote timestamp that was valid at
+ * the same time. Samples should be added in the order of their local
+ * timestamps.
+ * @public @memberof MIDIClockSync
+ * @param sync   The clock sync.
+ * @param local  The local timestamp.
+ * @param remote The remote timestamp.
+ * @retval 0 on success.
+ */
+int MIDIClockSyncAddSample( struct MIDIClockSync * sync, MIDITimestamp local, MIDITimestamp remote ) {
+  MIDITimestamp current;
+  double error, duration;
+
+  MIDIPrecond( sync != NULL, EFAULT );
+
+  current = _sync_output( sync, local );
+  sync->local[sync->next]  = local;
+  sync->remote[sync->next] = remote;
+  sync->next = ( sync->next + 1 ) % MIDI_CLOCK_SYNC_WINDOW;
+  if( sync->size < MIDI_CLOCK_SYNC_WINDOW ) sync->size++;
+  sync->count++;
+  _sync_update_estimate( sync );
+
+  sync->slew_local  = local;
+  sync->slew_remote = current;
+  error = _sync_estimate( sync, local, current );
+  duration = (double) ( _floor( _abs( error ) / ( sync->max_slew * sync->rate ) ) + 1 );
+  if( sync->count == 1 || _abs( error ) > sync->step_threshold ) {
+    /* step */
+    sync->slew_end  = local;
+    sync->slew_rate = sync->rate;
+  } else {
+    sync->slew_end  = local + (MIDITimestamp) duration;
+    sync->slew_rate = sync->rate + error / duration;
+  }
+  return 0;
+}
+
+/**
+ * @brief Get the estimated offset between the clocks.
+ * The offset is the remote time minus the local time (scaled to the
+ * remote rate) at the most recent sample.
+ * @public @memberof MIDIClockSync
+ * @param sync   The clock sync.
+ * @param offset The offset in remote ticks.
+ * @retval 0 on success.
+ */
+int MIDIClockSyncGetOffset( struct MIDIClockSync * sync, double * offset ) {
+  MIDIPrecond( sync != NULL, EFAULT );
+  MIDIPrecond( offset != NULL, EINVAL );
+  *offset = (double) sync->origin_remote + sync->base - sync->nominal * (double) sync->origin_local;
+  return 0;
+}
+
+/**
+ * @brief Get the estimated skew between the clocks.
+ * The skew is the relative rate difference, e.g. @c 1e-5 if the remote
+ * clock runs 10 ppm faster than it nominally should.
+ * @public @memberof MIDIClockSync
+ * @param sync The clock sync.
+ * @param skew The relative skew.
+ * @retval 0 on success.
+ */
+int MIDIClockSyncGetSkew( struct MIDIClockSync * sync, double * skew ) {
+  MIDIPrecond( sync != NULL, EFAULT );
+  MIDIPrecond( skew != NULL, EINVAL );
+  *skew = sync->rate / sync->nominal - 1.0;
+  return 0;
+}
+
+/**
+ * @brief Convert a local timestamp to the remote clock.
+ * The conversion is slewed and monotonic for increasing local timestamps
+ * as long as no step occurs.
+ * @public @memberof MIDIClockSync
+ * @param sync   The clock sync.
+ * @param local  The local timestamp.
+ * @param remote The remote timestamp.
+ * @retval 0 on success.
+ */
+int MIDIClockSyncLocalToRemote( struct MIDIClockSync * sync, MIDITimestamp local, MIDITimestamp * remote ) {
+  MIDIPrecond( sync != NULL, EFAULT );
+  MIDIPrecond( remote != NULL, EINVAL );
+  *remote = _sync_output( sync, local );
+  return 0;
+}
+
+/**
+ * @brief Convert a remote timestamp to the local clock.
+ * This is the inverse of MIDIClockSyncLocalToRemote, rounded down.
+ * @public @memberof MIDIClockSync
+ * @param sync   The clock sync.
+ * @param remote The remote timestamp.
+ * @param local  The local timestamp.
+ * @retval 0 on success.
+ */
+int MIDIClockSyncRemoteToLocal( struct MIDIClockSync * sync, MIDITimestamp remote, MIDITimestamp * local ) {
+  MIDIPrecond( sync != NULL, EFAULT );
+  MIDIPrecond( local != NULL, EINVAL );
+  if( sync->slew_end > sync->slew_local && remote < _sync_output( sync, sync->slew_end ) ) {
+    *local = sync->slew_local + _floor( (double) ( remote - sync->slew_remote ) / sync->slew_rate );
+  } else {
+    *local = sync->origin_local
+           + _floor( ( (double) ( remote - sync->origin_remote ) - sync->base ) / sync->rate );
+  }
+  return 0;
+}
+
+/**
+ * @brief Get the current time of the remote clock.
+ * Read the local clock and convert it. The result never decreases
+ * between calls, even if the estimate stepped backwards.
+ * @public @memberof MIDIClockSync
+ * @param sync   The clock sync.
+ * @param remote The current remote time.
+ * @retval 0 on success.
+ */
+int MIDIClockSyncGetNow( struct MIDIClockSync * sync, MIDITimestamp * remote ) {
+  MIDITimestamp local, now;
+  MIDIPrecond( sync != NULL, EFAULT );
+  MIDIPrecond( remote != NULL, EINVAL );
+  MIDIClockGetNow( sync->clock, &local );
+  now = _sync_output( sync, local );
+  if( sync->count > 0 && now < sync->last ) {
+    now = sync->last;
+  }
+  sync->last = now;
+  *remote = now;
+  return 0;
+}
+
+/** @} */
@@ -0,0 +1,27 @@
+#ifndef MIDIKIT_MIDI_CLOCK_SYNC_H
+#define MIDIKIT_MIDI_CLOCK_SYNC_H
+#include "midi.h"
+
+#define MIDI_CLOCK_SYNC_WINDOW 16
+
+struct MIDIClock;
+struct MIDIClockSync;
+
+struct MIDIClockSync * MIDIClockSyncCreate( struct MIDIClock * clock, MIDISamplingRate remote_rate );
+void MIDIClockSyncDestroy( struct MIDIClockSync * sync );
+void MIDIClockSyncRetain( struct MIDIClockSync * sync );
+void MIDIClockSyncRelease( struct MIDIClockSync * sync );
+
+int MIDIClockSyncReset( struct MIDIClockSync * sync );
+int MIDIClockSyncSetMaxSlew( struct MIDIClockSync * sync, double max_slew );
+int MIDIClockSyncSetStepThreshold( struct MIDIClockSync * sync, MIDITimestamp threshold );
+
+int MIDIClockSyncAddSample( struct MIDIClockSync * sync, MIDITimestamp local, MIDITimestamp remote );
+int MIDIClockSyncGetOffset( struct MIDIClockSync * sync, double * offset );
+int MIDIClockSyncGetSkew( struct MIDIClockSync * sync, double * skew );
+
+int MIDIClockSyncLocalToRemote( struct MIDIClockSync * sync, MIDITimestamp local, MIDITimestamp * remote );
+int MIDIClockSyncRemoteToLocal( struct MIDIClockSync * sync, MIDITimestamp remote, MIDITimestamp * local );
+int MIDIClockSyncGetNow( struct MIDIClockSync * sync, MIDITimestamp * remote );
+
+#endif
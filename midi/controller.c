@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include "message.h"
 #include "device.h"
 #include "controller.h"
 
@@ -45,7 +46,23 @@ static char * _control_names[] = {
 */
 
 /** @internal */
-struct MIDINRPList;
+struct MIDINonRegisteredParameter;
+
+/**
+ * @internal
+ * Open-addressing hash table of non-registered parameters, keyed by
+ * the 14-bit parameter number. Empty slots have the number
+ * @c MIDI_CONTROL_RPN_RESET, which is never stored.
+ * The entries are also linked from the most to the least recently
+ * changed one, so that changes can be listed without a full scan.
+ */
+struct MIDINRPTable {
+  size_t length;
+  size_t capacity;
+  size_t newest;
+  size_t oldest;
+  struct MIDINonRegisteredParameter * entries;
+};
 
 /**
  * @ingroup MIDI
@@ -62,7 +79,12 @@ struct MIDIController {
   MIDIBoolean   current_parameter_registered;
   MIDIValue controls[N_CONTROLS];
   MIDIValue registered_parameters[6];
-  struct MIDINRPList * list;
+  struct MIDINRPTable nrp;
+
+  unsigned long version;
+  unsigned long parameter_version;
+  unsigned long control_version[N_CONTROLS];
+  unsigned long registered_version[6];
 };
 
 /* MARK: Internals *//**
@@ -75,69 +97,249 @@ struct MIDIController {
 struct MIDINonRegisteredParameter {
   MIDILongValue number;
   MIDILongValue value;
+  unsigned long version;
+  size_t newer;
+  size_t older;
 };
 
-struct MIDINRPList {
-  struct MIDINonRegisteredParameter * parameter;
-  struct MIDINRPList * next;
-};
+#define NRP_INITIAL_CAPACITY 16
+#define NRP_NONE ((size_t) -1)
+
+/**
+ * @brief Set a control value.
+ * Stamp the control with a new version if the value changed.
+ * @param controller The controller.
+ * @param control    The control number.
+ * @param value      The new value.
+ */
+static void _set_control( struct MIDIController * controller, MIDIControl control, MIDIValue value ) {
+  if( controller->controls[(int)control] != value ) {
+    controller->controls[(int)control] = value;
+    controller->control_version[(int)control] = ++controller->version;
+  }
+}
+
+/**
+ * @brief Set one byte of a registered parameter.
+ * Stamp the byte with a new version if the value changed.
+ * @param controller The controller.
+ * @param index      The index of the byte, e.g.
+ *                   @c MIDI_CONTROL_RPN_FINE_TUNING_MSB.
+ * @param value      The new value.
+ */
+static void _set_registered( struct MIDIController * controller, int index, MIDIValue value ) {
+  if( controller->registered_parameters[index] != value ) {
+    controller->registered_parameters[index] = value;
+    controller->registered_version[index] = ++controller->version;
+  }
+}
+
+/**
+ * @brief Select the parameter that data entry messages apply to.
+ * @param controller The controller.
+ * @param parameter  The parameter number.
+ * @param registered @c MIDI_ON for a registered parameter,
+ *                   @c MIDI_OFF for a non-registered parameter.
+ */
+static void _select_parameter( struct MIDIController * controller, MIDILongValue parameter, MIDIBoolean registered ) {
+  if( controller->current_parameter != parameter ||
+      controller->current_parameter_registered != registered ) {
+    controller->current_parameter = parameter;
+    controller->current_parameter_registered = registered;
+    controller->parameter_version = ++controller->version;
+  }
+}
+
+/**
+ * @brief Find the slot of a non-registered parameter.
+ * Use linear probing starting at the parameter's hash.
+ * @param table     The table. Must have at least one empty slot.
+ * @param parameter The parameter number.
+ * @return a pointer to the slot containing the parameter or to the
+ *         empty slot where it would be inserted.
+ */
+static struct MIDINonRegisteredParameter * _nrp_slot( struct MIDINRPTable * table, MIDILongValue parameter ) {
+  size_t mask = table->capacity - 1;
+  size_t i = ( (unsigned long) parameter * 0x9e3779b1UL >> 7 ) & mask;
+  while( table->entries[i].number != parameter &&
+         table->entries[i].number != MIDI_CONTROL_RPN_RESET ) {
+    i = (i+1) & mask;
+  }
+  return &(table->entries[i]);
+}
+
+/**
+ * @brief Unlink an entry from the list of changes.
+ * @param table The table.
+ * @param i     The index of the entry.
+ */
+static void _nrp_unlink( struct MIDINRPTable * table, size_t i ) {
+  struct MIDINonRegisteredParameter * entry = &(table->entries[i]);
+  if( entry->newer == NRP_NONE ) table->newest = entry->older;
+  else table->entries[entry->newer].older = entry->older;
+  if( entry->older == NRP_NONE ) table->oldest = entry->newer;
+  else table->entries[entry->older].newer = entry->newer;
+}
+
+/**
+ * @brief Link an entry as the most recently changed one.
+ * @param table The table.
+ * @param i     The index of the entry.
+ */
+static void _nrp_link( struct MIDINRPTable * table, size_t i ) {
+  struct MIDINonRegisteredParameter * entry = &(table->entries[i]);
+  entry->newer = NRP_NONE;
+  entry->older = table->newest;
+  if( table->newest == NRP_NONE ) table->oldest = i;
+  else table->entries[table->newest].newer = i;
+  table->newest = i;
+}
+
+/**
+ * @brief Resize the table and rehash all parameters.
+ * The order of the list of changes is preserved.
+ * @param table    The table.
+ * @param capacity The new capacity. Must be a power of two.
+ * @retval 0 on success.
+ * @retval 1 if the table could not be resized.
+ */
+static int _nrp_resize( struct MIDINRPTable * table, size_t capacity ) {
+  struct MIDINonRegisteredParameter * entries = table->entries;
+  struct MIDINonRegisteredParameter * entry;
+  size_t i = table->oldest;
+
+  table->entries = malloc( sizeof(struct MIDINonRegisteredParameter) * capacity );
+  if( table->entries == NULL ) {
+    table->entries = entries;
+    return 1;
+  }
+  table->capacity = capacity;
+  table->newest   = NRP_NONE;
+  table->oldest   = NRP_NONE;
+  for( capacity=0; capacity<table->capacity; capacity++ ) {
+    table->entries[capacity].number = MIDI_CONTROL_RPN_RESET;
+  }
+  while( i != NRP_NONE ) {
+    entry  = _nrp_slot( table, entries[i].number );
+    *entry = entries[i];
+    _nrp_link( table, entry - table->entries );
+    i = entries[i].newer;
+  }
+  free( entries );
+  return 0;
+}
+
+/**
+ * @brief Look up a non-registered parameter.
+ * @param table     The table.
+ * @param parameter The parameter number.
+ * @return a pointer to the parameter if it is stored in the table.
+ * @return a @c NULL pointer otherwise.
+ */
+static struct MIDINonRegisteredParameter * _nrp_find( struct MIDINRPTable * table, MIDILongValue parameter ) {
+  struct MIDINonRegisteredParameter * entry;
+  if( table->length == 0 || parameter == MIDI_CONTROL_RPN_RESET ) return NULL;
+  entry = _nrp_slot( table, parameter );
+  return ( entry->number == parameter ) ? entry : NULL;
+}
+
+/**
+ * @brief Store the value of a non-registered parameter.
+ * Insert the parameter if it is not yet stored. The table is kept
+ * at most three quarters full. If the value changed, stamp the
+ * parameter with a new version and move it to the front of the
+ * list of changes.
+ * @param table     The table.
+ * @param parameter The parameter number.
+ * @param value     The value to store.
+ * @param version   The controller's version counter.
+ * @retval 0 on success.
+ * @retval 1 if the parameter could not be stored.
+ */
+static int _nrp_store( struct MIDINRPTable * table, MIDILongValue parameter, MIDILongValue value,
+                       unsigned long * version ) {
+  struct MIDINonRegisteredParameter * entry;
+  if( parameter == MIDI_CONTROL_RPN_RESET ) return 1;
+  if( (table->length+1) * 4 > table->capacity * 3 ) {
+    if( _nrp_resize( table, table->capacity ? table->capacity * 2 : NRP_INITIAL_CAPACITY ) ) return 1;
+  }
+  entry = _nrp_slot( table, parameter );
+  if( entry->number != parameter ) {
+    entry->number = parameter;
+    table->length++;
+  } else if( entry->value == value ) {
+    return 0;
+  } else {
+    _nrp_unlink( table, entry - table->entries );
+  }
+  entry->value   = value;
+  entry->version = ++(*version);
+  _nrp_link( table, entry - table->entries );
+  return 0;
+}
+
+/**
+ * @brief Remove all non-registered parameters.
+ * @param table The table.
+ */
+static void _nrp_clear( struct MIDINRPTable * table ) {
+  size_t i;
+  for( i=0; i<table->capacity; i++ ) {
+    table->entries[i].number = MIDI_CONTROL_RPN_RESET;
+  }
+  table->length = 0;
+  table->newest = NRP_NONE;
+  table->oldest = NRP_NONE;
+}
 
 static int _load_non_registered_parameter( struct MIDIController * controller ) {
   MIDILongValue parameter = MIDI_LONG_VALUE( controller->controls[MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_MSB],
                                              controller->controls[MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_LSB] );
-  struct MIDINRPList * list = controller->list;
-  if( controller->current_parameter_registered == MIDI_ON ) return 1;
-  if( parameter == controller->current_parameter )          return 0;
+  struct MIDINonRegisteredParameter * entry;
+  if( controller->current_parameter_registered == MIDI_OFF &&
+      parameter == controller->current_parameter ) return 0;
+  _select_parameter( controller, parameter, MIDI_OFF );
   if( parameter == MIDI_CONTROL_RPN_RESET ) {
-    controller->controls[MIDI_CONTROL_DATA_ENTRY]    = 0x7f;
-    controller->controls[MIDI_CONTROL_DATA_ENTRY+32] = 0x7f;
-    controller->current_parameter = MIDI_CONTROL_RPN_RESET;
-    controller->current_parameter_registered = MIDI_OFF;
+    _set_control( controller, MIDI_CONTROL_DATA_ENTRY, 0x7f );
+    _set_control( controller, MIDI_CONTROL_DATA_ENTRY+32, 0x7f );
     return 0;
   }
-  while( list != NULL ) {
-    if( list->parameter != NULL && list->parameter->number == parameter ) {
-       controller->controls[MIDI_CONTROL_DATA_ENTRY]    = MIDI_MSB( list->parameter->value );
-       controller->controls[MIDI_CONTROL_DATA_ENTRY+32] = MIDI_LSB( list->parameter->value );
-       controller->current_parameter = parameter;
-       controller->current_parameter_registered = MIDI_OFF;
-       return 0;
-    }
+  entry = _nrp_find( &(controller->nrp), parameter );
+  if( entry != NULL ) {
+    _set_control( controller, MIDI_CONTROL_DATA_ENTRY, MIDI_MSB( entry->value ) );
+    _set_control( controller, MIDI_CONTROL_DATA_ENTRY+32, MIDI_LSB( entry->value ) );
+  } else {
+    _set_control( controller, MIDI_CONTROL_DATA_ENTRY, 0 );
+    _set_control( controller, MIDI_CONTROL_DATA_ENTRY+32, 0 );
   }
-  return 1;
+  return 0;
 }
 
 static int _store_non_registered_parameter( struct MIDIController * controller ) {
   MIDILongValue parameter = controller->current_parameter;
-  struct MIDINRPList * list = controller->list;
   if( controller->current_parameter_registered == MIDI_ON ) return 1;
-  while( list != NULL ) {
-    if( list->parameter != NULL && list->parameter->number == parameter ) {
-       list->parameter->value = MIDI_LONG_VALUE( controller->controls[MIDI_CONTROL_DATA_ENTRY],
-                                                 controller->controls[MIDI_CONTROL_DATA_ENTRY+32] );
-       return 0;
-    }
-  }
-  return 1;
+  if( parameter == MIDI_CONTROL_RPN_RESET ) return 0;
+  return _nrp_store( &(controller->nrp), parameter,
+                     MIDI_LONG_VALUE( controller->controls[MIDI_CONTROL_DATA_ENTRY],
+                                      controller->controls[MIDI_CONTROL_DATA_ENTRY+32] ),
+                     &(controller->version) );
 }
 
 static int _load_registered_parameter( struct MIDIController * controller ) {
   MIDILongValue parameter = MIDI_LONG_VALUE( controller->controls[MIDI_CONTROL_REGISTERED_PARAMETER_NUMBER_MSB],
                                              controller->controls[MIDI_CONTROL_REGISTERED_PARAMETER_NUMBER_LSB] );
-  if( controller->current_parameter_registered == MIDI_OFF ) return 1;
-  if( parameter == controller->current_parameter )           return 0;
+  if( controller->current_parameter_registered == MIDI_ON &&
+      parameter == controller->current_parameter ) return 0;
   if( parameter == MIDI_CONTROL_RPN_RESET ) {
-    controller->controls[MIDI_CONTROL_DATA_ENTRY]    = 0x7f;
-    controller->controls[MIDI_CONTROL_DATA_ENTRY+32] = 0x7f;
-    controller->current_parameter = MIDI_CONTROL_RPN_RESET;
-    controller->current_parameter_registered = MIDI_ON;
+    _set_control( controller, MIDI_CONTROL_DATA_ENTRY, 0x7f );
+    _set_control( controller, MIDI_CONTROL_DATA_ENTRY+32, 0x7f );
+    _select_parameter( controller, MIDI_CONTROL_RPN_RESET, MIDI_ON );
     return 0;
   }
   if( parameter >= MIDI_CONTROL_RPN_PITCH_BEND_RANGE && parameter <= MIDI_CONTROL_RPN_COARSE_TUNING ) {
-    controller->controls[MIDI_CONTROL_DATA_ENTRY]    = controller->registered_parameters[parameter*2];
-    controller->controls[MIDI_CONTROL_DATA_ENTRY+32] = controller->registered_parameters[parameter*2+1];
-    controller->current_parameter = parameter;
-    controller->current_parameter_registered = MIDI_ON;
+    _set_control( controller, MIDI_CONTROL_DATA_ENTRY, controller->registered_parameters[parameter*2] );
+    _set_control( controller, MIDI_CONTROL_DATA_ENTRY+32, controller->registered_parameters[parameter*2+1] );
+    _select_parameter( controller, parameter, MIDI_ON );
     return 0;
   }
   return 1;
@@ -148,8 +350,8 @@ static int _store_registered_parameter( struct MIDIController * controller ) {
   if( controller->current_parameter_registered == MIDI_OFF ) return 1;
   if( parameter == MIDI_CONTROL_RPN_RESET ) return 0;
   if( parameter >= MIDI_CONTROL_RPN_PITCH_BEND_RANGE && parameter <= MIDI_CONTROL_RPN_COARSE_TUNING ) {
-    controller->registered_parameters[parameter*2]   = controller->controls[MIDI_CONTROL_DATA_ENTRY];
-    controller->registered_parameters[parameter*2+1] = controller->controls[MIDI_CONTROL_DATA_ENTRY+32];
+    _set_registered( controller, parameter*2, controller->controls[MIDI_CONTROL_DATA_ENTRY] );
+    _set_registered( controller, parameter*2+1, controller->controls[MIDI_CONTROL_DATA_ENTRY+32] );
     return 0;
   }
   return 1;
@@ -172,36 +374,35 @@ static int _store_current_parameter( struct MIDIController * controller ) {
 }
 
 static int _initialize_controls_for_gm( struct MIDIController * controller ) {
-  controller->controls[MIDI_CONTROL_CHANNEL_VOLUME]        = 100;
-  controller->controls[MIDI_CONTROL_EXPRESSION_CONTROLLER] = 127;
-  controller->controls[MIDI_CONTROL_PAN]                   =  64;
+  _set_control( controller, MIDI_CONTROL_CHANNEL_VOLUME,        100 );
+  _set_control( controller, MIDI_CONTROL_EXPRESSION_CONTROLLER, 127 );
+  _set_control( controller, MIDI_CONTROL_PAN,                   64 );
   return 0;
 }
 
 static int _reset_controls( struct MIDIController * controller ) {
-  controller->controls[MIDI_CONTROL_MODULATION_WHEEL]      = 0;
-  controller->controls[MIDI_CONTROL_EXPRESSION_CONTROLLER] = 127;
-  controller->controls[MIDI_CONTROL_DAMPER_PEDAL]          = 0;
-  controller->controls[MIDI_CONTROL_PORTAMENTO]            = 0;
-  controller->controls[MIDI_CONTROL_SOSTENUTO]             = 0;
-  controller->controls[MIDI_CONTROL_SOFT_PEDAL]            = 0;
-
-  controller->controls[MIDI_CONTROL_DATA_ENTRY]    = 0x7f;
-  controller->controls[MIDI_CONTROL_DATA_ENTRY+32] = 0x7f;
-  controller->controls[MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_MSB] = 0x7f;
-  controller->controls[MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_LSB] = 0x7f;
-  controller->controls[MIDI_CONTROL_REGISTERED_PARAMETER_NUMBER_MSB]     = 0x7f;
-  controller->controls[MIDI_CONTROL_REGISTERED_PARAMETER_NUMBER_LSB]     = 0x7f;
-
-  controller->current_parameter            = MIDI_CONTROL_RPN_RESET;
-  controller->current_parameter_registered = MIDI_OFF;
+  _set_control( controller, MIDI_CONTROL_MODULATION_WHEEL,      0 );
+  _set_control( controller, MIDI_CONTROL_EXPRESSION_CONTROLLER, 127 );
+  _set_control( controller, MIDI_CONTROL_DAMPER_PEDAL,          0 );
+  _set_control( controller, MIDI_CONTROL_PORTAMENTO,            0 );
+  _set_control( controller, MIDI_CONTROL_SOSTENUTO,             0 );
+  _set_control( controller, MIDI_CONTROL_SOFT_PEDAL,            0 );
+
+  _set_control( controller, MIDI_CONTROL_DATA_ENTRY,                          0x7f );
+  _set_control( controller, MIDI_CONTROL_DATA_ENTRY+32,                       0x7f );
+  _set_control( controller, MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_MSB, 0x7f );
+  _set_control( controller, MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_LSB, 0x7f );
+  _set_control( controller, MIDI_CONTROL_REGISTERED_PARAMETER_NUMBER_MSB,     0x7f );
+  _set_control( controller, MIDI_CONTROL_REGISTERED_PARAMETER_NUMBER_LSB,     0x7f );
 
-  controller->registered_parameters[MIDI_CONTROL_RPN_PITCH_BEND_RANGE_SEMITONES] = 2;
-  controller->registered_parameters[MIDI_CONTROL_RPN_PITCH_BEND_RANGE_CENTS]     = 0;
-  controller->registered_parameters[MIDI_CONTROL_RPN_FINE_TUNING_MSB]            = 0x40;
-  controller->registered_parameters[MIDI_CONTROL_RPN_FINE_TUNING_LSB]            = 0;
-  controller->registered_parameters[MIDI_CONTROL_RPN_COARSE_TUNING_MSB]          = 0x40;
-  controller->registered_parameters[MIDI_CONTROL_RPN_COARSE_TUNING_LSB]          = 0;
+  _select_parameter( controller, MIDI_CONTROL_RPN_RESET, MIDI_OFF );
+
+  _set_registered( controller, MIDI_CONTROL_RPN_PITCH_BEND_RANGE_SEMITONES, 2 );
+  _set_registered( controller, MIDI_CONTROL_RPN_PITCH_BEND_RANGE_CENTS,     0 );
+  _set_registered( controller, MIDI_CONTROL_RPN_FINE_TUNING_MSB,            0x40 );
+  _set_registered( controller, MIDI_CONTROL_RPN_FINE_TUNING_LSB,            0 );
+  _set_registered( controller, MIDI_CONTROL_RPN_COARSE_TUNING_MSB,          0x40 );
+  _set_registered( controller, MIDI_CONTROL_RPN_COARSE_TUNING_LSB,          0 );
   return 0;
 }
 
@@ -209,7 +410,15 @@ static int _initialize_controls( struct MIDIController * controller ) {
   int i;
   for( i=0; i<N_CONTROLS; i++ ) {
     controller->controls[i] = 0;
+    controller->control_version[i] = 0;
+  }
+  for( i=0; i<6; i++ ) {
+    controller->registered_parameters[i] = 0;
+    controller->registered_version[i] = 0;
   }
+  controller->current_parameter = MIDI_CONTROL_RPN_RESET;
+  controller->current_parameter_registered = MIDI_OFF;
+  controller->parameter_version = 0;
   return _reset_controls( controller ) + _initialize_controls_for_gm( controller );
 }
 
@@ -233,6 +442,251 @@ static int _poly_mode( struct MIDIController * controller, MIDIBoolean value ) {
   return 0;
 }
 
+/**
+ * @brief State of a receiving controller while a diff is created.
+ * Keeps track of the controls that select parameters and of the data
+ * entry value, which change as the diff's messages are received.
+ */
+struct MIDIControllerDiffState {
+  MIDIChannel channel;
+  struct MIDIMessageBatch * batch;
+  MIDIValue controls[N_CONTROLS];
+  MIDILongValue parameter;
+  MIDIBoolean   registered;
+  int result;
+};
+
+/**
+ * @brief Append a control change to the diff.
+ * @param diff    The diff state.
+ * @param control The control number.
+ * @param value   The control value.
+ */
+static void _diff_send( struct MIDIControllerDiffState * diff, MIDIControl control, MIDIValue value ) {
+  struct MIDIMessage * message = MIDIMessageCreate( MIDI_STATUS_CONTROL_CHANGE );
+  if( message == NULL ) {
+    diff->result++;
+    return;
+  }
+  diff->result += MIDIMessageSet( message, MIDI_CHANNEL, sizeof(MIDIChannel), &(diff->channel) );
+  diff->result += MIDIMessageSet( message, MIDI_CONTROL, sizeof(MIDIControl), &control );
+  diff->result += MIDIMessageSet( message, MIDI_VALUE,   sizeof(MIDIValue),   &value );
+  diff->result += MIDIMessageBatchAppend( diff->batch, message );
+  MIDIMessageRelease( message );
+  diff->controls[(int)control] = value;
+}
+
+/**
+ * @brief Select a parameter on the receiving controller.
+ * Only send the parameter number bytes that differ. If the number is
+ * already set but a parameter of the other kind is selected, resend
+ * the LSB to select it.
+ * @param diff       The diff state.
+ * @param parameter  The parameter number.
+ * @param registered @c MIDI_ON to select a registered parameter.
+ * @param loaded     The value the receiver loads into the data entry
+ *                   controls when the parameter is selected.
+ */
+static void _diff_select( struct MIDIControllerDiffState * diff, MIDILongValue parameter, MIDIBoolean registered,
+                          MIDILongValue loaded ) {
+  MIDIControl msb = registered ? MIDI_CONTROL_REGISTERED_PARAMETER_NUMBER_MSB : MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_MSB;
+  MIDIControl lsb = registered ? MIDI_CONTROL_REGISTERED_PARAMETER_NUMBER_LSB : MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_LSB;
+  MIDIBoolean sent = MIDI_OFF;
+
+  if( diff->parameter == parameter && diff->registered == registered &&
+      diff->controls[(int)msb] == (MIDI_MSB( parameter )) &&
+      diff->controls[(int)lsb] == (MIDI_LSB( parameter )) ) return;
+  if( diff->controls[(int)msb] != (MIDI_MSB( parameter )) ) {
+    _diff_send( diff, msb, MIDI_MSB( parameter ) );
+    sent = MIDI_ON;
+  }
+  if( diff->controls[(int)lsb] != (MIDI_LSB( parameter )) || !sent ) {
+    _diff_send( diff, lsb, MIDI_LSB( parameter ) );
+  }
+  diff->parameter  = parameter;
+  diff->registered = registered;
+  diff->controls[MIDI_CONTROL_DATA_ENTRY]    = MIDI_MSB( loaded );
+  diff->controls[MIDI_CONTROL_DATA_ENTRY+32] = MIDI_LSB( loaded );
+}
+
+/**
+ * @brief Set the data entry value on the receiving controller.
+ * Only send the bytes that differ.
+ * @param diff  The diff state.
+ * @param value The value.
+ * @param force @c MIDI_ON to send at least one byte, e.g. to create
+ *              a non-registered parameter on the receiver.
+ */
+static void _diff_data( struct MIDIControllerDiffState * diff, MIDILongValue value, MIDIBoolean force ) {
+  if( diff->controls[MIDI_CONTROL_DATA_ENTRY] != (MIDI_MSB( value )) ) {
+    _diff_send( diff, MIDI_CONTROL_DATA_ENTRY, MIDI_MSB( value ) );
+    force = MIDI_OFF;
+  }
+  if( diff->controls[MIDI_CONTROL_DATA_ENTRY+32] != (MIDI_LSB( value )) || force ) {
+    _diff_send( diff, MIDI_CONTROL_DATA_ENTRY+32, MIDI_LSB( value ) );
+  }
+}
+
+/**
+ * @brief Get the value a controller loads when a parameter is selected.
+ * @param controller The controller.
+ * @param other      A controller to look up non-registered parameters
+ *                   that @c controller does not know. May be @c NULL.
+ * @param parameter  The parameter number.
+ * @param registered @c MIDI_ON for a registered parameter.
+ * @return the value of the data entry controls after selection.
+ */
+static MIDILongValue _diff_loaded( struct MIDIController * controller, struct MIDIController * other,
+                                   MIDILongValue parameter, MIDIBoolean registered ) {
+  struct MIDINonRegisteredParameter * entry;
+  if( parameter == MIDI_CONTROL_RPN_RESET ) return MIDI_CONTROL_RPN_RESET;
+  if( registered ) {
+    if( parameter > MIDI_CONTROL_RPN_COARSE_TUNING ) return 0;
+    return MIDI_LONG_VALUE( controller->registered_parameters[parameter*2],
+                            controller->registered_parameters[parameter*2+1] );
+  }
+  entry = _nrp_find( &(controller->nrp), parameter );
+  if( entry == NULL && other != NULL ) entry = _nrp_find( &(other->nrp), parameter );
+  return ( entry != NULL ) ? entry->value : 0;
+}
+
+static int _diff_compare_parameters( const void * a, const void * b ) {
+  return *((const MIDILongValue*)a) - *((const MIDILongValue*)b);
+}
+
+/**
+ * @brief Append the messages for all registered parameters that differ.
+ * If the selected parameter of @c to differs, it is sent last.
+ * @param diff The diff state.
+ * @param from The state of the receiving controller.
+ * @param to   The state the receiving controller should end up in.
+ */
+static void _diff_registered( struct MIDIControllerDiffState * diff, struct MIDIController * from,
+                              struct MIDIController * to ) {
+  MIDILongValue p, last = MIDI_CONTROL_RPN_COARSE_TUNING;
+  int i;
+
+  if( to->current_parameter_registered && to->current_parameter <= MIDI_CONTROL_RPN_COARSE_TUNING ) {
+    last = to->current_parameter;
+  }
+  for( i=1; i<=MIDI_CONTROL_RPN_COARSE_TUNING+1; i++ ) {
+    p = ( last + i ) % ( MIDI_CONTROL_RPN_COARSE_TUNING+1 );
+    if( from->registered_parameters[p*2]   != to->registered_parameters[p*2] ||
+        from->registered_parameters[p*2+1] != to->registered_parameters[p*2+1] ) {
+      _diff_select( diff, p, MIDI_ON, _diff_loaded( from, NULL, p, MIDI_ON ) );
+      _diff_data( diff, _diff_loaded( to, NULL, p, MIDI_ON ), MIDI_OFF );
+    }
+  }
+}
+
+/**
+ * @brief Append the messages for all non-registered parameters that differ.
+ * The parameters are sorted so that the number MSB rarely changes. If
+ * the selected parameter of @c to differs, it is sent last.
+ * @param diff The diff state.
+ * @param from The state of the receiving controller.
+ * @param to   The state the receiving controller should end up in.
+ * @retval 0 on success.
+ * @retval 1 if there was not enough memory.
+ */
+static int _diff_non_registered( struct MIDIControllerDiffState * diff, struct MIDIController * from,
+                                 struct MIDIController * to ) {
+  struct MIDINonRegisteredParameter * entry, * old;
+  MIDILongValue * parameters, last = MIDI_CONTROL_RPN_RESET;
+  size_t i, n = 0;
+
+  if( to->nrp.length == 0 ) return 0;
+  parameters = malloc( sizeof(MIDILongValue) * to->nrp.length );
+  if( parameters == NULL ) return 1;
+  for( i = to->nrp.newest; i != NRP_NONE; i = to->nrp.entries[i].older ) {
+    entry = &(to->nrp.entries[i]);
+    old   = _nrp_find( &(from->nrp), entry->number );
+    if( old == NULL || old->value != entry->value ) {
+      if( !to->current_parameter_registered && entry->number == to->current_parameter ) {
+        last = entry->number;
+      } else {
+        parameters[n++] = entry->number;
+      }
+    }
+  }
+  qsort( parameters, n, sizeof(MIDILongValue), &_diff_compare_parameters );
+  if( last != MIDI_CONTROL_RPN_RESET ) parameters[n++] = last;
+  for( i=0; i<n; i++ ) {
+    old = _nrp_find( &(from->nrp), parameters[i] );
+    _diff_select( diff, parameters[i], MIDI_OFF, ( old != NULL ) ? old->value : 0 );
+    _diff_data( diff, _nrp_find( &(to->nrp), parameters[i] )->value, ( old == NULL ) ? MIDI_ON : MIDI_OFF );
+  }
+  free( parameters );
+  return 0;
+}
+
+/* stored record types */
+#define STORE_CONTROL    0x01 /* type, control, value */
+#define STORE_REGISTERED 0x02 /* type, index, value */
+#define STORE_NRP        0x03 /* type, number msb, number lsb, value msb, value lsb */
+#define STORE_PARAMETER  0x04 /* type, number msb, number lsb, registered */
+#define STORE_CLEAR_NRP  0x05 /* type */
+
+/**
+ * @brief Store everything that changed after a given version.
+ * Controls and registered parameters are checked by their version
+ * stamps, non-registered parameters are taken from the front of the
+ * list of changes, so the cost depends on the number of changes and
+ * not on the number of stored parameters. Controls and registered
+ * parameters are written in index order. Non-registered parameters are
+ * written from the least to the most recent change, so that restoring
+ * them rebuilds the list of changes in the same order. The current
+ * parameter is written last.
+ * @param controller The controller.
+ * @param since      The version after which changes are stored.
+ * @param full       @c MIDI_ON to store the complete state.
+ * @param size       The size of the buffer.
+ * @param buffer     The buffer.
+ * @param written    The number of bytes required to store the state.
+ * @retval 0 on success.
+ * @retval 1 if the buffer is too small.
+ */
+static int _store( struct MIDIController * controller, unsigned long since, MIDIBoolean full,
+                   size_t size, unsigned char * buffer, size_t * written ) {
+  struct MIDINRPTable * table = &(controller->nrp);
+  size_t n = 0, e;
+  int i;
+
+#define PUT( b ) do { if( n < size ) buffer[n] = (unsigned char) (b); n++; } while( 0 )
+  if( full ) {
+    PUT( STORE_CLEAR_NRP );
+  }
+  for( i=0; i<N_CONTROLS; i++ ) {
+    if( full || controller->control_version[i] > since ) {
+      PUT( STORE_CONTROL ); PUT( i ); PUT( controller->controls[i] );
+    }
+  }
+  for( i=0; i<6; i++ ) {
+    if( full || controller->registered_version[i] > since ) {
+      PUT( STORE_REGISTERED ); PUT( i ); PUT( controller->registered_parameters[i] );
+    }
+  }
+  e = table->oldest;
+  if( !full ) {
+    for( e = table->newest; e != NRP_NONE && table->entries[e].version > since; e = table->entries[e].older );
+    e = ( e == NRP_NONE ) ? table->oldest : table->entries[e].newer;
+  }
+  for( ; e != NRP_NONE; e = table->entries[e].newer ) {
+    PUT( STORE_NRP );
+    PUT( MIDI_MSB( table->entries[e].number ) ); PUT( MIDI_LSB( table->entries[e].number ) );
+    PUT( MIDI_MSB( table->entries[e].value ) );  PUT( MIDI_LSB( table->entries[e].value ) );
+  }
+  if( full || controller->parameter_version > since ) {
+    PUT( STORE_PARAMETER );
+    PUT( MIDI_MSB( controller->current_parameter ) ); PUT( MIDI_LSB( controller->current_parameter ) );
+    PUT( controller->current_parameter_registered );
+  }
+#undef PUT
+
+  if( written != NULL ) *written = n;
+  return ( n > size ) ? 1 : 0;
+}
+
 /**
  * @}
  * @endcond
@@ -258,6 +712,12 @@ struct MIDIController * MIDIControllerCreate( struct MIDIControllerDelegate * de
   MIDIPrecondReturn( controller != NULL, ENOMEM, NULL );
   controller->refs = 1;
   controller->delegate = delegate;
+  controller->nrp.length   = 0;
+  controller->nrp.capacity = 0;
+  controller->nrp.newest   = NRP_NONE;
+  controller->nrp.oldest   = NRP_NONE;
+  controller->nrp.entries  = NULL;
+  controller->version      = 0;
   _initialize_controls( controller );
   return controller;
 }
@@ -270,6 +730,7 @@ struct MIDIController * MIDIControllerCreate( struct MIDIControllerDelegate * de
  */
 void MIDIControllerDestroy( struct MIDIController * controller ) {
   MIDIPrecondReturn( controller != NULL, EFAULT, (void)0 );
+  if( controller->nrp.entries != NULL ) free( controller->nrp.entries );
   free( controller );
 }
 
@@ -326,7 +787,7 @@ int MIDIControllerSetControl( struct MIDIController * controller, MIDIControl co
   if( size == sizeof(MIDIValue) ) {
     v1 = *((MIDIValue*)value);
     if( controller->controls[(int)control] != v1 ) {
-      controller->controls[(int)control] = v1;
+      _set_control( controller, control, v1 );
       /* send control change */
     }
   } else if( size == sizeof(MIDILongValue) ) {
@@ -396,13 +857,27 @@ int MIDIControllerGetControl( struct MIDIController * controller, MIDIControl co
  * @param size       The size of the buffer pointed to by @c value.
  * @param value      The value to store. The type may vary depending on the
  *                   kind of parameter.
+ * @retval 0 on success.
  */
 int MIDIControllerSetRegisteredParameter( struct MIDIController * controller, MIDIControlParameter parameter, size_t size,  void * value ) {
   MIDIPrecond( controller != NULL, EFAULT );
   MIDIPrecond( size > 0 && value != NULL, EINVAL );
 
-  MIDIControllerSetControl( controller, MIDI_CONTROL_REGISTERED_PARAMETER_NUMBER, sizeof(MIDILongValue), &parameter );
-  /* set registered parameter */
+  MIDIPrecond( size == sizeof(MIDIValue) || size == sizeof(MIDILongValue), EINVAL );
+  MIDIPrecond( parameter >= MIDI_CONTROL_RPN_PITCH_BEND_RANGE && parameter <= MIDI_CONTROL_RPN_COARSE_TUNING, EINVAL );
+  MIDILongValue p = parameter, v;
+
+  if( size == sizeof(MIDIValue) ) {
+    v = MIDI_LONG_VALUE( *((MIDIValue*)value), 0 );
+  } else {
+    v = *((MIDILongValue*)value) & 0x3fff;
+  }
+  MIDIControllerSetControl( controller, MIDI_CONTROL_REGISTERED_PARAMETER_NUMBER, sizeof(MIDILongValue), &p );
+  _select_parameter( controller, p, MIDI_ON );
+  _set_registered( controller, p*2,   MIDI_MSB( v ) );
+  _set_registered( controller, p*2+1, MIDI_LSB( v ) );
+  _set_control( controller, MIDI_CONTROL_DATA_ENTRY,    MIDI_MSB( v ) );
+  _set_control( controller, MIDI_CONTROL_DATA_ENTRY+32, MIDI_LSB( v ) );
   return 0;
 }
 
@@ -415,11 +890,20 @@ int MIDIControllerSetRegisteredParameter( struct MIDIController * controller, MI
  * @param size       The size of the buffer pointed to by @c value.
  * @param value      The value to store. The type may vary depending on the
  *                   kind of parameter.
+ * @retval 0 on success.
  */
 int MIDIControllerGetRegisteredParameter( struct MIDIController * controller, MIDIControlParameter parameter, size_t size,  void * value ) {
   MIDIPrecond( controller != NULL, EFAULT );
   MIDIPrecond( size > 0 && value != NULL, EINVAL );
+  MIDIPrecond( size == sizeof(MIDIValue) || size == sizeof(MIDILongValue), EINVAL );
+  MIDIPrecond( parameter >= MIDI_CONTROL_RPN_PITCH_BEND_RANGE && parameter <= MIDI_CONTROL_RPN_COARSE_TUNING, EINVAL );
 
+  if( size == sizeof(MIDIValue) ) {
+    *((MIDIValue*)value) = controller->registered_parameters[parameter*2];
+  } else {
+    *((MIDILongValue*)value) = MIDI_LONG_VALUE( controller->registered_parameters[parameter*2],
+                                                controller->registered_parameters[parameter*2+1] );
+  }
   return 0;
 }
 
@@ -434,13 +918,27 @@ int MIDIControllerGetRegisteredParameter( struct MIDIController * controller, MI
  * @param size       The size of the buffer pointed to by @c value.
  * @param value      The value to store. The type may vary depending on the
  *                   kind of parameter.
+ * @retval 0 on success.
+ * @retval 1 if the parameter could not be stored.
  */
 int MIDIControllerSetNonRegisteredParameter( struct MIDIController * controller, MIDIControlParameter parameter, size_t size,  void * value ) {
   MIDIPrecond( controller != NULL, EFAULT );
   MIDIPrecond( size > 0 && value != NULL, EINVAL );
 
-  MIDIControllerSetControl( controller, MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER, sizeof(MIDILongValue), &parameter );
-  /* set non-registered parameter */
+  MIDIPrecond( size == sizeof(MIDIValue) || size == sizeof(MIDILongValue), EINVAL );
+  MIDIPrecond( parameter >= 0 && parameter < MIDI_CONTROL_RPN_RESET, EINVAL );
+  MIDILongValue p = parameter, v;
+
+  if( size == sizeof(MIDIValue) ) {
+    v = MIDI_LONG_VALUE( *((MIDIValue*)value), 0 );
+  } else {
+    v = *((MIDILongValue*)value) & 0x3fff;
+  }
+  if( _nrp_store( &(controller->nrp), p, v, &(controller->version) ) ) return 1;
+  MIDIControllerSetControl( controller, MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER, sizeof(MIDILongValue), &p );
+  _select_parameter( controller, p, MIDI_OFF );
+  _set_control( controller, MIDI_CONTROL_DATA_ENTRY, MIDI_MSB( v ) );
+  _set_control( controller, MIDI_CONTROL_DATA_ENTRY+32, MIDI_LSB( v ) );
   return 0;
 }
 
@@ -453,40 +951,234 @@ int MIDIControllerSetNonRegisteredParameter( struct MIDIController * controller,
  * @param size       The size of the buffer pointed to by @c value.
  * @param value      The value to store. The type may vary depending on the
  *                   kind of parameter.
+ * @retval 0 on success.
+ * @retval 1 if the parameter was never set.
  */
 int MIDIControllerGetNonRegisteredParameter( struct MIDIController * controller, MIDIControlParameter parameter, size_t size,  void * value ) {
   MIDIPrecond( controller != NULL, EFAULT );
   MIDIPrecond( size > 0 && value != NULL, EINVAL );
+  MIDIPrecond( size == sizeof(MIDIValue) || size == sizeof(MIDILongValue), EINVAL );
+  struct MIDINonRegisteredParameter * entry = _nrp_find( &(controller->nrp), parameter );
 
+  if( entry == NULL ) return 1;
+  if( size == sizeof(MIDIValue) ) {
+    *((MIDIValue*)value) = MIDI_MSB( entry->value );
+  } else {
+    *((MIDILongValue*)value) = entry->value;
+  }
+  return 0;
+}
+
+/**
+ * @brief Get the controller's version.
+ * The version is incremented whenever a control or parameter value
+ * changes. Pass it to MIDIControllerStoreDelta to store only the
+ * values that changed afterwards.
+ * @public @memberof MIDIController
+ * @param controller The controller.
+ * @param version    The current version.
+ * @retval 0 on success.
+ */
+int MIDIControllerGetVersion( struct MIDIController * controller, unsigned long * version ) {
+  MIDIPrecond( controller != NULL, EFAULT );
+  MIDIPrecond( version != NULL, EINVAL );
+  *version = controller->version;
   return 0;
 }
 
 /**
  * @brief Store control values.
+ * Store all controls, registered and non-registered parameters and
+ * the currently selected parameter.
  * @public @memberof MIDIController
  * @param controller The controller.
  * @param size       The size of the buffer pointed to by @c buffer.
  * @param buffer     The buffer to store the controller values in.
- * @param written    The number of bytes written to the buffer.
+ * @param written    The number of bytes written to the buffer. If the
+ *                   buffer is too small, the number of bytes required.
+ * @retval 0 on success.
+ * @retval 1 if the buffer is too small.
  */
 int MIDIControllerStore( struct MIDIController * controller, size_t size, void * buffer, size_t * written ) {
   MIDIPrecond( controller != NULL, EFAULT );
   MIDIPrecond( size > 0 && buffer != NULL, EINVAL );
-  return 0;
+  return _store( controller, 0, MIDI_ON, size, buffer, written );
+}
+
+/**
+ * @brief Store the control values that changed after a given version.
+ * The result can be passed to MIDIControllerRecall to apply the changes
+ * to a controller that recalled the state at @c since_version before.
+ * Removal of non-registered parameters is not tracked.
+ * @public @memberof MIDIController
+ * @param controller    The controller.
+ * @param since_version The version returned by MIDIControllerGetVersion.
+ * @param size          The size of the buffer pointed to by @c buffer.
+ * @param buffer        The buffer to store the controller values in.
+ * @param written       The number of bytes written to the buffer. If the
+ *                      buffer is too small, the number of bytes required.
+ * @retval 0 on success.
+ * @retval 1 if the buffer is too small.
+ */
+int MIDIControllerStoreDelta( struct MIDIController * controller, unsigned long since_version,
+                              size_t size, void * buffer, size_t * written ) {
+  MIDIPrecond( controller != NULL, EFAULT );
+  MIDIPrecond( size > 0 && buffer != NULL, EINVAL );
+  return _store( controller, since_version, MIDI_OFF, size, buffer, written );
 }
 
 /**
  * @brief Recall the values of previously stored controls.
+ * Apply a complete state stored with MIDIControllerStore or the changes
+ * stored with MIDIControllerStoreDelta.
  * @public @memberof MIDIController
  * @param controller The controller.
  * @param size       The size of the buffer pointed to by @c buffer.
  * @param buffer     The buffer to store the controller values in.
  * @param read       The number of bytes read from the buffer.
+ * @retval 0 on success.
+ * @retval 1 if the buffer contains an invalid or incomplete record.
  */
 int MIDIControllerRecall( struct MIDIController * controller, size_t size, void * buffer, size_t * read ) {
   MIDIPrecond( controller != NULL, EFAULT );
   MIDIPrecond( size > 0 && buffer != NULL, EINVAL );
-  return 0;
+  unsigned char * b = buffer;
+  size_t n = 0;
+  int result = 0;
+
+  while( n < size && result == 0 ) {
+    switch( b[n] ) {
+      case STORE_CONTROL:
+        if( n+3 > size || b[n+1] >= N_CONTROLS ) {
+          result = 1;
+        } else {
+          _set_control( controller, b[n+1], b[n+2] & 0x7f );
+          n += 3;
+        }
+        break;
+      case STORE_REGISTERED:
+        if( n+3 > size || b[n+1] >= 6 ) {
+          result = 1;
+        } else {
+          _set_registered( controller, b[n+1], b[n+2] & 0x7f );
+          n += 3;
+        }
+        break;
+      case STORE_NRP:
+        if( n+5 > size ) {
+          result = 1;
+        } else {
+          result = _nrp_store( &(controller->nrp), MIDI_LONG_VALUE( b[n+1], b[n+2] ),
+                               MIDI_LONG_VALUE( b[n+3], b[n+4] ), &(controller->version) );
+          if( result == 0 ) n += 5;
+        }
+        break;
+      case STORE_PARAMETER:
+        if( n+4 > size ) {
+          result = 1;
+        } else {
+          _select_parameter( controller, MIDI_LONG_VALUE( b[n+1], b[n+2] ), MIDI_BOOL( b[n+3] ) );
+          n += 4;
+        }
+        break;
+      case STORE_CLEAR_NRP:
+        if( controller->nrp.length > 0 ) {
+          _nrp_clear( &(controller->nrp) );
+          controller->version++;
+        }
+        n += 1;
+        break;
+      default:
+        result = 1;
+        break;
+    }
+  }
+  if( read != NULL ) *read = n;
+  return result;
+}
+
+/**
+ * @brief Create the messages that change one controller state into another.
+ * Append the control change messages that a receiver in the state of
+ * @c from needs to end up in the state of @c to. Only controls that
+ * differ are sent. Parameters are selected by sending only the number
+ * bytes that changed, sorted by parameter number, and the parameter
+ * that is selected in @c to is sent last, so that it does not have to
+ * be selected again. The RPN/NRPN null function is only sent if @c to
+ * has no parameter selected. All
+ * messages share one status byte, so encoding the batch with running
+ * status (see MIDIMessageBatchEncode) needs two bytes per message.
+ * Non-registered parameters that only exist in @c from can not be
+ * removed and are left alone.
+ * @public @memberof MIDIController
+ * @param from    The state of the receiving controller.
+ * @param to      The state the receiving controller should end up in.
+ * @param channel The channel to send the control changes on.
+ * @param batch   The batch to append the messages to.
+ * @retval 0 on success.
+ * @retval >0 if some messages could not be created.
+ */
+int MIDIControllerDiff( struct MIDIController * from, struct MIDIController * to, MIDIChannel channel,
+                        struct MIDIMessageBatch * batch ) {
+  struct MIDIControllerDiffState diff;
+  MIDILongValue p;
+  unsigned int msb, lsb;
+  MIDIBoolean other;
+  int c;
+  MIDIPrecond( from != NULL, EFAULT );
+  MIDIPrecond( to != NULL, EFAULT );
+  MIDIPrecond( batch != NULL, EINVAL );
+  MIDIPrecond( channel >= MIDI_CHANNEL_1 && channel <= MIDI_CHANNEL_16, EINVAL );
+
+  diff.channel    = channel;
+  diff.batch      = batch;
+  diff.parameter  = from->current_parameter;
+  diff.registered = from->current_parameter_registered;
+  diff.result     = 0;
+  for( c=0; c<N_CONTROLS; c++ ) {
+    diff.controls[c] = from->controls[c];
+  }
+
+  /* plain controls, MSBs before LSBs; channel mode messages are not state */
+  for( c=0; c<MIDI_CONTROL_ALL_SOUND_OFF; c++ ) {
+    switch( c ) {
+      case MIDI_CONTROL_DATA_ENTRY:
+      case MIDI_CONTROL_DATA_ENTRY+32:
+      case MIDI_CONTROL_DATA_INCREMENT:
+      case MIDI_CONTROL_DATA_DECREMENT:
+      case MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_MSB:
+      case MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_LSB:
+      case MIDI_CONTROL_REGISTERED_PARAMETER_NUMBER_MSB:
+      case MIDI_CONTROL_REGISTERED_PARAMETER_NUMBER_LSB:
+        break;
+      default:
+        if( from->controls[c] != to->controls[c] ) _diff_send( &diff, c, to->controls[c] );
+        break;
+    }
+  }
+
+  /* the kind of parameter that ends up selected goes last */
+  if( to->current_parameter_registered ) {
+    diff.result += _diff_non_registered( &diff, from, to );
+    _diff_registered( &diff, from, to );
+  } else {
+    _diff_registered( &diff, from, to );
+    diff.result += _diff_non_registered( &diff, from, to );
+  }
+
+  /* parameter numbers of the kind that is not selected, then the selected parameter */
+  other = to->current_parameter_registered ? MIDI_OFF : MIDI_ON;
+  msb   = other ? MIDI_CONTROL_REGISTERED_PARAMETER_NUMBER_MSB : MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_MSB;
+  lsb   = other ? MIDI_CONTROL_REGISTERED_PARAMETER_NUMBER_LSB : MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_LSB;
+  p = MIDI_LONG_VALUE( to->controls[msb], to->controls[lsb] );
+  if( diff.controls[msb] != to->controls[msb] || diff.controls[lsb] != to->controls[lsb] ) {
+    _diff_select( &diff, p, other, _diff_loaded( to, from, p, other ) );
+  }
+  _diff_select( &diff, to->current_parameter, to->current_parameter_registered,
+                _diff_loaded( to, from, to->current_parameter, to->current_parameter_registered ) );
+  _diff_data( &diff, MIDI_LONG_VALUE( to->controls[MIDI_CONTROL_DATA_ENTRY],
+                                      to->controls[MIDI_CONTROL_DATA_ENTRY+32] ), MIDI_OFF );
+  return diff.result;
 }
 
 /** @} */
@@ -512,36 +1204,44 @@ int MIDIControllerRecall( struct MIDIController * controller, size_t size, void
  */
 int MIDIControllerReceiveControlChange( struct MIDIController * controller, struct MIDIDevice * device,
                                         MIDIChannel channel, MIDIControl control, MIDIValue value ) {
+  MIDILongValue data;
   MIDIPrecond( controller != NULL, EFAULT );
   if( control < MIDI_CONTROL_ALL_SOUND_OFF ) {
     switch( control ) {
       case MIDI_CONTROL_DATA_INCREMENT:
-        controller->controls[MIDI_CONTROL_DATA_ENTRY+32]++;
-        if( controller->controls[MIDI_CONTROL_DATA_ENTRY+32] & 0x80 ) {
-          controller->controls[MIDI_CONTROL_DATA_ENTRY+32] &= 0x7f;
-          controller->controls[MIDI_CONTROL_DATA_ENTRY]++;
-        }
-        break;
+        data = MIDI_LONG_VALUE( controller->controls[MIDI_CONTROL_DATA_ENTRY],
+                                controller->controls[MIDI_CONTROL_DATA_ENTRY+32] ) + 1;
+        _set_control( controller, MIDI_CONTROL_DATA_ENTRY,    MIDI_MSB( data ) );
+        _set_control( controller, MIDI_CONTROL_DATA_ENTRY+32, MIDI_LSB( data ) );
+        _set_control( controller, control, value );
+        _store_current_parameter( controller );
+        return 0;
       case MIDI_CONTROL_DATA_DECREMENT:
-        controller->controls[MIDI_CONTROL_DATA_ENTRY+32]--;
-        if( controller->controls[MIDI_CONTROL_DATA_ENTRY+32] & 0x80 ) {
-          controller->controls[MIDI_CONTROL_DATA_ENTRY+32] &= 0x7f;
-          controller->controls[MIDI_CONTROL_DATA_ENTRY]--;
-        }
-        break;
+        data = MIDI_LONG_VALUE( controller->controls[MIDI_CONTROL_DATA_ENTRY],
+                                controller->controls[MIDI_CONTROL_DATA_ENTRY+32] ) - 1;
+        _set_control( controller, MIDI_CONTROL_DATA_ENTRY,    MIDI_MSB( data ) );
+        _set_control( controller, MIDI_CONTROL_DATA_ENTRY+32, MIDI_LSB( data ) );
+        _set_control( controller, control, value );
+        _store_current_parameter( controller );
+        return 0;
       case MIDI_CONTROL_DATA_ENTRY:
       case MIDI_CONTROL_DATA_ENTRY+32:
-        break;
+        _set_control( controller, control, value );
+        _store_current_parameter( controller );
+        return 0;
       case MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_MSB:
       case MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_LSB:
-        break;
+        _set_control( controller, control, value );
+        return _load_non_registered_parameter( controller );
       case MIDI_CONTROL_REGISTERED_PARAMETER_NUMBER_MSB:
       case MIDI_CONTROL_REGISTERED_PARAMETER_NUMBER_LSB:
-        break;
+        _set_control( controller, control, value );
+        _load_registered_parameter( controller );
+        return 0;
       default:
         break;
     }
-    controller->controls[(int)control] = value;
+    _set_control( controller, control, value );
   } else {
     switch( control ) {
       case  MIDI_CONTROL_ALL_SOUND_OFF:
@@ -126,6 +126,7 @@
 /** @} */
 
 struct MIDIDevice;
+struct MIDIMessageBatch;
 
 struct MIDIController;
 struct MIDIControllerDelegate {
@@ -145,8 +146,13 @@ int MIDIControllerGetRegisteredParameter( struct MIDIController * controller, MI
 int MIDIControllerSetNonRegisteredParameter( struct MIDIController * controller, MIDIControlParameter parameter, size_t size,  void * value );
 int MIDIControllerGetNonRegisteredParameter( struct MIDIController * controller, MIDIControlParameter parameter, size_t size,  void * value );
 
+int MIDIControllerGetVersion( struct MIDIController * controller, unsigned long * version );
 int MIDIControllerStore( struct MIDIController * controller, size_t size, void * buffer, size_t * written );
+int MIDIControllerStoreDelta( struct MIDIController * controller, unsigned long since_version,
+                              size_t size, void * buffer, size_t * written );
 int MIDIControllerRecall( struct MIDIController * controller, size_t size, void * buffer, size_t * read );
+int MIDIControllerDiff( struct MIDIController * from, struct MIDIController * to, MIDIChannel channel,
+                        struct MIDIMessageBatch * batch );
 
 int MIDIControllerReceiveControlChange( struct MIDIController * controller, struct MIDIDevice * device,
                                         MIDIChannel channel, MIDIControl control, MIDIValue value );
@@ -7,10 +7,20 @@
 #include "type.h"
 #include "port.h"
 #include "message.h"
+#include "message_format.h"
 #include "controller.h"
 #include "timer.h"
+#include "time_code.h"
 
 #define N_CHANNEL 16
+#define N_DISPATCH 32
+
+/**
+ * @brief Get the dispatch table index for a status byte.
+ * Channel messages are indexed by their high nibble, system messages
+ * by their low nibble after the sixteen channel entries.
+ */
+#define DISPATCH_INDEX( b ) ( ( (b) < 0xf0 ) ? ( (b) >> 4 ) : ( N_CHANNEL + ( (b) & 0x0f ) ) )
 
 
 /**
@@ -92,6 +102,29 @@
  *        MIDI_STATUS_CONTINUE, MIDI_STATUS_STOP,
  *        MIDI_STATUS_ACTIVE_SENSING, MIDI_STATUS_RESET
  */
+/**
+ * @public @property MIDIDeviceDelegate::recv_batch
+ * @brief Batch callback.
+ * Called once with all messages of a received MIDIMessageBatch. The
+ * per-message callbacks are not called for these messages, but they
+ * still reach the attached controllers, timer and time code. Messages
+ * that are received one by one are not passed to this callback.
+ * @see   MIDIMessageBatch
+ */
+
+/**
+ * @brief Active notes of one direction.
+ * A 128 bit map of sounding keys per channel. Velocity and timestamp
+ * of the last note on are only stored if note details are enabled.
+ * @private @memberof MIDIDevice
+ * @cond INTERNALS
+ */
+struct MIDIDeviceNotes {
+  uint64_t        bits[N_CHANNEL][2];
+  MIDIVelocity  * velocity;
+  MIDITimestamp * timestamp;
+};
+/** @endcond */
 
 /**
  * @ingroup MIDI
@@ -116,8 +149,13 @@ struct MIDIDevice {
   MIDIBoolean omni_mode;
   MIDIBoolean poly_mode;
   struct MIDITimer      * timer;
+  struct MIDITimeCode   * time_code;
 /*struct MIDIInstrument * instrument[N_CHANNEL]; */
   struct MIDIController * controller[N_CHANNEL];
+  struct MIDIController * omni_controller[N_CHANNEL+1];
+  struct MIDIDeviceNotes  notes[2];
+  int (*dispatch[N_DISPATCH])( struct MIDIDevice * device, struct MIDIMessage * message,
+                               struct MIDIMessageData * data );
 /** @endcond */
 };
 
@@ -128,12 +166,149 @@ struct MIDIDevice {
  * @{
  */
  
+/**
+ * @brief Count the set bits of a note map word.
+ * @private @memberof MIDIDevice
+ * @param v The word.
+ * @return the number of set bits.
+ */
+static int _bit_count( uint64_t v ) {
+#ifdef __GNUC__
+  return __builtin_popcountll( v );
+#else
+  int n = 0;
+  for( ; v != 0; v &= v - 1 ) n++;
+  return n;
+#endif
+}
+
+/**
+ * @brief Find the lowest set bit of a note map word.
+ * @private @memberof MIDIDevice
+ * @param v The word, must not be zero.
+ * @return the index of the lowest set bit.
+ */
+static int _bit_lowest( uint64_t v ) {
+#ifdef __GNUC__
+  return __builtin_ctzll( v );
+#else
+  int n = 0;
+  for( ; ( v & 1 ) == 0; v >>= 1 ) n++;
+  return n;
+#endif
+}
+
+/**
+ * @brief Update the active notes.
+ * Set the key's bit on note on and clear it on note off or note on
+ * with zero velocity.
+ * @private @memberof MIDIDevice
+ * @param notes     The note map.
+ * @param status    The status, either note on or note off.
+ * @param channel   The channel.
+ * @param key       The key.
+ * @param velocity  The velocity.
+ * @param timestamp The timestamp of the message.
+ */
+static void _notes_update( struct MIDIDeviceNotes * notes, MIDIStatus status, MIDIChannel channel,
+                           MIDIKey key, MIDIVelocity velocity, MIDITimestamp timestamp ) {
+  uint64_t bit = (uint64_t) 1 << ( key & 0x3f );
+  int i = ( channel & 0xf ) * 128 + ( key & 0x7f );
+  if( status == MIDI_STATUS_NOTE_ON && velocity > 0 ) {
+    notes->bits[channel & 0xf][( key >> 6 ) & 1] |= bit;
+    if( notes->velocity != NULL ) {
+      notes->velocity[i]  = velocity;
+      notes->timestamp[i] = timestamp;
+    }
+  } else {
+    notes->bits[channel & 0xf][( key >> 6 ) & 1] &= ~bit;
+  }
+}
+
+/**
+ * @brief Update the active notes from a message.
+ * Note messages update single keys, "All Notes Off" and the channel
+ * mode messages that imply it clear the whole channel.
+ * @private @memberof MIDIDevice
+ * @param notes   The note map.
+ * @param message The message.
+ */
+static void _notes_track( struct MIDIDeviceNotes * notes, struct MIDIMessage * message ) {
+  struct MIDIMessageData * data;
+  MIDITimestamp timestamp;
+  unsigned char * m;
+
+  if( MIDIMessageGetData( message, &data ) ) return;
+  m = &(data->bytes[0]);
+  switch( MIDI_HIGH_NIBBLE(m[0]) ) {
+    case MIDI_STATUS_NOTE_OFF:
+    case MIDI_STATUS_NOTE_ON:
+      MIDIMessageGetTimestamp( message, &timestamp );
+      _notes_update( notes, MIDI_HIGH_NIBBLE(m[0]), MIDI_LOW_NIBBLE(m[0]), m[1], m[2], timestamp );
+      break;
+    case MIDI_STATUS_CONTROL_CHANGE:
+      if( m[1] >= MIDI_CONTROL_ALL_NOTES_OFF ) {
+        notes->bits[MIDI_LOW_NIBBLE(m[0])][0] = 0;
+        notes->bits[MIDI_LOW_NIBBLE(m[0])][1] = 0;
+      }
+      break;
+  }
+}
+
+/**
+ * @brief Receive a note message.
+ * Update the received notes and pass the message to the delegate.
+ * @private @memberof MIDIDevice
+ * @param device    The device.
+ * @param status    The status, either note on or note off.
+ * @param channel   The channel.
+ * @param key       The key.
+ * @param velocity  The velocity.
+ * @param timestamp The timestamp of the message.
+ * @retval 0 on success.
+ */
+static int _recv_note( struct MIDIDevice * device, MIDIStatus status, MIDIChannel channel,
+                       MIDIKey key, MIDIVelocity velocity, MIDITimestamp timestamp ) {
+  _notes_update( &(device->notes[MIDI_DEVICE_NOTES_RECEIVED]), status, channel, key, velocity, timestamp );
+  if( device->delegate == NULL ) return 0;
+  if( status == MIDI_STATUS_NOTE_ON ) {
+    if( device->delegate->recv_non == NULL ) return 0;
+    return (*device->delegate->recv_non)( device, channel, key, velocity );
+  } else {
+    if( device->delegate->recv_nof == NULL ) return 0;
+    return (*device->delegate->recv_nof)( device, channel, key, velocity );
+  }
+}
+
+/**
+ * @brief Update the list of unique controllers.
+ * Collect every controller that is connected to at least one channel
+ * exactly once, so that control changes in Omni mode can be passed to
+ * each controller without checking for duplicates. The list is
+ * terminated with a @c NULL pointer. This must be called whenever a
+ * channel controller changes.
+ * @private @memberof MIDIDevice
+ * @param device The device.
+ */
+static void _update_omni_controller( struct MIDIDevice * device ) {
+  struct MIDIController * ctl;
+  int c, i, n = 0;
+
+  for( c=0; c<N_CHANNEL; c++ ) {
+    ctl = device->controller[c];
+    if( ctl == NULL ) continue;
+    for( i=0; i<n && device->omni_controller[i] != ctl; i++ );
+    if( i == n ) device->omni_controller[n++] = ctl;
+  }
+  device->omni_controller[n] = NULL;
+}
+
 /**
  * @brief Receive a control change in Omni mode.
  * Receive a control change and pass it to all connected controllers.
- * We ensure that even if one controller is connected to multiple
- * channels, it will receive the control change only once, by keeping
- * a list of controllers that received the given message.
+ * Even if one controller is connected to multiple channels it will
+ * receive the control change only once, because the device keeps a
+ * precomputed list of unique controllers.
  * @private @memberof MIDIDevice
  * @param device  The device.
  * @param channel The channel.
@@ -143,30 +318,12 @@ struct MIDIDevice {
  */
 static int _recv_cc_omni( struct MIDIDevice * device, MIDIChannel channel,
                           MIDIControl control, MIDIValue value ) {
-  int result = 0, i;
-  struct MIDIController * ctl;
-  struct MIDIController * recv[N_CHANNEL+1] = { NULL };
-  MIDIChannel c;
+  struct MIDIController ** ctl;
+  int result = 0;
   MIDIPrecond( device != NULL, EFAULT );
-  
-  for( c=MIDI_CHANNEL_1; c<=MIDI_CHANNEL_16; c++ ) {
-    if( device->controller[(int)c] != NULL ) {
-      i   = 0;
-      ctl = device->controller[(int)c];
-      /* if we have already sent the CC to the controller,
-       * it will be contained in the recv list. */
-      while( i<N_CHANNEL
-          && recv[i]!=NULL
-          && recv[i]!=ctl ) i++;
-      if( recv[i] != ctl ) {
-        /* we reached the end of (the filled part of) the list
-         * without finding the controller. */
-        recv[i]   = ctl;
-        recv[i+1] = NULL;
-        result   += MIDIControllerReceiveControlChange( ctl, device, channel,
-                                                        control, value );
-      }
-    }
+
+  for( ctl = &(device->omni_controller[0]); *ctl != NULL; ctl++ ) {
+    result += MIDIControllerReceiveControlChange( *ctl, device, channel, control, value );
   }
   return result;
 }
@@ -214,15 +371,158 @@ static int _recv_rt( struct MIDIDevice * device, MIDIStatus status, MIDITimestam
   return MIDITimerReceiveRealTime( device->timer, device, status, timestamp );
 }
 
+/**
+ * @brief Receive a time code quarter frame message.
+ * Pass the message to the connected time code (if any) and the delegate.
+ * @private @memberof MIDIDevice
+ * @param device         The device.
+ * @param time_code_type One of the eight code-types specified by the MIDI time code spec.
+ * @param value          The 4-bit value for the given time code type.
+ * @param timestamp      The timestamp of the message.
+ * @retval 0 on success.
+ */
+static int _recv_tcqf( struct MIDIDevice * device, MIDIValue time_code_type, MIDIValue value, MIDITimestamp timestamp ) {
+  int result = 0;
+  MIDIPrecond( device != NULL, EFAULT );
+  if( device->time_code != NULL ) {
+    result = MIDITimeCodeReceiveQuarterFrame( device->time_code, device, time_code_type, value, timestamp );
+  }
+  return result + MIDIDeviceReceiveTimeCodeQuarterFrame( device, time_code_type, value );
+}
+
+/**
+ * @brief Dispatch functions.
+ * Decode the fields of a received message directly from its data bytes
+ * and pass them to the delegate or to the device's receive functions.
+ * @private @memberof MIDIDevice
+ * @param device  The device.
+ * @param message The received message.
+ * @param data    The message data.
+ * @retval 0 on success.
+ */
+static int _dispatch_note( struct MIDIDevice * device, struct MIDIMessage * message, struct MIDIMessageData * data ) {
+  unsigned char * m = &(data->bytes[0]);
+  MIDITimestamp timestamp;
+  MIDIMessageGetTimestamp( message, &timestamp );
+  return _recv_note( device, MIDI_HIGH_NIBBLE(m[0]), MIDI_LOW_NIBBLE(m[0]), m[1], m[2], timestamp );
+}
+
+static int _dispatch_pkp( struct MIDIDevice * device, struct MIDIMessage * message, struct MIDIMessageData * data ) {
+  unsigned char * m = &(data->bytes[0]);
+  return (*device->delegate->recv_pkp)( device, MIDI_LOW_NIBBLE(m[0]), m[1], m[2] );
+}
+
+static int _dispatch_cc( struct MIDIDevice * device, struct MIDIMessage * message, struct MIDIMessageData * data ) {
+  unsigned char * m = &(data->bytes[0]);
+  return MIDIDeviceReceiveControlChange( device, MIDI_LOW_NIBBLE(m[0]), m[1], m[2] );
+}
+
+static int _dispatch_pc( struct MIDIDevice * device, struct MIDIMessage * message, struct MIDIMessageData * data ) {
+  unsigned char * m = &(data->bytes[0]);
+  return (*device->delegate->recv_pc)( device, MIDI_LOW_NIBBLE(m[0]), m[1] );
+}
+
+static int _dispatch_cp( struct MIDIDevice * device, struct MIDIMessage * message, struct MIDIMessageData * data ) {
+  unsigned char * m = &(data->bytes[0]);
+  return (*device->delegate->recv_cp)( device, MIDI_LOW_NIBBLE(m[0]), m[1] );
+}
+
+static int _dispatch_pwc( struct MIDIDevice * device, struct MIDIMessage * message, struct MIDIMessageData * data ) {
+  unsigned char * m = &(data->bytes[0]);
+  return (*device->delegate->recv_pwc)( device, MIDI_LOW_NIBBLE(m[0]), MIDI_LONG_VALUE( m[2], m[1] ) );
+}
+
+static int _dispatch_sx( struct MIDIDevice * device, struct MIDIMessage * message, struct MIDIMessageData * data ) {
+  unsigned char * m = &(data->bytes[0]);
+  return (*device->delegate->recv_sx)( device, ( m[1] << 8 ) + m[2], data->size, data->data, m[3] >> 1 );
+}
+
+static int _dispatch_tcqf( struct MIDIDevice * device, struct MIDIMessage * message, struct MIDIMessageData * data ) {
+  unsigned char * m = &(data->bytes[0]);
+  MIDITimestamp timestamp;
+  MIDIMessageGetTimestamp( message, &timestamp );
+  return _recv_tcqf( device, MIDI_HIGH_NIBBLE(m[1]), MIDI_LOW_NIBBLE(m[1]), timestamp );
+}
+
+static int _dispatch_spp( struct MIDIDevice * device, struct MIDIMessage * message, struct MIDIMessageData * data ) {
+  unsigned char * m = &(data->bytes[0]);
+  return (*device->delegate->recv_spp)( device, MIDI_LONG_VALUE( m[2], m[1] ) );
+}
+
+static int _dispatch_ss( struct MIDIDevice * device, struct MIDIMessage * message, struct MIDIMessageData * data ) {
+  return (*device->delegate->recv_ss)( device, data->bytes[1] );
+}
+
+static int _dispatch_tr( struct MIDIDevice * device, struct MIDIMessage * message, struct MIDIMessageData * data ) {
+  return (*device->delegate->recv_tr)( device );
+}
+
+static int _dispatch_eox( struct MIDIDevice * device, struct MIDIMessage * message, struct MIDIMessageData * data ) {
+  return (*device->delegate->recv_eox)( device );
+}
+
+static int _dispatch_rt( struct MIDIDevice * device, struct MIDIMessage * message, struct MIDIMessageData * data ) {
+  MIDITimestamp timestamp;
+  MIDIMessageGetTimestamp( message, &timestamp );
+  return MIDIDeviceReceiveRealTime( device, data->bytes[0], timestamp );
+}
+
+/**
+ * @brief Resolve the dispatch table.
+ * Install a dispatch function for every status that has a receiver,
+ * either a delegate callback or an attached controller, timer or
+ * time code. Note messages and control changes are always dispatched
+ * to keep track of the active notes. Messages with any other status
+ * are skipped without decoding. This must be called whenever one of
+ * the receivers changes.
+ * @private @memberof MIDIDevice
+ * @param device The device.
+ */
+static void _dispatch_resolve( struct MIDIDevice * device ) {
+  struct MIDIDeviceDelegate * delegate = device->delegate;
+  int (**dispatch)( struct MIDIDevice *, struct MIDIMessage *, struct MIDIMessageData * ) = &(device->dispatch[0]);
+  int i;
+
+  for( i=0; i<N_DISPATCH; i++ ) {
+    dispatch[i] = NULL;
+  }
+  dispatch[DISPATCH_INDEX(MIDI_STATUS_NOTE_OFF<<4)]       = &_dispatch_note;
+  dispatch[DISPATCH_INDEX(MIDI_STATUS_NOTE_ON<<4)]        = &_dispatch_note;
+  dispatch[DISPATCH_INDEX(MIDI_STATUS_CONTROL_CHANGE<<4)] = &_dispatch_cc;
+  if( delegate != NULL ) {
+    if( delegate->recv_pkp != NULL ) dispatch[DISPATCH_INDEX(MIDI_STATUS_POLYPHONIC_KEY_PRESSURE<<4)] = &_dispatch_pkp;
+    if( delegate->recv_pc  != NULL ) dispatch[DISPATCH_INDEX(MIDI_STATUS_PROGRAM_CHANGE<<4)]     = &_dispatch_pc;
+    if( delegate->recv_cp  != NULL ) dispatch[DISPATCH_INDEX(MIDI_STATUS_CHANNEL_PRESSURE<<4)]   = &_dispatch_cp;
+    if( delegate->recv_pwc != NULL ) dispatch[DISPATCH_INDEX(MIDI_STATUS_PITCH_WHEEL_CHANGE<<4)] = &_dispatch_pwc;
+    if( delegate->recv_sx  != NULL ) dispatch[DISPATCH_INDEX(MIDI_STATUS_SYSTEM_EXCLUSIVE)]        = &_dispatch_sx;
+    if( delegate->recv_spp != NULL ) dispatch[DISPATCH_INDEX(MIDI_STATUS_SONG_POSITION_POINTER)]   = &_dispatch_spp;
+    if( delegate->recv_ss  != NULL ) dispatch[DISPATCH_INDEX(MIDI_STATUS_SONG_SELECT)]             = &_dispatch_ss;
+    if( delegate->recv_tr  != NULL ) dispatch[DISPATCH_INDEX(MIDI_STATUS_TUNE_REQUEST)]            = &_dispatch_tr;
+    if( delegate->recv_eox != NULL ) dispatch[DISPATCH_INDEX(MIDI_STATUS_END_OF_EXCLUSIVE)]        = &_dispatch_eox;
+  }
+  if( device->time_code != NULL || ( delegate != NULL && delegate->recv_tcqf != NULL ) ) {
+    dispatch[DISPATCH_INDEX(MIDI_STATUS_TIME_CODE_QUARTER_FRAME)] = &_dispatch_tcqf;
+  }
+  if( device->timer != NULL || ( delegate != NULL && delegate->recv_rt != NULL ) ) {
+    dispatch[DISPATCH_INDEX(MIDI_STATUS_TIMING_CLOCK)]   = &_dispatch_rt;
+    dispatch[DISPATCH_INDEX(MIDI_STATUS_START)]          = &_dispatch_rt;
+    dispatch[DISPATCH_INDEX(MIDI_STATUS_CONTINUE)]       = &_dispatch_rt;
+    dispatch[DISPATCH_INDEX(MIDI_STATUS_STOP)]           = &_dispatch_rt;
+    dispatch[DISPATCH_INDEX(MIDI_STATUS_ACTIVE_SENSING)] = &_dispatch_rt;
+    dispatch[DISPATCH_INDEX(MIDI_STATUS_RESET)]          = &_dispatch_rt;
+  }
+}
+
 /**
  * @brief Receive a generic MIDI message.
  * This is called by the @c IN port whenever it relays a MIDIMessage
  * to the device. Such a message may come from a MIDIDriver or the @c THRU
  * port of another device.
  *
- * The device determines the message type and calls the appropiate member
- * function. If something is attached to the device's @c THRU port, the message
- * is relayed via the port @em before the device processes the message.
+ * The device looks up the message's status byte in its dispatch table
+ * and calls the resolved dispatch function, if any. If something is
+ * attached to the device's @c THRU port, the message is relayed via the
+ * port @em before the device processes the message.
  * This implies that, when multiple devices are daisy-chained with their
  * @c THRU ports, the last device in the chain will be the first device to process
  * the message.
@@ -233,84 +533,80 @@ static int _recv_rt( struct MIDIDevice * device, MIDIStatus status, MIDITimestam
  * @retval 1 if the message could not be processed.
  */
 static int _recv_msg( struct MIDIDevice * device, struct MIDIMessage * message ) {
-  MIDIStatus     status;
-  MIDITimestamp  timestamp;
-  MIDIValue      v[3];
-  MIDILongValue  lv;
-  uint8_t b;
-  size_t  s;
-  void *  vp;
+  struct MIDIMessageData * data;
+  int (*dispatch)( struct MIDIDevice *, struct MIDIMessage *, struct MIDIMessageData * );
   MIDIPrecond( device != NULL, EFAULT );
   MIDIPrecond( message != NULL, EINVAL );
-  
-  MIDIMessageGetStatus( message, &status );
-  switch( status ) {
-    case MIDI_STATUS_NOTE_OFF:
-      MIDIMessageGet( message, MIDI_CHANNEL,  sizeof(MIDIChannel),  &v[0] );
-      MIDIMessageGet( message, MIDI_KEY,      sizeof(MIDIKey),      &v[1] );
-      MIDIMessageGet( message, MIDI_VELOCITY, sizeof(MIDIVelocity), &v[2] );
-      return MIDIDeviceReceiveNoteOff( device, v[0], v[1], v[2] );
-    case MIDI_STATUS_NOTE_ON:
-      MIDIMessageGet( message, MIDI_CHANNEL,  sizeof(MIDIChannel),  &v[0] );
-      MIDIMessageGet( message, MIDI_KEY,      sizeof(MIDIKey),      &v[1] );
-      MIDIMessageGet( message, MIDI_VELOCITY, sizeof(MIDIVelocity), &v[2] );
-      return MIDIDeviceReceiveNoteOn( device, v[0], v[1], v[2] );
-    case MIDI_STATUS_POLYPHONIC_KEY_PRESSURE:
-      MIDIMessageGet( message, MIDI_CHANNEL,  sizeof(MIDIChannel),  &v[0] );
-      MIDIMessageGet( message, MIDI_KEY,      sizeof(MIDIKey),      &v[1] );
-      MIDIMessageGet( message, MIDI_PRESSURE, sizeof(MIDIPressure), &v[2] );
-      return MIDIDeviceReceivePolyphonicKeyPressure( device, v[0], v[1], v[2] );
-    case MIDI_STATUS_CONTROL_CHANGE:
-      MIDIMessageGet( message, MIDI_CHANNEL, sizeof(MIDIChannel), &v[0] );
-      MIDIMessageGet( message, MIDI_CONTROL, sizeof(MIDIControl), &v[1] );
-      MIDIMessageGet( message, MIDI_VALUE,   sizeof(MIDIValue),   &v[2] );
-      return MIDIDeviceReceiveControlChange( device, v[0], v[1], v[2] );
-    case MIDI_STATUS_PROGRAM_CHANGE:
-      MIDIMessageGet( message, MIDI_CHANNEL, sizeof(MIDIChannel), &v[0] );
-      MIDIMessageGet( message, MIDI_PROGRAM, sizeof(MIDIProgram), &v[1] );
-      return MIDIDeviceReceiveProgramChange( device, v[0], v[1] );
-    case MIDI_STATUS_CHANNEL_PRESSURE:
-      MIDIMessageGet( message, MIDI_CHANNEL,  sizeof(MIDIChannel),  &v[0] );
-      MIDIMessageGet( message, MIDI_PRESSURE, sizeof(MIDIPressure), &v[1] );
-      return MIDIDeviceReceiveChannelPressure( device, v[0], v[1] );
-    case MIDI_STATUS_PITCH_WHEEL_CHANGE:
-      MIDIMessageGet( message, MIDI_CHANNEL, sizeof(MIDIChannel),   &v[0] );
-      MIDIMessageGet( message, MIDI_VALUE,   sizeof(MIDILongValue), &lv );
-      return MIDIDeviceReceivePitchWheelChange( device, v[0], lv );
-    case MIDI_STATUS_SYSTEM_EXCLUSIVE:
-      MIDIMessageGet( message, MIDI_MANUFACTURER_ID, sizeof(MIDIManufacturerId), &v[0] );
-      MIDIMessageGet( message, MIDI_SYSEX_SIZE,      sizeof(size_t), &s );
-      MIDIMessageGet( message, MIDI_SYSEX_DATA,      sizeof(void*), &vp );
-      MIDIMessageGet( message, MIDI_SYSEX_FRAGMENT,  sizeof(uint8_t), &b );
-      return MIDIDeviceReceiveSystemExclusive( device, v[0], s, vp, b );
-    case MIDI_STATUS_TIME_CODE_QUARTER_FRAME:
-      MIDIMessageGet( message, MIDI_TIME_CODE_TYPE, sizeof(MIDIValue), &v[0] );
-      MIDIMessageGet( message, MIDI_VALUE,          sizeof(MIDIValue), &v[1] );
-      return MIDIDeviceReceiveTimeCodeQuarterFrame( device, v[0], v[1] );
-    case MIDI_STATUS_SONG_POSITION_POINTER:
-      MIDIMessageGet( message, MIDI_VALUE, sizeof(MIDILongValue), &lv );
-      return MIDIDeviceReceiveSongPositionPointer( device, lv );
-    case MIDI_STATUS_SONG_SELECT:
-      MIDIMessageGet( message, MIDI_VALUE, sizeof(MIDIValue), &v[0] );
-      return MIDIDeviceReceiveSongSelect( device, v[0] );
-    case MIDI_STATUS_TUNE_REQUEST:
-      return MIDIDeviceReceiveTuneRequest( device );
-    case MIDI_STATUS_END_OF_EXCLUSIVE:
-      return MIDIDeviceReceiveEndOfExclusive( device );
-    case MIDI_STATUS_TIMING_CLOCK:
-    case MIDI_STATUS_START:
-    case MIDI_STATUS_CONTINUE:
-    case MIDI_STATUS_STOP:
-    case MIDI_STATUS_ACTIVE_SENSING:
-    case MIDI_STATUS_RESET:
-      MIDIMessageGetTimestamp( message, &timestamp );
-      return MIDIDeviceReceiveRealTime( device, status, timestamp );
-    default:
-      break;
+
+  MIDIMessageGetData( message, &data );
+  dispatch = device->dispatch[DISPATCH_INDEX(data->bytes[0])];
+  if( dispatch == NULL ) return 0;
+  return (*dispatch)( device, message, data );
+}
+
+/**
+ * @brief Route a received MIDI message without calling the delegate.
+ * Update the received notes and pass the message to the attached
+ * controllers, timer and time code. This is used for the messages of
+ * a batch that the delegate already received as a whole.
+ * @private @memberof MIDIDevice
+ * @param device  The midi device.
+ * @param message The received message.
+ * @retval 0 on success.
+ */
+static int _route_msg( struct MIDIDevice * device, struct MIDIMessage * message ) {
+  struct MIDIMessageData * data;
+  MIDITimestamp timestamp;
+  unsigned char * m;
+
+  if( MIDIMessageGetData( message, &data ) ) return 0;
+  m = &(data->bytes[0]);
+  _notes_track( &(device->notes[MIDI_DEVICE_NOTES_RECEIVED]), message );
+  if( MIDI_HIGH_NIBBLE(m[0]) == MIDI_STATUS_CONTROL_CHANGE ) {
+    return _recv_cc( device, MIDI_LOW_NIBBLE(m[0]), m[1], m[2] );
+  }
+  MIDIMessageGetTimestamp( message, &timestamp );
+  if( m[0] == MIDI_STATUS_TIME_CODE_QUARTER_FRAME && device->time_code != NULL ) {
+    return MIDITimeCodeReceiveQuarterFrame( device->time_code, device,
+                                            MIDI_HIGH_NIBBLE(m[1]), MIDI_LOW_NIBBLE(m[1]), timestamp );
+  }
+  if( m[0] >= MIDI_STATUS_TIMING_CLOCK ) {
+    return _recv_rt( device, m[0], timestamp );
   }
   return 0;
 }
 
+/**
+ * @brief Receive a batch of MIDI messages.
+ * If the delegate has a batch callback, pass the whole batch to it and
+ * only route the contained messages to the attached controllers, timer
+ * and time code. Otherwise dispatch every contained message like a
+ * single received message.
+ * @private @memberof MIDIDevice
+ * @param device The midi device.
+ * @param batch  The received batch.
+ * @retval 0 on success.
+ */
+static int _recv_batch( struct MIDIDevice * device, struct MIDIMessageBatch * batch ) {
+  struct MIDIMessage * message;
+  size_t i = 0;
+  int result = 0;
+  MIDIPrecond( device != NULL, EFAULT );
+  MIDIPrecond( batch != NULL, EINVAL );
+
+  if( device->delegate != NULL && device->delegate->recv_batch != NULL ) {
+    result = (*device->delegate->recv_batch)( device, batch );
+    while( MIDIMessageBatchNext( batch, 0, &i, &message ) == 0 ) {
+      result += _route_msg( device, message );
+    }
+  } else {
+    while( MIDIMessageBatchNext( batch, 0, &i, &message ) == 0 ) {
+      result += _recv_msg( device, message );
+    }
+  }
+  return result;
+}
+
 /**
  * @brief Receive anything that can be sent through a port.
  * This is used as the callback of the device's @c IN port.
@@ -328,6 +624,9 @@ static int _recv( void * dev, void * source, struct MIDITypeSpec * type, void *
   if( type == MIDIMessageType ) {
     MIDIPrecond( data != NULL, EINVAL );
     return _recv_msg( dev, data );
+  } else if( type == MIDIMessageBatchType ) {
+    MIDIPrecond( data != NULL, EINVAL );
+    return _recv_batch( dev, data );
   } else {
     return 0;
   }
@@ -359,7 +658,7 @@ struct MIDIDevice * MIDIDeviceCreate( struct MIDIDeviceDelegate * delegate ) {
   if( device == NULL ) return NULL;
 
   device->refs = 1;
-  device->in   = MIDIPortCreate( "Device IN",  MIDI_PORT_IN | MIDI_PORT_THRU, device, &_recv );
+  device->in   = MIDIPortCreate( "Device IN",  MIDI_PORT_IN | MIDI_PORT_THRU | MIDI_PORT_BATCH, device, &_recv );
   device->out  = MIDIPortCreate( "Device OUT", MIDI_PORT_OUT, device, NULL );
 /*device->in   = NULL;
   device->out  = NULL;
@@ -369,10 +668,21 @@ struct MIDIDevice * MIDIDeviceCreate( struct MIDIDeviceDelegate * delegate ) {
   device->omni_mode    = MIDI_OFF;
   device->poly_mode    = MIDI_ON;
   device->timer        = NULL;
+  device->time_code    = NULL;
   for( channel=MIDI_CHANNEL_1; channel<=MIDI_CHANNEL_16; channel++ ) {
   /*device->instrument[(int)channel] = NULL;*/
     device->controller[(int)channel] = NULL;
+    device->notes[MIDI_DEVICE_NOTES_RECEIVED].bits[(int)channel][0] = 0;
+    device->notes[MIDI_DEVICE_NOTES_RECEIVED].bits[(int)channel][1] = 0;
+    device->notes[MIDI_DEVICE_NOTES_SENT].bits[(int)channel][0] = 0;
+    device->notes[MIDI_DEVICE_NOTES_SENT].bits[(int)channel][1] = 0;
   }
+  device->omni_controller[0] = NULL;
+  device->notes[MIDI_DEVICE_NOTES_RECEIVED].velocity  = NULL;
+  device->notes[MIDI_DEVICE_NOTES_RECEIVED].timestamp = NULL;
+  device->notes[MIDI_DEVICE_NOTES_SENT].velocity  = NULL;
+  device->notes[MIDI_DEVICE_NOTES_SENT].timestamp = NULL;
+  _dispatch_resolve( device );
   return device;
 }
 
@@ -395,6 +705,8 @@ void MIDIDeviceDestroy( struct MIDIDevice * device ) {
   MIDIPortRelease( device->out );
 
   if( device->timer != NULL ) MIDITimerRelease( device->timer );
+  if( device->time_code != NULL ) MIDITimeCodeRelease( device->time_code );
+  MIDIDeviceSetNoteDetails( device, MIDI_OFF );
   for( channel=MIDI_CHANNEL_1; channel<=MIDI_CHANNEL_16; channel++ ) {
   /*if( device->instrument[(int)channel] != NULL ) MIDIInstrumentRelease( device->instrument[(int)channel] );;*/
     if( device->controller[(int)channel] != NULL ) MIDIControllerRelease( device->controller[(int)channel] );;
@@ -550,6 +862,38 @@ int MIDIDeviceAttachThru( struct MIDIDevice * device, struct MIDIPort * port ) {
  * @{
  */
 
+/**
+ * @brief Set the device's delegate.
+ * The dispatch table of the device is resolved from the delegate's
+ * callbacks when it is set. If the callbacks of the delegate are changed
+ * afterwards, the delegate has to be set again.
+ * @public @memberof MIDIDevice
+ * @param device   The device.
+ * @param delegate The delegate. May be @c NULL.
+ * @retval 0 on success.
+ */
+int MIDIDeviceSetDelegate( struct MIDIDevice * device, struct MIDIDeviceDelegate * delegate ) {
+  MIDIPrecond( device != NULL, EFAULT );
+  device->delegate = delegate;
+  _dispatch_resolve( device );
+  return 0;
+}
+
+/**
+ * @brief Get the device's delegate.
+ * @see MIDIDeviceSetDelegate
+ * @public @memberof MIDIDevice
+ * @param device   The device.
+ * @param delegate The delegate.
+ * @retval 0 on success.
+ */
+int MIDIDeviceGetDelegate( struct MIDIDevice * device, struct MIDIDeviceDelegate ** delegate ) {
+  MIDIPrecond( device != NULL, EFAULT );
+  MIDIPrecond( delegate != NULL, EINVAL );
+  *delegate = device->delegate;
+  return 0;
+}
+
 /**
  * @brief Set the device's base channel.
  * Every MIDI device has a base channel. The base channel is used to reply to
@@ -583,6 +927,38 @@ int MIDIDeviceGetBaseChannel( struct MIDIDevice * device, MIDIChannel * channel
   return 0;
 }
 
+/**
+ * @brief Set the device's Omni mode.
+ * In Omni mode, control changes on any channel are passed to every
+ * connected controller. Otherwise, only control changes on the base
+ * channel are passed to the base channel's controller.
+ * @public @memberof MIDIDevice
+ * @param device    The device.
+ * @param omni_mode @c MIDI_ON or @c MIDI_OFF.
+ * @retval 0 on success.
+ */
+int MIDIDeviceSetOmniMode( struct MIDIDevice * device, MIDIBoolean omni_mode ) {
+  MIDIPrecond( device != NULL, EFAULT );
+  MIDIPrecond( omni_mode == MIDI_ON || omni_mode == MIDI_OFF, EINVAL );
+  device->omni_mode = omni_mode;
+  return 0;
+}
+
+/**
+ * @brief Get the device's Omni mode.
+ * @see MIDIDeviceSetOmniMode
+ * @public @memberof MIDIDevice
+ * @param device    The device.
+ * @param omni_mode The Omni mode.
+ * @retval 0 on success.
+ */
+int MIDIDeviceGetOmniMode( struct MIDIDevice * device, MIDIBoolean * omni_mode ) {
+  MIDIPrecond( device != NULL, EFAULT );
+  MIDIPrecond( omni_mode != NULL, EINVAL );
+  *omni_mode = device->omni_mode;
+  return 0;
+}
+
 /**
  * @brief Set the device's timer.
  * The device's timer is responsible for following real time messages to
@@ -599,6 +975,7 @@ int MIDIDeviceSetTimer( struct MIDIDevice * device, struct MIDITimer * timer ) {
   if( device->timer != NULL ) MIDITimerRelease( device->timer );
   MIDITimerRetain( timer );
   device->timer = timer;
+  _dispatch_resolve( device );
   return 0;
 }
 
@@ -617,6 +994,41 @@ int MIDIDeviceGetTimer( struct MIDIDevice * device, struct MIDITimer ** timer )
   return 0;
 }
 
+/**
+ * @brief Set the device's time code.
+ * The device's time code receives the time code quarter frames and
+ * reassembles full SMPTE positions.
+ * @public @memberof MIDIDevice
+ * @param device    The device.
+ * @param time_code The time code.
+ * @retval 0  on success.
+ * @retval >0 if the time code could not be set.
+ */
+int MIDIDeviceSetTimeCode( struct MIDIDevice * device, struct MIDITimeCode * time_code ) {
+  MIDIPrecond( device != NULL, EFAULT );
+  if( time_code != NULL ) MIDITimeCodeRetain( time_code );
+  if( device->time_code != NULL ) MIDITimeCodeRelease( device->time_code );
+  device->time_code = time_code;
+  _dispatch_resolve( device );
+  return 0;
+}
+
+/**
+ * @brief Get the device's time code.
+ * @see MIDIDeviceSetTimeCode
+ * @public @memberof MIDIDevice
+ * @param device    The device.
+ * @param time_code The time code.
+ * @retval 0  on success.
+ * @retval >0 if the time code could not be stored.
+ */
+int MIDIDeviceGetTimeCode( struct MIDIDevice * device, struct MIDITimeCode ** time_code ) {
+  MIDIPrecond( device != NULL, EFAULT );
+  MIDIPrecond( time_code != NULL, EINVAL );
+  *time_code = device->time_code;
+  return 0;
+}
+
 /*
  **
  * @brief Set the instrument for a specific channel.
@@ -707,6 +1119,8 @@ int MIDIDeviceSetChannelController( struct MIDIDevice * device, MIDIChannel chan
   if( device->controller[(int)channel] != NULL ) MIDIControllerRelease( device->controller[(int)channel] );
   device->controller[(int)channel] = controller;
   MIDIControllerRetain( controller );
+  _update_omni_controller( device );
+  _dispatch_resolve( device );
   return 0;
 }
 
@@ -733,6 +1147,186 @@ int MIDIDeviceGetChannelController( struct MIDIDevice * device, MIDIChannel chan
 
 /** @} */
 
+/* MARK: Note tracking *//**
+ * @name Note tracking
+ * Query sounding notes and turn them off.
+ * The device keeps a bit map of active notes per channel for received
+ * and for sent messages. Note on sets a key, note off (or note on with
+ * zero velocity) clears it. "All Notes Off" and the channel mode
+ * messages clear the whole channel.
+ * @{
+ */
+
+/**
+ * @brief Enable or disable note details.
+ * If enabled, the device stores the velocity and timestamp of every
+ * active note in addition to the note bit maps.
+ * @public @memberof MIDIDevice
+ * @param device  The device.
+ * @param details @c MIDI_ON to enable, @c MIDI_OFF to disable note details.
+ * @retval 0 on success.
+ * @retval >0 if the note details could not be allocated, they are disabled then.
+ */
+int MIDIDeviceSetNoteDetails( struct MIDIDevice * device, MIDIBoolean details ) {
+  struct MIDIDeviceNotes * notes;
+  int i;
+  MIDIPrecond( device != NULL, EFAULT );
+  for( i=0; i<2; i++ ) {
+    notes = &(device->notes[i]);
+    if( details == MIDI_OFF ) {
+      if( notes->velocity != NULL ) free( notes->velocity );
+      if( notes->timestamp != NULL ) free( notes->timestamp );
+      notes->velocity  = NULL;
+      notes->timestamp = NULL;
+    } else if( notes->velocity == NULL ) {
+      notes->velocity  = calloc( N_CHANNEL * 128, sizeof(MIDIVelocity) );
+      notes->timestamp = calloc( N_CHANNEL * 128, sizeof(MIDITimestamp) );
+      if( notes->velocity == NULL || notes->timestamp == NULL ) {
+        for( ; i>=0; i-- ) {
+          notes = &(device->notes[i]);
+          free( notes->velocity );
+          free( notes->timestamp );
+          notes->velocity  = NULL;
+          notes->timestamp = NULL;
+        }
+        MIDIError( ENOMEM, "Could not allocate space for note details." );
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Get the active notes of a channel.
+ * Store the 128 bit map of sounding keys in two words, key @c k is
+ * active if bit <tt>k % 64</tt> of <tt>notes[k / 64]</tt> is set.
+ * @public @memberof MIDIDevice
+ * @param device    The device.
+ * @param direction @c MIDI_DEVICE_NOTES_RECEIVED or @c MIDI_DEVICE_NOTES_SENT.
+ * @param channel   The channel. Use @c MIDI_CHANNEL_ALL to combine all channels.
+ * @param notes     The note bit map.
+ * @retval 0 on success.
+ */
+int MIDIDeviceGetActiveNotes( struct MIDIDevice * device, int direction, MIDIChannel channel, uint64_t notes[2] ) {
+  uint64_t (*bits)[2];
+  int c;
+  MIDIPrecond( device != NULL, EFAULT );
+  MIDIPrecond( direction == MIDI_DEVICE_NOTES_RECEIVED || direction == MIDI_DEVICE_NOTES_SENT, EINVAL );
+  MIDIPrecond( notes != NULL, EINVAL );
+  bits = device->notes[direction].bits;
+  if( channel == MIDI_CHANNEL_BASE ) channel = device->base_channel;
+  if( channel == MIDI_CHANNEL_ALL ) {
+    notes[0] = 0;
+    notes[1] = 0;
+    for( c=0; c<N_CHANNEL; c++ ) {
+      notes[0] |= bits[c][0];
+      notes[1] |= bits[c][1];
+    }
+    return 0;
+  }
+  MIDIPrecond( channel >= MIDI_CHANNEL_1 && channel <= MIDI_CHANNEL_16, EINVAL );
+  notes[0] = bits[(int)channel][0];
+  notes[1] = bits[(int)channel][1];
+  return 0;
+}
+
+/**
+ * @brief Get the number of active notes.
+ * @public @memberof MIDIDevice
+ * @param device    The device.
+ * @param direction @c MIDI_DEVICE_NOTES_RECEIVED or @c MIDI_DEVICE_NOTES_SENT.
+ * @param channel   The channel. Use @c MIDI_CHANNEL_ALL to count on all channels.
+ * @param count     The number of active notes.
+ * @retval 0 on success.
+ */
+int MIDIDeviceGetActiveNoteCount( struct MIDIDevice * device, int direction, MIDIChannel channel, size_t * count ) {
+  uint64_t (*bits)[2];
+  int c;
+  MIDIPrecond( device != NULL, EFAULT );
+  MIDIPrecond( direction == MIDI_DEVICE_NOTES_RECEIVED || direction == MIDI_DEVICE_NOTES_SENT, EINVAL );
+  MIDIPrecond( count != NULL, EINVAL );
+  bits = device->notes[direction].bits;
+  if( channel == MIDI_CHANNEL_BASE ) channel = device->base_channel;
+  if( channel == MIDI_CHANNEL_ALL ) {
+    *count = 0;
+    for( c=0; c<N_CHANNEL; c++ ) {
+      *count += _bit_count( bits[c][0] ) + _bit_count( bits[c][1] );
+    }
+    return 0;
+  }
+  MIDIPrecond( channel >= MIDI_CHANNEL_1 && channel <= MIDI_CHANNEL_16, EINVAL );
+  *count = _bit_count( bits[(int)channel][0] ) + _bit_count( bits[(int)channel][1] );
+  return 0;
+}
+
+/**
+ * @brief Get the details of an active note.
+ * Requires note details to be enabled.
+ * @see MIDIDeviceSetNoteDetails
+ * @public @memberof MIDIDevice
+ * @param device    The device.
+ * @param direction @c MIDI_DEVICE_NOTES_RECEIVED or @c MIDI_DEVICE_NOTES_SENT.
+ * @param channel   The channel.
+ * @param key       The key.
+ * @param velocity  The velocity of the note on. May be @c NULL.
+ * @param timestamp The timestamp of the note on. May be @c NULL.
+ * @retval 0 on success.
+ * @retval 1 if the note is not active.
+ */
+int MIDIDeviceGetNoteDetails( struct MIDIDevice * device, int direction, MIDIChannel channel, MIDIKey key,
+                              MIDIVelocity * velocity, MIDITimestamp * timestamp ) {
+  struct MIDIDeviceNotes * notes;
+  MIDIPrecond( device != NULL, EFAULT );
+  MIDIPrecond( direction == MIDI_DEVICE_NOTES_RECEIVED || direction == MIDI_DEVICE_NOTES_SENT, EINVAL );
+  if( channel == MIDI_CHANNEL_BASE ) channel = device->base_channel;
+  MIDIPrecond( channel >= MIDI_CHANNEL_1 && channel <= MIDI_CHANNEL_16, EINVAL );
+  MIDIPrecond( (unsigned char) key < 128, EINVAL );
+  notes = &(device->notes[direction]);
+  MIDIPrecond( notes->velocity != NULL, EINVAL );
+  if( ( notes->bits[(int)channel][key >> 6] & ( (uint64_t) 1 << ( key & 0x3f ) ) ) == 0 ) return 1;
+  if( velocity != NULL )  *velocity  = notes->velocity[channel * 128 + key];
+  if( timestamp != NULL ) *timestamp = notes->timestamp[channel * 128 + key];
+  return 0;
+}
+
+/**
+ * @brief Turn off all sent notes.
+ * Send a "Note Off" message for every note that was turned on by this
+ * device and not turned off since. Unlike "All Notes Off" this also
+ * works for receivers that ignore channel mode messages.
+ * @public @memberof MIDIDevice
+ * @param device  The device.
+ * @param channel The channel. Use @c MIDI_CHANNEL_ALL for all channels.
+ * @retval 0 on success.
+ * @retval >0 if a note off could not be sent.
+ */
+int MIDIDeviceSendPanic( struct MIDIDevice * device, MIDIChannel channel ) {
+  uint64_t bits;
+  int c, first, last, i, result = 0;
+  MIDIPrecond( device != NULL, EFAULT );
+  if( channel == MIDI_CHANNEL_BASE ) channel = device->base_channel;
+  if( channel == MIDI_CHANNEL_ALL ) {
+    first = MIDI_CHANNEL_1;
+    last  = MIDI_CHANNEL_16;
+  } else {
+    MIDIPrecond( channel >= MIDI_CHANNEL_1 && channel <= MIDI_CHANNEL_16, EINVAL );
+    first = channel;
+    last  = channel;
+  }
+  for( c=first; c<=last; c++ ) {
+    for( i=0; i<2; i++ ) {
+      /* sending the note off clears the bit in the map */
+      for( bits = device->notes[MIDI_DEVICE_NOTES_SENT].bits[c][i]; bits != 0; bits &= bits - 1 ) {
+        result += MIDIDeviceSendNoteOff( device, c, i * 64 + _bit_lowest( bits ), 0 );
+      }
+    }
+  }
+  return result;
+}
+
+/** @} */
+
 /* MARK: Message passing *//**
  * @name Message passing
  * Receiving and and sending MIDIMessage objects.
@@ -767,9 +1361,45 @@ int MIDIDeviceReceive( struct MIDIDevice * device, struct MIDIMessage * message
 int MIDIDeviceSend( struct MIDIDevice * device, struct MIDIMessage * message ) {
   MIDIPrecond( device != NULL, EFAULT );
   MIDIPrecond( message != NULL, EINVAL );
+  _notes_track( &(device->notes[MIDI_DEVICE_NOTES_SENT]), message );
   return MIDIPortSend( device->out, MIDIMessageType, message );
 }
 
+/**
+ * @brief Receive a batch of MIDI messages.
+ * This simulates a received batch on the device's @c IN port.
+ * @public @memberof MIDIDevice
+ * @param device The midi device.
+ * @param batch  The received batch.
+ * @retval 0 on success.
+ * @retval >0 if the batch could not be processed.
+ */
+int MIDIDeviceReceiveBatch( struct MIDIDevice * device, struct MIDIMessageBatch * batch ) {
+  MIDIPrecond( device != NULL, EFAULT );
+  MIDIPrecond( batch != NULL, EINVAL );
+  return MIDIPortReceive( device->in, MIDIMessageBatchType, batch );
+}
+
+/**
+ * @brief Send a batch of MIDI messages.
+ * Send all messages of the batch through the @c OUT port at once.
+ * @public @memberof MIDIDevice
+ * @param device The device.
+ * @param batch  The batch.
+ * @retval 0 on success.
+ * @retval >0 if the batch could not be sent.
+ */
+int MIDIDeviceSendBatch( struct MIDIDevice * device, struct MIDIMessageBatch * batch ) {
+  struct MIDIMessage * message;
+  size_t i = 0;
+  MIDIPrecond( device != NULL, EFAULT );
+  MIDIPrecond( batch != NULL, EINVAL );
+  while( MIDIMessageBatchNext( batch, 0, &i, &message ) == 0 ) {
+    _notes_track( &(device->notes[MIDI_DEVICE_NOTES_SENT]), message );
+  }
+  return MIDIPortSend( device->out, MIDIMessageBatchType, batch );
+}
+
 /**
  * @brief Receive a "Note Off" message.
  * This is called whenever the device receives a "Note Off" message.
@@ -777,6 +1407,7 @@ int MIDIDeviceSend( struct MIDIDevice * device, struct MIDIMessage * message ) {
  * @public @memberof MIDIDevice
  * @param device   The midi device.
  * @param channel  The channel on which the note ended.
+ *                 Use @c MIDI_CHANNEL_BASE for the base channel.
  * @param key      The key that ended.
  * @param velocity The velocity with which the "key" was released.
  * @retval 0 on success.
@@ -784,10 +1415,9 @@ int MIDIDeviceSend( struct MIDIDevice * device, struct MIDIMessage * message ) {
  */
 int MIDIDeviceReceiveNoteOff( struct MIDIDevice * device, MIDIChannel channel, MIDIKey key, MIDIVelocity velocity ) {
   MIDIPrecond( device != NULL, EFAULT );
-  if( device->delegate == NULL || device->delegate->recv_nof == NULL ) {
-    return 0;
-  }
-  return (*device->delegate->recv_nof)( device, channel, key, velocity );
+  if( channel == MIDI_CHANNEL_BASE ) channel = device->base_channel;
+  MIDIPrecond( channel >= MIDI_CHANNEL_1 && channel <= MIDI_CHANNEL_16, EINVAL );
+  return _recv_note( device, MIDI_STATUS_NOTE_OFF, channel, key, velocity, 0 );
 }
 
 /**
@@ -823,6 +1453,7 @@ int MIDIDeviceSendNoteOff( struct MIDIDevice * device, MIDIChannel channel, MIDI
  * @public @memberof MIDIDevice
  * @param device   The midi device.
  * @param channel  The channel on which the note occurred.
+ *                 Use @c MIDI_CHANNEL_BASE for the base channel.
  * @param key      The key that was played.
  * @param velocity The velocity with which the "key" was pressed.
  * @retval 0 on success.
@@ -830,10 +1461,9 @@ int MIDIDeviceSendNoteOff( struct MIDIDevice * device, MIDIChannel channel, MIDI
  */
 int MIDIDeviceReceiveNoteOn( struct MIDIDevice * device, MIDIChannel channel, MIDIKey key, MIDIVelocity velocity ) {
   MIDIPrecond( device != NULL, EFAULT );
-  if( device->delegate == NULL || device->delegate->recv_non == NULL ) {
-    return 0;
-  }
-  return (*device->delegate->recv_non)( device, channel, key, velocity );
+  if( channel == MIDI_CHANNEL_BASE ) channel = device->base_channel;
+  MIDIPrecond( channel >= MIDI_CHANNEL_1 && channel <= MIDI_CHANNEL_16, EINVAL );
+  return _recv_note( device, MIDI_STATUS_NOTE_ON, channel, key, velocity, 0 );
 }
 
 /**
@@ -915,14 +1545,22 @@ int MIDIDeviceSendPolyphonicKeyPressure( struct MIDIDevice * device, MIDIChannel
  * @public @memberof MIDIDevice
  * @param device  The midi device.
  * @param channel The channel on which the control change occured.
+ *                Use @c MIDI_CHANNEL_BASE for the base channel.
  * @param control The control that was changed.
  * @param value   The new value of the control.
  * @retval 0 on success.
  * @retval 1 if the message could not be processed.
  */
 int MIDIDeviceReceiveControlChange( struct MIDIDevice * device, MIDIChannel channel, MIDIControl control, MIDIValue value ) {
+  int result;
   MIDIPrecond( device != NULL, EFAULT );
-  int result = _recv_cc( device, channel, control, value );
+  if( channel == MIDI_CHANNEL_BASE ) channel = device->base_channel;
+  MIDIPrecond( channel >= MIDI_CHANNEL_1 && channel <= MIDI_CHANNEL_16, EINVAL );
+  result = _recv_cc( device, channel, control, value );
+  if( control >= MIDI_CONTROL_ALL_NOTES_OFF ) {
+    device->notes[MIDI_DEVICE_NOTES_RECEIVED].bits[(int)channel][0] = 0;
+    device->notes[MIDI_DEVICE_NOTES_RECEIVED].bits[(int)channel][1] = 0;
+  }
   if( device->delegate == NULL || device->delegate->recv_cc == NULL ) {
     return result;
   }
@@ -4,12 +4,17 @@
 #include "midi.h"
 
 struct MIDIMessage;
+struct MIDIMessageBatch;
 struct MIDIPort;
 struct MIDIController;
 struct MIDITimer;
+struct MIDITimeCode;
 
 struct MIDIDevice;
 
+#define MIDI_DEVICE_NOTES_RECEIVED 0
+#define MIDI_DEVICE_NOTES_SENT     1
+
 struct MIDIDeviceDelegate {
   int (*recv_nof)( struct MIDIDevice * device, MIDIChannel channel, MIDIKey key, MIDIVelocity velocity );
   int (*recv_non)( struct MIDIDevice * device, MIDIChannel channel, MIDIKey key, MIDIVelocity velocity );
@@ -26,6 +31,7 @@ struct MIDIDeviceDelegate {
   int (*recv_tr)( struct MIDIDevice * device );
   int (*recv_eox)( struct MIDIDevice * device );
   int (*recv_rt)( struct MIDIDevice * device, MIDIStatus status, MIDITimestamp );
+  int (*recv_batch)( struct MIDIDevice * device, struct MIDIMessageBatch * batch );
 };
 
 struct MIDIDevice * MIDIDeviceCreate( struct MIDIDeviceDelegate * delegate );
@@ -33,6 +39,9 @@ void MIDIDeviceDestroy( struct MIDIDevice * device );
 void MIDIDeviceRetain( struct MIDIDevice * device );
 void MIDIDeviceRelease( struct MIDIDevice * device );
 
+int MIDIDeviceSetDelegate( struct MIDIDevice * device, struct MIDIDeviceDelegate * delegate );
+int MIDIDeviceGetDelegate( struct MIDIDevice * device, struct MIDIDeviceDelegate ** delegate );
+
 int MIDIDeviceGetInputPort( struct MIDIDevice * device, struct MIDIPort ** port );
 int MIDIDeviceDetachIn( struct MIDIDevice * device );
 int MIDIDeviceAttachIn( struct MIDIDevice * device, struct MIDIPort * port );
@@ -48,17 +57,32 @@ int MIDIDeviceAttachThru( struct MIDIDevice * device, struct MIDIPort * port );
 int MIDIDeviceSetBaseChannel( struct MIDIDevice * device, MIDIChannel channel );
 int MIDIDeviceGetBaseChannel( struct MIDIDevice * device, MIDIChannel * channel );
 
+int MIDIDeviceSetOmniMode( struct MIDIDevice * device, MIDIBoolean omni_mode );
+int MIDIDeviceGetOmniMode( struct MIDIDevice * device, MIDIBoolean * omni_mode );
+
 int MIDIDeviceSetTimer( struct MIDIDevice * device, struct MIDITimer * timer );
 int MIDIDeviceGetTimer( struct MIDIDevice * device, struct MIDITimer ** timer );
 
+int MIDIDeviceSetTimeCode( struct MIDIDevice * device, struct MIDITimeCode * time_code );
+int MIDIDeviceGetTimeCode( struct MIDIDevice * device, struct MIDITimeCode ** time_code );
+
 /*int MIDIDeviceSetChannelInstrument( struct MIDIDevice * device, MIDIChannel channel, struct MIDIInstrument * instrument );*/
 /*int MIDIDeviceGetChannelInstrument( struct MIDIDevice * device, MIDIChannel channel, struct MIDIInstrument ** instrument );*/
 
 int MIDIDeviceSetChannelController( struct MIDIDevice * device, MIDIChannel channel, struct MIDIController * controller );
 int MIDIDeviceGetChannelController( struct MIDIDevice * device, MIDIChannel channel, struct MIDIController ** controller );
 
+int MIDIDeviceSetNoteDetails( struct MIDIDevice * device, MIDIBoolean details );
+int MIDIDeviceGetActiveNotes( struct MIDIDevice * device, int direction, MIDIChannel channel, uint64_t notes[2] );
+int MIDIDeviceGetActiveNoteCount( struct MIDIDevice * device, int direction, MIDIChannel channel, size_t * count );
+int MIDIDeviceGetNoteDetails( struct MIDIDevice * device, int direction, MIDIChannel channel, MIDIKey key,
+                              MIDIVelocity * velocity, MIDITimestamp * timestamp );
+int MIDIDeviceSendPanic( struct MIDIDevice * device, MIDIChannel channel );
+
 int MIDIDeviceReceive( struct MIDIDevice * device, struct MIDIMessage * message );
 int MIDIDeviceSend( struct MIDIDevice * device, struct MIDIMessage * message );
+int MIDIDeviceReceiveBatch( struct MIDIDevice * device, struct MIDIMessageBatch * batch );
+int MIDIDeviceSendBatch( struct MIDIDevice * device, struct MIDIMessageBatch * batch );
 
 int MIDIDeviceReceiveNoteOff( struct MIDIDevice * device, MIDIChannel channel, MIDIKey key, MIDIVelocity velocity );
 int MIDIDeviceSendNoteOff( struct MIDIDevice * device, MIDIChannel channel, MIDIKey key, MIDIVelocity velocity );
@@ -72,8 +72,12 @@
 static int _port_receive( void * target, void * source, struct MIDITypeSpec * type, void * object ) {
   struct MIDIDriver * driver = target;
 
-  if( type == MIDIMessageType && driver->send != NULL ) {
+  if( driver->send == NULL ) return 0;
+  if( type == MIDIMessageType ) {
     return (*driver->send)( driver, object );
+  } else if( type == MIDIMessageBatchType ) {
+    /* only loopback drivers set MIDI_PORT_BATCH, they relay the batch as a whole */
+    return MIDIDriverReceiveBatch( driver, object );
   } else {
     return 0;
   }
@@ -210,7 +214,8 @@ int MIDIDriverGetPort( struct MIDIDriver * driver, struct MIDIPort ** port ) {
 /**
  * @brief Make the MIDIDriver implement itself as loopback.
  * The driver's callback will be modified so that it passes
- * outgoing messages to it's own receive method.
+ * outgoing messages to it's own receive method. The driver's port
+ * accepts batches, so that they are relayed as a whole.
  * @public @memberof MIDIDriver
  * @param driver The driver
  * @retval 0  on success.
@@ -219,7 +224,7 @@ int MIDIDriverGetPort( struct MIDIDriver * driver, struct MIDIPort ** port ) {
 int MIDIDriverMakeLoopback( struct MIDIDriver * driver ) {
   MIDIPrecond( driver != NULL, EFAULT );
   driver->send = &MIDIDriverReceive;
-  return 0;
+  return MIDIPortSetMode( driver->port, MIDI_PORT_IN | MIDI_PORT_OUT | MIDI_PORT_BATCH );
 }
 
 /**
@@ -239,6 +244,22 @@ int MIDIDriverReceive( struct MIDIDriver * driver, struct MIDIMessage * message
   return MIDIPortSend( driver->port, MIDIMessageType, message );
 }
 
+/**
+ * @brief Receive a batch of MIDIMessages.
+ * Relay all messages of one incoming packet at once via all attached
+ * receiving ports.
+ * @public @memberof MIDIDriver
+ * @param driver The driver.
+ * @param batch  The batch.
+ * @retval 0  on success.
+ * @retval >0 if the batch could not be relayed.
+ */
+int MIDIDriverReceiveBatch( struct MIDIDriver * driver, struct MIDIMessageBatch * batch ) {
+  MIDIPrecond( driver != NULL, EFAULT );
+  MIDIPrecond( batch != NULL, EINVAL );
+  return MIDIPortSend( driver->port, MIDIMessageBatchType, batch );
+}
+
 /**
  * @brief Send a generic MIDIMessage.
  * Pass an outgoing message (through the port) to the implementation.
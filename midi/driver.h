@@ -5,6 +5,7 @@
 struct MIDIPort;
 struct MIDIEvent;
 struct MIDIMessage;
+struct MIDIMessageBatch;
 
 struct MIDIDriver;
 
@@ -38,6 +39,7 @@ int MIDIDriverGetPort( struct MIDIDriver * driver, struct MIDIPort ** port );
 
 int MIDIDriverSend( struct MIDIDriver * driver, struct MIDIMessage * message );
 int MIDIDriverReceive( struct MIDIDriver * driver, struct MIDIMessage * message );
+int MIDIDriverReceiveBatch( struct MIDIDriver * driver, struct MIDIMessageBatch * batch );
 int MIDIDriverTriggerEvent( struct MIDIDriver * driver, struct MIDIEvent * event );
 
 int MIDIDriverStartProfiling( struct MIDIDriver * driver );
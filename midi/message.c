@@ -81,7 +81,7 @@ struct MIDIMessage * MIDIMessageCreate( MIDIStatus status ) {
 
   message->refs   = 1;
   message->format = format;
-  for( i=1; i<MIDI_MESSAGE_DATA_BYTES; i++ ) {
+  for( i=0; i<MIDI_MESSAGE_DATA_BYTES; i++ ) {
     message->data.bytes[i] = 0;
   }
   message->data.size = 0;
@@ -230,6 +230,23 @@ int MIDIMessageGet( struct MIDIMessage * message, MIDIProperty property, size_t
   return MIDIMessageFormatGet( message->format, &(message->data), property, size, value );
 }
 
+/**
+ * @brief Get the raw message data.
+ * Provide read access to the status and data bytes of the message so
+ * that receivers can decode fields without going through the property
+ * accessors. The data is owned by the message and must not be modified.
+ * @public @memberof MIDIMessage
+ * @param message The message.
+ * @param data    The location to store the data pointer in.
+ * @retval 0 on success.
+ */
+int MIDIMessageGetData( struct MIDIMessage * message, struct MIDIMessageData ** data ) {
+  MIDIPrecond( message != NULL, EFAULT );
+  MIDIPrecond( data != NULL, EINVAL );
+  *data = &(message->data);
+  return 0;
+}
+
 /** @} */
 
 /* MARK: Message coding *//**
@@ -390,3 +407,310 @@ int MIDIMessageListDecode( struct MIDIMessageList * messages, size_t size, unsig
 }
 
 /** @} */
+
+/* MARK: -
+ * MARK: Message batches *//**
+ * @name Message batches
+ * Collections of messages that are passed through ports at once.
+ * @{
+ */
+
+/**
+ * @ingroup MIDI
+ * @struct MIDIMessageBatch message.h
+ * @brief A batch of messages.
+ * A batch holds all messages of one packet or port send so that
+ * receivers can process them in a single pass.
+ */
+struct MIDIMessageBatch {
+/**
+ * @privatesection
+ * @cond INTERNALS
+ */
+  int    refs;
+  size_t length;
+  size_t capacity;
+  struct MIDIMessage ** messages;
+/** @endcond */
+};
+
+/**
+ * @brief Declare the MIDIMessageBatch type specification.
+ */
+MIDI_TYPE_SPEC_OBJECT( MIDIMessageBatch, 0x4011 );
+
+/**
+ * @brief Create a MIDIMessageBatch instance.
+ * Allocate space and initialize an empty batch.
+ * @public @memberof MIDIMessageBatch
+ * @param capacity The number of messages to reserve space for.
+ * @return a pointer to the created batch structure on success.
+ * @return a @c NULL pointer if the batch could not created.
+ */
+struct MIDIMessageBatch * MIDIMessageBatchCreate( size_t capacity ) {
+  struct MIDIMessageBatch * batch = malloc( sizeof( struct MIDIMessageBatch ) );
+  MIDIPrecondReturn( batch != NULL, ENOMEM, NULL );
+  batch->refs     = 1;
+  batch->length   = 0;
+  batch->capacity = capacity;
+  batch->messages = NULL;
+  if( capacity > 0 ) {
+    batch->messages = malloc( sizeof( struct MIDIMessage * ) * capacity );
+    if( batch->messages == NULL ) {
+      free( batch );
+      return NULL;
+    }
+  }
+  return batch;
+}
+
+/**
+ * @brief Destroy a MIDIMessageBatch instance.
+ * Release all contained messages and free the batch.
+ * @public @memberof MIDIMessageBatch
+ * @param batch The batch.
+ */
+void MIDIMessageBatchDestroy( struct MIDIMessageBatch * batch ) {
+  MIDIMessageBatchClear( batch );
+  if( batch->messages != NULL ) free( batch->messages );
+  free( batch );
+}
+
+/**
+ * @brief Retain a MIDIMessageBatch instance.
+ * Increment the reference counter of a batch so that it won't be destroyed.
+ * @public @memberof MIDIMessageBatch
+ * @param batch The batch.
+ */
+void MIDIMessageBatchRetain( struct MIDIMessageBatch * batch ) {
+  batch->refs++;
+}
+
+/**
+ * @brief Release a MIDIMessageBatch instance.
+ * Decrement the reference counter of a batch. If the reference count
+ * reached zero, destroy the batch.
+ * @public @memberof MIDIMessageBatch
+ * @param batch The batch.
+ */
+void MIDIMessageBatchRelease( struct MIDIMessageBatch * batch ) {
+  if( ! --batch->refs ) {
+    MIDIMessageBatchDestroy( batch );
+  }
+}
+
+/**
+ * @brief Append a message to a batch.
+ * The message is retained by the batch. Space is grown as needed.
+ * @public @memberof MIDIMessageBatch
+ * @param batch   The batch.
+ * @param message The message.
+ * @retval 0 on success.
+ */
+int MIDIMessageBatchAppend( struct MIDIMessageBatch * batch, struct MIDIMessage * message ) {
+  struct MIDIMessage ** messages;
+  size_t capacity;
+  MIDIPrecond( batch != NULL, EFAULT );
+  MIDIPrecond( message != NULL, EINVAL );
+  if( batch->length == batch->capacity ) {
+    capacity = ( batch->capacity > 0 ) ? batch->capacity * 2 : 8;
+    messages = realloc( batch->messages, sizeof( struct MIDIMessage * ) * capacity );
+    MIDIPrecond( messages != NULL, ENOMEM );
+    batch->messages = messages;
+    batch->capacity = capacity;
+  }
+  MIDIMessageRetain( message );
+  batch->messages[batch->length++] = message;
+  return 0;
+}
+
+/**
+ * @brief Remove all messages from a batch.
+ * Release the contained messages but keep the reserved space.
+ * @public @memberof MIDIMessageBatch
+ * @param batch The batch.
+ * @retval 0 on success.
+ */
+int MIDIMessageBatchClear( struct MIDIMessageBatch * batch ) {
+  MIDIPrecond( batch != NULL, EFAULT );
+  while( batch->length > 0 ) {
+    MIDIMessageRelease( batch->messages[--batch->length] );
+  }
+  return 0;
+}
+
+/**
+ * @brief Get the number of messages in a batch.
+ * @public @memberof MIDIMessageBatch
+ * @param batch  The batch.
+ * @param length The number of messages.
+ * @retval 0 on success.
+ */
+int MIDIMessageBatchGetLength( struct MIDIMessageBatch * batch, size_t * length ) {
+  MIDIPrecond( batch != NULL, EFAULT );
+  MIDIPrecond( length != NULL, EINVAL );
+  *length = batch->length;
+  return 0;
+}
+
+/**
+ * @brief Get a message from a batch.
+ * The message is not retained for the caller.
+ * @public @memberof MIDIMessageBatch
+ * @param batch   The batch.
+ * @param index   The index of the message.
+ * @param message The message.
+ * @retval 0 on success.
+ */
+int MIDIMessageBatchGetMessage( struct MIDIMessageBatch * batch, size_t index, struct MIDIMessage ** message ) {
+  MIDIPrecond( batch != NULL, EFAULT );
+  MIDIPrecond( index < batch->length, ERANGE );
+  MIDIPrecond( message != NULL, EINVAL );
+  *message = batch->messages[index];
+  return 0;
+}
+
+/**
+ * @brief Encode all messages of a batch.
+ * Encode the messages into a buffer using running status coding.
+ * Consecutive channel messages with the same status byte are written
+ * without repeating it.
+ * @public @memberof MIDIMessageBatch
+ * @param batch   The batch.
+ * @param status  A pointer to the running status. Start with zero to
+ *                write the first status byte.
+ * @param size    The size of the memory pointed to by @c buffer.
+ * @param buffer  The buffer to encode the messages into.
+ * @param written The number of bytes that were actually written.
+ * @retval 0 on success.
+ * @retval 1 if the messages could not be encoded.
+ */
+int MIDIMessageBatchEncode( struct MIDIMessageBatch * batch, MIDIRunningStatus * status,
+                            size_t size, unsigned char * buffer, size_t * written ) {
+  struct MIDIMessage * message;
+  size_t i, p = 0, w = 0;
+  int result = 0;
+
+  MIDIPrecond( batch != NULL, EFAULT );
+  MIDIPrecond( status != NULL, EINVAL );
+  MIDIPrecond( size > 0 && buffer != NULL, EINVAL );
+
+  for( i=0; i<batch->length && result == 0; i++ ) {
+    message = batch->messages[i];
+    result = MIDIMessageFormatEncodeRunningStatus( message->format, &(message->data), status, size-p, buffer+p, &w );
+    if( result == 0 ) p += w;
+  }
+  if( written != NULL ) *written = p;
+  return result;
+}
+
+/**
+ * @brief Find the next message with a given status.
+ * Search the batch for a message with the given status, starting at
+ * @c index. Channel message statuses (like @ref MIDI_STATUS_NOTE_ON)
+ * match any channel, a status of zero matches every message.
+ * On success, @c index is advanced past the found message so that
+ * the batch can be iterated with:
+ * @code
+ * size_t i = 0;
+ * while( MIDIMessageBatchNext( batch, MIDI_STATUS_NOTE_ON, &i, &message ) == 0 ) { ... }
+ * @endcode
+ * @public @memberof MIDIMessageBatch
+ * @param batch   The batch.
+ * @param status  The status to look for.
+ * @param index   The index to start at.
+ * @param message The found message.
+ * @retval 0 if a message was found.
+ * @retval 1 if there are no more matching messages.
+ */
+int MIDIMessageBatchNext( struct MIDIMessageBatch * batch, MIDIStatus status,
+                          size_t * index, struct MIDIMessage ** message ) {
+  size_t i;
+  unsigned char b;
+  MIDIPrecond( batch != NULL, EFAULT );
+  MIDIPrecond( index != NULL && message != NULL, EINVAL );
+  for( i=*index; i<batch->length; i++ ) {
+    b = batch->messages[i]->data.bytes[0];
+    if( status == 0 || b == status || ( b < 0xf0 && MIDI_HIGH_NIBBLE(b) == status ) ) {
+      *message = batch->messages[i];
+      *index   = i + 1;
+      return 0;
+    }
+  }
+  *index = batch->length;
+  return 1;
+}
+
+/**
+ * @brief Get the next note on or note off message.
+ * Find the next note message, starting at @c index, and decode its
+ * fields. The @c status is either @ref MIDI_STATUS_NOTE_ON or
+ * @ref MIDI_STATUS_NOTE_OFF, note on messages with zero velocity are
+ * passed unchanged.
+ * @see MIDIMessageBatchNext
+ * @public @memberof MIDIMessageBatch
+ * @param batch    The batch.
+ * @param index    The index to start at.
+ * @param status   The status of the found message.
+ * @param channel  The channel.
+ * @param key      The key.
+ * @param velocity The velocity.
+ * @retval 0 if a message was found.
+ * @retval 1 if there are no more note messages.
+ */
+int MIDIMessageBatchNextNote( struct MIDIMessageBatch * batch, size_t * index, MIDIStatus * status,
+                              MIDIChannel * channel, MIDIKey * key, MIDIVelocity * velocity ) {
+  size_t i;
+  unsigned char * m;
+  MIDIPrecond( batch != NULL, EFAULT );
+  MIDIPrecond( index != NULL, EINVAL );
+  for( i=*index; i<batch->length; i++ ) {
+    m = &(batch->messages[i]->data.bytes[0]);
+    if( MIDI_HIGH_NIBBLE(m[0]) == MIDI_STATUS_NOTE_ON || MIDI_HIGH_NIBBLE(m[0]) == MIDI_STATUS_NOTE_OFF ) {
+      if( status   != NULL ) *status   = MIDI_HIGH_NIBBLE(m[0]);
+      if( channel  != NULL ) *channel  = MIDI_LOW_NIBBLE(m[0]);
+      if( key      != NULL ) *key      = m[1];
+      if( velocity != NULL ) *velocity = m[2];
+      *index = i + 1;
+      return 0;
+    }
+  }
+  *index = batch->length;
+  return 1;
+}
+
+/**
+ * @brief Get the next control change message.
+ * Find the next control change message, starting at @c index, and
+ * decode its fields.
+ * @see MIDIMessageBatchNext
+ * @public @memberof MIDIMessageBatch
+ * @param batch   The batch.
+ * @param index   The index to start at.
+ * @param channel The channel.
+ * @param control The control number.
+ * @param value   The control value.
+ * @retval 0 if a message was found.
+ * @retval 1 if there are no more control change messages.
+ */
+int MIDIMessageBatchNextControlChange( struct MIDIMessageBatch * batch, size_t * index,
+                                       MIDIChannel * channel, MIDIControl * control, MIDIValue * value ) {
+  size_t i;
+  unsigned char * m;
+  MIDIPrecond( batch != NULL, EFAULT );
+  MIDIPrecond( index != NULL, EINVAL );
+  for( i=*index; i<batch->length; i++ ) {
+    m = &(batch->messages[i]->data.bytes[0]);
+    if( MIDI_HIGH_NIBBLE(m[0]) == MIDI_STATUS_CONTROL_CHANGE ) {
+      if( channel != NULL ) *channel = MIDI_LOW_NIBBLE(m[0]);
+      if( control != NULL ) *control = m[1];
+      if( value   != NULL ) *value   = m[2];
+      *index = i + 1;
+      return 0;
+    }
+  }
+  *index = batch->length;
+  return 1;
+}
+
+/** @} */
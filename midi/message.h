@@ -6,7 +6,10 @@
 #include "type.h"
 
 struct MIDIMessage;
+struct MIDIMessageData;
+struct MIDIMessageBatch;
 extern struct MIDITypeSpec * MIDIMessageType;
+extern struct MIDITypeSpec * MIDIMessageBatchType;
 
 struct MIDIMessageList {
 /*size_t refs;
@@ -27,6 +30,7 @@ int MIDIMessageGetTimestamp( struct MIDIMessage * message, MIDITimestamp * times
 int MIDIMessageGetSize( struct MIDIMessage * message, size_t * size );
 int MIDIMessageSet( struct MIDIMessage * message, MIDIProperty property, size_t size, void * value );
 int MIDIMessageGet( struct MIDIMessage * message, MIDIProperty property, size_t size, void * value );
+int MIDIMessageGetData( struct MIDIMessage * message, struct MIDIMessageData ** data );
 
 int MIDIMessageEncode( struct MIDIMessage * message, size_t size, unsigned char * buffer, size_t * written );
 int MIDIMessageDecode( struct MIDIMessage * message, size_t size, unsigned char * buffer, size_t * read );
@@ -50,4 +54,23 @@ int MIDIMessageListGetLength( struct MIDIMessageList * messages, size_t * length
 int MIDIMessageListEncode( struct MIDIMessageList * messages, size_t size, unsigned char * buffer, size_t * written );
 int MIDIMessageListDecode( struct MIDIMessageList * messages, size_t size, unsigned char * buffer, size_t * read );
 
+struct MIDIMessageBatch * MIDIMessageBatchCreate( size_t capacity );
+void MIDIMessageBatchDestroy( struct MIDIMessageBatch * batch );
+void MIDIMessageBatchRetain( struct MIDIMessageBatch * batch );
+void MIDIMessageBatchRelease( struct MIDIMessageBatch * batch );
+
+int MIDIMessageBatchAppend( struct MIDIMessageBatch * batch, struct MIDIMessage * message );
+int MIDIMessageBatchClear( struct MIDIMessageBatch * batch );
+int MIDIMessageBatchGetLength( struct MIDIMessageBatch * batch, size_t * length );
+int MIDIMessageBatchGetMessage( struct MIDIMessageBatch * batch, size_t index, struct MIDIMessage ** message );
+int MIDIMessageBatchEncode( struct MIDIMessageBatch * batch, MIDIRunningStatus * status,
+                            size_t size, unsigned char * buffer, size_t * written );
+
+int MIDIMessageBatchNext( struct MIDIMessageBatch * batch, MIDIStatus status,
+                          size_t * index, struct MIDIMessage ** message );
+int MIDIMessageBatchNextNote( struct MIDIMessageBatch * batch, size_t * index, MIDIStatus * status,
+                              MIDIChannel * channel, MIDIKey * key, MIDIVelocity * velocity );
+int MIDIMessageBatchNextControlChange( struct MIDIMessageBatch * batch, size_t * index,
+                                       MIDIChannel * channel, MIDIControl * control, MIDIValue * value );
+
 #endif
@@ -3,6 +3,7 @@
 #include "midi.h"
 #include "list.h"
 #include "port.h"
+#include "message.h"
 
 /**
  * @ingroup MIDI
@@ -54,6 +55,12 @@ MIDI_TYPE_SPEC_OBJECT( MIDIPort, 0x3000 );
  * intercepted by an observer.
  * @relates MIDIPort
  */
+/**
+ * @def MIDI_PORT_BATCH
+ * @brief Port mode for ports that can receive MIDIMessageBatch objects.
+ * Ports without this flag receive the messages of a batch one by one.
+ * @relates MIDIPort
+ */
 /**
  * @def MIDI_PORT_INVALID
  * @brief Marker for invalidated ports.
@@ -181,6 +188,25 @@ static int _port_passthrough( struct MIDIPort * port, struct MIDIPort * source,
   return MIDIListApply( port->ports, &params, &_port_apply_send );
 }
 
+/**
+ * @brief Receive the messages of a batch one by one.
+ * This is used for ports that can not handle batches themselves.
+ * @private @memberof MIDIPort
+ * @param port   The target port.
+ * @param source The source port of the batch.
+ * @param batch  The batch.
+ * @retval 0 on success.
+ */
+static int _port_receive_batch( struct MIDIPort * port, struct MIDIPort * source, struct MIDIMessageBatch * batch ) {
+  struct MIDIMessage * message;
+  size_t i = 0;
+  int result = 0;
+  while( MIDIMessageBatchNext( batch, 0, &i, &message ) == 0 ) {
+    result += MIDIPortReceiveFrom( port, source, MIDIMessageType, message );
+  }
+  return result;
+}
+
 /**
  * @}
  * @endcond
@@ -388,6 +414,41 @@ int MIDIPortGetObserver( struct MIDIPort * port, void ** target, MIDIPortInterce
   return 0;
 }
 
+/**
+ * @brief Set the communication mode of a port.
+ * This can be used to enable or disable receiving batches after the
+ * port was created.
+ * @public @memberof MIDIPort
+ * @param port The port.
+ * @param mode The communication mode flags.
+ * @retval 0 on success.
+ */
+int MIDIPortSetMode( struct MIDIPort * port, int mode ) {
+  MIDIPrecond( port != NULL, EFAULT );
+  MIDIPrecond( !( port->mode & MIDI_PORT_INVALID ), EPERM );
+  MIDIPrecond( !( mode & MIDI_PORT_INVALID ), EINVAL );
+  if( mode & MIDI_PORT_IN ) {
+    MIDIPrecond( port->target != NULL, EINVAL );
+    MIDIPrecond( port->receive != NULL, EINVAL );
+  }
+  port->mode = mode;
+  return 0;
+}
+
+/**
+ * @brief Get the communication mode of a port.
+ * @public @memberof MIDIPort
+ * @param port The port.
+ * @param mode The communication mode flags.
+ * @retval 0 on success.
+ */
+int MIDIPortGetMode( struct MIDIPort * port, int * mode ) {
+  MIDIPrecond( port != NULL, EFAULT );
+  MIDIPrecond( mode != NULL, EINVAL );
+  *mode = port->mode;
+  return 0;
+}
+
 /**
  * @brief Simulate an incoming message that was sent by another port.
  * @public @memberof MIDIPort
@@ -409,6 +470,9 @@ int MIDIPortReceiveFrom( struct MIDIPort * port, struct MIDIPort * source, struc
     MIDIAssert( port->target  != NULL );
     MIDIAssert( port->receive != NULL );
 
+    if( type == MIDIMessageBatchType && !( port->mode & MIDI_PORT_BATCH ) ) {
+      return _port_receive_batch( port, source, object );
+    }
     _port_intercept( port, MIDI_PORT_IN, type, object );
     if( source != NULL ) {
       result = (*port->receive)( port->target, source->target, type, object );
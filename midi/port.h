@@ -6,6 +6,7 @@
 #define MIDI_PORT_OUT     0x02
 #define MIDI_PORT_THRU    0x04
 #define MIDI_PORT_INVALID 0x08
+#define MIDI_PORT_BATCH   0x10
 
 struct MIDIPort;
 extern struct MIDITypeSpec * MIDIPortType;
@@ -27,6 +28,8 @@ int MIDIPortInvalidate( struct MIDIPort * port );
 
 int MIDIPortSetObserver( struct MIDIPort * port, void * target, MIDIPortInterceptFn * intercept );
 int MIDIPortGetObserver( struct MIDIPort * port, void ** target, MIDIPortInterceptFn ** intercept );
+int MIDIPortSetMode( struct MIDIPort * port, int mode );
+int MIDIPortGetMode( struct MIDIPort * port, int * mode );
 
 int MIDIPortReceiveFrom( struct MIDIPort * port, struct MIDIPort * source, struct MIDITypeSpec * type, void * object );
 int MIDIPortReceive( struct MIDIPort * port, struct MIDITypeSpec * type, void * object );
@@ -1,5 +1,11 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
 #include <stdlib.h>
+#include <sched.h>
+#include <sys/mman.h>
 #include <sys/select.h>
+#include <sys/socket.h>
 #include <sys/time.h>
 #include <time.h>
 #include "runloop.h"
@@ -18,6 +24,8 @@ struct MIDIRunloopSource {
   fd_set writefds;
   struct timespec timeout_start;
   struct timespec timeout_time;
+  struct timespec busy_time;
+  struct MIDIRunloopSourceStats stats;
   struct MIDIRunloopSourceDelegate delegate;
   struct MIDIRunloop * runloop;
 };
@@ -25,6 +33,10 @@ struct MIDIRunloopSource {
 struct MIDIRunloop {
   int    refs;
   int    active;
+  int    busy_poll_usec;
+  int    realtime_flags;
+  int    realtime_priority;
+  int    realtime_cpu;
   struct MIDIRunloopDelegate delegate;
   struct MIDIRunloopSource   master;
   struct MIDIRunloopSource * sources[MAX_RUNLOOP_SOURCES];
@@ -116,7 +128,7 @@ static int _timespec_cmp( struct timespec * lhs, struct timespec * rhs ) {
 static void _timespec_add( struct timespec * lhs, struct timespec * rhs ) {
   lhs->tv_sec  += rhs->tv_sec;
   lhs->tv_nsec += rhs->tv_nsec;
-  while( lhs->tv_nsec > 1000000000 ) {
+  while( lhs->tv_nsec >= 1000000000 ) {
     lhs->tv_sec  += 1;
     lhs->tv_nsec -= 1000000000;
   }
@@ -148,11 +160,59 @@ static void _timespec_now( struct timespec * ts ) {
   ts->tv_nsec = tv.tv_usec * 1000;
 }
 
+static void _timespec_monotonic( struct timespec * ts ) {
+#ifdef CLOCK_MONOTONIC
+  clock_gettime( CLOCK_MONOTONIC, ts );
+#else
+  _timespec_now( ts );
+#endif
+}
+
+static void _timespec_elapsed( struct timespec * ts, struct timespec * start ) {
+  _timespec_monotonic( ts );
+  ts->tv_sec  -= start->tv_sec;
+  ts->tv_nsec -= start->tv_nsec;
+  if( ts->tv_nsec < 0 ) {
+    ts->tv_sec  -= 1;
+    ts->tv_nsec += 1000000000;
+  }
+}
+
 static void _timeval_from_timespec( struct timeval * tv, struct timespec * ts ) {
   tv->tv_sec  = ts->tv_sec;
   tv->tv_usec = ts->tv_nsec / 1000;
 }
 
+static void _runloop_callback_stats_zero( struct MIDIRunloopCallbackStats * stats ) {
+  stats->count = 0;
+  _timespec_zero( &(stats->total) );
+  _timespec_zero( &(stats->max) );
+}
+
+static void _runloop_source_stats_zero( struct MIDIRunloopSourceStats * stats ) {
+  _runloop_callback_stats_zero( &(stats->read) );
+  _runloop_callback_stats_zero( &(stats->write) );
+  _runloop_callback_stats_zero( &(stats->timeout) );
+  stats->wait_count = 0;
+  _timespec_zero( &(stats->blocked) );
+}
+
+/**
+ * @brief Account for a finished callback.
+ * @private @memberof MIDIRunloopSource
+ * @param stats The statistics of the callback.
+ * @param start The monotonic time at which the callback was invoked.
+ */
+static void _runloop_callback_stats_update( struct MIDIRunloopCallbackStats * stats, struct timespec * start ) {
+  struct timespec elapsed;
+  _timespec_elapsed( &elapsed, start );
+  stats->count++;
+  _timespec_add( &(stats->total), &elapsed );
+  if( _timespec_cmp( &elapsed, &(stats->max) ) > 0 ) {
+    _timespec_cpy( &(stats->max), &elapsed );
+  }
+}
+
 struct MIDIRunloopSource * MIDIRunloopSourceCreate( struct MIDIRunloopSourceDelegate * delegate ) {
   struct MIDIRunloopSource * source = malloc( sizeof( struct MIDIRunloopSource ) );
   if( source == NULL ) return NULL;
@@ -165,6 +225,8 @@ struct MIDIRunloopSource * MIDIRunloopSourceCreate( struct MIDIRunloopSourceDele
 
   _timespec_zero( &(source->timeout_start) );
   _timespec_zero( &(source->timeout_time) );
+  _timespec_zero( &(source->busy_time) );
+  _runloop_source_stats_zero( &(source->stats) );
 
   if( delegate != NULL ) {
     source->delegate.info    = delegate->info;
@@ -220,6 +282,36 @@ int MIDIRunloopSourceInvalidate( struct MIDIRunloopSource * source ) {
   }
 }
 
+/**
+ * @brief Get a snapshot of the runloop source's statistics.
+ * For each callback the number of invocations, the total and the maximum
+ * time spent in the callback is recorded. Additionally the time the
+ * source spent blocked in MIDIRunloopSourceWait is tracked.
+ * All times are measured with a monotonic clock.
+ * @public @memberof MIDIRunloopSource
+ * @param source The runloop source.
+ * @param stats  The statistics structure to copy the values to.
+ * @retval 0 on success.
+ */
+int MIDIRunloopSourceGetStats( struct MIDIRunloopSource * source, struct MIDIRunloopSourceStats * stats ) {
+  MIDIPrecond( source != NULL, EFAULT );
+  MIDIPrecond( stats != NULL, EINVAL );
+  *stats = source->stats;
+  return 0;
+}
+
+/**
+ * @brief Reset the statistics of a runloop source.
+ * @public @memberof MIDIRunloopSource
+ * @param source The runloop source.
+ * @retval 0 on success.
+ */
+int MIDIRunloopSourceResetStats( struct MIDIRunloopSource * source ) {
+  MIDIPrecond( source != NULL, EFAULT );
+  _runloop_source_stats_zero( &(source->stats) );
+  return 0;
+}
+
 /**
  * @brief Start a new timeout.
  * @private @memberof MIDIRunloopSource
@@ -269,10 +361,15 @@ static int _runloop_source_timeout_check( struct MIDIRunloopSource * source, str
  * @param now    Must be set to the current time.
  */
 static int _runloop_source_timeout( struct MIDIRunloopSource * source, struct timespec * now ) {
+  int result;
+  struct timespec start;
   if( source->delegate.info == NULL || source->delegate.timeout == NULL ) return 0;
   MIDIPrecond( source->delegate.info != NULL, EINVAL );
   _runloop_source_timeout_start( source, now );
-  return (source->delegate.timeout)( source->delegate.info, now );
+  _timespec_monotonic( &start );
+  result = (source->delegate.timeout)( source->delegate.info, now );
+  _runloop_callback_stats_update( &(source->stats.timeout), &start );
+  return result;
 }
 
 /**
@@ -283,10 +380,15 @@ static int _runloop_source_timeout( struct MIDIRunloopSource * source, struct ti
  * @param fds    The fd_set from which to read.
  */
 static int _runloop_source_read( struct MIDIRunloopSource * source, struct timespec * now, fd_set * fds ) {
+  int result;
+  struct timespec start;
   if( source->delegate.info == NULL || source->delegate.read == NULL ) return 0;
   if( _fds_check( fds, source->nfds ) ) {
     _runloop_source_timeout_start( source, now );
-    return (source->delegate.read)( source->delegate.info, source->nfds, fds );
+    _timespec_monotonic( &start );
+    result = (source->delegate.read)( source->delegate.info, source->nfds, fds );
+    _runloop_callback_stats_update( &(source->stats.read), &start );
+    return result;
   } else {
     return 0;
   }
@@ -300,30 +402,93 @@ static int _runloop_source_read( struct MIDIRunloopSource * source, struct times
  * @param fds    The fd_set to which to write.
  */
 static int _runloop_source_write( struct MIDIRunloopSource * source, struct timespec * now, fd_set * fds ) {
+  int result;
+  struct timespec start;
   if( source->delegate.info == NULL || source->delegate.write == NULL ) return 0;
   if( _fds_check( fds, source->nfds ) ) {
     _fds_sub( &(source->writefds), fds, source->nfds );
     _runloop_source_timeout_start( source, now );
-    return (source->delegate.write)( source->delegate.info, source->nfds, fds );
+    _timespec_monotonic( &start );
+    result = (source->delegate.write)( source->delegate.info, source->nfds, fds );
+    _runloop_callback_stats_update( &(source->stats.write), &start );
+    return result;
   }
   return 0;
 }
 
+/**
+ * @brief Poll the runloop source without blocking.
+ * Repeatedly check the file descriptors with a zero timeout until one of
+ * them becomes ready, the scheduled timeout expires or the busy-poll window
+ * of the source is over.
+ * @private @memberof MIDIRunloopSource
+ * @param source   The runloop source.
+ * @param now      Must be set to the current time. Will be updated.
+ * @param readfds  Will be set to the descriptors ready for reading.
+ * @param writefds Will be set to the descriptors ready for writing.
+ * @return the result of the last select call
+ */
+static int _runloop_source_spin( struct MIDIRunloopSource * source, struct timespec * now,
+                                 fd_set * readfds, fd_set * writefds ) {
+  int result = 0;
+  struct timespec end;
+  struct timeval  zero_tv;
+
+  _timespec_cpy( &end, now );
+  _timespec_add( &end, &(source->busy_time) );
+  do {
+    if( source->nfds > 0 ) {
+      _fds_cpy( readfds, &(source->readfds), source->nfds );
+      _fds_cpy( writefds, &(source->writefds), source->nfds );
+      zero_tv.tv_sec  = 0;
+      zero_tv.tv_usec = 0;
+      result = select( source->nfds, readfds, writefds, NULL, &zero_tv );
+    }
+    _timespec_now( now );
+    if( result != 0 || _runloop_source_timeout_check( source, now ) ) {
+      break;
+    }
+  } while( _timespec_cmp( now, &end ) < 0 );
+  return result;
+}
+
+/**
+ * @brief Account for time spent blocked in select or nanosleep.
+ * @private @memberof MIDIRunloopSource
+ * @param source The runloop source.
+ * @param start  The monotonic time at which the source started waiting.
+ */
+static void _runloop_source_blocked( struct MIDIRunloopSource * source, struct timespec * start ) {
+  struct timespec elapsed;
+  _timespec_elapsed( &elapsed, start );
+  source->stats.wait_count++;
+  _timespec_add( &(source->stats.blocked), &elapsed );
+}
+
 /**
  * @brief Wait until any callback of the runloop source is triggered.
  * If no callbacks are scheduled return immediately.
+ * If a busy-poll window is set, spin for at most that long before
+ * blocking in select or nanosleep.
  * @public @memberof MIDIRunloopSource
  * @param source The runloop source.
  */
 int MIDIRunloopSourceWait( struct MIDIRunloopSource * source ) {
   int result = 0;
-  struct timespec now, remain;
+  struct timespec now, remain, start;
   struct timeval  remain_tv = { 0, 0 };
   fd_set readfds;
   fd_set writefds;
 
   /*printf( "RunloopSourceWait\n" );*/
   _timespec_now( &now );
+  if( ! _timespec_empty( &(source->busy_time) )
+   && ( source->nfds > 0 || ! _timespec_empty( &(source->timeout_time) ) ) ) {
+    if( _runloop_source_spin( source, &now, &readfds, &writefds ) > 0 ) {
+      return _runloop_source_read( source, &now, &readfds )
+           + _runloop_source_write( source, &now, &writefds );
+    }
+  }
   if( _runloop_source_timeout_check( source, &now ) ) {
     /* timed out before check */
     /*printf( "- timeout(sec:%li,nsec:%li)\n", source->timeout_time.tv_sec, source->timeout_time.tv_nsec );*/
@@ -336,7 +501,9 @@ int MIDIRunloopSourceWait( struct MIDIRunloopSource * source ) {
     _fds_cpy( &writefds, &(source->writefds), source->nfds );
 
     /*printf( "- select(nfds:%i)\n", source->nfds );*/
+    _timespec_monotonic( &start );
     result = select( source->nfds, &readfds, &writefds, NULL, &remain_tv );
+    _runloop_source_blocked( source, &start );
     _timespec_now( &now );
     if( result > 0 ) {
       /*printf( "- read/write\n" );*/
@@ -350,7 +517,9 @@ int MIDIRunloopSourceWait( struct MIDIRunloopSource * source ) {
     /* nanosleep */
     /*printf( "- sleep\n" );*/
     _runloop_source_timeout_remain( source, &remain, &now );
+    _timespec_monotonic( &start );
     result = nanosleep( &remain, NULL );
+    _runloop_source_blocked( source, &start );
     _timespec_now( &now );
     /*printf( "- timeout\n" );*/
     return _runloop_source_timeout( source, &now );
@@ -546,6 +715,42 @@ static int _runloop_master_write( void * rl, int nfds, fd_set * writefds ) {
   return result;
 }
 
+/**
+ * @brief Schedule the master timeout for the earliest source deadline.
+ * Sources may reschedule their timeouts with varying intervals from
+ * their callbacks. Recompute the master timeout from the remaining
+ * time of each source so that it does not stick to the shortest
+ * interval ever scheduled.
+ * @private @memberof MIDIRunloop
+ * @param runloop The runloop.
+ * @param now     Must be set to the current time.
+ */
+static void _runloop_master_reschedule( struct MIDIRunloop * runloop, struct timespec * now ) {
+  int i, found = 0;
+  struct MIDIRunloopSource * source;
+  struct timespec deadline, earliest;
+
+  for( i=0; i<MAX_RUNLOOP_SOURCES; i++ ) {
+    source = runloop->sources[i];
+    if( source == NULL || _timespec_empty( &(source->timeout_time) ) ) continue;
+    _timespec_cpy( &deadline, &(source->timeout_start) );
+    _timespec_add( &deadline, &(source->timeout_time) );
+    if( ! found || _timespec_cmp( &deadline, &earliest ) < 0 ) {
+      _timespec_cpy( &earliest, &deadline );
+      found = 1;
+    }
+  }
+  if( ! found ) return;
+  _timespec_cpy( &(runloop->master.timeout_start), now );
+  if( _timespec_cmp( &earliest, now ) > 0 ) {
+    _timespec_sub( &earliest, now );
+    _timespec_cpy( &(runloop->master.timeout_time), &earliest );
+  } else {
+    _timespec_zero( &(runloop->master.timeout_time) );
+    runloop->master.timeout_time.tv_nsec = 1;
+  }
+}
+
 static int _runloop_master_timeout( void * rl, struct timespec * ts ) {
   int i, result = 0;
   struct MIDIRunloop * runloop = rl;
@@ -572,6 +777,7 @@ static int _runloop_master_timeout( void * rl, struct timespec * ts ) {
       runloop->master.delegate.write = &_runloop_master_write;
     }
   }
+  _runloop_master_reschedule( runloop, &now );
   return result;
 }
 
@@ -582,11 +788,17 @@ struct MIDIRunloop * MIDIRunloopCreate( struct MIDIRunloopDelegate * delegate )
 
   runloop->refs   = 1;
   runloop->active = 0;
+  runloop->busy_poll_usec    = 0;
+  runloop->realtime_flags    = 0;
+  runloop->realtime_priority = 0;
+  runloop->realtime_cpu      = -1;
   runloop->master.nfds = 0;
   FD_ZERO( &(runloop->master.readfds) );
   FD_ZERO( &(runloop->master.writefds) );
   _timespec_now( &(runloop->master.timeout_start) );
   _timespec_zero( &(runloop->master.timeout_time) );
+  _timespec_zero( &(runloop->master.busy_time) );
+  _runloop_source_stats_zero( &(runloop->master.stats) );
   runloop->master.delegate.read    = NULL;
   runloop->master.delegate.write   = NULL;
   runloop->master.delegate.timeout = NULL;
@@ -638,6 +850,26 @@ void MIDIRunloopRelease( struct MIDIRunloop * runloop ) {
   }
 }
 
+/**
+ * @brief Enable busy polling on a socket.
+ * Set the @c SO_BUSY_POLL socket option on the given file descriptor if
+ * the runloop was configured to do so and the platform supports it.
+ * Descriptors that are no sockets are silently ignored.
+ * @private @memberof MIDIRunloop
+ * @param runloop The runloop.
+ * @param fd      The file descriptor.
+ */
+static void _runloop_busy_poll_fd( struct MIDIRunloop * runloop, int fd ) {
+#ifdef SO_BUSY_POLL
+  int usec = runloop->busy_poll_usec;
+  if( usec > 0 ) {
+    if( setsockopt( fd, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec) ) != 0 ) {
+      MIDILog( DEBUG, "Could not enable busy polling on fd %i.\n", fd );
+    }
+  }
+#endif
+}
+
 static int _runloop_schedule_read( struct MIDIRunloop * runloop, int fd ) {
   MIDIAssert( runloop != NULL );
   
@@ -645,6 +877,7 @@ static int _runloop_schedule_read( struct MIDIRunloop * runloop, int fd ) {
     runloop->master.nfds = fd + 1;
   }
   FD_SET( fd, &(runloop->master.readfds) );
+  _runloop_busy_poll_fd( runloop, fd );
   runloop->master.delegate.read = &_runloop_master_read;
 
   if( runloop->delegate.info != NULL && runloop->delegate.schedule_read != NULL ) {
@@ -744,6 +977,7 @@ static int _runloop_schedule_timeout( struct MIDIRunloop * runloop, struct times
 }
 
 static int _runloop_update_from_source( struct MIDIRunloop * runloop, struct MIDIRunloopSource * source ) {
+  int fd;
   if( ! _timespec_empty( &(source->timeout_time) ) ) {
     if( (  _timespec_cmp( &(source->timeout_time), &(runloop->master.timeout_time) ) < 0 )
         || _timespec_empty( &(runloop->master.timeout_time) ) ) {
@@ -759,6 +993,11 @@ static int _runloop_update_from_source( struct MIDIRunloop * runloop, struct MID
   if( source->nfds > 0 ) {
     _fds_add( &(runloop->master.readfds), &(source->readfds), source->nfds );
     _fds_add( &(runloop->master.writefds), &(source->writefds), source->nfds );
+    for( fd=0; fd<source->nfds; fd++ ) {
+      if( FD_ISSET( fd, &(source->readfds) ) ) {
+        _runloop_busy_poll_fd( runloop, fd );
+      }
+    }
     if( source->nfds > runloop->master.nfds ) {
       runloop->master.nfds = source->nfds;
     }
@@ -806,12 +1045,178 @@ int MIDIRunloopRemoveSource( struct MIDIRunloop * runloop, struct MIDIRunloopSou
   return 1;
 }
 
+/**
+ * @brief Get a snapshot of the runloop's own statistics.
+ * The runloop dispatches to its sources through one master source. Its
+ * callback times include the time spent in all source callbacks and its
+ * blocked time is the time the whole runloop spent waiting for events.
+ * Use MIDIRunloopSourceGetStats to find out how the time is distributed
+ * among the sources.
+ * @public @memberof MIDIRunloop
+ * @param runloop The runloop.
+ * @param stats   The statistics structure to copy the values to.
+ * @retval 0 on success.
+ */
+int MIDIRunloopGetStats( struct MIDIRunloop * runloop, struct MIDIRunloopSourceStats * stats ) {
+  MIDIPrecond( runloop != NULL, EFAULT );
+  return MIDIRunloopSourceGetStats( &(runloop->master), stats );
+}
+
+/**
+ * @brief Reset the statistics of the runloop and all its sources.
+ * @public @memberof MIDIRunloop
+ * @param runloop The runloop.
+ * @retval 0 on success.
+ */
+int MIDIRunloopResetStats( struct MIDIRunloop * runloop ) {
+  int i;
+  MIDIPrecond( runloop != NULL, EFAULT );
+  _runloop_source_stats_zero( &(runloop->master.stats) );
+  for( i=0; i<MAX_RUNLOOP_SOURCES; i++ ) {
+    if( runloop->sources[i] != NULL ) {
+      _runloop_source_stats_zero( &(runloop->sources[i]->stats) );
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Configure the busy-poll mode of the runloop.
+ * Instead of blocking in select right away, each step of the runloop
+ * spins on non-blocking checks of the scheduled file descriptors and
+ * timeouts for the given window. This trades CPU time for wake-up
+ * latency. A zero window (or @c NULL) disables busy polling.
+ * If @c socket_usec is greater than zero, the @c SO_BUSY_POLL option
+ * is set to that value on every socket scheduled for reading, where
+ * supported.
+ * @public @memberof MIDIRunloop
+ * @param runloop     The runloop.
+ * @param window      The time to spin before blocking.
+ * @param socket_usec The value for @c SO_BUSY_POLL in microseconds.
+ * @retval 0 on success.
+ */
+int MIDIRunloopSetBusyPoll( struct MIDIRunloop * runloop, struct timespec * window, int socket_usec ) {
+  int fd;
+  MIDIPrecond( runloop != NULL, EFAULT );
+  MIDIPrecond( socket_usec >= 0, EINVAL );
+  if( window == NULL ) {
+    _timespec_zero( &(runloop->master.busy_time) );
+  } else {
+    MIDIPrecond( window->tv_sec >= 0 && window->tv_nsec >= 0 && window->tv_nsec < 1000000000, EINVAL );
+    _timespec_cpy( &(runloop->master.busy_time), window );
+  }
+  runloop->busy_poll_usec = socket_usec;
+  for( fd=0; fd<runloop->master.nfds; fd++ ) {
+    if( FD_ISSET( fd, &(runloop->master.readfds) ) ) {
+      _runloop_busy_poll_fd( runloop, fd );
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Get the busy-poll configuration of the runloop.
+ * @public @memberof MIDIRunloop
+ * @param runloop     The runloop.
+ * @param window      The time to spin before blocking.
+ * @param socket_usec The value for @c SO_BUSY_POLL in microseconds.
+ * @retval 0 on success.
+ */
+int MIDIRunloopGetBusyPoll( struct MIDIRunloop * runloop, struct timespec * window, int * socket_usec ) {
+  MIDIPrecond( runloop != NULL, EFAULT );
+  if( window != NULL ) {
+    _timespec_cpy( window, &(runloop->master.busy_time) );
+  }
+  if( socket_usec != NULL ) {
+    *socket_usec = runloop->busy_poll_usec;
+  }
+  return 0;
+}
+
+/**
+ * @brief Request real-time scheduling for the runloop thread.
+ * The settings are applied to the calling thread when MIDIRunloopStart
+ * is called. Each of the flags may fail independently (usually for lack
+ * of privileges), in which case an error is logged and the runloop
+ * runs anyway.
+ * - @c MIDI_RUNLOOP_REALTIME_SCHED: use @c SCHED_FIFO with @c priority
+ * - @c MIDI_RUNLOOP_REALTIME_AFFINITY: pin the thread to CPU @c cpu
+ * - @c MIDI_RUNLOOP_REALTIME_MLOCK: lock all current and future pages
+ * @public @memberof MIDIRunloop
+ * @param runloop  The runloop.
+ * @param flags    Any combination of the flags above, 0 to disable.
+ * @param priority The @c SCHED_FIFO priority.
+ * @param cpu      The CPU to pin the runloop thread to.
+ * @retval 0 on success.
+ */
+int MIDIRunloopSetRealtime( struct MIDIRunloop * runloop, int flags, int priority, int cpu ) {
+  MIDIPrecond( runloop != NULL, EFAULT );
+  MIDIPrecond( ( flags & MIDI_RUNLOOP_REALTIME_AFFINITY ) == 0 || cpu >= 0, EINVAL );
+  runloop->realtime_flags    = flags;
+  runloop->realtime_priority = priority;
+  runloop->realtime_cpu      = cpu;
+  return 0;
+}
+
+/**
+ * @brief Pin the calling thread to a single CPU.
+ * Only supported on Linux, fails everywhere else.
+ * @private @memberof MIDIRunloop
+ * @param cpu The CPU number.
+ * @retval 0 on success.
+ */
+static int _runloop_set_affinity( int cpu ) {
+#ifdef __linux__
+  cpu_set_t cpus;
+  CPU_ZERO( &cpus );
+  CPU_SET( cpu, &cpus );
+  return sched_setaffinity( 0, sizeof(cpus), &cpus );
+#else
+  return 1;
+#endif
+}
+
+/**
+ * @brief Apply the real-time settings to the calling thread.
+ * @private @memberof MIDIRunloop
+ * @param runloop The runloop.
+ * @return the number of settings that could not be applied.
+ */
+static int _runloop_apply_realtime( struct MIDIRunloop * runloop ) {
+  int failed = 0;
+  struct sched_param param;
+
+  if( runloop->realtime_flags & MIDI_RUNLOOP_REALTIME_SCHED ) {
+    param.sched_priority = runloop->realtime_priority;
+    if( sched_setscheduler( 0, SCHED_FIFO, &param ) != 0 ) {
+      MIDILog( ERROR, "Could not set SCHED_FIFO priority %i.\n", runloop->realtime_priority );
+      failed++;
+    }
+  }
+  if( runloop->realtime_flags & MIDI_RUNLOOP_REALTIME_AFFINITY ) {
+    if( _runloop_set_affinity( runloop->realtime_cpu ) != 0 ) {
+      MIDILog( ERROR, "Could not pin runloop to CPU %i.\n", runloop->realtime_cpu );
+      failed++;
+    }
+  }
+  if( runloop->realtime_flags & MIDI_RUNLOOP_REALTIME_MLOCK ) {
+    if( mlockall( MCL_CURRENT | MCL_FUTURE ) != 0 ) {
+      MIDILog( ERROR, "Could not lock runloop memory.\n" );
+      failed++;
+    }
+  }
+  return failed;
+}
+
 int MIDIRunloopStep( struct MIDIRunloop * runloop ) {
   return MIDIRunloopSourceWait( &(runloop->master) );
 }
 
 int MIDIRunloopStart( struct MIDIRunloop * runloop ) {
   int result = 0;
+  if( runloop->realtime_flags ) {
+    _runloop_apply_realtime( runloop );
+  }
   runloop->active = 1;
   do {
     result = MIDIRunloopStep( runloop );
@@ -7,9 +7,27 @@
 #define MIDI_RUNLOOP_IDLE       4
 #define MIDI_RUNLOOP_INVALIDATE 8
 
+#define MIDI_RUNLOOP_REALTIME_SCHED    1
+#define MIDI_RUNLOOP_REALTIME_AFFINITY 2
+#define MIDI_RUNLOOP_REALTIME_MLOCK    4
+
 struct MIDIRunloopSource;
 struct MIDIRunloop;
 
+struct MIDIRunloopCallbackStats {
+  unsigned long   count;
+  struct timespec total;
+  struct timespec max;
+};
+
+struct MIDIRunloopSourceStats {
+  struct MIDIRunloopCallbackStats read;
+  struct MIDIRunloopCallbackStats write;
+  struct MIDIRunloopCallbackStats timeout;
+  unsigned long   wait_count;
+  struct timespec blocked;
+};
+
 struct MIDIRunloopSourceDelegate {
   void *info;
   int (*read)( void * info, int nfds, fd_set * readfds );
@@ -34,6 +52,8 @@ void MIDIRunloopSourceRelease( struct MIDIRunloopSource * source );
 
 int MIDIRunloopSourceInvalidate( struct MIDIRunloopSource * source );
 int MIDIRunloopSourceWait( struct MIDIRunloopSource * source );
+int MIDIRunloopSourceGetStats( struct MIDIRunloopSource * source, struct MIDIRunloopSourceStats * stats );
+int MIDIRunloopSourceResetStats( struct MIDIRunloopSource * source );
 
 int MIDIRunloopSourceScheduleRead( struct MIDIRunloopSource * source, int fd );
 int MIDIRunloopSourceClearRead( struct MIDIRunloopSource * source, int fd );
@@ -50,6 +70,13 @@ void MIDIRunloopRelease( struct MIDIRunloop * runloop );
 int MIDIRunloopAddSource( struct MIDIRunloop * runloop, struct MIDIRunloopSource * source );
 int MIDIRunloopRemoveSource( struct MIDIRunloop * runloop, struct MIDIRunloopSource * source );
 
+int MIDIRunloopGetStats( struct MIDIRunloop * runloop, struct MIDIRunloopSourceStats * stats );
+int MIDIRunloopResetStats( struct MIDIRunloop * runloop );
+
+int MIDIRunloopSetBusyPoll( struct MIDIRunloop * runloop, struct timespec * window, int socket_usec );
+int MIDIRunloopGetBusyPoll( struct MIDIRunloop * runloop, struct timespec * window, int * socket_usec );
+int MIDIRunloopSetRealtime( struct MIDIRunloop * runloop, int flags, int priority, int cpu );
+
 int MIDIRunloopStart( struct MIDIRunloop * runloop );
 int MIDIRunloopStop( struct MIDIRunloop * runloop );
 int MIDIRunloopStep( struct MIDIRunloop * runloop );
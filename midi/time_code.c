@@ -0,0 +1,758 @@
+#include <stdlib.h>
+#include "time_code.h"
+#include "clock.h"
+#include "device.h"
+#include "message.h"
+#include "runloop.h"
+#include "util.h"
+
+#define MIDI_TIME_CODE_FRAMES_PER_10_MINUTES_DF 17982
+#define MIDI_TIME_CODE_FRAMES_PER_MINUTE_DF      1798
+
+/**
+ * @brief Number of quarter frames after which the period filter settles.
+ */
+#define MIDI_TIME_CODE_FILTER 16
+
+/**
+ * @ingroup MIDI
+ * @struct MIDITimeCode time_code.h
+ * @brief Receive and generate MIDI time code.
+ * The receiver collects the eight quarter frame messages that make up
+ * a full SMPTE position. It detects the direction of playback from the
+ * order of the pieces and restarts collecting when a piece is missing.
+ * Every completed position (one per two frames) is reported to the
+ * delegate with the predicted timestamp at which the next frame starts.
+ * Between full positions, positions and frame timestamps are predicted
+ * from the filtered quarter frame period.
+ * The receiver follows the rate encoded in the received time code, it
+ * does not change the rate of the generator.
+ * The generator sends quarter frames at absolute deadlines computed
+ * from the start time, timestamped with their deadline and up to a
+ * configurable lookahead before they are due.
+ */
+struct MIDITimeCode {
+/**
+ * @privatesection
+ * @cond INTERNALS
+ */
+  int    refs;
+  struct MIDITimeCodeDelegate * delegate;
+  struct MIDIClock * clock;
+  int    rate; /**< Rate of the generator */
+  struct {
+    int           rate;      /**< Rate of the received time code */
+    double        nominal;   /**< Nominal quarter frame period at the received rate */
+    int           locked;    /**< Whether anchor refers to a received position */
+    int           direction; /**< Direction of the current sequence or 0 */
+    int           playback;  /**< Direction at the anchor */
+    int           last_type; /**< Type of the last quarter frame or -1 */
+    unsigned int  mask;      /**< Pieces received in the current sequence */
+    MIDIValue     piece[8];
+    MIDITimestamp last;      /**< Timestamp of the last quarter frame */
+    double        period;    /**< Filtered quarter frame period */
+    long          frame;     /**< Frame number of the anchor */
+    MIDITimestamp anchor;    /**< Predicted start of the anchor frame */
+  } receiver;
+  struct {
+    struct MIDIUtilSchedule schedule; /**< Deadlines of the quarter frames */
+    struct MIDIDevice * device; /**< Device to send on (not retained) */
+    long          frame;        /**< Frame at which the generator started */
+  } generator;
+/** @endcond */
+};
+
+/* MARK: Internals *//**
+ * @name Internals
+ * @cond INTERNALS
+ * @{
+ */
+
+/**
+ * @brief Get the nominal number of frames per second.
+ * @private @memberof MIDITimeCode
+ * @param rate The time code rate.
+ * @return the number of frames in one (time code) second.
+ */
+static int _fps( int rate ) {
+  static const int fps[4] = { 24, 25, 30, 30 };
+  return fps[rate & 3];
+}
+
+/**
+ * @brief Get the number of frames in 24 hours.
+ * @private @memberof MIDITimeCode
+ * @param rate The time code rate.
+ * @return the number of frames in one day.
+ */
+static long _frames_per_day( int rate ) {
+  if( rate == MIDI_TIME_CODE_29_97_FPS ) {
+    return 24L * 6 * MIDI_TIME_CODE_FRAMES_PER_10_MINUTES_DF;
+  } else {
+    return 24L * 3600 * _fps( rate );
+  }
+}
+
+/**
+ * @brief Wrap a frame number into one day.
+ * @private @memberof MIDITimeCode
+ * @param rate  The time code rate.
+ * @param frame The frame number.
+ * @return the frame number in the range [0,frames per day).
+ */
+static long _wrap( int rate, long frame ) {
+  long day = _frames_per_day( rate );
+  frame %= day;
+  return ( frame < 0 ) ? frame + day : frame;
+}
+
+/**
+ * @brief Check if a position is valid at a rate.
+ * @private @memberof MIDITimeCode
+ * @param rate     The time code rate.
+ * @param position The position.
+ * @return non-zero if the position exists at the given rate.
+ */
+static int _valid( int rate, struct MIDITimeCodePosition * position ) {
+  if( position->hours >= 24 || position->minutes >= 60 || position->seconds >= 60 ) return 0;
+  if( position->frames >= _fps( rate ) ) return 0;
+  if( rate == MIDI_TIME_CODE_29_97_FPS && position->seconds == 0
+   && position->frames < 2 && position->minutes % 10 != 0 ) return 0;
+  return 1;
+}
+
+/**
+ * @brief Get the nominal quarter frame period.
+ * @private @memberof MIDITimeCode
+ * @param time_code The time code.
+ * @param rate      The time code rate.
+ * @return the quarter frame period in ticks of the time code's clock.
+ */
+static double _nominal( struct MIDITimeCode * time_code, int rate ) {
+  MIDISamplingRate sampling_rate = 0;
+  MIDIClockGetSamplingRate( time_code->clock, &sampling_rate );
+  if( rate == MIDI_TIME_CODE_29_97_FPS ) {
+    return (double) sampling_rate * 1001.0 / ( 30000.0 * 4 );
+  } else {
+    return (double) sampling_rate / ( _fps( rate ) * 4.0 );
+  }
+}
+
+/**
+ * @brief Update the nominal quarter frame period of the receiver.
+ * @private @memberof MIDITimeCode
+ * @param time_code The time code.
+ */
+static void _receiver_update_nominal( struct MIDITimeCode * time_code ) {
+  time_code->receiver.nominal = _nominal( time_code, time_code->receiver.rate );
+  time_code->receiver.period  = time_code->receiver.nominal;
+}
+
+/**
+ * @brief Get the quarter frame pieces of a frame.
+ * @private @memberof MIDITimeCode
+ * @param rate  The time code rate.
+ * @param frame The frame number.
+ * @param piece The eight 4-bit pieces.
+ */
+static void _encode( int rate, long frame, MIDIValue * piece ) {
+  struct MIDITimeCodePosition p;
+  MIDITimeCodePositionFromFrames( rate, &p, frame );
+  piece[0] = p.frames & 0x0f;
+  piece[1] = ( p.frames >> 4 ) & 0x01;
+  piece[2] = p.seconds & 0x0f;
+  piece[3] = ( p.seconds >> 4 ) & 0x03;
+  piece[4] = p.minutes & 0x0f;
+  piece[5] = ( p.minutes >> 4 ) & 0x03;
+  piece[6] = p.hours & 0x0f;
+  piece[7] = ( ( p.hours >> 4 ) & 0x01 ) | ( ( rate & 3 ) << 1 );
+}
+
+/**
+ * @brief Restart collecting quarter frames.
+ * @private @memberof MIDITimeCode
+ * @param time_code The time code.
+ */
+static void _receiver_reset( struct MIDITimeCode * time_code ) {
+  time_code->receiver.mask      = 0;
+  time_code->receiver.direction = 0;
+}
+
+/**
+ * @brief Assemble a full position from the collected pieces.
+ * The pieces describe the frame in which the first piece of the
+ * sequence was sent. When the last piece arrives, 1.75 frames have
+ * passed since then and the frame after the next starts one quarter
+ * frame later.
+ * @private @memberof MIDITimeCode
+ * @param time_code The time code.
+ * @param timestamp The timestamp of the last piece.
+ * @retval 0 on success.
+ */
+static int _receiver_complete( struct MIDITimeCode * time_code, MIDITimestamp timestamp ) {
+  struct MIDITimeCodePosition p;
+  MIDIValue * piece = &(time_code->receiver.piece[0]);
+  int rate;
+  long frame;
+
+  rate = ( piece[7] >> 1 ) & 3;
+  if( rate != time_code->receiver.rate ) {
+    time_code->receiver.rate = rate;
+    _receiver_update_nominal( time_code );
+  }
+  p.frames  = piece[0] | ( ( piece[1] & 0x01 ) << 4 );
+  p.seconds = piece[2] | ( ( piece[3] & 0x03 ) << 4 );
+  p.minutes = piece[4] | ( ( piece[5] & 0x03 ) << 4 );
+  p.hours   = piece[6] | ( ( piece[7] & 0x01 ) << 4 );
+  if( ! _valid( rate, &p ) ) {
+    MIDILog( DEBUG, "Received invalid time code position.\n" );
+    return 1;
+  }
+  MIDITimeCodePositionToFrames( rate, &p, &frame );
+
+  time_code->receiver.locked   = 1;
+  time_code->receiver.playback = time_code->receiver.direction;
+  time_code->receiver.frame    = _wrap( rate, frame + 2 * time_code->receiver.direction );
+  time_code->receiver.anchor   = timestamp + (MIDITimestamp) ( time_code->receiver.period + 0.5 );
+  time_code->receiver.mask     = 0;
+
+  if( time_code->delegate == NULL || time_code->delegate->recv_position == NULL ) return 0;
+  MIDITimeCodePositionFromFrames( rate, &p, time_code->receiver.frame );
+  return (*time_code->delegate->recv_position)( time_code, &p, time_code->receiver.anchor );
+}
+
+/**
+ * @brief Send all quarter frames that are due before a given time.
+ * @private @memberof MIDITimeCode
+ * @param time_code The time code.
+ * @param limit     Send all quarter frames with a deadline up to this time.
+ * @retval 0 on success.
+ * @retval >0 if a quarter frame could not be sent.
+ */
+static int _generator_send( struct MIDITimeCode * time_code, MIDITimestamp limit ) {
+  struct MIDIUtilSchedule * schedule = &(time_code->generator.schedule);
+  struct MIDIMessage * message;
+  MIDITimestamp deadline;
+  MIDIValue piece[8], type;
+  long cycle = -1;
+  int result = 0;
+
+  for( deadline = MIDIUtilScheduleDeadline( schedule ); deadline <= limit; deadline = MIDIUtilScheduleDeadline( schedule ) ) {
+    type = schedule->tick % 8;
+    if( cycle != schedule->tick / 8 ) {
+      cycle = schedule->tick / 8;
+      _encode( time_code->rate, time_code->generator.frame + 2 * cycle, &(piece[0]) );
+    }
+    message = MIDIMessageCreate( MIDI_STATUS_TIME_CODE_QUARTER_FRAME );
+    if( message == NULL ) return 1;
+    result += MIDIMessageSet( message, MIDI_TIME_CODE_TYPE, sizeof(MIDIValue), &type );
+    result += MIDIMessageSet( message, MIDI_VALUE, sizeof(MIDIValue), &(piece[(unsigned int) type]) );
+    result += MIDIMessageSetTimestamp( message, deadline );
+    if( result == 0 ) {
+      result = MIDIDeviceSend( time_code->generator.device, message );
+    }
+    MIDIMessageRelease( message );
+    if( result ) return result;
+    schedule->tick++;
+  }
+  return 0;
+}
+
+/**
+ * @brief Send due quarter frames from the runloop.
+ * @private @memberof MIDITimeCode
+ * @param info    The time code.
+ * @param elapsed The time elapsed since the timeout was scheduled.
+ * @retval 0 on success.
+ */
+static int _generator_timeout( void * info, struct timespec * elapsed ) {
+  struct MIDITimeCode * time_code = info;
+  MIDITimestamp now;
+  int result;
+  if( ! time_code->generator.schedule.running ) return 0;
+  MIDIClockGetNow( time_code->clock, &now );
+  result  = _generator_send( time_code, now + time_code->generator.schedule.lookahead );
+  result += MIDIUtilScheduleTimeout( &(time_code->generator.schedule), time_code->clock, now );
+  return result;
+}
+
+/**
+ * @}
+ * @endcond
+ */
+
+/* MARK: -
+ * MARK: Creation and destruction *//**
+ * @name Creation and destruction
+ * Creating, destroying and reference counting of MIDITimeCode objects.
+ * @{
+ */
+
+/**
+ * @brief Create a MIDITimeCode instance.
+ * Allocate space and initialize a MIDITimeCode instance.
+ * The time code uses 30 fps and the global clock until changed.
+ * @public @memberof MIDITimeCode
+ * @param delegate The delegate to use for the time code. May be @c NULL.
+ * @return a pointer to the created time code structure on success.
+ * @return a @c NULL pointer if the time code could not created.
+ */
+struct MIDITimeCode * MIDITimeCodeCreate( struct MIDITimeCodeDelegate * delegate ) {
+  struct MIDITimeCode * time_code = malloc( sizeof( struct MIDITimeCode ) );
+  MIDIPrecondReturn( time_code != NULL, ENOMEM, NULL );
+  time_code->refs     = 1;
+  time_code->delegate = delegate;
+  time_code->rate     = MIDI_TIME_CODE_30_FPS;
+  MIDIClockGetGlobalClock( &(time_code->clock) );
+  MIDIClockRetain( time_code->clock );
+
+  time_code->receiver.locked    = 0;
+  time_code->receiver.playback  = MIDI_TIME_CODE_FORWARD;
+  time_code->receiver.last_type = -1;
+  time_code->receiver.last      = 0;
+  time_code->receiver.frame     = 0;
+  time_code->receiver.anchor    = 0;
+  time_code->receiver.rate      = MIDI_TIME_CODE_30_FPS;
+  _receiver_reset( time_code );
+  _receiver_update_nominal( time_code );
+
+  time_code->generator.schedule.running   = 0;
+  time_code->generator.schedule.source    = NULL;
+  time_code->generator.schedule.origin    = 0;
+  time_code->generator.schedule.lookahead = 0;
+  time_code->generator.schedule.tick      = 0;
+  time_code->generator.schedule.period    = _nominal( time_code, time_code->rate );
+  time_code->generator.device = NULL;
+  time_code->generator.frame  = 0;
+  return time_code;
+}
+
+/**
+ * @brief Destroy a MIDITimeCode instance.
+ * Free all resources occupied by the time code and release the clock.
+ * @public @memberof MIDITimeCode
+ * @param time_code The time code.
+ */
+void MIDITimeCodeDestroy( struct MIDITimeCode * time_code ) {
+  if( time_code->generator.schedule.source != NULL ) {
+    MIDIRunloopSourceInvalidate( time_code->generator.schedule.source );
+    MIDIRunloopSourceRelease( time_code->generator.schedule.source );
+  }
+  MIDIClockRelease( time_code->clock );
+  free( time_code );
+}
+
+/**
+ * @brief Retain a MIDITimeCode instance.
+ * Increment the reference counter of a time code so that it won't be destroyed.
+ * @public @memberof MIDITimeCode
+ * @param time_code The time code.
+ */
+void MIDITimeCodeRetain( struct MIDITimeCode * time_code ) {
+  time_code->refs++;
+}
+
+/**
+ * @brief Release a MIDITimeCode instance.
+ * Decrement the reference counter of a time code. If the reference count
+ * reached zero, destroy the time code.
+ * @public @memberof MIDITimeCode
+ * @param time_code The time code.
+ */
+void MIDITimeCodeRelease( struct MIDITimeCode * time_code ) {
+  if( ! --time_code->refs ) {
+    MIDITimeCodeDestroy( time_code );
+  }
+}
+
+/** @} */
+
+/* MARK: Properties *//**
+ * @name Properties
+ * @{
+ */
+
+/**
+ * @brief Set the clock used to interpret timestamps.
+ * @public @memberof MIDITimeCode
+ * @param time_code The time code.
+ * @param clock     The clock (pass @c NULL for global clock)
+ * @retval 0 on success.
+ */
+int MIDITimeCodeSetClock( struct MIDITimeCode * time_code, struct MIDIClock * clock ) {
+  MIDIPrecond( time_code != NULL, EFAULT );
+  MIDIPrecond( ! time_code->generator.schedule.running, EINVAL );
+  if( clock == NULL ) MIDIClockGetGlobalClock( &clock );
+  MIDIClockRetain( clock );
+  MIDIClockRelease( time_code->clock );
+  time_code->clock = clock;
+  _receiver_update_nominal( time_code );
+  time_code->generator.schedule.period = _nominal( time_code, time_code->rate );
+  return 0;
+}
+
+/**
+ * @brief Get the clock used to interpret timestamps.
+ * @public @memberof MIDITimeCode
+ * @param time_code The time code.
+ * @param clock     The clock.
+ * @retval 0 on success.
+ */
+int MIDITimeCodeGetClock( struct MIDITimeCode * time_code, struct MIDIClock ** clock ) {
+  MIDIPrecond( time_code != NULL, EFAULT );
+  MIDIPrecond( clock != NULL, EINVAL );
+  *clock = time_code->clock;
+  return 0;
+}
+
+/**
+ * @brief Set the frame rate.
+ * The rate is used by the generator. The receiver follows the rate
+ * encoded in the received time code.
+ * @public @memberof MIDITimeCode
+ * @param time_code The time code.
+ * @param rate      One of the @c MIDI_TIME_CODE_*_FPS constants.
+ * @retval 0 on success.
+ */
+int MIDITimeCodeSetRate( struct MIDITimeCode * time_code, int rate ) {
+  MIDIPrecond( time_code != NULL, EFAULT );
+  MIDIPrecond( rate >= MIDI_TIME_CODE_24_FPS && rate <= MIDI_TIME_CODE_30_FPS, EINVAL );
+  MIDIPrecond( ! time_code->generator.schedule.running, EINVAL );
+  time_code->rate = rate;
+  time_code->generator.schedule.period = _nominal( time_code, rate );
+  return 0;
+}
+
+/**
+ * @brief Get the frame rate of the generator.
+ * @public @memberof MIDITimeCode
+ * @param time_code The time code.
+ * @param rate      The rate.
+ * @retval 0 on success.
+ */
+int MIDITimeCodeGetRate( struct MIDITimeCode * time_code, int * rate ) {
+  MIDIPrecond( time_code != NULL, EFAULT );
+  MIDIPrecond( rate != NULL, EINVAL );
+  *rate = time_code->rate;
+  return 0;
+}
+
+/**
+ * @brief Get the frame rate of the received time code.
+ * @public @memberof MIDITimeCode
+ * @param time_code The time code.
+ * @param rate      The rate.
+ * @retval 0 on success.
+ * @retval >0 if no full position was received yet.
+ */
+int MIDITimeCodeGetReceivedRate( struct MIDITimeCode * time_code, int * rate ) {
+  MIDIPrecond( time_code != NULL, EFAULT );
+  MIDIPrecond( rate != NULL, EINVAL );
+  if( ! time_code->receiver.locked ) return 1;
+  *rate = time_code->receiver.rate;
+  return 0;
+}
+
+/**
+ * @brief Set how far ahead generated quarter frames are sent.
+ * @public @memberof MIDITimeCode
+ * @param time_code The time code.
+ * @param lookahead The lookahead in clock ticks.
+ * @retval 0 on success.
+ */
+int MIDITimeCodeSetLookahead( struct MIDITimeCode * time_code, MIDITimestamp lookahead ) {
+  MIDIPrecond( time_code != NULL, EFAULT );
+  MIDIPrecond( lookahead >= 0, EINVAL );
+  time_code->generator.schedule.lookahead = lookahead;
+  return 0;
+}
+
+/**
+ * @brief Get how far ahead generated quarter frames are sent.
+ * @public @memberof MIDITimeCode
+ * @param time_code The time code.
+ * @param lookahead The lookahead in clock ticks.
+ * @retval 0 on success.
+ */
+int MIDITimeCodeGetLookahead( struct MIDITimeCode * time_code, MIDITimestamp * lookahead ) {
+  MIDIPrecond( time_code != NULL, EFAULT );
+  MIDIPrecond( lookahead != NULL, EINVAL );
+  *lookahead = time_code->generator.schedule.lookahead;
+  return 0;
+}
+
+/**
+ * @brief Get the direction of the received time code.
+ * @public @memberof MIDITimeCode
+ * @param time_code The time code.
+ * @param direction @c MIDI_TIME_CODE_FORWARD or @c MIDI_TIME_CODE_REVERSE.
+ * @retval 0 on success.
+ * @retval >0 if no full position was received yet.
+ */
+int MIDITimeCodeGetDirection( struct MIDITimeCode * time_code, int * direction ) {
+  MIDIPrecond( time_code != NULL, EFAULT );
+  MIDIPrecond( direction != NULL, EINVAL );
+  if( ! time_code->receiver.locked ) return 1;
+  *direction = time_code->receiver.playback;
+  return 0;
+}
+
+/**
+ * @brief Get a pointer to the time code's runloop source.
+ * Add the source to a runloop to have it send quarter frames while
+ * the generator is running.
+ * @public @memberof MIDITimeCode
+ * @param time_code The time code.
+ * @param source    The runloop source.
+ * @retval 0 on success.
+ * @retval >0 if the runloop source could not be created.
+ */
+int MIDITimeCodeGetRunloopSource( struct MIDITimeCode * time_code, struct MIDIRunloopSource ** source ) {
+  struct MIDIRunloopSourceDelegate delegate = { NULL, NULL, NULL, &_generator_timeout };
+  MIDIPrecond( time_code != NULL, EFAULT );
+  MIDIPrecond( source != NULL, EINVAL );
+  if( time_code->generator.schedule.source == NULL ) {
+    delegate.info = time_code;
+    time_code->generator.schedule.source = MIDIRunloopSourceCreate( &delegate );
+    if( time_code->generator.schedule.source == NULL ) return 1;
+  }
+  *source = time_code->generator.schedule.source;
+  return 0;
+}
+
+/** @} */
+
+/* MARK: Positions *//**
+ * @name Positions
+ * Convert between SMPTE positions and frame numbers.
+ * @{
+ */
+
+/**
+ * @brief Convert a SMPTE position to a frame number.
+ * For 29.97 fps drop-frame time code, frame numbers 0 and 1 are
+ * skipped at the start of every minute that is not divisible by ten.
+ * @public @memberof MIDITimeCode
+ * @param rate     The time code rate.
+ * @param position The position.
+ * @param frames   The number of frames since 00:00:00:00.
+ * @retval 0 on success.
+ */
+int MIDITimeCodePositionToFrames( int rate, struct MIDITimeCodePosition * position, long * frames ) {
+  long minutes;
+  MIDIPrecond( rate >= MIDI_TIME_CODE_24_FPS && rate <= MIDI_TIME_CODE_30_FPS, EINVAL );
+  MIDIPrecond( position != NULL, EFAULT );
+  MIDIPrecond( frames != NULL, EINVAL );
+  MIDIPrecond( _valid( rate, position ), EINVAL );
+  minutes = position->hours * 60L + position->minutes;
+  *frames = ( minutes * 60 + position->seconds ) * _fps( rate ) + position->frames;
+  if( rate == MIDI_TIME_CODE_29_97_FPS ) {
+    *frames -= 2 * ( minutes - minutes / 10 );
+  }
+  return 0;
+}
+
+/**
+ * @brief Convert a frame number to a SMPTE position.
+ * @public @memberof MIDITimeCode
+ * @param rate     The time code rate.
+ * @param position The position.
+ * @param frames   The number of frames since 00:00:00:00.
+ * @retval 0 on success.
+ */
+int MIDITimeCodePositionFromFrames( int rate, struct MIDITimeCodePosition * position, long frames ) {
+  long blocks, remain;
+  int fps;
+  MIDIPrecond( rate >= MIDI_TIME_CODE_24_FPS && rate <= MIDI_TIME_CODE_30_FPS, EINVAL );
+  MIDIPrecond( position != NULL, EFAULT );
+  frames = _wrap( rate, frames );
+  fps = _fps( rate );
+  if( rate == MIDI_TIME_CODE_29_97_FPS ) {
+    blocks = frames / MIDI_TIME_CODE_FRAMES_PER_10_MINUTES_DF;
+    remain = frames % MIDI_TIME_CODE_FRAMES_PER_10_MINUTES_DF;
+    frames += 18 * blocks;
+    if( remain > 1 ) {
+      frames += 2 * ( ( remain - 2 ) / MIDI_TIME_CODE_FRAMES_PER_MINUTE_DF );
+    }
+  }
+  position->frames  = frames % fps;
+  position->seconds = ( frames / fps ) % 60;
+  position->minutes = ( frames / ( fps * 60L ) ) % 60;
+  position->hours   = ( frames / ( fps * 3600L ) ) % 24;
+  return 0;
+}
+
+/**
+ * @brief Predict the received position at a given time.
+ * @public @memberof MIDITimeCode
+ * @param time_code The time code.
+ * @param timestamp The time at which to get the position.
+ * @param position  The position.
+ * @retval 0 on success.
+ * @retval >0 if no full position was received yet.
+ */
+int MIDITimeCodeGetPosition( struct MIDITimeCode * time_code, MIDITimestamp timestamp,
+                             struct MIDITimeCodePosition * position ) {
+  double elapsed;
+  long frames;
+  MIDIPrecond( time_code != NULL, EFAULT );
+  MIDIPrecond( position != NULL, EINVAL );
+  if( ! time_code->receiver.locked ) return 1;
+  elapsed = (double) ( timestamp - time_code->receiver.anchor ) / ( 4 * time_code->receiver.period );
+  frames  = (long) elapsed;
+  if( frames > elapsed ) frames--;
+  return MIDITimeCodePositionFromFrames( time_code->receiver.rate, position,
+                                         time_code->receiver.frame + time_code->receiver.playback * frames );
+}
+
+/**
+ * @brief Predict when a received frame starts.
+ * Frames within half a day of the last received position are
+ * considered to lie in the direction of playback.
+ * @public @memberof MIDITimeCode
+ * @param time_code The time code.
+ * @param position  The position of the frame.
+ * @param timestamp The predicted timestamp.
+ * @retval 0 on success.
+ * @retval >0 if no full position was received yet.
+ */
+int MIDITimeCodeGetFrameTimestamp( struct MIDITimeCode * time_code, struct MIDITimeCodePosition * position,
+                                   MIDITimestamp * timestamp ) {
+  long frame, delta, day;
+  MIDIPrecond( time_code != NULL, EFAULT );
+  MIDIPrecond( timestamp != NULL, EINVAL );
+  if( ! time_code->receiver.locked ) return 1;
+  if( MIDITimeCodePositionToFrames( time_code->receiver.rate, position, &frame ) ) return 1;
+  day   = _frames_per_day( time_code->receiver.rate );
+  delta = _wrap( time_code->receiver.rate, ( frame - time_code->receiver.frame ) * time_code->receiver.playback );
+  if( delta > day / 2 ) delta -= day;
+  *timestamp = time_code->receiver.anchor
+             + (MIDITimestamp) ( delta * 4 * time_code->receiver.period + ( delta < 0 ? -0.5 : 0.5 ) );
+  return 0;
+}
+
+/** @} */
+
+/* MARK: Receiving and sending *//**
+ * @name Receiving and sending
+ * @{
+ */
+
+/**
+ * @brief Receive a quarter frame message.
+ * Collect the piece and report the full position to the delegate when
+ * all eight pieces were received in order. A piece that is out of order
+ * or arrives after more than two frames without time code restarts the
+ * collection.
+ * @public @memberof MIDITimeCode
+ * @param time_code      The time code.
+ * @param device         The device that received the message.
+ * @param time_code_type One of the eight code-types specified by the MIDI time code spec.
+ * @param value          The 4-bit value for the given time code type.
+ * @param timestamp      The timestamp of the message.
+ * @retval 0 on success.
+ */
+int MIDITimeCodeReceiveQuarterFrame( struct MIDITimeCode * time_code, struct MIDIDevice * device,
+                                     MIDIValue time_code_type, MIDIValue value, MIDITimestamp timestamp ) {
+  int type = time_code_type & 7, last, direction = 0;
+  double interval;
+  MIDIPrecond( time_code != NULL, EFAULT );
+  last = time_code->receiver.last_type;
+
+  if( last >= 0 ) {
+    interval = (double) ( timestamp - time_code->receiver.last );
+    if( interval > 8 * time_code->receiver.nominal ) {
+      /* dropout */
+      time_code->receiver.locked = 0;
+    } else if( type == ( ( last + 1 ) & 7 ) ) {
+      direction = MIDI_TIME_CODE_FORWARD;
+    } else if( type == ( ( last + 7 ) & 7 ) ) {
+      direction = MIDI_TIME_CODE_REVERSE;
+    }
+    if( direction != 0 && interval > 0.5 * time_code->receiver.period
+                       && interval < 1.5 * time_code->receiver.period ) {
+      time_code->receiver.period += ( interval - time_code->receiver.period ) / MIDI_TIME_CODE_FILTER;
+    }
+  }
+  time_code->receiver.last_type = type;
+  time_code->receiver.last      = timestamp;
+
+  if( direction == 0 || ( time_code->receiver.direction != 0 && direction != time_code->receiver.direction ) ) {
+    _receiver_reset( time_code );
+  }
+  time_code->receiver.direction = direction;
+  if( ( direction == MIDI_TIME_CODE_FORWARD && type == 0 )
+   || ( direction == MIDI_TIME_CODE_REVERSE && type == 7 ) ) {
+    time_code->receiver.mask = 0;
+  }
+  time_code->receiver.piece[type] = value & 0x0f;
+  time_code->receiver.mask |= 1 << type;
+
+  if( time_code->receiver.mask == 0xff
+   && ( ( direction == MIDI_TIME_CODE_FORWARD && type == 7 )
+     || ( direction == MIDI_TIME_CODE_REVERSE && type == 0 ) ) ) {
+    return _receiver_complete( time_code, timestamp );
+  }
+  return 0;
+}
+
+/**
+ * @brief Start generating time code.
+ * Quarter frames are sent on the device, the first one is due at
+ * @c timestamp and describes @c position. The device is not retained
+ * and must stay valid while the generator is running.
+ * @public @memberof MIDITimeCode
+ * @param time_code The time code.
+ * @param device    The device to send with.
+ * @param position  The position to start at.
+ * @param timestamp The time at which the position starts.
+ * @retval 0 on success.
+ * @retval >0 if the generator could not be started.
+ */
+int MIDITimeCodeStart( struct MIDITimeCode * time_code, struct MIDIDevice * device,
+                       struct MIDITimeCodePosition * position, MIDITimestamp timestamp ) {
+  MIDITimestamp now;
+  long frame;
+  MIDIPrecond( time_code != NULL, EFAULT );
+  MIDIPrecond( device != NULL, EINVAL );
+  if( MIDITimeCodePositionToFrames( time_code->rate, position, &frame ) ) return 1;
+  time_code->generator.device = device;
+  time_code->generator.frame  = frame;
+  time_code->generator.schedule.origin  = timestamp;
+  time_code->generator.schedule.tick    = 0;
+  time_code->generator.schedule.running = 1;
+  MIDIClockGetNow( time_code->clock, &now );
+  return MIDIUtilScheduleTimeout( &(time_code->generator.schedule), time_code->clock, now );
+}
+
+/**
+ * @brief Stop generating time code.
+ * @public @memberof MIDITimeCode
+ * @param time_code The time code.
+ * @retval 0 on success.
+ */
+int MIDITimeCodeStop( struct MIDITimeCode * time_code ) {
+  MIDIPrecond( time_code != NULL, EFAULT );
+  time_code->generator.schedule.running = 0;
+  time_code->generator.device = NULL;
+  return MIDIUtilScheduleTimeout( &(time_code->generator.schedule), time_code->clock, 0 );
+}
+
+/**
+ * @brief Send all quarter frames that are due.
+ * Send every quarter frame whose deadline is before @c timestamp plus
+ * the lookahead. This is done automatically if the time code's runloop
+ * source is scheduled in a runloop.
+ * @public @memberof MIDITimeCode
+ * @param time_code The time code.
+ * @param timestamp The current time.
+ * @retval 0 on success.
+ * @retval >0 if a quarter frame could not be sent.
+ */
+int MIDITimeCodeSend( struct MIDITimeCode * time_code, MIDITimestamp timestamp ) {
+  MIDIPrecond( time_code != NULL, EFAULT );
+  if( ! time_code->generator.schedule.running ) return 0;
+  return _generator_send( time_code, timestamp + time_code->generator.schedule.lookahead );
+}
+
+/** @} */
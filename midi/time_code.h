@@ -0,0 +1,61 @@
+#ifndef MIDIKIT_MIDI_TIME_CODE_H
+#define MIDIKIT_MIDI_TIME_CODE_H
+#include "midi.h"
+
+#define MIDI_TIME_CODE_24_FPS      0
+#define MIDI_TIME_CODE_25_FPS      1
+#define MIDI_TIME_CODE_29_97_FPS   2
+#define MIDI_TIME_CODE_30_FPS      3
+
+#define MIDI_TIME_CODE_FORWARD     1
+#define MIDI_TIME_CODE_REVERSE    -1
+
+struct MIDIClock;
+struct MIDIDevice;
+struct MIDIRunloopSource;
+struct MIDITimeCode;
+
+struct MIDITimeCodePosition {
+  MIDIValue hours;
+  MIDIValue minutes;
+  MIDIValue seconds;
+  MIDIValue frames;
+};
+
+struct MIDITimeCodeDelegate {
+  int (*recv_position)( struct MIDITimeCode * time_code, struct MIDITimeCodePosition * position,
+                        MIDITimestamp timestamp );
+};
+
+struct MIDITimeCode * MIDITimeCodeCreate( struct MIDITimeCodeDelegate * delegate );
+void MIDITimeCodeDestroy( struct MIDITimeCode * time_code );
+void MIDITimeCodeRetain( struct MIDITimeCode * time_code );
+void MIDITimeCodeRelease( struct MIDITimeCode * time_code );
+
+int MIDITimeCodeSetClock( struct MIDITimeCode * time_code, struct MIDIClock * clock );
+int MIDITimeCodeGetClock( struct MIDITimeCode * time_code, struct MIDIClock ** clock );
+int MIDITimeCodeSetRate( struct MIDITimeCode * time_code, int rate );
+int MIDITimeCodeGetRate( struct MIDITimeCode * time_code, int * rate );
+int MIDITimeCodeGetReceivedRate( struct MIDITimeCode * time_code, int * rate );
+int MIDITimeCodeSetLookahead( struct MIDITimeCode * time_code, MIDITimestamp lookahead );
+int MIDITimeCodeGetLookahead( struct MIDITimeCode * time_code, MIDITimestamp * lookahead );
+int MIDITimeCodeGetDirection( struct MIDITimeCode * time_code, int * direction );
+int MIDITimeCodeGetRunloopSource( struct MIDITimeCode * time_code, struct MIDIRunloopSource ** source );
+
+int MIDITimeCodePositionToFrames( int rate, struct MIDITimeCodePosition * position, long * frames );
+int MIDITimeCodePositionFromFrames( int rate, struct MIDITimeCodePosition * position, long frames );
+
+int MIDITimeCodeGetPosition( struct MIDITimeCode * time_code, MIDITimestamp timestamp,
+                             struct MIDITimeCodePosition * position );
+int MIDITimeCodeGetFrameTimestamp( struct MIDITimeCode * time_code, struct MIDITimeCodePosition * position,
+                                   MIDITimestamp * timestamp );
+
+int MIDITimeCodeReceiveQuarterFrame( struct MIDITimeCode * time_code, struct MIDIDevice * device,
+                                     MIDIValue time_code_type, MIDIValue value, MIDITimestamp timestamp );
+
+int MIDITimeCodeStart( struct MIDITimeCode * time_code, struct MIDIDevice * device,
+                       struct MIDITimeCodePosition * position, MIDITimestamp timestamp );
+int MIDITimeCodeStop( struct MIDITimeCode * time_code );
+int MIDITimeCodeSend( struct MIDITimeCode * time_code, MIDITimestamp timestamp );
+
+#endif
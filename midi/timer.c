@@ -3,16 +3,223 @@
 #include "timer.h"
 #include "clock.h"
 #include "message.h"
+#include "runloop.h"
+#include "util.h"
 
+/**
+ * @brief Number of clocks over which the tempo tracker averages.
+ * For the first clocks the tracker computes an exact least-squares fit,
+ * after that it fades out older clocks with the same time constant.
+ */
+#define MIDI_TIMER_TRACKER_WINDOW MIDI_CLOCKS_PER_QUARTER_NOTE
+
+/**
+ * @ingroup MIDI
+ * @struct MIDITimer timer.h
+ * @brief Follow and generate MIDI clock and real-time messages.
+ * The timer tracks the tempo of incoming MIDI timing clocks. Clock
+ * jitter is filtered with an alpha-beta filter (a steady-state Kalman
+ * filter for a constant tempo) whose gains start out as those of a
+ * growing least-squares fit. Each clock costs a handful of floating
+ * point operations.
+ * The timer can also generate timing clocks at a set tempo. Every clock
+ * is due at an absolute deadline computed from the start time, so
+ * scheduling errors do not build up. Clocks are sent ahead of time
+ * (see MIDITimerSetLookahead) with their deadline as timestamp.
+ */
 struct MIDITimer {
+/**
+ * @privatesection
+ * @cond INTERNALS
+ */
   int refs;
   struct MIDITimerDelegate * delegate;
+  struct MIDIClock * clock;
   MIDILongValue song_position;
   MIDILongValue beats_per_minute;
-  MIDITimestamp last_timestamp;
-  MIDITimestamp clocks[4];
+  int running;
+  struct {
+    int           locked; /**< Whether the anchor refers to the last clock */
+    long          count;  /**< Number of clocks used for the estimate */
+    long          ticks;  /**< Number of clocks since start */
+    MIDITimestamp anchor; /**< Timestamp of the last received clock */
+    double        time;   /**< Filtered time of the last clock relative to anchor */
+    double        period; /**< Filtered clock period */
+  } tracker;
+  struct {
+    struct MIDIUtilSchedule schedule; /**< Deadlines of the clocks */
+    struct MIDIDevice * device; /**< Device to send on (not retained) */
+    double        bpm;          /**< Tempo in quarter notes per minute */
+    long          clocks;       /**< Number of clocks sent since the start of the song */
+  } generator;
+/** @endcond */
 };
 
+/* MARK: Internals *//**
+ * @name Internals
+ * @cond INTERNALS
+ * @{
+ */
+
+/**
+ * @brief Get the sampling rate of the timer's clock.
+ * @private @memberof MIDITimer
+ * @param timer The timer.
+ * @return the sampling rate in ticks per second.
+ */
+static MIDISamplingRate _timer_rate( struct MIDITimer * timer ) {
+  MIDISamplingRate rate = 0;
+  MIDIClockGetSamplingRate( timer->clock, &rate );
+  return rate;
+}
+
+/**
+ * @brief Restart the tempo tracker.
+ * The next clock is used as a new reference point. Keep the current
+ * period estimate (if any) as an initial guess.
+ * @private @memberof MIDITimer
+ * @param timer The timer.
+ * @param ticks The number of clocks since the start of the song.
+ */
+static void _tracker_reset( struct MIDITimer * timer, long ticks ) {
+  if( timer->tracker.count > MIDI_TIMER_TRACKER_WINDOW / 2 ) {
+    timer->tracker.count = MIDI_TIMER_TRACKER_WINDOW / 2;
+  }
+  timer->tracker.locked = 0;
+  timer->tracker.ticks  = ticks;
+}
+
+/**
+ * @brief Feed a timing clock into the tempo tracker.
+ * Missing clocks are detected by comparing the elapsed time with the
+ * current period estimate. Clocks that arrive less than half a period
+ * after the previous one are treated as duplicates and ignored.
+ * While stopped the tempo is still tracked, but the song position
+ * stays where it is.
+ * @private @memberof MIDITimer
+ * @param timer     The timer.
+ * @param timestamp The timestamp of the clock.
+ */
+static void _tracker_clock( struct MIDITimer * timer, MIDITimestamp timestamp ) {
+  double elapsed, residual, alpha, beta, n;
+  long steps;
+
+  if( ! timer->tracker.locked ) {
+    timer->tracker.locked = 1;
+    timer->tracker.anchor = timestamp;
+    timer->tracker.time   = 0;
+    if( timer->running ) {
+      timer->tracker.ticks++;
+      timer->song_position = timer->tracker.ticks / MIDI_CLOCKS_PER_BEAT;
+    }
+    return;
+  }
+
+  elapsed = (double) ( timestamp - timer->tracker.anchor ) - timer->tracker.time;
+  if( timer->tracker.period <= 0 ) {
+    if( elapsed <= 0 ) return;
+    steps = 1;
+    timer->tracker.period = elapsed;
+    timer->tracker.time  += elapsed;
+  } else {
+    steps = (long) ( elapsed / timer->tracker.period + 0.5 );
+    if( steps < 1 ) return;
+    residual = elapsed - steps * timer->tracker.period;
+    n = ( timer->tracker.count + 2 < MIDI_TIMER_TRACKER_WINDOW ) ? timer->tracker.count + 2 : MIDI_TIMER_TRACKER_WINDOW;
+    alpha = 2.0 * ( 2.0 * n - 1.0 ) / ( n * ( n + 1.0 ) );
+    beta  = 6.0 / ( n * ( n + 1.0 ) );
+    timer->tracker.time   += steps * timer->tracker.period + alpha * residual;
+    timer->tracker.period += beta * residual / steps;
+  }
+  /* rebase on the received timestamp */
+  timer->tracker.time  -= (double) ( timestamp - timer->tracker.anchor );
+  timer->tracker.anchor = timestamp;
+  timer->tracker.count++;
+  if( timer->running ) {
+    timer->tracker.ticks += steps;
+    timer->song_position  = timer->tracker.ticks / MIDI_CLOCKS_PER_BEAT;
+  }
+  if( timer->tracker.period > 0 ) {
+    timer->beats_per_minute = 60.0 * _timer_rate( timer )
+                            / ( timer->tracker.period * MIDI_CLOCKS_PER_QUARTER_NOTE ) + 0.5;
+  }
+}
+
+/**
+ * @brief Update the clock period of the generator.
+ * Rebase the generator on the next deadline so that the change does
+ * not move clocks that were already sent.
+ * @private @memberof MIDITimer
+ * @param timer The timer.
+ */
+static void _generator_update_period( struct MIDITimer * timer ) {
+  if( timer->generator.schedule.running ) {
+    MIDIUtilScheduleRebase( &(timer->generator.schedule) );
+  }
+  timer->generator.schedule.period = 60.0 * _timer_rate( timer )
+                          / ( timer->generator.bpm * MIDI_CLOCKS_PER_QUARTER_NOTE );
+}
+
+/**
+ * @brief Send all clocks that are due before a given time.
+ * @private @memberof MIDITimer
+ * @param timer  The timer.
+ * @param device The device to send the clocks with.
+ * @param limit  Send all clocks with a deadline up to this time.
+ * @retval 0 on success.
+ * @retval >0 if a clock could not be sent.
+ */
+static int _generator_send( struct MIDITimer * timer, struct MIDIDevice * device, MIDITimestamp limit ) {
+  struct MIDIUtilSchedule * schedule = &(timer->generator.schedule);
+  MIDITimestamp deadline;
+  int result = 0;
+  for( deadline = MIDIUtilScheduleDeadline( schedule ); deadline <= limit; deadline = MIDIUtilScheduleDeadline( schedule ) ) {
+    result += MIDIDeviceSendRealTime( device, MIDI_STATUS_TIMING_CLOCK, deadline );
+    schedule->tick++;
+    timer->generator.clocks++;
+  }
+  return result;
+}
+
+/**
+ * @brief Send due clocks from the runloop.
+ * @private @memberof MIDITimer
+ * @param info    The timer.
+ * @param elapsed The time elapsed since the timeout was scheduled.
+ * @retval 0 on success.
+ */
+static int _generator_timeout( void * info, struct timespec * elapsed ) {
+  struct MIDITimer * timer = info;
+  MIDITimestamp now;
+  int result = 0;
+  if( ! timer->generator.schedule.running ) return 0;
+  MIDIClockGetNow( timer->clock, &now );
+  result += _generator_send( timer, timer->generator.device, now + timer->generator.schedule.lookahead );
+  result += MIDIUtilScheduleTimeout( &(timer->generator.schedule), timer->clock, now );
+  return result;
+}
+
+/**
+ * @}
+ * @endcond
+ */
+
+/* MARK: -
+ * MARK: Creation and destruction *//**
+ * @name Creation and destruction
+ * Creating, destroying and reference counting of MIDITimer objects.
+ * @{
+ */
+
+/**
+ * @brief Create a MIDITimer instance.
+ * Allocate space and initialize a MIDITimer instance.
+ * The timer interprets timestamps using the global clock.
+ * @public @memberof MIDITimer
+ * @param delegate The delegate to use for the timer. May be @c NULL.
+ * @return a pointer to the created timer structure on success.
+ * @return a @c NULL pointer if the timer could not created.
+ */
 struct MIDITimer * MIDITimerCreate( struct MIDITimerDelegate * delegate ) {
   struct MIDITimer * timer = malloc( sizeof( struct MIDITimer ) );
   if( timer == NULL ) return NULL;
@@ -20,38 +227,319 @@ struct MIDITimer * MIDITimerCreate( struct MIDITimerDelegate * delegate ) {
   timer->delegate         = delegate;
   timer->song_position    = 0;
   timer->beats_per_minute = 120;
-  timer->last_timestamp   = -1;
-  timer->clocks[0]        = -1;
-  timer->clocks[1]        = -1;
-  timer->clocks[2]        = -1;
-  timer->clocks[3]        = -1;
+  timer->running          = 0;
+  MIDIClockGetGlobalClock( &(timer->clock) );
+  MIDIClockRetain( timer->clock );
+  timer->tracker.locked = 0;
+  timer->tracker.count  = 0;
+  timer->tracker.ticks  = 0;
+  timer->tracker.anchor = 0;
+  timer->tracker.time   = 0;
+  timer->tracker.period = 0;
+  timer->generator.schedule.running   = 0;
+  timer->generator.schedule.source    = NULL;
+  timer->generator.schedule.origin    = 0;
+  timer->generator.schedule.lookahead = 0;
+  timer->generator.schedule.tick      = 0;
+  timer->generator.device = NULL;
+  timer->generator.bpm    = 120;
+  timer->generator.clocks = 0;
+  _generator_update_period( timer );
   return timer;
 }
 
+/**
+ * @brief Destroy a MIDITimer instance.
+ * Free all resources occupied by the timer and release the clock.
+ * @public @memberof MIDITimer
+ * @param timer The timer.
+ */
 void MIDITimerDestroy( struct MIDITimer * timer ) {
+  if( timer->generator.schedule.source != NULL ) {
+    MIDIRunloopSourceInvalidate( timer->generator.schedule.source );
+    MIDIRunloopSourceRelease( timer->generator.schedule.source );
+  }
+  MIDIClockRelease( timer->clock );
   free( timer );
 }
 
+/**
+ * @brief Retain a MIDITimer instance.
+ * Increment the reference counter of a timer so that it won't be destroyed.
+ * @public @memberof MIDITimer
+ * @param timer The timer.
+ */
 void MIDITimerRetain( struct MIDITimer * timer ) {
   timer->refs++;
 }
 
+/**
+ * @brief Release a MIDITimer instance.
+ * Decrement the reference counter of a timer. If the reference count
+ * reached zero, destroy the timer.
+ * @public @memberof MIDITimer
+ * @param timer The timer.
+ */
 void MIDITimerRelease( struct MIDITimer * timer ) {
   if( ! --timer->refs ) {
     MIDITimerDestroy( timer );
   }
 }
 
+/** @} */
+
+/* MARK: Properties *//**
+ * @name Properties
+ * @{
+ */
+
+/**
+ * @brief Set the clock used to interpret timestamps.
+ * @public @memberof MIDITimer
+ * @param timer The timer.
+ * @param clock The clock (pass @c NULL for global clock)
+ * @retval 0 on success.
+ */
+int MIDITimerSetClock( struct MIDITimer * timer, struct MIDIClock * clock ) {
+  MIDIPrecond( timer != NULL, EFAULT );
+  if( clock == NULL ) MIDIClockGetGlobalClock( &clock );
+  if( timer->generator.schedule.running ) {
+    /* rebase on the next deadline and move it into the new clock's domain */
+    _generator_update_period( timer );
+    MIDIClockConvertTimestamp( clock, timer->clock, &(timer->generator.schedule.origin) );
+  }
+  MIDIClockRetain( clock );
+  MIDIClockRelease( timer->clock );
+  timer->clock = clock;
+  _generator_update_period( timer );
+  return 0;
+}
+
+/**
+ * @brief Get the clock used to interpret timestamps.
+ * @public @memberof MIDITimer
+ * @param timer The timer.
+ * @param clock The clock.
+ * @retval 0 on success.
+ */
+int MIDITimerGetClock( struct MIDITimer * timer, struct MIDIClock ** clock ) {
+  MIDIPrecond( timer != NULL, EFAULT );
+  MIDIPrecond( clock != NULL, EINVAL );
+  *clock = timer->clock;
+  return 0;
+}
+
+/**
+ * @brief Get the current tempo.
+ * The tempo is estimated from the received timing clocks.
+ * @public @memberof MIDITimer
+ * @param timer The timer.
+ * @param bpm   The tempo in quarter notes per minute.
+ * @retval 0 on success.
+ * @retval >0 if not enough clocks were received yet.
+ */
+int MIDITimerGetTempo( struct MIDITimer * timer, double * bpm ) {
+  MIDIPrecond( timer != NULL, EFAULT );
+  MIDIPrecond( bpm != NULL, EINVAL );
+  if( timer->tracker.period <= 0 ) return 1;
+  *bpm = 60.0 * _timer_rate( timer ) / ( timer->tracker.period * MIDI_CLOCKS_PER_QUARTER_NOTE );
+  return 0;
+}
+
+/**
+ * @brief Get the beat phase at a given time.
+ * The phase is the position within the current quarter note, from
+ * 0 (on the beat) up to 1 (excluding).
+ * @public @memberof MIDITimer
+ * @param timer     The timer.
+ * @param timestamp The time at which to get the phase.
+ * @param phase     The phase.
+ * @retval 0 on success.
+ * @retval >0 if not enough clocks were received yet.
+ */
+int MIDITimerGetPhase( struct MIDITimer * timer, MIDITimestamp timestamp, double * phase ) {
+  double position;
+  long beats;
+  MIDIPrecond( timer != NULL, EFAULT );
+  MIDIPrecond( phase != NULL, EINVAL );
+  if( timer->tracker.period <= 0 || ! timer->tracker.locked ) return 1;
+  position = ( timer->tracker.ticks - 1 )
+           + ( (double) ( timestamp - timer->tracker.anchor ) - timer->tracker.time ) / timer->tracker.period;
+  position /= MIDI_CLOCKS_PER_QUARTER_NOTE;
+  beats = (long) position;
+  if( beats > position ) beats--;
+  *phase = position - beats;
+  return 0;
+}
+
+/**
+ * @brief Predict the time of the next beat.
+ * Predict when the next quarter note after the last received clock
+ * will start.
+ * @public @memberof MIDITimer
+ * @param timer     The timer.
+ * @param timestamp The predicted timestamp.
+ * @retval 0 on success.
+ * @retval >0 if not enough clocks were received yet.
+ */
+int MIDITimerGetNextBeat( struct MIDITimer * timer, MIDITimestamp * timestamp ) {
+  long remain;
+  MIDIPrecond( timer != NULL, EFAULT );
+  MIDIPrecond( timestamp != NULL, EINVAL );
+  if( timer->tracker.period <= 0 || ! timer->tracker.locked ) return 1;
+  remain = MIDI_CLOCKS_PER_QUARTER_NOTE - ( ( timer->tracker.ticks - 1 ) % MIDI_CLOCKS_PER_QUARTER_NOTE );
+  *timestamp = timer->tracker.anchor
+             + (MIDITimestamp) ( timer->tracker.time + remain * timer->tracker.period + 0.5 );
+  return 0;
+}
+
+/**
+ * @brief Set the tempo of generated clocks.
+ * The change takes effect with the next clock that was not sent yet.
+ * @public @memberof MIDITimer
+ * @param timer The timer.
+ * @param bpm   The tempo in quarter notes per minute.
+ * @retval 0 on success.
+ */
+int MIDITimerSetSendTempo( struct MIDITimer * timer, double bpm ) {
+  MIDIPrecond( timer != NULL, EFAULT );
+  MIDIPrecond( bpm > 0, EINVAL );
+  timer->generator.bpm = bpm;
+  _generator_update_period( timer );
+  return 0;
+}
+
+/**
+ * @brief Get the tempo of generated clocks.
+ * @public @memberof MIDITimer
+ * @param timer The timer.
+ * @param bpm   The tempo in quarter notes per minute.
+ * @retval 0 on success.
+ */
+int MIDITimerGetSendTempo( struct MIDITimer * timer, double * bpm ) {
+  MIDIPrecond( timer != NULL, EFAULT );
+  MIDIPrecond( bpm != NULL, EINVAL );
+  *bpm = timer->generator.bpm;
+  return 0;
+}
+
+/**
+ * @brief Set how far ahead generated clocks are sent.
+ * Clocks are always timestamped with their deadline. A lookahead
+ * allows the transport to send them before they are due.
+ * @public @memberof MIDITimer
+ * @param timer     The timer.
+ * @param lookahead The lookahead in clock ticks.
+ * @retval 0 on success.
+ */
+int MIDITimerSetLookahead( struct MIDITimer * timer, MIDITimestamp lookahead ) {
+  MIDIPrecond( timer != NULL, EFAULT );
+  MIDIPrecond( lookahead >= 0, EINVAL );
+  timer->generator.schedule.lookahead = lookahead;
+  return 0;
+}
+
+/**
+ * @brief Get how far ahead generated clocks are sent.
+ * @public @memberof MIDITimer
+ * @param timer     The timer.
+ * @param lookahead The lookahead in clock ticks.
+ * @retval 0 on success.
+ */
+int MIDITimerGetLookahead( struct MIDITimer * timer, MIDITimestamp * lookahead ) {
+  MIDIPrecond( timer != NULL, EFAULT );
+  MIDIPrecond( lookahead != NULL, EINVAL );
+  *lookahead = timer->generator.schedule.lookahead;
+  return 0;
+}
+
+/**
+ * @brief Get a pointer to the timer's runloop source.
+ * Add the source to a runloop to have it send clocks while the
+ * generator is running.
+ * @public @memberof MIDITimer
+ * @param timer  The timer.
+ * @param source The runloop source.
+ * @retval 0 on success.
+ * @retval >0 if the runloop source could not be created.
+ */
+int MIDITimerGetRunloopSource( struct MIDITimer * timer, struct MIDIRunloopSource ** source ) {
+  struct MIDIRunloopSourceDelegate delegate = { NULL, NULL, NULL, &_generator_timeout };
+  MIDIPrecond( timer != NULL, EFAULT );
+  MIDIPrecond( source != NULL, EINVAL );
+  if( timer->generator.schedule.source == NULL ) {
+    delegate.info = timer;
+    timer->generator.schedule.source = MIDIRunloopSourceCreate( &delegate );
+    if( timer->generator.schedule.source == NULL ) return 1;
+  }
+  *source = timer->generator.schedule.source;
+  return 0;
+}
+
+/**
+ * @brief Get the song position.
+ * The position follows the received timing clocks.
+ * @public @memberof MIDITimer
+ * @param timer    The timer.
+ * @param position The song position in MIDI beats (sixteenth notes).
+ * @retval 0 on success.
+ */
+int MIDITimerGetSongPosition( struct MIDITimer * timer, MIDILongValue * position ) {
+  MIDIPrecond( timer != NULL, EFAULT );
+  MIDIPrecond( position != NULL, EINVAL );
+  *position = timer->song_position;
+  return 0;
+}
+
+/**
+ * @brief Get the song position of the generator.
+ * The position follows the generated timing clocks.
+ * @public @memberof MIDITimer
+ * @param timer    The timer.
+ * @param position The song position in MIDI beats (sixteenth notes).
+ * @retval 0 on success.
+ */
+int MIDITimerGetSendSongPosition( struct MIDITimer * timer, MIDILongValue * position ) {
+  MIDIPrecond( timer != NULL, EFAULT );
+  MIDIPrecond( position != NULL, EINVAL );
+  *position = timer->generator.clocks / MIDI_CLOCKS_PER_BEAT;
+  return 0;
+}
+
+/** @} */
+
+/* MARK: Real-time messages *//**
+ * @name Real-time messages
+ * @{
+ */
+
+/**
+ * @brief Receive a real-time message.
+ * Follow timing clocks and start, stop and continue messages.
+ * @public @memberof MIDITimer
+ * @param timer     The timer.
+ * @param device    The device that received the message.
+ * @param status    The real-time status.
+ * @param timestamp The timestamp of the message.
+ * @retval 0 on success.
+ */
 int MIDITimerReceiveRealTime( struct MIDITimer * timer, struct MIDIDevice * device,
                               MIDIStatus status, MIDITimestamp timestamp ) {
   switch( status ) {
     case MIDI_STATUS_TIMING_CLOCK:
+      _tracker_clock( timer, timestamp );
       break;
     case MIDI_STATUS_START:
+      timer->running       = 1;
+      timer->song_position = 0;
+      _tracker_reset( timer, 0 );
       break;
     case MIDI_STATUS_CONTINUE:
+      timer->running = 1;
+      _tracker_reset( timer, (long) timer->song_position * MIDI_CLOCKS_PER_BEAT );
       break;
     case MIDI_STATUS_STOP:
+      timer->running = 0;
       break;
     default:
       return 1;
@@ -59,19 +547,82 @@ int MIDITimerReceiveRealTime( struct MIDITimer * timer, struct MIDIDevice * devi
   return 0;
 }
 
+/**
+ * @brief Send a real-time message.
+ * Control the clock generator:
+ * - @c MIDI_STATUS_START sends start and starts generating clocks
+ *   from song position zero. The first clock is due at @c timestamp.
+ * - @c MIDI_STATUS_CONTINUE sends continue and resumes generating
+ *   clocks at the current song position.
+ * - @c MIDI_STATUS_STOP sends stop and stops the generator.
+ * - @c MIDI_STATUS_TIMING_CLOCK sends all clocks that are due before
+ *   @c timestamp plus the lookahead. This is done automatically if
+ *   the timer's runloop source is scheduled in a runloop.
+ * The device is not retained and must stay valid while the generator
+ * is running.
+ * @public @memberof MIDITimer
+ * @param timer     The timer.
+ * @param device    The device to send with.
+ * @param status    The real-time status.
+ * @param timestamp The timestamp of the message.
+ * @retval 0 on success.
+ * @retval >0 if the message could not be sent.
+ */
 int MIDITimerSendRealTime( struct MIDITimer * timer, struct MIDIDevice * device,
                            MIDIStatus status, MIDITimestamp timestamp ) {
+  MIDITimestamp now;
+  int result = 0;
+  MIDIPrecond( timer != NULL, EFAULT );
+  MIDIPrecond( device != NULL, EINVAL );
   switch( status ) {
     case MIDI_STATUS_TIMING_CLOCK:
-      break;
+      if( ! timer->generator.schedule.running ) return 0;
+      return _generator_send( timer, device, timestamp + timer->generator.schedule.lookahead );
     case MIDI_STATUS_START:
-      break;
     case MIDI_STATUS_CONTINUE:
+      result = MIDIDeviceSendRealTime( device, status, timestamp );
+      if( result ) return result;
+      if( status == MIDI_STATUS_START ) {
+        timer->generator.clocks = 0;
+      } else {
+        /* resume on the beat */
+        timer->generator.clocks -= timer->generator.clocks % MIDI_CLOCKS_PER_BEAT;
+      }
+      timer->generator.device = device;
+      timer->generator.schedule.origin  = timestamp;
+      timer->generator.schedule.tick    = 0;
+      timer->generator.schedule.running = 1;
       break;
     case MIDI_STATUS_STOP:
+      timer->generator.schedule.running = 0;
+      timer->generator.device = NULL;
+      result = MIDIDeviceSendRealTime( device, status, timestamp );
       break;
     default:
       return 1;
   }
-  return 0;
+  MIDIClockGetNow( timer->clock, &now );
+  return result + MIDIUtilScheduleTimeout( &(timer->generator.schedule), timer->clock, now );
+}
+
+/**
+ * @brief Send a song position pointer.
+ * Set the position from which the generator continues and send it to
+ * the device. The generator must be stopped.
+ * @public @memberof MIDITimer
+ * @param timer    The timer.
+ * @param device   The device to send with.
+ * @param position The song position in MIDI beats (sixteenth notes).
+ * @retval 0 on success.
+ * @retval >0 if the message could not be sent.
+ */
+int MIDITimerSendSongPosition( struct MIDITimer * timer, struct MIDIDevice * device, MIDILongValue position ) {
+  MIDIPrecond( timer != NULL, EFAULT );
+  MIDIPrecond( device != NULL, EINVAL );
+  MIDIPrecond( ! timer->generator.schedule.running, EINVAL );
+  MIDIPrecond( position <= 0x3fff, EINVAL );
+  timer->generator.clocks = (long) position * MIDI_CLOCKS_PER_BEAT;
+  return MIDIDeviceSendSongPositionPointer( device, position );
 }
+
+/** @} */
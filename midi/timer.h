@@ -7,6 +7,8 @@
 #define MIDI_CLOCKS_PER_QUARTER_NOTE 24
 #define MIDI_BEATS_PER_QUARTER_NOTE   4
 
+struct MIDIClock;
+struct MIDIRunloopSource;
 struct MIDITimer;
 struct MIDITimerDelegate {
 };
@@ -16,9 +18,25 @@ void MIDITimerDestroy( struct MIDITimer * timer );
 void MIDITimerRetain( struct MIDITimer * timer );
 void MIDITimerRelease( struct MIDITimer * timer );
 
+int MIDITimerSetClock( struct MIDITimer * timer, struct MIDIClock * clock );
+int MIDITimerGetClock( struct MIDITimer * timer, struct MIDIClock ** clock );
+
+int MIDITimerGetTempo( struct MIDITimer * timer, double * bpm );
+int MIDITimerGetPhase( struct MIDITimer * timer, MIDITimestamp timestamp, double * phase );
+int MIDITimerGetNextBeat( struct MIDITimer * timer, MIDITimestamp * timestamp );
+int MIDITimerGetSongPosition( struct MIDITimer * timer, MIDILongValue * position );
+
+int MIDITimerSetSendTempo( struct MIDITimer * timer, double bpm );
+int MIDITimerGetSendTempo( struct MIDITimer * timer, double * bpm );
+int MIDITimerSetLookahead( struct MIDITimer * timer, MIDITimestamp lookahead );
+int MIDITimerGetLookahead( struct MIDITimer * timer, MIDITimestamp * lookahead );
+int MIDITimerGetSendSongPosition( struct MIDITimer * timer, MIDILongValue * position );
+int MIDITimerGetRunloopSource( struct MIDITimer * timer, struct MIDIRunloopSource ** source );
+
 int MIDITimerReceiveRealTime( struct MIDITimer * timer, struct MIDIDevice * device,
                               MIDIStatus status, MIDITimestamp timestamp );
 int MIDITimerSendRealTime( struct MIDITimer * timer, struct MIDIDevice * device,
                            MIDIStatus status, MIDITimestamp timestamp );
+int MIDITimerSendSongPosition( struct MIDITimer * timer, struct MIDIDevice * device, MIDILongValue position );
 
 #endif
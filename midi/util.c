@@ -4,6 +4,8 @@
 #include "driver.h"
 #include "device.h"
 #include "port.h"
+#include "clock.h"
+#include "runloop.h"
 
 /**
  * @defgroup MIDI-fnc Utility functions
@@ -90,4 +92,60 @@ int MIDIDriverConnectDevice( struct MIDIDriver * driver, struct MIDIDevice * dev
   return 0;
 }
 
+/**
+ * @struct MIDIUtilSchedule util.h
+ * @brief A series of evenly spaced deadlines.
+ * Generators of periodic messages (timing clocks, quarter frames) due
+ * the message with index @c tick at @c origin plus @c tick periods, so
+ * scheduling errors do not build up. Messages are sent up to
+ * @c lookahead before their deadline by the optional runloop @c source.
+ */
+
+/**
+ * @brief Get the next deadline of a schedule.
+ * @param schedule The schedule.
+ * @return the timestamp at which the message with index @c tick is due.
+ */
+MIDITimestamp MIDIUtilScheduleDeadline( struct MIDIUtilSchedule * schedule ) {
+  return schedule->origin + (MIDITimestamp) ( schedule->tick * schedule->period + 0.5 );
+}
+
+/**
+ * @brief Make the next deadline the origin of a schedule.
+ * Call this before changing the period, so that the change does not
+ * move messages that were already sent.
+ * @param schedule The schedule.
+ */
+void MIDIUtilScheduleRebase( struct MIDIUtilSchedule * schedule ) {
+  schedule->origin = MIDIUtilScheduleDeadline( schedule );
+  schedule->tick   = 0;
+}
+
+/**
+ * @brief Schedule the runloop source of a schedule for the next deadline.
+ * The timeout is computed from the absolute deadline, minus the
+ * lookahead, so late wake-ups do not delay any of the following
+ * messages. A stopped schedule clears the timeout.
+ * @param schedule The schedule.
+ * @param clock    The clock the deadlines refer to.
+ * @param now      The current time.
+ * @retval 0 on success.
+ */
+int MIDIUtilScheduleTimeout( struct MIDIUtilSchedule * schedule, struct MIDIClock * clock, MIDITimestamp now ) {
+  struct timespec ts = { 0, 0 };
+  MIDITimestamp remain;
+  double seconds;
+  if( schedule->source == NULL ) return 0;
+  if( ! schedule->running ) {
+    return MIDIRunloopSourceClearTimeout( schedule->source );
+  }
+  remain = MIDIUtilScheduleDeadline( schedule ) - schedule->lookahead - now;
+  if( remain > 0 ) {
+    MIDIClockTimestampToSeconds( clock, remain, &seconds );
+    ts.tv_sec  = (time_t) seconds;
+    ts.tv_nsec = (long) ( ( seconds - ts.tv_sec ) * 1000000000.0 );
+  }
+  return MIDIRunloopSourceScheduleTimeout( schedule->source, &ts );
+}
+
 /** @} */
@@ -1,9 +1,21 @@
 #ifndef MIDIKIT_MIDI_UTIL_H
 #define MIDIKIT_MIDI_UTIL_H
+#include "midi.h"
 
 struct MIDIPort;
 struct MIDIDevice;
 struct MIDIDriver;
+struct MIDIClock;
+struct MIDIRunloopSource;
+
+struct MIDIUtilSchedule {
+  int           running;
+  struct MIDIRunloopSource * source;
+  MIDITimestamp origin;
+  MIDITimestamp lookahead;
+  long          tick;
+  double        period;
+};
 
 typedef unsigned int MIDIVarLen;
 int MIDIUtilReadVarLen( MIDIVarLen * value, size_t size, unsigned char * buffer, size_t * read );
@@ -11,4 +23,8 @@ int MIDIUtilWriteVarLen( MIDIVarLen * value, size_t size, unsigned char * buffer
 
 int MIDIDriverConnectDevice( struct MIDIDriver * driver, struct MIDIDevice * device );
 
+MIDITimestamp MIDIUtilScheduleDeadline( struct MIDIUtilSchedule * schedule );
+void MIDIUtilScheduleRebase( struct MIDIUtilSchedule * schedule );
+int MIDIUtilScheduleTimeout( struct MIDIUtilSchedule * schedule, struct MIDIClock * clock, MIDITimestamp now );
+
 #endif
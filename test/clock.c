@@ -1,4 +1,5 @@
 #include <unistd.h>
+#include <sys/time.h>
 #include "test.h"
 #include "midi/clock.h"
 
@@ -144,3 +145,108 @@ int test006_clock( void ) {
   ASSERT_GREATER( a, c-epsilon, "Roundtrip conversion did break timestamp." );
   return 0;
 }
+
+/**
+ * Test that timestamp conversion is exact, even for large timestamps.
+ */
+int test007_clock( void ) {
+  struct MIDIClock * clock  = MIDIClockCreate( MIDI_SAMPLING_RATE_48KHZ );
+  struct MIDIClock * source = MIDIClockCreate( MIDI_SAMPLING_RATE_44K1HZ );
+  MIDITimestamp now, a, b;
+  /* 48000/44100 = 160/147 */
+  MIDITimestamp delta = 147LL << 33;
+  int i;
+
+  ASSERT_NOT_EQUAL( clock, NULL, "Could not create MIDI clock." );
+  ASSERT_NOT_EQUAL( source, NULL, "Could not create MIDI clock." );
+  ASSERT_NO_ERROR( MIDIClockGetNow( source, &now ), "Could not get current clock time." );
+  for( i=0; i<1000; i++ ) {
+    a = now + i * 7919;
+    b = a + delta;
+    ASSERT_NO_ERROR( MIDIClockConvertTimestamp( clock, source, &a ), "Could not convert timestamp." );
+    ASSERT_NO_ERROR( MIDIClockConvertTimestamp( clock, source, &b ), "Could not convert timestamp." );
+    ASSERT_EQUAL( b - a, 160LL << 33, "Conversion of large timestamp is not exact." );
+  }
+  a = now;
+  ASSERT_NO_ERROR( MIDIClockConvertTimestamp( clock, source, &a ), "Could not convert timestamp." );
+  ASSERT_NO_ERROR( MIDIClockConvertTimestamp( source, clock, &a ), "Could not convert timestamp." );
+  ASSERT_LESS_OR_EQUAL( now - a, 1, "Roundtrip conversion did break timestamp." );
+  ASSERT_GREATER_OR_EQUAL( now - a, 0, "Roundtrip conversion did break timestamp." );
+
+  MIDIClockRelease( clock );
+  MIDIClockRelease( source );
+  return 0;
+}
+
+/**
+ * Test that batch conversion matches single conversion exactly.
+ */
+int test008_clock( void ) {
+  struct MIDIClock * clock  = MIDIClockCreate( MIDI_SAMPLING_RATE_96KHZ );
+  struct MIDIClock * source = MIDIClockCreate( MIDI_SAMPLING_RATE_11KHZ );
+  MIDITimestamp in[64], out[64], single;
+  double seconds[64], second;
+  int i;
+
+  ASSERT_NOT_EQUAL( clock, NULL, "Could not create MIDI clock." );
+  ASSERT_NOT_EQUAL( source, NULL, "Could not create MIDI clock." );
+  ASSERT_NO_ERROR( MIDIClockGetNow( source, &(in[0]) ), "Could not get current clock time." );
+  for( i=1; i<64; i++ ) {
+    in[i] = in[0] + ( i - 32 ) * 1000003LL * i;
+  }
+
+  ASSERT_NO_ERROR( MIDIClockConvertTimestamps( clock, source, 64, in, out ), "Could not convert timestamps." );
+  for( i=0; i<64; i++ ) {
+    single = in[i];
+    MIDIClockConvertTimestamp( clock, source, &single );
+    ASSERT_EQUAL( out[i], single, "Batch conversion does not match single conversion." );
+  }
+
+  ASSERT_NO_ERROR( MIDIClockTimestampsToSeconds( clock, 64, out, seconds ), "Could not convert to seconds." );
+  for( i=0; i<64; i++ ) {
+    MIDIClockTimestampToSeconds( clock, out[i], &second );
+    ASSERT_EQUAL( seconds[i], second, "Batch conversion to seconds does not match." );
+  }
+
+  ASSERT_NO_ERROR( MIDIClockTimestampsFromSeconds( source, 64, seconds, out ), "Could not convert from seconds." );
+  for( i=0; i<64; i++ ) {
+    MIDIClockTimestampFromSeconds( source, &single, seconds[i] );
+    ASSERT_EQUAL( out[i], single, "Batch conversion from seconds does not match." );
+  }
+
+  ASSERT_NO_ERROR( MIDIClockConvertTimestamps( clock, source, 64, in, in ), "Could not convert in place." );
+  ASSERT_NO_ERROR( MIDIClockTimestampToSeconds( clock, 144000, &second ), "Could not convert to seconds." );
+  ASSERT_EQUAL( second, 1.5, "Conversion to seconds truncates fractions." );
+
+  MIDIClockRelease( clock );
+  MIDIClockRelease( source );
+  return 0;
+}
+
+/**
+ * Test that wallclock times can be mapped into a clock's domain.
+ */
+int test009_clock( void ) {
+  struct MIDIClock * clock = MIDIClockCreate( MIDI_SAMPLING_RATE_48KHZ );
+  MIDITimestamp now, past;
+  struct timeval tv;
+  struct timespec wallclock;
+
+  ASSERT_NOT_EQUAL( clock, NULL, "Could not create MIDI clock." );
+  gettimeofday( &tv, NULL );
+  wallclock.tv_sec  = tv.tv_sec;
+  wallclock.tv_nsec = tv.tv_usec * 1000;
+  if( wallclock.tv_nsec < 10000000 ) {
+    wallclock.tv_sec  -= 1;
+    wallclock.tv_nsec += 1000000000;
+  }
+  wallclock.tv_nsec -= 10000000; /* 10ms ago */
+
+  ASSERT_NO_ERROR( MIDIClockTimestampFromWallclock( clock, &past, &wallclock ), "Could not convert wallclock time." );
+  ASSERT_NO_ERROR( MIDIClockGetNow( clock, &now ), "Could not get current clock time." );
+  ASSERT_GREATER_OR_EQUAL( now - past, 480, "Wallclock time was mapped too late." );
+  ASSERT_LESS( now - past, 960, "Wallclock time was mapped too early." );
+
+  MIDIClockRelease( clock );
+  return 0;
+}
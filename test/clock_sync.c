@@ -0,0 +1,88 @@
+#include "test.h"
+#include "midi/clock.h"
+#include "midi/clock_sync.h"
+
+#define SYNC_RATE     10000
+#define SYNC_OFFSET   5000000
+#define SYNC_INTERVAL 10000
+
+static MIDITimestamp _remote( MIDITimestamp local, int k ) {
+  /* remote clock runs 100ppm fast, with some jitter */
+  static const int jitter[] = { 0, 2, -1, 1, -2, 0, 1, -1 };
+  return SYNC_OFFSET + local + local / 10000 + jitter[k % 8];
+}
+
+/**
+ * Test that offset and skew are estimated and the converted
+ * time is monotonic while the estimate changes.
+ */
+int test001_clock_sync( void ) {
+  struct MIDIClock * clock = MIDIClockCreate( SYNC_RATE );
+  struct MIDIClockSync * sync;
+  MIDITimestamp local, remote, last = 0, t;
+  double skew, offset;
+  int k;
+
+  ASSERT_NOT_EQUAL( clock, NULL, "Could not create MIDI clock." );
+  sync = MIDIClockSyncCreate( clock, SYNC_RATE );
+  ASSERT_NOT_EQUAL( sync, NULL, "Could not create clock sync." );
+
+  for( k=0; k<40; k++ ) {
+    local  = k * SYNC_INTERVAL;
+    remote = _remote( local, k );
+    if( k == 20 ) remote += 500; /* outlier */
+    ASSERT_NO_ERROR( MIDIClockSyncAddSample( sync, local, remote ), "Could not add sample." );
+    for( t=local; t<local+SYNC_INTERVAL; t+=97 ) {
+      ASSERT_NO_ERROR( MIDIClockSyncLocalToRemote( sync, t, &remote ), "Could not convert local time." );
+      if( k > 0 ) {
+        ASSERT_GREATER_OR_EQUAL( remote, last, "Converted time runs backwards." );
+      }
+      last = remote;
+    }
+  }
+
+  ASSERT_NO_ERROR( MIDIClockSyncGetSkew( sync, &skew ), "Could not get skew." );
+  ASSERT( skew > 0.00008 && skew < 0.00012, "Skew estimate is off." );
+  ASSERT_NO_ERROR( MIDIClockSyncGetOffset( sync, &offset ), "Could not get offset." );
+  ASSERT( offset > SYNC_OFFSET && offset < SYNC_OFFSET + 40 * SYNC_INTERVAL / 10000 + 10, "Offset estimate is off." );
+
+  local = 50 * SYNC_INTERVAL;
+  ASSERT_NO_ERROR( MIDIClockSyncLocalToRemote( sync, local, &remote ), "Could not convert local time." );
+  ASSERT_LESS_OR_EQUAL( remote - _remote( local, 0 ), 3, "Converted time did not converge." );
+  ASSERT_GREATER_OR_EQUAL( remote - _remote( local, 0 ), -3, "Converted time did not converge." );
+  ASSERT_NO_ERROR( MIDIClockSyncRemoteToLocal( sync, remote, &t ), "Could not convert remote time." );
+  ASSERT_LESS_OR_EQUAL( local - t, 1, "Roundtrip conversion did break timestamp." );
+  ASSERT_GREATER_OR_EQUAL( local - t, 0, "Roundtrip conversion did break timestamp." );
+
+  MIDIClockSyncRelease( sync );
+  MIDIClockRelease( clock );
+  return 0;
+}
+
+/**
+ * Test that the current remote time never decreases, even when
+ * the estimate steps backwards.
+ */
+int test002_clock_sync( void ) {
+  struct MIDIClock * clock = MIDIClockCreate( SYNC_RATE );
+  struct MIDIClockSync * sync = MIDIClockSyncCreate( clock, SYNC_RATE );
+  MIDITimestamp local, a, b;
+
+  ASSERT_NOT_EQUAL( sync, NULL, "Could not create clock sync." );
+  ASSERT_NO_ERROR( MIDIClockGetNow( clock, &local ), "Could not get current clock time." );
+  ASSERT_NO_ERROR( MIDIClockSyncAddSample( sync, local, local + SYNC_OFFSET ), "Could not add sample." );
+  ASSERT_NO_ERROR( MIDIClockSyncGetNow( sync, &a ), "Could not get current remote time." );
+  ASSERT_GREATER_OR_EQUAL( a, local + SYNC_OFFSET, "Current remote time is too early." );
+
+  /* jump back by a full second, beyond the step threshold */
+  ASSERT_NO_ERROR( MIDIClockSyncAddSample( sync, local + 1, local + SYNC_OFFSET - SYNC_RATE ), "Could not add sample." );
+  ASSERT_NO_ERROR( MIDIClockSyncGetNow( sync, &b ), "Could not get current remote time." );
+  ASSERT_GREATER_OR_EQUAL( b, a, "Current remote time runs backwards." );
+
+  ASSERT_ERROR( MIDIClockSyncSetMaxSlew( sync, 0 ), "Accepted invalid slew rate." );
+  MIDIErrorNumber = 0;
+
+  MIDIClockSyncRelease( sync );
+  MIDIClockRelease( clock );
+  return 0;
+}
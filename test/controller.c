@@ -0,0 +1,236 @@
+#include "test.h"
+#include "midi/message.h"
+#include "midi/controller.h"
+
+#define N_PARAMETERS 0x3fff
+
+/**
+ * Test that non-registered parameters can be set and read back,
+ * including the full range of parameter numbers.
+ */
+int test001_controller( void ) {
+  struct MIDIController * controller = MIDIControllerCreate( NULL );
+  MIDIControlParameter p;
+  MIDILongValue value;
+  MIDIValue v;
+
+  ASSERT_NOT_EQUAL( controller, NULL, "Could not create controller." );
+  ASSERT_GREATER( MIDIControllerGetNonRegisteredParameter( controller, 0x123, sizeof(MIDILongValue), &value ), 0,
+                  "Got value of unset parameter." );
+
+  for( p=0; p<N_PARAMETERS; p++ ) {
+    value = ( p * 7 ) & 0x3fff;
+    ASSERT_NO_ERROR( MIDIControllerSetNonRegisteredParameter( controller, p, sizeof(MIDILongValue), &value ),
+                     "Could not set non-registered parameter." );
+  }
+  for( p=0; p<N_PARAMETERS; p++ ) {
+    ASSERT_NO_ERROR( MIDIControllerGetNonRegisteredParameter( controller, p, sizeof(MIDILongValue), &value ),
+                     "Could not get non-registered parameter." );
+    ASSERT_EQUAL( value, ( p * 7 ) & 0x3fff, "Non-registered parameter has wrong value." );
+  }
+
+  ASSERT_NO_ERROR( MIDIControllerGetControl( controller, MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER, sizeof(MIDILongValue), &value ),
+                   "Could not get non-registered parameter number." );
+  ASSERT_EQUAL( value, N_PARAMETERS-1, "Non-registered parameter number was not selected." );
+  ASSERT_NO_ERROR( MIDIControllerGetControl( controller, MIDI_CONTROL_DATA_ENTRY, sizeof(MIDIValue), &v ),
+                   "Could not get data entry." );
+  ASSERT_EQUAL( v, MIDI_MSB( ( (N_PARAMETERS-1) * 7 ) & 0x3fff ), "Data entry was not updated." );
+
+  MIDIControllerRelease( controller );
+  return 0;
+}
+
+/**
+ * Test that received data entry messages update the selected
+ * non-registered parameter and that selecting a parameter recalls
+ * its value.
+ */
+int test002_controller( void ) {
+  struct MIDIController * controller = MIDIControllerCreate( NULL );
+  MIDILongValue value;
+  MIDIValue v;
+
+  /* select 0x0201, set it to 0x0a05 and increment once */
+  ASSERT_NO_ERROR( MIDIControllerReceiveControlChange( controller, NULL, MIDI_CHANNEL_1, MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_MSB, 0x04 ), "Could not receive NRPN MSB." );
+  ASSERT_NO_ERROR( MIDIControllerReceiveControlChange( controller, NULL, MIDI_CHANNEL_1, MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_LSB, 0x01 ), "Could not receive NRPN LSB." );
+  ASSERT_NO_ERROR( MIDIControllerReceiveControlChange( controller, NULL, MIDI_CHANNEL_1, MIDI_CONTROL_DATA_ENTRY, 0x14 ), "Could not receive data entry." );
+  ASSERT_NO_ERROR( MIDIControllerReceiveControlChange( controller, NULL, MIDI_CHANNEL_1, MIDI_CONTROL_DATA_ENTRY+32, 0x05 ), "Could not receive data entry LSB." );
+  ASSERT_NO_ERROR( MIDIControllerReceiveControlChange( controller, NULL, MIDI_CHANNEL_1, MIDI_CONTROL_DATA_INCREMENT, 0 ), "Could not receive data increment." );
+  ASSERT_NO_ERROR( MIDIControllerGetNonRegisteredParameter( controller, 0x0201, sizeof(MIDILongValue), &value ),
+                   "Could not get non-registered parameter." );
+  ASSERT_EQUAL( value, MIDI_LONG_VALUE( 0x14, 0x06 ), "Received data entry was not stored." );
+
+  /* select 0x0202, which has no value yet */
+  ASSERT_NO_ERROR( MIDIControllerReceiveControlChange( controller, NULL, MIDI_CHANNEL_1, MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_LSB, 0x02 ), "Could not receive NRPN LSB." );
+  ASSERT_NO_ERROR( MIDIControllerGetControl( controller, MIDI_CONTROL_DATA_ENTRY, sizeof(MIDIValue), &v ), "Could not get data entry." );
+  ASSERT_EQUAL( v, 0, "Data entry of new parameter is not zero." );
+  ASSERT_NO_ERROR( MIDIControllerReceiveControlChange( controller, NULL, MIDI_CHANNEL_1, MIDI_CONTROL_DATA_ENTRY, 0x33 ), "Could not receive data entry." );
+
+  /* select 0x0201 again */
+  ASSERT_NO_ERROR( MIDIControllerReceiveControlChange( controller, NULL, MIDI_CHANNEL_1, MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_LSB, 0x01 ), "Could not receive NRPN LSB." );
+  ASSERT_NO_ERROR( MIDIControllerGetControl( controller, MIDI_CONTROL_DATA_ENTRY+32, sizeof(MIDIValue), &v ), "Could not get data entry LSB." );
+  ASSERT_EQUAL( v, 0x06, "Stored value was not recalled." );
+  ASSERT_NO_ERROR( MIDIControllerGetNonRegisteredParameter( controller, 0x0202, sizeof(MIDIValue), &v ),
+                   "Could not get non-registered parameter." );
+  ASSERT_EQUAL( v, 0x33, "Second parameter has wrong value." );
+
+  /* null function number deselects the parameter */
+  ASSERT_NO_ERROR( MIDIControllerReceiveControlChange( controller, NULL, MIDI_CHANNEL_1, MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_MSB, 0x7f ), "Could not receive NRPN MSB." );
+  ASSERT_NO_ERROR( MIDIControllerReceiveControlChange( controller, NULL, MIDI_CHANNEL_1, MIDI_CONTROL_NON_REGISTERED_PARAMETER_NUMBER_LSB, 0x7f ), "Could not receive NRPN LSB." );
+  ASSERT_NO_ERROR( MIDIControllerReceiveControlChange( controller, NULL, MIDI_CHANNEL_1, MIDI_CONTROL_DATA_ENTRY, 0x01 ), "Could not receive data entry." );
+  ASSERT_GREATER( MIDIControllerGetNonRegisteredParameter( controller, MIDI_CONTROL_RPN_RESET, sizeof(MIDIValue), &v ), 0,
+                  "Null function number was stored." );
+
+  MIDIControllerRelease( controller );
+  return 0;
+}
+
+/**
+ * Test that a stored controller state can be recalled and that deltas
+ * only contain the values that changed after a given version.
+ */
+int test003_controller( void ) {
+  struct MIDIController * a = MIDIControllerCreate( NULL );
+  struct MIDIController * b = MIDIControllerCreate( NULL );
+  unsigned char buffer[1024], small[8];
+  unsigned long version;
+  size_t size, n;
+  MIDIControlParameter p;
+  MIDILongValue value;
+  MIDIValue v;
+
+  for( p=0x100; p<0x140; p++ ) {
+    value = p;
+    ASSERT_NO_ERROR( MIDIControllerSetNonRegisteredParameter( a, p, sizeof(MIDILongValue), &value ),
+                     "Could not set non-registered parameter." );
+  }
+  v = 42;
+  ASSERT_NO_ERROR( MIDIControllerSetControl( a, MIDI_CONTROL_BALANCE, sizeof(MIDIValue), &v ), "Could not set control." );
+
+  ASSERT_NO_ERROR( MIDIControllerStore( a, sizeof(buffer), buffer, &size ), "Could not store controller." );
+  ASSERT_GREATER( size, 64*5, "Stored state is too small." );
+  ASSERT_GREATER( MIDIControllerStore( a, sizeof(small), small, &n ), 0, "Stored state in too small buffer." );
+  ASSERT_EQUAL( n, size, "Required size was not reported." );
+  ASSERT_NO_ERROR( MIDIControllerRecall( b, size, buffer, &n ), "Could not recall controller." );
+  ASSERT_EQUAL( n, size, "Not all stored bytes were read." );
+  ASSERT_NO_ERROR( MIDIControllerGetNonRegisteredParameter( b, 0x120, sizeof(MIDILongValue), &value ),
+                   "Recalled controller is missing a parameter." );
+  ASSERT_EQUAL( value, 0x120, "Recalled parameter has wrong value." );
+  ASSERT_NO_ERROR( MIDIControllerGetControl( b, MIDI_CONTROL_BALANCE, sizeof(MIDIValue), &v ), "Could not get control." );
+  ASSERT_EQUAL( v, 42, "Recalled control has wrong value." );
+
+  /* change one control and one parameter */
+  ASSERT_NO_ERROR( MIDIControllerGetVersion( a, &version ), "Could not get version." );
+  ASSERT_NO_ERROR( MIDIControllerStoreDelta( a, version, sizeof(buffer), buffer, &size ), "Could not store delta." );
+  ASSERT_EQUAL( size, 0, "Delta without changes is not empty." );
+  v = 42;
+  ASSERT_NO_ERROR( MIDIControllerSetControl( a, MIDI_CONTROL_BALANCE, sizeof(MIDIValue), &v ), "Could not set control." );
+  ASSERT_NO_ERROR( MIDIControllerStoreDelta( a, version, sizeof(buffer), buffer, &size ), "Could not store delta." );
+  ASSERT_EQUAL( size, 0, "Unchanged value is in delta." );
+
+  v = 7;
+  ASSERT_NO_ERROR( MIDIControllerSetControl( a, MIDI_CONTROL_PAN, sizeof(MIDIValue), &v ), "Could not set control." );
+  value = 0x1234;
+  ASSERT_NO_ERROR( MIDIControllerSetNonRegisteredParameter( a, 0x101, sizeof(MIDILongValue), &value ),
+                   "Could not set non-registered parameter." );
+  ASSERT_NO_ERROR( MIDIControllerStoreDelta( a, version, sizeof(buffer), buffer, &size ), "Could not store delta." );
+  /* pan, data entry msb & lsb, nrpn number lsb, parameter and selection */
+  ASSERT_EQUAL( size, 4*3 + 5 + 4, "Delta has wrong size." );
+  ASSERT_NO_ERROR( MIDIControllerRecall( b, size, buffer, &n ), "Could not recall delta." );
+  ASSERT_NO_ERROR( MIDIControllerGetNonRegisteredParameter( b, 0x101, sizeof(MIDILongValue), &value ),
+                   "Could not get non-registered parameter." );
+  ASSERT_EQUAL( value, 0x1234, "Delta parameter was not recalled." );
+  ASSERT_NO_ERROR( MIDIControllerGetControl( b, MIDI_CONTROL_PAN, sizeof(MIDIValue), &v ), "Could not get control." );
+  ASSERT_EQUAL( v, 7, "Delta control was not recalled." );
+  ASSERT_NO_ERROR( MIDIControllerGetNonRegisteredParameter( b, 0x13f, sizeof(MIDILongValue), &value ),
+                   "Could not get non-registered parameter." );
+  ASSERT_EQUAL( value, 0x13f, "Unchanged parameter was lost." );
+
+  buffer[0] = 0x7f;
+  ASSERT_GREATER( MIDIControllerRecall( b, 1, buffer, &n ), 0, "Recalled invalid record." );
+
+  MIDIControllerRelease( a );
+  MIDIControllerRelease( b );
+  return 0;
+}
+
+/**
+ * Test that the diff between two controllers moves a receiver from
+ * the first to the second state with few messages.
+ */
+int test004_controller( void ) {
+  struct MIDIController * a = MIDIControllerCreate( NULL );
+  struct MIDIController * b = MIDIControllerCreate( NULL );
+  struct MIDIController * c = MIDIControllerCreate( NULL );
+  struct MIDIMessageBatch * batch = MIDIMessageBatchCreate( 0 );
+  unsigned char buffer[1024];
+  MIDIRunningStatus status = 0;
+  MIDIChannel channel;
+  MIDIControl control;
+  MIDIControlParameter p;
+  MIDILongValue value, other;
+  MIDIValue v, w;
+  size_t i, length, size;
+
+  value = 0x100;
+  ASSERT_NO_ERROR( MIDIControllerSetNonRegisteredParameter( a, 0x0105, sizeof(MIDILongValue), &value ), "Could not set parameter." );
+  ASSERT_NO_ERROR( MIDIControllerSetNonRegisteredParameter( a, 0x0300, sizeof(MIDILongValue), &value ), "Could not set parameter." );
+  ASSERT_NO_ERROR( MIDIControllerSetNonRegisteredParameter( b, 0x0300, sizeof(MIDILongValue), &value ), "Could not set parameter." );
+  value = 0x2000;
+  ASSERT_NO_ERROR( MIDIControllerSetNonRegisteredParameter( b, 0x0105, sizeof(MIDILongValue), &value ), "Could not set parameter." );
+  value = 0x10;
+  ASSERT_NO_ERROR( MIDIControllerSetNonRegisteredParameter( b, 0x0106, sizeof(MIDILongValue), &value ), "Could not set parameter." );
+  value = MIDI_LONG_VALUE( 12, 0 );
+  ASSERT_NO_ERROR( MIDIControllerSetRegisteredParameter( b, MIDI_CONTROL_RPN_PITCH_BEND_RANGE, sizeof(MIDILongValue), &value ), "Could not set parameter." );
+  v = 90;
+  ASSERT_NO_ERROR( MIDIControllerSetControl( b, MIDI_CONTROL_CHANNEL_VOLUME, sizeof(MIDIValue), &v ), "Could not set control." );
+  /* channel mode messages are not part of the diff */
+  v = 0x7f;
+  ASSERT_NO_ERROR( MIDIControllerSetControl( b, MIDI_CONTROL_LOCAL_CONTROL, sizeof(MIDIValue), &v ), "Could not set control." );
+
+  /* c starts as a copy of a */
+  ASSERT_NO_ERROR( MIDIControllerStore( a, sizeof(buffer), buffer, &size ), "Could not store controller." );
+  ASSERT_NO_ERROR( MIDIControllerRecall( c, size, buffer, NULL ), "Could not recall controller." );
+
+  ASSERT_NO_ERROR( MIDIControllerDiff( a, b, MIDI_CHANNEL_3, batch ), "Could not create diff." );
+  ASSERT_NO_ERROR( MIDIMessageBatchGetLength( batch, &length ), "Could not get batch length." );
+  /* volume, NRPN 0x105 (MSB, LSB, data MSB), NRPN 0x106 (LSB, data LSB),
+   * RPN 0 (MSB, LSB, data MSB), which stays selected */
+  ASSERT_EQUAL( length, 9, "Diff has unexpected number of messages." );
+  i = 0;
+  while( MIDIMessageBatchNextControlChange( batch, &i, &channel, &control, &v ) == 0 ) {
+    ASSERT_EQUAL( channel, MIDI_CHANNEL_3, "Diff message has wrong channel." );
+    ASSERT_NO_ERROR( MIDIControllerReceiveControlChange( c, NULL, channel, control, v ), "Could not receive control change." );
+  }
+  ASSERT_NO_ERROR( MIDIMessageBatchEncode( batch, &status, sizeof(buffer), buffer, &size ), "Could not encode batch." );
+  ASSERT_EQUAL( size, 1 + 2 * length, "Batch was not encoded with running status." );
+
+  for( control=0; control<MIDI_CONTROL_ALL_SOUND_OFF; control++ ) {
+    if( control == MIDI_CONTROL_DATA_INCREMENT || control == MIDI_CONTROL_DATA_DECREMENT ) continue;
+    ASSERT_NO_ERROR( MIDIControllerGetControl( b, control, sizeof(MIDIValue), &v ), "Could not get control." );
+    ASSERT_NO_ERROR( MIDIControllerGetControl( c, control, sizeof(MIDIValue), &w ), "Could not get control." );
+    ASSERT_EQUAL( v, w, "Control was not synchronized." );
+  }
+  for( p=MIDI_CONTROL_RPN_PITCH_BEND_RANGE; p<=MIDI_CONTROL_RPN_COARSE_TUNING; p++ ) {
+    ASSERT_NO_ERROR( MIDIControllerGetRegisteredParameter( b, p, sizeof(MIDILongValue), &value ), "Could not get parameter." );
+    ASSERT_NO_ERROR( MIDIControllerGetRegisteredParameter( c, p, sizeof(MIDILongValue), &other ), "Could not get parameter." );
+    ASSERT_EQUAL( value, other, "Registered parameter was not synchronized." );
+  }
+  for( p=0x0105; p<=0x0106; p++ ) {
+    ASSERT_NO_ERROR( MIDIControllerGetNonRegisteredParameter( b, p, sizeof(MIDILongValue), &value ), "Could not get parameter." );
+    ASSERT_NO_ERROR( MIDIControllerGetNonRegisteredParameter( c, p, sizeof(MIDILongValue), &other ), "Could not get parameter." );
+    ASSERT_EQUAL( value, other, "Non-registered parameter was not synchronized." );
+  }
+
+  /* no messages for equal states */
+  ASSERT_NO_ERROR( MIDIMessageBatchClear( batch ), "Could not clear batch." );
+  ASSERT_NO_ERROR( MIDIControllerDiff( c, b, MIDI_CHANNEL_3, batch ), "Could not create diff." );
+  ASSERT_NO_ERROR( MIDIMessageBatchGetLength( batch, &length ), "Could not get batch length." );
+  ASSERT_EQUAL( length, 0, "Diff of equal states is not empty." );
+
+  MIDIMessageBatchRelease( batch );
+  MIDIControllerRelease( a );
+  MIDIControllerRelease( b );
+  MIDIControllerRelease( c );
+  return 0;
+}
@@ -1,15 +1,54 @@
 #include "test.h"
+#include "midi/clock.h"
 #include "midi/port.h"
 #include "midi/message.h"
 #include "midi/device.h"
+#include "midi/driver.h"
+#include "midi/controller.h"
+#include "midi/timer.h"
+
+#define DEVICE_MESSAGES 400000
 
 MIDIStatus _status;
 
+static int _n_recv = 0;
+static int _sum = 0;
+
+static int _receive_note( struct MIDIDevice * device, MIDIChannel channel, MIDIKey key, MIDIVelocity velocity ) {
+  _sum += channel + key + velocity;
+  _n_recv++;
+  return 0;
+}
+
+static int _receive_cc( struct MIDIDevice * device, MIDIChannel channel, MIDIControl control, MIDIValue value ) {
+  _sum += channel + control + value;
+  _n_recv++;
+  return 0;
+}
+
+static int _receive_pwc( struct MIDIDevice * device, MIDIChannel channel, MIDILongValue value ) {
+  _sum += channel + value;
+  _n_recv++;
+  return 0;
+}
+
 static int _receive_rt( struct MIDIDevice * device, MIDIStatus status, MIDITimestamp timestamp ) {
   _status = status;
   return 0;
 }
 
+static int _n_batch = 0;
+static int _n_batch_notes = 0;
+
+static int _receive_batch( struct MIDIDevice * device, struct MIDIMessageBatch * batch ) {
+  size_t i = 0;
+  while( MIDIMessageBatchNextNote( batch, &i, NULL, NULL, NULL, NULL ) == 0 ) {
+    _n_batch_notes++;
+  }
+  _n_batch++;
+  return 0;
+}
+
 static struct MIDIDeviceDelegate _test_device = {
   NULL, /* recv_nof  */
   NULL, /* recv_non  */
@@ -24,7 +63,8 @@ static struct MIDIDeviceDelegate _test_device = {
   NULL, /* recv_ss   */
   NULL, /* recv_tr   */
   NULL, /* recv_eox  */
-  &_receive_rt
+  &_receive_rt,
+  NULL  /* recv_batch */
 };
 
 /**
@@ -89,3 +129,281 @@ int test002_device( void ) {
   MIDIDeviceRelease( device_slave );
   return 0;
 }
+
+/**
+ * Test that received messages are dispatched with the correct fields
+ * only to the callbacks that are set, and report the throughput.
+ */
+int test003_device( void ) {
+  struct MIDIDeviceDelegate delegate = { NULL };
+  struct MIDIClock * clock = MIDIClockCreate( 1000000 );
+  struct MIDIDevice * device = MIDIDeviceCreate( NULL );
+  struct MIDIMessage * message[5];
+  MIDITimestamp start, end;
+  MIDIChannel channel = MIDI_CHANNEL_3;
+  MIDIKey key = 60;
+  MIDIVelocity velocity = 100;
+  MIDIControl control = 7;
+  MIDIValue value = 90;
+  MIDILongValue pitch = 0x2345;
+  int i;
+
+  message[0] = MIDIMessageCreate( MIDI_STATUS_NOTE_ON );
+  message[1] = MIDIMessageCreate( MIDI_STATUS_CONTROL_CHANGE );
+  message[2] = MIDIMessageCreate( MIDI_STATUS_PITCH_WHEEL_CHANGE );
+  message[3] = MIDIMessageCreate( MIDI_STATUS_NOTE_OFF );
+  message[4] = MIDIMessageCreate( MIDI_STATUS_TIMING_CLOCK );
+  for( i=0; i<4; i++ ) {
+    ASSERT_NO_ERROR( MIDIMessageSet( message[i], MIDI_CHANNEL, sizeof(MIDIChannel), &channel ), "Could not set channel." );
+  }
+  MIDIMessageSet( message[0], MIDI_KEY, sizeof(MIDIKey), &key );
+  MIDIMessageSet( message[0], MIDI_VELOCITY, sizeof(MIDIVelocity), &velocity );
+  MIDIMessageSet( message[1], MIDI_CONTROL, sizeof(MIDIControl), &control );
+  MIDIMessageSet( message[1], MIDI_VALUE, sizeof(MIDIValue), &value );
+  MIDIMessageSet( message[2], MIDI_VALUE, sizeof(MIDILongValue), &pitch );
+  MIDIMessageSet( message[3], MIDI_KEY, sizeof(MIDIKey), &key );
+
+  /* callbacks are resolved when the delegate is set */
+  delegate.recv_non = &_receive_note;
+  _n_recv = 0;
+  _sum    = 0;
+  for( i=0; i<5; i++ ) {
+    ASSERT_NO_ERROR( MIDIDeviceReceive( device, message[i] ), "Could not receive message." );
+  }
+  ASSERT_EQUAL( _n_recv, 0, "Device without delegate called a callback." );
+  ASSERT_NO_ERROR( MIDIDeviceSetDelegate( device, &delegate ), "Could not set delegate." );
+  for( i=0; i<5; i++ ) {
+    ASSERT_NO_ERROR( MIDIDeviceReceive( device, message[i] ), "Could not receive message." );
+  }
+  ASSERT_EQUAL( _n_recv, 1, "Unset callbacks were called." );
+  ASSERT_EQUAL( _sum, channel + key + velocity, "Note on fields were not decoded correctly." );
+
+  delegate.recv_nof = &_receive_note;
+  delegate.recv_cc  = &_receive_cc;
+  delegate.recv_pwc = &_receive_pwc;
+  ASSERT_NO_ERROR( MIDIDeviceSetDelegate( device, &delegate ), "Could not set delegate." );
+  _n_recv = 0;
+  _sum    = 0;
+  for( i=0; i<5; i++ ) {
+    ASSERT_NO_ERROR( MIDIDeviceReceive( device, message[i] ), "Could not receive message." );
+  }
+  ASSERT_EQUAL( _n_recv, 4, "Not every callback was called." );
+  ASSERT_EQUAL( _sum, 2 * ( channel + key ) + velocity + channel + control + value + channel + pitch,
+                "Message fields were not decoded correctly." );
+
+  _n_recv = 0;
+  MIDIClockGetNow( clock, &start );
+  for( i=0; i<DEVICE_MESSAGES; i++ ) {
+    MIDIDeviceReceive( device, message[i%5] );
+  }
+  MIDIClockGetNow( clock, &end );
+  ASSERT_EQUAL( _n_recv, DEVICE_MESSAGES / 5 * 4, "Not every message was dispatched." );
+  if( end <= start ) end = start + 1;
+  printf( "Device throughput: %d messages in %lld usec (%.0f messages/sec)\n",
+          DEVICE_MESSAGES, end - start, DEVICE_MESSAGES * 1000000.0 / ( end - start ) );
+
+  for( i=0; i<5; i++ ) {
+    MIDIMessageRelease( message[i] );
+  }
+  MIDIDeviceRelease( device );
+  MIDIClockRelease( clock );
+  return 0;
+}
+
+/**
+ * Test that a batch sent through a loopback driver reaches the batch
+ * callback once instead of the per-message callbacks, while the
+ * messages are still routed to the timer and the note tracking.
+ * Without a batch callback every message is dispatched on its own.
+ */
+int test004_device( void ) {
+  struct MIDIDeviceDelegate delegate = { NULL };
+  struct MIDIDriver * driver = MIDIDriverCreate( "loopback", MIDI_SAMPLING_RATE_DEFAULT );
+  struct MIDIDevice * out = MIDIDeviceCreate( NULL );
+  struct MIDIDevice * in;
+  struct MIDITimer * timer = MIDITimerCreate( NULL );
+  struct MIDIMessageBatch * batch = MIDIMessageBatchCreate( 0 );
+  struct MIDIMessage * message;
+  struct MIDIPort * port;
+  MIDILongValue position;
+  MIDIVelocity velocity = 100;
+  uint64_t notes[2];
+  MIDIKey key;
+  int i;
+
+  delegate.recv_non   = &_receive_note;
+  delegate.recv_batch = &_receive_batch;
+  in = MIDIDeviceCreate( &delegate );
+  ASSERT_NO_ERROR( MIDIDeviceSetTimer( in, timer ), "Could not set timer." );
+  ASSERT_NO_ERROR( MIDIDriverMakeLoopback( driver ), "Could not make loopback driver." );
+  ASSERT_NO_ERROR( MIDIDriverGetPort( driver, &port ), "Could not get driver port." );
+  ASSERT_NO_ERROR( MIDIDeviceAttachOut( out, port ), "Could not attach out port." );
+  ASSERT_NO_ERROR( MIDIDeviceAttachIn( in, port ), "Could not attach in port." );
+
+  for( key=0; key<64; key++ ) {
+    message = MIDIMessageCreate( MIDI_STATUS_NOTE_ON );
+    MIDIMessageSet( message, MIDI_KEY, sizeof(MIDIKey), &key );
+    MIDIMessageSet( message, MIDI_VELOCITY, sizeof(MIDIVelocity), &velocity );
+    ASSERT_NO_ERROR( MIDIMessageBatchAppend( batch, message ), "Could not append message." );
+    MIDIMessageRelease( message );
+  }
+  message = MIDIMessageCreate( MIDI_STATUS_START );
+  ASSERT_NO_ERROR( MIDIMessageBatchAppend( batch, message ), "Could not append message." );
+  MIDIMessageRelease( message );
+  for( i=0; i<12; i++ ) {
+    message = MIDIMessageCreate( MIDI_STATUS_TIMING_CLOCK );
+    MIDIMessageSetTimestamp( message, 1000 * ( i + 1 ) );
+    ASSERT_NO_ERROR( MIDIMessageBatchAppend( batch, message ), "Could not append message." );
+    MIDIMessageRelease( message );
+  }
+
+  _n_recv  = 0;
+  _n_batch = 0;
+  _n_batch_notes = 0;
+  ASSERT_NO_ERROR( MIDIDeviceSendBatch( out, batch ), "Could not send batch." );
+  ASSERT_EQUAL( _n_batch, 1, "Batch callback was not called once." );
+  ASSERT_EQUAL( _n_batch_notes, 64, "Batch did not contain every note." );
+  ASSERT_EQUAL( _n_recv, 0, "Note callback was called for a batch." );
+  ASSERT_NO_ERROR( MIDIDeviceGetActiveNotes( in, MIDI_DEVICE_NOTES_RECEIVED, MIDI_CHANNEL_1, notes ), "Could not get active notes." );
+  ASSERT( notes[0] == ~0ULL && notes[1] == 0, "Batch notes were not tracked." );
+  ASSERT_NO_ERROR( MIDITimerGetSongPosition( timer, &position ), "Could not get song position." );
+  ASSERT_EQUAL( position, 2, "Batch clocks did not reach the timer." );
+
+  delegate.recv_batch = NULL;
+  ASSERT_NO_ERROR( MIDIDeviceSetDelegate( in, &delegate ), "Could not set delegate." );
+  _n_recv  = 0;
+  _n_batch = 0;
+  ASSERT_NO_ERROR( MIDIDeviceSendBatch( out, batch ), "Could not send batch." );
+  ASSERT_EQUAL( _n_batch, 0, "Unset batch callback was called." );
+  ASSERT_EQUAL( _n_recv, 64, "Note callback was not called for every note." );
+
+  MIDIMessageBatchRelease( batch );
+  MIDIDeviceRelease( in );
+  MIDIDeviceRelease( out );
+  MIDITimerRelease( timer );
+  MIDIDriverRelease( driver );
+  return 0;
+}
+
+/**
+ * Test that received and sent notes are tracked and that a panic
+ * sends note offs only for the sounding notes.
+ */
+int test005_device( void ) {
+  struct MIDIDeviceDelegate delegate = { NULL };
+  struct MIDIDriver * driver = MIDIDriverCreate( "loopback", MIDI_SAMPLING_RATE_DEFAULT );
+  struct MIDIDevice * out = MIDIDeviceCreate( NULL );
+  struct MIDIDevice * in;
+  struct MIDIMessage * message;
+  struct MIDIPort * port;
+  uint64_t notes[2];
+  size_t count;
+  MIDIChannel channel = MIDI_CHANNEL_4;
+  MIDIKey key = 100;
+  MIDIVelocity velocity = 77;
+  MIDITimestamp timestamp = 12345;
+
+  delegate.recv_nof = &_receive_note;
+  in = MIDIDeviceCreate( &delegate );
+  ASSERT_NO_ERROR( MIDIDriverMakeLoopback( driver ), "Could not make loopback driver." );
+  ASSERT_NO_ERROR( MIDIDriverGetPort( driver, &port ), "Could not get driver port." );
+  ASSERT_NO_ERROR( MIDIDeviceAttachOut( out, port ), "Could not attach out port." );
+  ASSERT_NO_ERROR( MIDIDeviceAttachIn( in, port ), "Could not attach in port." );
+  ASSERT_NO_ERROR( MIDIDeviceSetNoteDetails( in, MIDI_ON ), "Could not enable note details." );
+
+  ASSERT_NO_ERROR( MIDIDeviceSendNoteOn( out, MIDI_CHANNEL_1, 60, 100 ), "Could not send note on." );
+  ASSERT_NO_ERROR( MIDIDeviceSendNoteOn( out, MIDI_CHANNEL_1, 64, 100 ), "Could not send note on." );
+  ASSERT_NO_ERROR( MIDIDeviceSendNoteOn( out, MIDI_CHANNEL_1, 67, 100 ), "Could not send note on." );
+  ASSERT_NO_ERROR( MIDIDeviceSendNoteOn( out, MIDI_CHANNEL_1, 67, 0 ), "Could not send note on." );
+  ASSERT_NO_ERROR( MIDIDeviceSendNoteOn( out, MIDI_CHANNEL_2, 36, 90 ), "Could not send note on." );
+
+  message = MIDIMessageCreate( MIDI_STATUS_NOTE_ON );
+  MIDIMessageSet( message, MIDI_CHANNEL, sizeof(MIDIChannel), &channel );
+  MIDIMessageSet( message, MIDI_KEY, sizeof(MIDIKey), &key );
+  MIDIMessageSet( message, MIDI_VELOCITY, sizeof(MIDIVelocity), &velocity );
+  MIDIMessageSetTimestamp( message, timestamp );
+  ASSERT_NO_ERROR( MIDIDeviceSend( out, message ), "Could not send note on." );
+  MIDIMessageRelease( message );
+
+  ASSERT_NO_ERROR( MIDIDeviceGetActiveNotes( in, MIDI_DEVICE_NOTES_RECEIVED, MIDI_CHANNEL_1, notes ), "Could not get active notes." );
+  ASSERT( notes[0] == ( 1ULL << 60 ) && notes[1] == ( 1ULL << ( 64 - 64 ) ), "Received notes are wrong." );
+  ASSERT_NO_ERROR( MIDIDeviceGetActiveNotes( in, MIDI_DEVICE_NOTES_RECEIVED, MIDI_CHANNEL_ALL, notes ), "Could not get active notes." );
+  ASSERT( notes[0] == ( ( 1ULL << 36 ) | ( 1ULL << 60 ) ) && notes[1] == ( ( 1ULL << ( 64 - 64 ) ) | ( 1ULL << ( 100 - 64 ) ) ),
+          "Combined notes are wrong." );
+  ASSERT_NO_ERROR( MIDIDeviceGetActiveNoteCount( out, MIDI_DEVICE_NOTES_SENT, MIDI_CHANNEL_ALL, &count ), "Could not count notes." );
+  ASSERT_EQUAL( count, 4, "Sent note count is wrong." );
+
+  velocity = 0;
+  timestamp = 0;
+  ASSERT_NO_ERROR( MIDIDeviceGetNoteDetails( in, MIDI_DEVICE_NOTES_RECEIVED, channel, key, &velocity, &timestamp ), "Could not get note details." );
+  ASSERT( velocity == 77 && timestamp == 12345, "Note details are wrong." );
+  ASSERT_NOT_EQUAL( MIDIDeviceGetNoteDetails( in, MIDI_DEVICE_NOTES_RECEIVED, channel, 99, NULL, NULL ), 0, "Inactive note has details." );
+
+  /* all notes off clears the channel on the receiving side only */
+  ASSERT_NO_ERROR( MIDIDeviceReceiveControlChange( in, MIDI_CHANNEL_2, MIDI_CONTROL_ALL_NOTES_OFF, 0 ), "Could not receive all notes off." );
+  ASSERT_NO_ERROR( MIDIDeviceGetActiveNoteCount( in, MIDI_DEVICE_NOTES_RECEIVED, MIDI_CHANNEL_ALL, &count ), "Could not count notes." );
+  ASSERT_EQUAL( count, 3, "All notes off did not clear the channel." );
+
+  _n_recv = 0;
+  ASSERT_NO_ERROR( MIDIDeviceSendPanic( out, MIDI_CHANNEL_ALL ), "Could not send panic." );
+  ASSERT_EQUAL( _n_recv, 4, "Panic did not send one note off per sounding note." );
+  ASSERT_NO_ERROR( MIDIDeviceGetActiveNoteCount( out, MIDI_DEVICE_NOTES_SENT, MIDI_CHANNEL_ALL, &count ), "Could not count notes." );
+  ASSERT_EQUAL( count, 0, "Panic left sent notes active." );
+  ASSERT_NO_ERROR( MIDIDeviceGetActiveNoteCount( in, MIDI_DEVICE_NOTES_RECEIVED, MIDI_CHANNEL_ALL, &count ), "Could not count notes." );
+  ASSERT_EQUAL( count, 0, "Panic left received notes active." );
+
+  /* the base channel is resolved before notes are tracked */
+  ASSERT_NO_ERROR( MIDIDeviceSetBaseChannel( in, MIDI_CHANNEL_5 ), "Could not set base channel." );
+  ASSERT_NO_ERROR( MIDIDeviceReceiveNoteOn( in, MIDI_CHANNEL_BASE, 60, 100 ), "Could not receive note on." );
+  ASSERT_NO_ERROR( MIDIDeviceGetActiveNotes( in, MIDI_DEVICE_NOTES_RECEIVED, MIDI_CHANNEL_5, notes ), "Could not get active notes." );
+  ASSERT( notes[0] == ( 1ULL << 60 ) && notes[1] == 0, "Note on the base channel was not tracked." );
+  ASSERT_NO_ERROR( MIDIDeviceReceiveControlChange( in, MIDI_CHANNEL_BASE, MIDI_CONTROL_ALL_NOTES_OFF, 0 ), "Could not receive all notes off." );
+  ASSERT_NO_ERROR( MIDIDeviceGetActiveNoteCount( in, MIDI_DEVICE_NOTES_RECEIVED, MIDI_CHANNEL_ALL, &count ), "Could not count notes." );
+  ASSERT_EQUAL( count, 0, "All notes off on the base channel did not clear it." );
+
+  MIDIDeviceRelease( in );
+  MIDIDeviceRelease( out );
+  MIDIDriverRelease( driver );
+  return 0;
+}
+
+/**
+ * Test that in Omni mode every controller receives a control change
+ * exactly once, even if it is attached to several channels.
+ */
+int test006_device( void ) {
+  struct MIDIDevice * device = MIDIDeviceCreate( NULL );
+  struct MIDIController * all = MIDIControllerCreate( NULL );
+  struct MIDIController * one = MIDIControllerCreate( NULL );
+  MIDIValue value;
+
+  ASSERT_NO_ERROR( MIDIDeviceSetChannelController( device, MIDI_CHANNEL_ALL, all ), "Could not set controller." );
+  ASSERT_NO_ERROR( MIDIDeviceSetChannelController( device, MIDI_CHANNEL_5, one ), "Could not set controller." );
+  ASSERT_NO_ERROR( MIDIControllerReceiveControlChange( all, NULL, MIDI_CHANNEL_1, MIDI_CONTROL_DATA_ENTRY+32, 0 ), "Could not reset data entry." );
+  ASSERT_NO_ERROR( MIDIControllerReceiveControlChange( one, NULL, MIDI_CHANNEL_1, MIDI_CONTROL_DATA_ENTRY+32, 0 ), "Could not reset data entry." );
+
+  /* not in omni mode, only the base channel is passed on */
+  ASSERT_NO_ERROR( MIDIDeviceReceiveControlChange( device, MIDI_CHANNEL_5, MIDI_CONTROL_DATA_INCREMENT, 0 ), "Could not receive control change." );
+  ASSERT_NO_ERROR( MIDIControllerGetControl( all, MIDI_CONTROL_DATA_ENTRY+32, sizeof(MIDIValue), &value ), "Could not get control." );
+  ASSERT_EQUAL( value, 0, "Control change on other channel was passed on." );
+
+  ASSERT_NO_ERROR( MIDIDeviceSetOmniMode( device, MIDI_ON ), "Could not set omni mode." );
+  ASSERT_NO_ERROR( MIDIDeviceReceiveControlChange( device, MIDI_CHANNEL_9, MIDI_CONTROL_DATA_INCREMENT, 0 ), "Could not receive control change." );
+  ASSERT_NO_ERROR( MIDIControllerGetControl( all, MIDI_CONTROL_DATA_ENTRY+32, sizeof(MIDIValue), &value ), "Could not get control." );
+  ASSERT_EQUAL( value, 1, "Controller on all channels did not receive the control change once." );
+  ASSERT_NO_ERROR( MIDIControllerGetControl( one, MIDI_CONTROL_DATA_ENTRY+32, sizeof(MIDIValue), &value ), "Could not get control." );
+  ASSERT_EQUAL( value, 1, "Controller on one channel did not receive the control change once." );
+
+  /* replacing the last reference removes the controller */
+  ASSERT_NO_ERROR( MIDIDeviceSetChannelController( device, MIDI_CHANNEL_ALL, one ), "Could not set controller." );
+  ASSERT_NO_ERROR( MIDIDeviceReceiveControlChange( device, MIDI_CHANNEL_1, MIDI_CONTROL_DATA_INCREMENT, 0 ), "Could not receive control change." );
+  ASSERT_NO_ERROR( MIDIControllerGetControl( all, MIDI_CONTROL_DATA_ENTRY+32, sizeof(MIDIValue), &value ), "Could not get control." );
+  ASSERT_EQUAL( value, 1, "Detached controller received a control change." );
+  ASSERT_NO_ERROR( MIDIControllerGetControl( one, MIDI_CONTROL_DATA_ENTRY+32, sizeof(MIDIValue), &value ), "Could not get control." );
+  ASSERT_EQUAL( value, 2, "Controller did not receive the control change once." );
+
+  MIDIDeviceRelease( device );
+  MIDIControllerRelease( all );
+  MIDIControllerRelease( one );
+  return 0;
+}
@@ -1,6 +1,10 @@
 #include <stdlib.h>
+#include <limits.h>
 #include <unistd.h>
+#include <string.h>
+#include <sys/time.h>
 #include <arpa/inet.h>
+#include <net/if.h>
 #include "test.h"
 #include "driver/common/rtp.h"
 
@@ -181,14 +185,1060 @@ int test005_rtp( void ) {
   return 0;
 }
 
+/**
+ * Test that multiple packets can be sent and received with one call
+ * and that non-RTP datagrams are passed through.
+ */
+int test006_rtp( void ) {
+  struct RTPPeer * peer;
+  struct RTPPacketInfo infos[8];
+  struct iovec iov[3];
+  unsigned char payload[3] = { 0x11, 0x22, 0x33 };
+  unsigned char send_buffer[13] = { 0x80, 96,   /* V=2, P=0, X=0, CC=0, PT=96 */
+                                    0x34, 0x00, /* Seqnum, continued below */
+                                    5, 6, 7, 8, /* timestamp */
+                                  ( RTP_CLIENT_SSRC >> 24 ) & 0xff,
+                                  ( RTP_CLIENT_SSRC >> 16 ) & 0xff,
+                                  ( RTP_CLIENT_SSRC >> 8 ) & 0xff,
+                                  ( RTP_CLIENT_SSRC ) & 0xff,
+                                    0 };
+  unsigned char recv_buffer[32];
+  unsigned short seqnum;
+  size_t count;
+  int i, s, bytes;
+  ASSERT_NO_ERROR( _rtp_socket( &s, &client_address ),
+                   "Could not create client socket." );
+  ASSERT_NO_ERROR( RTPSessionFindPeerBySSRC( _session, &peer, RTP_CLIENT_SSRC ),
+                   "Could not find peer." );
+
+  for( i=0; i<3; i++ ) {
+    infos[i].peer         = peer;
+    infos[i].padding      = 0;
+    infos[i].extension    = 0;
+    infos[i].csrc_count   = 0;
+    infos[i].marker       = 0;
+    infos[i].payload_type = 96;
+    infos[i].timestamp    = i;
+    infos[i].iovlen       = 1;
+    infos[i].iov          = &(iov[i]);
+    iov[i].iov_base = &(payload[i]);
+    iov[i].iov_len  = 1;
+  }
+  ASSERT_NO_ERROR( RTPSessionSendPackets( _session, 3, &(infos[0]), &count ),
+                   "Could not send packets to peer." );
+  ASSERT_EQUAL( count, 3, "Sent unexpected number of packets." );
+  for( i=0; i<3; i++ ) {
+    bytes = recv( s, &recv_buffer[0], sizeof(recv_buffer), 0 );
+    ASSERT_EQUAL( bytes, 13, "Received packet of unexpected size." );
+    seqnum = ( recv_buffer[2] << 8 ) | recv_buffer[3];
+    ASSERT_EQUAL( seqnum, infos[0].sequence_number + i, "Packets were not numbered consecutively." );
+    ASSERT_EQUAL( recv_buffer[12], payload[i], "Packet has unexpected payload." );
+  }
+
+  for( i=0; i<3; i++ ) {
+    send_buffer[3]  = 0x13 + i; /* follows the packet of test004 */
+    send_buffer[12] = payload[i];
+    sendto( s, &send_buffer[0], sizeof(send_buffer), 0,
+            (struct sockaddr *) &server_address, sizeof(server_address) );
+  }
+  sendto( s, &payload[0], sizeof(payload), 0,
+          (struct sockaddr *) &server_address, sizeof(server_address) );
+  usleep( 1000 );
+
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( _session, 8, &(infos[0]), &count ),
+                   "Could not receive packets." );
+  ASSERT_EQUAL( count, 4, "Received unexpected number of packets." );
+  for( i=0; i<3; i++ ) {
+    ASSERT_EQUAL( infos[i].peer, peer, "Packet was associated with the wrong peer." );
+    ASSERT_EQUAL( infos[i].sequence_number, 0x3413 + i, "Packet has unexpected sequence number." );
+    ASSERT_EQUAL( infos[i].iov[0].iov_len, 1, "Packet has unexpected payload size." );
+    ASSERT_EQUAL( *(unsigned char *) infos[i].iov[0].iov_base, payload[i], "Packet has unexpected payload." );
+  }
+  ASSERT_EQUAL( infos[3].peer, NULL, "Non-RTP datagram was associated with a peer." );
+  ASSERT_EQUAL( infos[3].iov[0].iov_len, sizeof(payload), "Non-RTP datagram has unexpected size." );
+  ASSERT_EQUAL( infos[3].addr_size, sizeof(client_address), "Non-RTP datagram has unexpected address." );
+  close( s );
+  return 0;
+}
 
 /**
  * Test that an RTP session can be properly teared down.
  */
-int test006_rtp( void ) {
+int test007_rtp( void ) {
   if( _session != NULL ) {
     RTPSessionRelease( _session );
   }
 
   return 0;
 }
+
+#define RTP_MANY_PEERS     10000
+#define RTP_FEW_PEERS      100
+#define RTP_LOOKUP_RUNS    5
+#define RTP_LOOKUP_GROWTH  10
+
+static unsigned long _elapsed_usec( struct timeval * start ) {
+  struct timeval now;
+  gettimeofday( &now, NULL );
+  return ( now.tv_sec - start->tv_sec ) * 1000000 + ( now.tv_usec - start->tv_usec );
+}
+
+/**
+ * Look up the first @c count peers of a session created by @c test008_rtp
+ * @c rounds times by SSRC and by address and return the fastest of a
+ * few runs in microseconds.
+ */
+static unsigned long _rtp_lookup_usec( struct RTPSession * session, int count, int rounds ) {
+  struct RTPPeer * p;
+  struct sockaddr_in address;
+  struct timeval start;
+  unsigned long usec, best = 0;
+  int run, r, i;
+
+  _rtp_address( &address, 0 );
+  for( run=0; run<RTP_LOOKUP_RUNS; run++ ) {
+    gettimeofday( &start, NULL );
+    for( r=0; r<rounds; r++ ) {
+      for( i=0; i<count; i++ ) {
+        address.sin_port = htons( 1024 + i );
+        RTPSessionFindPeerBySSRC( session, &p, 0x10000 * i + 1 );
+        RTPSessionFindPeerByAddress( session, &p, sizeof(address), (struct sockaddr *) &address );
+      }
+    }
+    usec = _elapsed_usec( &start );
+    if( run == 0 || usec < best ) {
+      best = usec;
+    }
+  }
+  return best;
+}
+
+/**
+ * Test that a session can handle a large number of peers, that
+ * looking one up does not get slower with the number of peers and
+ * that iteration order is stable while peers, including the current
+ * one, are removed.
+ */
+int test008_rtp( void ) {
+  struct RTPSession * session;
+  struct RTPSession * few;
+  struct RTPPeer ** peers;
+  struct RTPPeer * p;
+  struct sockaddr_in address;
+  unsigned long usec_many, usec_few;
+  int i, s;
+
+  s = socket( AF_INET, SOCK_DGRAM, 0 );
+  ASSERT_GREATER_OR_EQUAL( s, 0, "Could not create socket." );
+  session = RTPSessionCreate( s );
+  ASSERT_NOT_EQUAL( session, NULL, "Could not create RTP session." );
+  peers = malloc( sizeof(struct RTPPeer *) * RTP_MANY_PEERS );
+  ASSERT_NOT_EQUAL( peers, NULL, "Could not allocate peer list." );
+
+  ASSERT_NO_ERROR( _rtp_address( &address, 0 ), "Could not fill out peer address." );
+  for( i=0; i<RTP_MANY_PEERS; i++ ) {
+    address.sin_port = htons( 1024 + i );
+    peers[i] = RTPPeerCreate( 0x10000 * i + 1, sizeof(address), (struct sockaddr *) &address );
+    ASSERT_NOT_EQUAL( peers[i], NULL, "Could not create RTP peer." );
+    ASSERT_NO_ERROR( RTPSessionAddPeer( session, peers[i] ), "Could not add peer." );
+    RTPPeerRelease( peers[i] );
+  }
+
+  for( i=0; i<RTP_MANY_PEERS; i++ ) {
+    ASSERT_NO_ERROR( RTPSessionFindPeerBySSRC( session, &p, 0x10000 * i + 1 ), "Could not find peer by SSRC." );
+    ASSERT_EQUAL( p, peers[i], "Lookup by SSRC returned wrong peer." );
+  }
+
+  for( i=0; i<RTP_MANY_PEERS; i++ ) {
+    address.sin_port = htons( 1024 + i );
+    ASSERT_NO_ERROR( RTPSessionFindPeerByAddress( session, &p, sizeof(address), (struct sockaddr *) &address ),
+                     "Could not find peer by address." );
+    ASSERT_EQUAL( p, peers[i], "Lookup by address returned wrong peer." );
+  }
+
+  /* the same number of lookups in a small session takes about as long */
+  s = socket( AF_INET, SOCK_DGRAM, 0 );
+  ASSERT_GREATER_OR_EQUAL( s, 0, "Could not create socket." );
+  few = RTPSessionCreate( s );
+  ASSERT_NOT_EQUAL( few, NULL, "Could not create RTP session." );
+  for( i=0; i<RTP_FEW_PEERS; i++ ) {
+    address.sin_port = htons( 1024 + i );
+    p = RTPPeerCreate( 0x10000 * i + 1, sizeof(address), (struct sockaddr *) &address );
+    ASSERT_NOT_EQUAL( p, NULL, "Could not create RTP peer." );
+    ASSERT_NO_ERROR( RTPSessionAddPeer( few, p ), "Could not add peer." );
+    RTPPeerRelease( p );
+  }
+  usec_many = _rtp_lookup_usec( session, RTP_MANY_PEERS, 1 );
+  usec_few  = _rtp_lookup_usec( few, RTP_FEW_PEERS, RTP_MANY_PEERS / RTP_FEW_PEERS );
+  RTPSessionRelease( few );
+  ASSERT_LESS( usec_many, RTP_LOOKUP_GROWTH * ( usec_few + 1 ), "Peer lookup grows with the number of peers." );
+
+  /* remove every other peer while iterating */
+  p = NULL;
+  for( i=0; i<RTP_MANY_PEERS; i++ ) {
+    ASSERT_NO_ERROR( RTPSessionNextPeer( session, &p ), "Could not get next peer." );
+    ASSERT_EQUAL( p, peers[i], "Peers were not iterated in order." );
+    if( i > 0 && i % 2 == 1 ) {
+      ASSERT_NO_ERROR( RTPSessionRemovePeer( session, peers[i-1] ), "Could not remove peer." );
+    }
+  }
+  ASSERT_NO_ERROR( RTPSessionNextPeer( session, &p ), "Could not get next peer." );
+  ASSERT_EQUAL( p, NULL, "Iteration did not end after last peer." );
+
+  ASSERT_ERROR( RTPSessionFindPeerBySSRC( session, &p, 1 ), "Removed peer was found." );
+  for( i=1; i<RTP_MANY_PEERS; i+=2 ) {
+    ASSERT_NO_ERROR( RTPSessionNextPeer( session, &p ), "Could not get next peer." );
+    ASSERT_EQUAL( p, peers[i], "Remaining peers were not iterated in order." );
+  }
+
+  /* remove the current peer while iterating */
+  p = NULL;
+  for( i=1; i<RTP_MANY_PEERS; i+=2 ) {
+    ASSERT_NO_ERROR( RTPSessionNextPeer( session, &p ), "Could not get next peer." );
+    ASSERT_EQUAL( p, peers[i], "Peers were not iterated in order." );
+    if( i % 4 == 1 ) {
+      ASSERT_NO_ERROR( RTPSessionRemovePeer( session, p ), "Could not remove current peer." );
+    }
+  }
+  ASSERT_NO_ERROR( RTPSessionNextPeer( session, &p ), "Could not get next peer." );
+  ASSERT_EQUAL( p, NULL, "Iteration did not end after last peer." );
+  for( i=3; i<RTP_MANY_PEERS; i+=4 ) {
+    ASSERT_NO_ERROR( RTPSessionNextPeer( session, &p ), "Could not get next peer." );
+    ASSERT_EQUAL( p, peers[i], "Remaining peers were not iterated in order." );
+  }
+
+  free( peers );
+  RTPSessionRelease( session );
+  return 0;
+}
+
+#define RTP_FANOUT_PEERS 4
+#define RTP_FANOUT_MANY  256
+#define RTP_FANOUT_RUNS  5
+#define RTP_FANOUT_USEC  10
+
+/**
+ * Send one packet to @c n peers and return the fastest of a few runs
+ * in microseconds.
+ */
+static unsigned long _rtp_fanout_usec( struct RTPSession * session, struct RTPPacketInfo * info,
+                                       size_t n, struct RTPPeer ** peers ) {
+  struct timeval start;
+  unsigned long usec, best = 0;
+  size_t sent;
+  int run;
+
+  for( run=0; run<RTP_FANOUT_RUNS; run++ ) {
+    gettimeofday( &start, NULL );
+    RTPSessionSendPacketToPeers( session, info, n, peers, NULL, &sent );
+    usec = _elapsed_usec( &start );
+    if( sent != n ) return ULONG_MAX;
+    if( run == 0 || usec < best ) {
+      best = usec;
+    }
+  }
+  return best;
+}
+
+/**
+ * Test that one packet can be sent to many peers with only the
+ * sequence number and the per-peer trailer differing.
+ */
+int test009_rtp( void ) {
+  struct RTPSession * session;
+  struct RTPPeer * peers[RTP_FANOUT_PEERS];
+  struct RTPPacketInfo info;
+  struct sockaddr_in address;
+  struct iovec iov, trailers[RTP_FANOUT_PEERS];
+  unsigned char payload[3] = { 0x11, 0x22, 0x33 };
+  unsigned char trailer[RTP_FANOUT_PEERS];
+  unsigned char recv_buffer[32];
+  struct RTPPeer ** many;
+  unsigned long usec;
+  int cm[RTP_FANOUT_MANY];
+  int i, s, c[RTP_FANOUT_PEERS], bytes;
+  size_t sent;
+
+  s = socket( AF_INET, SOCK_DGRAM, 0 );
+  ASSERT_GREATER_OR_EQUAL( s, 0, "Could not create socket." );
+  session = RTPSessionCreate( s );
+  ASSERT_NOT_EQUAL( session, NULL, "Could not create RTP session." );
+
+  for( i=0; i<RTP_FANOUT_PEERS; i++ ) {
+    ASSERT_NO_ERROR( _rtp_address( &address, RTP_CLIENT_PORT + 1 + i ), "Could not fill out peer address." );
+    ASSERT_NO_ERROR( _rtp_socket( &(c[i]), &address ), "Could not create peer socket." );
+    peers[i] = RTPPeerCreate( RTP_CLIENT_SSRC + 1 + i, sizeof(address), (struct sockaddr *) &address );
+    ASSERT_NOT_EQUAL( peers[i], NULL, "Could not create RTP peer." );
+    ASSERT_NO_ERROR( RTPSessionAddPeer( session, peers[i] ), "Could not add peer." );
+    RTPPeerRelease( peers[i] );
+    trailer[i] = 0xa0 + i;
+    trailers[i].iov_base = &(trailer[i]);
+    trailers[i].iov_len  = 1;
+  }
+
+  info.padding      = 0;
+  info.extension    = 0;
+  info.csrc_count   = 0;
+  info.marker       = 0;
+  info.payload_type = 97;
+  info.timestamp    = 0x01020304;
+  info.iovlen       = 1;
+  info.iov          = &iov;
+  iov.iov_base = &(payload[0]);
+  iov.iov_len  = sizeof(payload);
+
+  ASSERT_NO_ERROR( RTPSessionSendPacketToPeers( session, &info, RTP_FANOUT_PEERS, &(peers[0]), &(trailers[0]), &sent ),
+                   "Could not send packet to peers." );
+  ASSERT_EQUAL( sent, RTP_FANOUT_PEERS, "Packet was not sent to all peers." );
+  ASSERT_NO_ERROR( RTPSessionSendPacketToPeers( session, &info, RTP_FANOUT_PEERS, &(peers[0]), NULL, &sent ),
+                   "Could not send packet to peers." );
+
+  for( i=0; i<RTP_FANOUT_PEERS; i++ ) {
+    bytes = recv( c[i], &recv_buffer[0], sizeof(recv_buffer), 0 );
+    ASSERT_EQUAL( bytes, 16, "Received packet of unexpected size." );
+    ASSERT_EQUAL( recv_buffer[1], 97, "Packet has unexpected payload type." );
+    ASSERT_EQUAL( recv_buffer[3], 1, "Packet has unexpected sequence number." );
+    ASSERT_EQUAL( recv_buffer[7], 0x04, "Packet has unexpected timestamp." );
+    ASSERT_EQUAL( recv_buffer[12], 0x11, "Packet has unexpected payload." );
+    ASSERT_EQUAL( recv_buffer[15], trailer[i], "Packet has unexpected trailer." );
+    bytes = recv( c[i], &recv_buffer[0], sizeof(recv_buffer), 0 );
+    ASSERT_EQUAL( bytes, 15, "Received packet of unexpected size." );
+    ASSERT_EQUAL( recv_buffer[3], 2, "Packets were not numbered consecutively." );
+  }
+
+  /* the per-peer cost, including the kernel's, stays within a few microseconds */
+  many = malloc( sizeof(struct RTPPeer *) * RTP_FANOUT_MANY );
+  ASSERT_NOT_EQUAL( many, NULL, "Could not allocate peer list." );
+  for( i=0; i<RTP_FANOUT_MANY; i++ ) {
+    ASSERT_NO_ERROR( _rtp_address( &address, RTP_CLIENT_PORT + 1000 + i ), "Could not fill out peer address." );
+    ASSERT_NO_ERROR( _rtp_socket( &(cm[i]), &address ), "Could not create peer socket." );
+    many[i] = RTPPeerCreate( RTP_CLIENT_SSRC + 100 + i, sizeof(address), (struct sockaddr *) &address );
+    ASSERT_NOT_EQUAL( many[i], NULL, "Could not create RTP peer." );
+    ASSERT_NO_ERROR( RTPSessionAddPeer( session, many[i] ), "Could not add peer." );
+    RTPPeerRelease( many[i] );
+  }
+  usec = _rtp_fanout_usec( session, &info, RTP_FANOUT_MANY, many );
+  free( many );
+  for( i=0; i<RTP_FANOUT_MANY; i++ ) {
+    close( cm[i] );
+  }
+  ASSERT_LESS( usec, RTP_FANOUT_USEC * RTP_FANOUT_MANY, "Sending to many peers is too slow." );
+
+  for( i=0; i<RTP_FANOUT_PEERS; i++ ) {
+    close( c[i] );
+  }
+  RTPSessionRelease( session );
+  return 0;
+}
+
+#define RTP_MULTICAST_GROUP "239.255.77.1"
+#define RTP_MULTICAST_PORT  5304
+
+static int _rtp_multicast_socket( int * s, struct sockaddr_in * group ) {
+  struct sockaddr_in address;
+  struct timeval timeout = { 1, 0 };
+  int socket_id = socket( AF_INET, SOCK_DGRAM, 0 );
+  int reuse = 1;
+
+  ASSERT_GREATER_OR_EQUAL( socket_id, 0, "Could not create socket." );
+  setsockopt( socket_id, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse) );
+  setsockopt( socket_id, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout) );
+
+  address = *group;
+  address.sin_addr.s_addr = htonl( INADDR_ANY );
+  ASSERT_NO_ERROR( bind( socket_id, (void*) &address, sizeof(address) ),
+                   "Could not bind socket." );
+  *s = socket_id;
+  return 0;
+}
+
+/**
+ * Test that sessions can exchange packets through a multicast group
+ * and still tell the senders apart.
+ */
+int test010_rtp( void ) {
+  struct RTPSession * sessions[2];
+  struct RTPPacketInfo infos[4];
+  struct RTPPeer * group;
+  struct RTPPeer * peer;
+  struct sockaddr_in address;
+  unsigned char payload[3] = { 0x44, 0x55, 0x66 };
+  unsigned long ssrc[2];
+  unsigned int interface = if_nametoindex( "lo" );
+  size_t received;
+  int i, s;
+
+  address.sin_family = AF_INET;
+  address.sin_port   = htons( RTP_MULTICAST_PORT );
+  ASSERT_NOT_EQUAL( inet_aton( RTP_MULTICAST_GROUP, &(address.sin_addr) ), 0,
+                    "Could not create multicast address." );
+
+  for( i=0; i<2; i++ ) {
+    ASSERT_NO_ERROR( _rtp_multicast_socket( &s, &address ), "Could not create multicast socket." );
+    sessions[i] = RTPSessionCreate( s );
+    ASSERT_NOT_EQUAL( sessions[i], NULL, "Could not create RTP session." );
+    RTPSessionSetSSRC( sessions[i], RTP_CLIENT_SSRC + 100 + i );
+    RTPSessionGetSSRC( sessions[i], &(ssrc[i]) );
+    ASSERT_NO_ERROR( RTPSessionJoinGroup( sessions[i], sizeof(address), (struct sockaddr *) &address, interface ),
+                     "Could not join multicast group." );
+    ASSERT_NO_ERROR( RTPSessionSetMulticastTTL( sessions[i], 1 ), "Could not set multicast TTL." );
+    ASSERT_NO_ERROR( RTPSessionSetMulticastLoopback( sessions[i], 1 ), "Could not enable multicast loopback." );
+  }
+  ASSERT_NO_ERROR( RTPSessionGetGroup( sessions[0], &group ), "Could not get multicast group." );
+
+  /* one packet from each session reaches both */
+  for( i=0; i<2; i++ ) {
+    ASSERT_NO_ERROR( RTPSessionSend( sessions[i], sizeof(payload), &(payload[0]), NULL ),
+                     "Could not send to multicast group." );
+  }
+  usleep( 1000 );
+
+  for( i=0; i<2; i++ ) {
+    ASSERT_NO_ERROR( RTPSessionReceivePackets( sessions[i], 4, &(infos[0]), &received ),
+                     "Could not receive from multicast group." );
+    ASSERT_EQUAL( received, 2, "Received unexpected number of packets." );
+    ASSERT_EQUAL( infos[i].peer, NULL, "Own packet was attributed to a peer." );
+    ASSERT_NOT_EQUAL( infos[1-i].peer, NULL, "Packet of other session was not attributed to a peer." );
+    ASSERT_EQUAL( infos[1-i].ssrc, ssrc[1-i], "Packet has unexpected SSRC." );
+    ASSERT_EQUAL( infos[1-i].payload_size, sizeof(payload), "Packet has unexpected payload size." );
+    ASSERT_NO_ERROR( RTPSessionFindPeerBySSRC( sessions[i], &peer, ssrc[1-i] ), "Sender was not added as peer." );
+    ASSERT_ERROR( RTPSessionFindPeerBySSRC( sessions[i], &peer, ssrc[i] ), "Session added itself as peer." );
+  }
+
+  ASSERT_NO_ERROR( RTPSessionLeaveGroup( sessions[0] ), "Could not leave multicast group." );
+  ASSERT_ERROR( RTPSessionGetGroup( sessions[0], &group ), "Session is still part of the group." );
+  RTPSessionRelease( sessions[0] );
+  RTPSessionRelease( sessions[1] );
+  return 0;
+}
+
+#define RTP_PLAYOUT_SSRC ( RTP_CLIENT_SSRC + 200 )
+
+static unsigned long _usec_now( void ) {
+  struct timeval tv;
+  gettimeofday( &tv, NULL );
+  return ( (unsigned long) tv.tv_sec * 1000000 + tv.tv_usec ) & 0xffffffff;
+}
+
+static void _rtp_send_raw( int s, struct sockaddr_in * address, unsigned long ssrc, unsigned short seqnum ) {
+  unsigned long timestamp = _usec_now();
+  unsigned char buffer[13] = { 0x80, 96,
+                               ( seqnum >> 8 ) & 0xff, seqnum & 0xff,
+                               ( timestamp >> 24 ) & 0xff, ( timestamp >> 16 ) & 0xff,
+                               ( timestamp >> 8 ) & 0xff, timestamp & 0xff,
+                               ( ssrc >> 24 ) & 0xff, ( ssrc >> 16 ) & 0xff,
+                               ( ssrc >> 8 ) & 0xff, ssrc & 0xff,
+                               seqnum & 0xff };
+  sendto( s, &buffer[0], sizeof(buffer), 0, (struct sockaddr *) address, sizeof(*address) );
+}
+
+/**
+ * Test that received packets are played out in sequence number order,
+ * that late packets are dropped and that the playout delay adapts to
+ * the measured jitter within the configured bounds.
+ */
+int test011_rtp( void ) {
+  struct RTPSession * session;
+  struct RTPPacketInfo infos[16];
+  struct RTPPacketInfo info;
+  struct sockaddr_in address, peer_address;
+  unsigned short order[3] = { 3, 1, 2 };
+  unsigned long jitter, delay;
+  size_t received;
+  int i, s, c;
+
+  ASSERT_NO_ERROR( _rtp_address( &address, RTP_SERVER_PORT + 1 ), "Could not fill out session address." );
+  ASSERT_NO_ERROR( _rtp_socket( &s, &address ), "Could not create session socket." );
+  ASSERT_NO_ERROR( _rtp_address( &peer_address, RTP_CLIENT_PORT + 10 ), "Could not fill out peer address." );
+  ASSERT_NO_ERROR( _rtp_socket( &c, &peer_address ), "Could not create peer socket." );
+  session = RTPSessionCreate( s );
+  ASSERT_NOT_EQUAL( session, NULL, "Could not create RTP session." );
+  ASSERT_NO_ERROR( RTPSessionSetClockRate( session, 1000000 ), "Could not set clock rate." );
+
+  /* reordered packets come out sorted */
+  for( i=0; i<3; i++ ) {
+    _rtp_send_raw( c, &address, RTP_PLAYOUT_SSRC, order[i] );
+  }
+  usleep( 1000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( session, 16, &(infos[0]), &received ), "Could not receive packets." );
+  ASSERT_EQUAL( received, 3, "Received unexpected number of packets." );
+  for( i=0; i<3; i++ ) {
+    ASSERT_NO_ERROR( RTPSessionPushPacket( session, &(infos[i]) ), "Could not buffer packet." );
+  }
+  for( i=1; i<=3; i++ ) {
+    ASSERT_NO_ERROR( RTPSessionPopPacket( session, &info ), "No packet was due." );
+    ASSERT_EQUAL( info.sequence_number, i, "Packets were not played out in order." );
+    ASSERT_EQUAL( *(unsigned char *) info.iov[0].iov_base, i, "Packet has unexpected payload." );
+  }
+  ASSERT_ERROR( RTPSessionPopPacket( session, &info ), "Empty buffer returned a packet." );
+
+  /* a packet that was already played is a duplicate */
+  _rtp_send_raw( c, &address, RTP_PLAYOUT_SSRC, 2 );
+  usleep( 1000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( session, 16, &(infos[0]), &received ), "Could not receive packets." );
+  ASSERT_ERROR( RTPSessionPushPacket( session, &(infos[0]) ), "Duplicate packet was buffered." );
+
+  /* irregular sending shows up as jitter */
+  for( i=4; i<14; i++ ) {
+    _rtp_send_raw( c, &address, RTP_PLAYOUT_SSRC, i );
+    usleep( ( i % 2 ) ? 200 : 3000 );
+  }
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( session, 16, &(infos[0]), &received ), "Could not receive packets." );
+  ASSERT_EQUAL( received, 10, "Received unexpected number of packets." );
+  for( i=0; i<received; i++ ) {
+    ASSERT_NO_ERROR( RTPSessionPushPacket( session, &(infos[i]) ), "Could not buffer packet." );
+  }
+  ASSERT_NO_ERROR( RTPPeerGetJitter( infos[0].peer, &jitter ), "Could not get jitter." );
+  ASSERT_GREATER( jitter, 0, "No jitter was measured." );
+  for( i=0; RTPSessionPopPacket( session, &info ) == 0; i++ );
+  ASSERT_EQUAL( i, 10, "Without a playout delay not all packets were due." );
+
+  /* the playout delay holds packets back within its bounds */
+  ASSERT_ERROR( RTPSessionSetPlayoutDelay( session, 50000, 20000 ), "Accepted invalid playout delay bounds." );
+  ASSERT_NO_ERROR( RTPSessionSetPlayoutDelay( session, 20000, 50000 ), "Could not set playout delay." );
+  ASSERT_NO_ERROR( RTPSessionGetPlayoutDelay( session, infos[0].peer, &delay ), "Could not get playout delay." );
+  ASSERT_GREATER_OR_EQUAL( delay, 20000, "Playout delay is below its bound." );
+  ASSERT_LESS_OR_EQUAL( delay, 50000, "Playout delay is above its bound." );
+
+  _rtp_send_raw( c, &address, RTP_PLAYOUT_SSRC, 14 );
+  usleep( 1000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( session, 16, &(infos[0]), &received ), "Could not receive packets." );
+  ASSERT_NO_ERROR( RTPSessionPushPacket( session, &(infos[0]) ), "Could not buffer packet." );
+  ASSERT_ERROR( RTPSessionPopPacket( session, &info ), "Packet was played out before its delay." );
+  usleep( 60000 );
+  ASSERT_NO_ERROR( RTPSessionPopPacket( session, &info ), "Packet was not played out after its delay." );
+  ASSERT_EQUAL( info.sequence_number, 14, "Played out unexpected packet." );
+
+  close( c );
+  RTPSessionRelease( session );
+  return 0;
+}
+
+/**
+ * Test that peers exchange RTCP reports and derive loss, jitter and
+ * round-trip time from them.
+ */
+int test012_rtp( void ) {
+  struct RTPSession * sessions[2];
+  struct RTPPeer * peers[2];
+  struct RTPPacketInfo infos[8];
+  struct RTPPeerStats stats;
+  struct sockaddr_in address[2];
+  unsigned char payload[3] = { 0x77, 0x88, 0x99 };
+  size_t received;
+  int i, s;
+
+  for( i=0; i<2; i++ ) {
+    ASSERT_NO_ERROR( _rtp_address( &(address[i]), RTP_SERVER_PORT + 2 + i ), "Could not fill out address." );
+    ASSERT_NO_ERROR( _rtp_socket( &s, &(address[i]) ), "Could not create socket." );
+    sessions[i] = RTPSessionCreate( s );
+    ASSERT_NOT_EQUAL( sessions[i], NULL, "Could not create RTP session." );
+    RTPSessionSetSSRC( sessions[i], RTP_CLIENT_SSRC + 300 + i );
+  }
+  for( i=0; i<2; i++ ) {
+    peers[i] = RTPPeerCreate( RTP_CLIENT_SSRC + 300 + 1 - i, sizeof(address[1-i]), (struct sockaddr *) &(address[1-i]) );
+    ASSERT_NOT_EQUAL( peers[i], NULL, "Could not create RTP peer." );
+    ASSERT_NO_ERROR( RTPSessionAddPeer( sessions[i], peers[i] ), "Could not add peer." );
+    RTPPeerRelease( peers[i] );
+  }
+
+  /* four packets are sent, the fifth one is lost on the way */
+  for( i=0; i<4; i++ ) {
+    ASSERT_NO_ERROR( RTPSessionSend( sessions[0], sizeof(payload), &(payload[0]), NULL ), "Could not send packet." );
+  }
+  RTPSessionGetSocket( sessions[0], &s );
+  _rtp_send_raw( s, &(address[1]), RTP_CLIENT_SSRC + 300, 6 );
+  usleep( 1000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( sessions[1], 8, &(infos[0]), &received ), "Could not receive packets." );
+  ASSERT_EQUAL( received, 5, "Received unexpected number of packets." );
+
+  ASSERT_NO_ERROR( RTPPeerGetStats( peers[0], &stats ), "Could not get sender statistics." );
+  ASSERT_EQUAL( stats.packets_sent, 4, "Sender counted unexpected number of packets." );
+  ASSERT_EQUAL( stats.bytes_sent, 4 * sizeof(payload), "Sender counted unexpected number of bytes." );
+  ASSERT_NO_ERROR( RTPPeerGetStats( peers[1], &stats ), "Could not get receiver statistics." );
+  ASSERT_EQUAL( stats.packets_received, 5, "Receiver counted unexpected number of packets." );
+  ASSERT_EQUAL( stats.bytes_received, 4 * sizeof(payload) + 1, "Receiver counted unexpected number of bytes." );
+  ASSERT_EQUAL( stats.packets_lost, 1, "Receiver counted unexpected number of lost packets." );
+
+  /* the receiver report tells the sender about the loss */
+  ASSERT_NO_ERROR( RTPSessionSendReports( sessions[1] ), "Could not send receiver report." );
+  usleep( 1000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( sessions[0], 8, &(infos[0]), &received ), "Could not receive report." );
+  ASSERT_EQUAL( received, 1, "Received unexpected number of packets." );
+  ASSERT_EQUAL( infos[0].peer, NULL, "Report was mistaken for an RTP packet." );
+  ASSERT_NO_ERROR( RTPPeerGetStats( peers[0], &stats ), "Could not get sender statistics." );
+  ASSERT_EQUAL( stats.remote_packets_lost, 1, "Sender did not learn about the loss." );
+  ASSERT_GREATER( stats.remote_fraction_lost, 0, "Sender did not learn about the loss fraction." );
+  ASSERT_EQUAL( stats.round_trip_time, 0, "Round-trip time was measured without a sender report." );
+
+  /* a sender report answered by a receiver report yields the round-trip time */
+  ASSERT_NO_ERROR( RTPSessionSendReports( sessions[0] ), "Could not send sender report." );
+  usleep( 3000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( sessions[1], 8, &(infos[0]), &received ), "Could not receive report." );
+  ASSERT_NO_ERROR( RTPSessionSendReports( sessions[1] ), "Could not send receiver report." );
+  usleep( 1000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( sessions[0], 8, &(infos[0]), &received ), "Could not receive report." );
+  ASSERT_NO_ERROR( RTPPeerGetStats( peers[0], &stats ), "Could not get sender statistics." );
+  ASSERT_GREATER_OR_EQUAL( stats.round_trip_time, 2000, "Round-trip time is too short." );
+  ASSERT_LESS( stats.round_trip_time, 100000, "Round-trip time is too long." );
+
+  /* a single stray packet is dropped without touching the statistics */
+  RTPSessionGetSocket( sessions[0], &s );
+  _rtp_send_raw( s, &(address[1]), RTP_CLIENT_SSRC + 300, 20000 );
+  usleep( 1000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( sessions[1], 8, &(infos[0]), &received ), "Could not receive packets." );
+  ASSERT_EQUAL( received, 1, "Received unexpected number of packets." );
+  ASSERT_EQUAL( infos[0].peer, NULL, "Stray packet was not dropped." );
+  ASSERT_NO_ERROR( RTPPeerGetStats( peers[1], &stats ), "Could not get receiver statistics." );
+  ASSERT_EQUAL( stats.packets_received, 5, "Stray packet reset the received packets." );
+  ASSERT_EQUAL( stats.packets_lost, 1, "Stray packet reset the lost packets." );
+
+  /* a restarted sender is confirmed by its second packet and starts a new loss count */
+  _rtp_send_raw( s, &(address[1]), RTP_CLIENT_SSRC + 300, 40000 );
+  _rtp_send_raw( s, &(address[1]), RTP_CLIENT_SSRC + 300, 40001 );
+  _rtp_send_raw( s, &(address[1]), RTP_CLIENT_SSRC + 300, 40002 );
+  usleep( 1000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( sessions[1], 8, &(infos[0]), &received ), "Could not receive packets." );
+  ASSERT_EQUAL( received, 3, "Received unexpected number of packets." );
+  ASSERT_EQUAL( infos[0].peer, NULL, "First packet after the restart was not dropped." );
+  ASSERT_EQUAL( infos[1].peer, peers[1], "Restart was not confirmed." );
+  ASSERT_NO_ERROR( RTPPeerGetStats( peers[1], &stats ), "Could not get receiver statistics." );
+  ASSERT_EQUAL( stats.packets_received, 2, "Restart did not reset the received packets." );
+  ASSERT_EQUAL( stats.packets_lost, 0, "Restart was counted as loss." );
+
+  RTPSessionRelease( sessions[0] );
+  RTPSessionRelease( sessions[1] );
+  return 0;
+}
+
+#define RTP_SHARDS 4
+
+/**
+ * Test that sessions can be sharded over SO_REUSEPORT sockets and that
+ * packets are steered to shards by the SSRC of their sender.
+ */
+int test013_rtp( void ) {
+  struct RTPSession * shards[RTP_SHARDS];
+  struct RTPPacketInfo infos[4];
+  struct RTPPeer * peer;
+  struct sockaddr_in address, peer_address;
+  unsigned char byte;
+  unsigned long ssrc[2];
+  size_t received;
+  int i, k, s, c, reuse = 1;
+
+  ASSERT_NO_ERROR( _rtp_address( &address, RTP_SERVER_PORT + 4 ), "Could not fill out session address." );
+  s = socket( AF_INET, SOCK_DGRAM, 0 );
+  ASSERT_GREATER_OR_EQUAL( s, 0, "Could not create socket." );
+  shards[0] = RTPSessionCreate( s );
+  ASSERT_NOT_EQUAL( shards[0], NULL, "Could not create RTP session." );
+  ASSERT_NO_ERROR( bind( s, (void *) &address, sizeof(address) ), "Could not bind socket." );
+  ASSERT_ERROR( RTPSessionCreateShard( shards[0], &(shards[1]) ), "Created shard without SO_REUSEPORT." );
+  RTPSessionRelease( shards[0] );
+
+  s = socket( AF_INET, SOCK_DGRAM, 0 );
+  ASSERT_GREATER_OR_EQUAL( s, 0, "Could not create socket." );
+  ASSERT_NO_ERROR( setsockopt( s, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse) ), "Could not enable SO_REUSEPORT." );
+  ASSERT_NO_ERROR( bind( s, (void *) &address, sizeof(address) ), "Could not bind socket." );
+  shards[0] = RTPSessionCreate( s );
+  ASSERT_NOT_EQUAL( shards[0], NULL, "Could not create RTP session." );
+  for( i=1; i<RTP_SHARDS; i++ ) {
+    ASSERT_NO_ERROR( RTPSessionCreateShard( shards[0], &(shards[i]) ), "Could not create shard." );
+    RTPSessionGetSSRC( shards[0], &(ssrc[0]) );
+    RTPSessionGetSSRC( shards[i], &(ssrc[1]) );
+    ASSERT_EQUAL( ssrc[0], ssrc[1], "Shard does not share the session's SSRC." );
+  }
+  ASSERT_NO_ERROR( RTPSessionSetShardSteering( shards[0], RTP_SHARDS ), "Could not attach steering program." );
+
+  ASSERT_NO_ERROR( _rtp_address( &peer_address, RTP_CLIENT_PORT + 12 ), "Could not fill out peer address." );
+  ASSERT_NO_ERROR( _rtp_socket( &c, &peer_address ), "Could not create peer socket." );
+  for( i=0; i<2*RTP_SHARDS; i++ ) {
+    _rtp_send_raw( c, &address, RTP_CLIENT_SSRC + 400 + i, 1 );
+    usleep( 1000 );
+    k = ( RTP_CLIENT_SSRC + 400 + i ) % RTP_SHARDS;
+    ASSERT_NO_ERROR( RTPSessionReceivePackets( shards[k], 4, &(infos[0]), &received ), "Could not receive packet." );
+    ASSERT_EQUAL( received, 1, "Shard received unexpected number of packets." );
+    ASSERT_EQUAL( infos[0].ssrc, RTP_CLIENT_SSRC + 400 + i, "Packet was steered to the wrong shard." );
+    ASSERT_NO_ERROR( RTPSessionFindPeerBySSRC( shards[k], &peer, RTP_CLIENT_SSRC + 400 + i ),
+                     "Shard did not add the sender as peer." );
+    for( k=0; k<RTP_SHARDS; k++ ) {
+      RTPSessionGetSocket( shards[k], &s );
+      ASSERT_EQUAL( recv( s, &byte, 1, MSG_DONTWAIT ), -1, "Packet was delivered to more than one shard." );
+    }
+  }
+
+  close( c );
+  for( i=RTP_SHARDS; i>0; i-- ) {
+    RTPSessionRelease( shards[i-1] );
+  }
+  return 0;
+}
+
+/**
+ * Test that received packets carry the time they reached the socket
+ * when kernel timestamps are enabled.
+ */
+int test014_rtp( void ) {
+  struct RTPSession * session;
+  struct RTPPacketInfo infos[4];
+  struct iovec iov[2];
+  struct sockaddr_in address, peer_address;
+  struct timeval now;
+  size_t received;
+  long age;
+  int s, c;
+
+  ASSERT_NO_ERROR( _rtp_address( &address, RTP_SERVER_PORT + 5 ), "Could not fill out session address." );
+  ASSERT_NO_ERROR( _rtp_socket( &s, &address ), "Could not create session socket." );
+  ASSERT_NO_ERROR( _rtp_address( &peer_address, RTP_CLIENT_PORT + 13 ), "Could not fill out peer address." );
+  ASSERT_NO_ERROR( _rtp_socket( &c, &peer_address ), "Could not create peer socket." );
+  session = RTPSessionCreate( s );
+  ASSERT_NOT_EQUAL( session, NULL, "Could not create RTP session." );
+
+  /* without kernel timestamps the arrival is the time the packet was read */
+  _rtp_send_raw( c, &address, RTP_CLIENT_SSRC + 500, 1 );
+  usleep( 20000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( session, 4, &(infos[0]), &received ), "Could not receive packet." );
+  gettimeofday( &now, NULL );
+  age = ( now.tv_sec - infos[0].arrival.tv_sec ) * 1000000 + now.tv_usec - infos[0].arrival.tv_nsec / 1000;
+  ASSERT_LESS( age, 10000, "Arrival time is older than the read." );
+
+  ASSERT_NO_ERROR( RTPSessionSetKernelTimestamps( session, 1 ), "Could not enable kernel timestamps." );
+  usleep( 10000 ); /* Linux switches on receive timestamping asynchronously */
+  _rtp_send_raw( c, &address, RTP_CLIENT_SSRC + 500, 2 );
+  usleep( 20000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( session, 4, &(infos[0]), &received ), "Could not receive packet." );
+  ASSERT_NOT_EQUAL( infos[0].peer, NULL, "Packet with timestamp was not decoded." );
+  gettimeofday( &now, NULL );
+  age = ( now.tv_sec - infos[0].arrival.tv_sec ) * 1000000 + now.tv_usec - infos[0].arrival.tv_nsec / 1000;
+  ASSERT_GREATER_OR_EQUAL( age, 15000, "Arrival time was not taken by the kernel." );
+  ASSERT_LESS( age, 1000000, "Kernel arrival time is off." );
+
+  _rtp_send_raw( c, &address, RTP_CLIENT_SSRC + 500, 3 );
+  usleep( 20000 );
+  infos[1].iovlen = 2;
+  infos[1].iov    = &(iov[0]);
+  ASSERT_NO_ERROR( RTPSessionReceivePacket( session, &(infos[1]) ), "Could not receive packet." );
+  gettimeofday( &now, NULL );
+  age = ( now.tv_sec - infos[1].arrival.tv_sec ) * 1000000 + now.tv_usec - infos[1].arrival.tv_nsec / 1000;
+  ASSERT_GREATER_OR_EQUAL( age, 15000, "Arrival time was not taken by the kernel." );
+
+  close( c );
+  RTPSessionRelease( session );
+  return 0;
+}
+
+/**
+ * Test that received packets own pooled buffers that can be handed on
+ * without copying and that large packets fit.
+ */
+int test015_rtp( void ) {
+  struct RTPSession * session;
+  struct RTPPacketInfo infos[4];
+  struct RTPPacketInfo info;
+  struct RTPPacketBuffer * buffer;
+  struct sockaddr_in address, peer_address;
+  unsigned char packet[1800];
+  unsigned char * payload;
+  size_t received, size;
+  void * data;
+  int s, c;
+
+  ASSERT_NO_ERROR( _rtp_address( &address, RTP_SERVER_PORT + 6 ), "Could not fill out session address." );
+  ASSERT_NO_ERROR( _rtp_socket( &s, &address ), "Could not create session socket." );
+  ASSERT_NO_ERROR( _rtp_address( &peer_address, RTP_CLIENT_PORT + 14 ), "Could not fill out peer address." );
+  ASSERT_NO_ERROR( _rtp_socket( &c, &peer_address ), "Could not create peer socket." );
+  session = RTPSessionCreate( s );
+  ASSERT_NOT_EQUAL( session, NULL, "Could not create RTP session." );
+
+  /* unretained buffers are reused */
+  _rtp_send_raw( c, &address, RTP_CLIENT_SSRC + 600, 1 );
+  usleep( 1000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( session, 4, &(infos[0]), &received ), "Could not receive packet." );
+  ASSERT_NOT_EQUAL( infos[0].buffer, NULL, "Packet was not received into a pooled buffer." );
+  buffer = infos[0].buffer;
+  _rtp_send_raw( c, &address, RTP_CLIENT_SSRC + 600, 2 );
+  usleep( 1000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( session, 4, &(infos[0]), &received ), "Could not receive packet." );
+  ASSERT_EQUAL( infos[0].buffer, buffer, "Unretained buffer was not reused." );
+
+  /* retained buffers survive the next receive and are handed on without copying */
+  RTPPacketBufferRetain( buffer );
+  payload = infos[0].iov[0].iov_base;
+  ASSERT_NO_ERROR( RTPSessionPushPacket( session, &(infos[0]) ), "Could not buffer packet." );
+  _rtp_send_raw( c, &address, RTP_CLIENT_SSRC + 600, 3 );
+  usleep( 1000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( session, 4, &(infos[0]), &received ), "Could not receive packet." );
+  ASSERT_NOT_EQUAL( infos[0].buffer, buffer, "Retained buffer was reused." );
+  ASSERT_EQUAL( *payload, 2, "Retained packet was overwritten." );
+  ASSERT_NO_ERROR( RTPSessionPopPacket( session, &info ), "Could not play out packet." );
+  ASSERT_EQUAL( info.buffer, buffer, "Buffered packet does not reference its buffer." );
+  ASSERT_EQUAL( info.iov[0].iov_base, payload, "Buffered packet was copied." );
+  ASSERT_NO_ERROR( RTPPacketBufferGetData( buffer, &size, &data ), "Could not get buffer data." );
+  ASSERT_GREATER_OR_EQUAL( size, 1500, "Default buffer is smaller than the MTU." );
+
+  /* large packets fit once the packet size is raised */
+  memset( &(packet[0]), 0x5a, sizeof(packet) );
+  packet[0] = 0x80;
+  packet[1] = 96;
+  packet[2] = 0;
+  packet[3] = 4;
+  packet[8] = ( ( RTP_CLIENT_SSRC + 600 ) >> 24 ) & 0xff;
+  packet[9] = ( ( RTP_CLIENT_SSRC + 600 ) >> 16 ) & 0xff;
+  packet[10] = ( ( RTP_CLIENT_SSRC + 600 ) >> 8 ) & 0xff;
+  packet[11] = ( RTP_CLIENT_SSRC + 600 ) & 0xff;
+  ASSERT_ERROR( RTPSessionSetPacketSize( session, 4 ), "Accepted a packet size below the RTP header." );
+  ASSERT_NO_ERROR( RTPSessionSetPacketSize( session, 2048 ), "Could not set packet size." );
+  sendto( c, &(packet[0]), sizeof(packet), 0, (struct sockaddr *) &address, sizeof(address) );
+  usleep( 1000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( session, 4, &(infos[0]), &received ), "Could not receive packet." );
+  ASSERT_NOT_EQUAL( infos[0].peer, NULL, "Large packet was not decoded." );
+  ASSERT_EQUAL( infos[0].payload_size, sizeof(packet) - 12, "Large packet was truncated." );
+
+  /* buffers outlive their session */
+  close( c );
+  RTPSessionRelease( session );
+  ASSERT_EQUAL( *payload, 2, "Retained packet was overwritten." );
+  RTPPacketBufferRelease( buffer );
+  return 0;
+}
+
+#define RTP_IMPAIRED_PACKETS 64
+
+/**
+ * Send a round of packets through an impairment, followed by one that
+ * is not impaired, and count how often each packet arrived.
+ */
+static int _rtp_impaired_round( struct RTPSession * sender, struct RTPPeer * peer, struct RTPSession * receiver,
+                                struct RTPImpairment * impairment, unsigned char * counts ) {
+  struct RTPPacketInfo info;
+  struct iovec iov[2];
+  unsigned char payload = 0x42;
+  unsigned long seqnum;
+  size_t i;
+
+  info.iovlen = 2;
+  info.iov    = &(iov[0]);
+  memset( counts, 0, RTP_IMPAIRED_PACKETS );
+  RTPPeerGetOutSequenceNumber( peer, &seqnum );
+  ASSERT_NO_ERROR( RTPSessionSetImpairment( sender, impairment, NULL ), "Could not set impairment." );
+  for( i=0; i<RTP_IMPAIRED_PACKETS; i++ ) {
+    ASSERT_NO_ERROR( RTPSessionSend( sender, 1, &payload, NULL ), "Could not send packet." );
+  }
+  ASSERT_NO_ERROR( RTPSessionSetImpairment( sender, NULL, NULL ), "Could not clear impairment." );
+  ASSERT_NO_ERROR( RTPSessionSend( sender, 1, &payload, NULL ), "Could not send packet." );
+
+  for(;;) {
+    ASSERT_NO_ERROR( RTPSessionReceivePacket( receiver, &info ), "Could not receive packet." );
+    i = (unsigned short) ( info.sequence_number - seqnum - 1 );
+    if( i == RTP_IMPAIRED_PACKETS ) break;
+    ASSERT_LESS( i, RTP_IMPAIRED_PACKETS, "Received unexpected packet." );
+    counts[i]++;
+  }
+  return 0;
+}
+
+/**
+ * Test that the impairment layer loses, duplicates, delays and reorders
+ * datagrams reproducibly.
+ */
+int test016_rtp( void ) {
+  struct RTPSession * sessions[2];
+  struct RTPPeer * peer;
+  struct RTPPacketInfo infos[8];
+  struct RTPImpairment impairment;
+  struct sockaddr_in address[2];
+  struct timeval start;
+  struct timespec due;
+  unsigned char counts[2][RTP_IMPAIRED_PACKETS];
+  unsigned char seen[9];
+  size_t received, total, lost, bursts, duplicated, reordered;
+  unsigned short last;
+  int i, s;
+
+  for( i=0; i<2; i++ ) {
+    ASSERT_NO_ERROR( _rtp_address( &(address[i]), RTP_SERVER_PORT + 7 + i ), "Could not fill out address." );
+    ASSERT_NO_ERROR( _rtp_socket( &s, &(address[i]) ), "Could not create socket." );
+    sessions[i] = RTPSessionCreate( s );
+    ASSERT_NOT_EQUAL( sessions[i], NULL, "Could not create RTP session." );
+    RTPSessionSetSSRC( sessions[i], RTP_CLIENT_SSRC + 700 + i );
+  }
+  peer = RTPPeerCreate( RTP_CLIENT_SSRC + 701, sizeof(address[1]), (struct sockaddr *) &(address[1]) );
+  ASSERT_NOT_EQUAL( peer, NULL, "Could not create RTP peer." );
+  ASSERT_NO_ERROR( RTPSessionAddPeer( sessions[0], peer ), "Could not add peer." );
+  RTPPeerRelease( peer );
+
+  memset( &impairment, 0, sizeof(impairment) );
+  impairment.loss = 1.5;
+  ASSERT_ERROR( RTPSessionSetImpairment( sessions[0], &impairment, NULL ), "Accepted an invalid probability." );
+
+  /* the same seed loses and duplicates the same packets */
+  impairment.seed       = 42;
+  impairment.loss       = 0.2;
+  impairment.burst_loss = 0.5;
+  impairment.duplicate  = 0.1;
+  ASSERT_NO_ERROR( _rtp_impaired_round( sessions[0], peer, sessions[1], &impairment, &(counts[0][0]) ),
+                   "Could not run first impaired round." );
+  ASSERT_NO_ERROR( _rtp_impaired_round( sessions[0], peer, sessions[1], &impairment, &(counts[1][0]) ),
+                   "Could not run second impaired round." );
+  ASSERT_EQUAL( memcmp( &(counts[0][0]), &(counts[1][0]), RTP_IMPAIRED_PACKETS ), 0,
+                "Impairment is not reproducible." );
+  lost = bursts = duplicated = 0;
+  for( i=0; i<RTP_IMPAIRED_PACKETS; i++ ) {
+    if( counts[0][i] == 0 ) lost++;
+    if( counts[0][i] == 0 && i > 0 && counts[0][i-1] == 0 ) bursts++;
+    if( counts[0][i] == 2 ) duplicated++;
+  }
+  ASSERT_GREATER( lost, 0, "No packets were lost." );
+  ASSERT_LESS( lost, RTP_IMPAIRED_PACKETS / 2, "Too many packets were lost." );
+  ASSERT_GREATER( bursts, 0, "No packets were lost in bursts." );
+  ASSERT_GREATER( duplicated, 0, "No packets were duplicated." );
+
+  /* received packets are delayed and some are overtaken */
+  memset( &impairment, 0, sizeof(impairment) );
+  impairment.seed          = 7;
+  impairment.delay         = 20000;
+  impairment.reorder       = 0.3;
+  impairment.reorder_delay = 5000;
+  ASSERT_NO_ERROR( RTPSessionSetImpairment( sessions[1], NULL, &impairment ), "Could not set impairment." );
+  RTPSessionGetSocket( sessions[0], &s );
+  gettimeofday( &start, NULL );
+  for( i=1; i<=8; i++ ) {
+    _rtp_send_raw( s, &(address[1]), RTP_CLIENT_SSRC + 710, i );
+  }
+  memset( &(seen[0]), 0, sizeof(seen) );
+  last = 0;
+  reordered = 0;
+  for( total=0; total<8; total+=received ) {
+    ASSERT_NO_ERROR( RTPSessionReceivePackets( sessions[1], 8, &(infos[0]), &received ), "Could not receive packets." );
+    if( received == 0 ) {
+      ASSERT_NO_ERROR( RTPSessionGetImpairedArrival( sessions[1], &due ), "No packets are held back." );
+      ASSERT_LESS( due.tv_sec, start.tv_sec + 2, "Packets are held back for too long." );
+      usleep( 1000 );
+    }
+    for( i=0; i<received; i++ ) {
+      ASSERT_NOT_EQUAL( infos[i].peer, NULL, "Received an invalid packet." );
+      ASSERT_GREATER( infos[i].arrival.tv_sec * 1000000L + infos[i].arrival.tv_nsec / 1000,
+                      start.tv_sec * 1000000L + start.tv_usec + 20000, "Packet was not delayed." );
+      ASSERT_LESS_OR_EQUAL( infos[i].sequence_number, 8, "Received unexpected packet." );
+      seen[infos[i].sequence_number]++;
+      if( infos[i].sequence_number < last ) reordered++;
+      last = infos[i].sequence_number;
+    }
+  }
+  for( i=1; i<=8; i++ ) {
+    ASSERT_EQUAL( seen[i], 1, "Packet was not received exactly once." );
+  }
+  ASSERT_GREATER( reordered, 0, "No packets were reordered." );
+
+  /* lost packets don't block the receiver */
+  memset( &impairment, 0, sizeof(impairment) );
+  impairment.loss = 1;
+  ASSERT_NO_ERROR( RTPSessionSetImpairment( sessions[1], NULL, &impairment ), "Could not set impairment." );
+  _rtp_send_raw( s, &(address[1]), RTP_CLIENT_SSRC + 710, 9 );
+  usleep( 1000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( sessions[1], 8, &(infos[0]), &received ), "Could not receive packets." );
+  ASSERT_EQUAL( received, 0, "Lost packet was received." );
+  ASSERT_ERROR( RTPSessionGetImpairedArrival( sessions[1], &due ), "Lost packet is held back." );
+  ASSERT_NO_ERROR( RTPSessionSetImpairment( sessions[1], NULL, NULL ), "Could not clear impairment." );
+
+  RTPSessionRelease( sessions[0] );
+  RTPSessionRelease( sessions[1] );
+  return 0;
+}
+
+/**
+ * Test that a packet overtaken across two receive calls is still played
+ * out without a playout delay, and only once.
+ */
+int test017_rtp( void ) {
+  struct RTPSession * session;
+  struct RTPPacketInfo infos[4];
+  struct RTPPacketInfo info;
+  struct sockaddr_in address, peer_address;
+  unsigned short order[4] = { 1, 3, 2, 2 };
+  size_t received;
+  int i, s, c;
+
+  ASSERT_NO_ERROR( _rtp_address( &address, RTP_SERVER_PORT + 9 ), "Could not fill out session address." );
+  ASSERT_NO_ERROR( _rtp_socket( &s, &address ), "Could not create session socket." );
+  ASSERT_NO_ERROR( _rtp_address( &peer_address, RTP_CLIENT_PORT + 17 ), "Could not fill out peer address." );
+  ASSERT_NO_ERROR( _rtp_socket( &c, &peer_address ), "Could not create peer socket." );
+  session = RTPSessionCreate( s );
+  ASSERT_NOT_EQUAL( session, NULL, "Could not create RTP session." );
+
+  for( i=0; i<3; i++ ) {
+    _rtp_send_raw( c, &address, RTP_PLAYOUT_SSRC + 1, order[i] );
+    usleep( 1000 );
+    ASSERT_NO_ERROR( RTPSessionReceivePackets( session, 4, &(infos[0]), &received ), "Could not receive packets." );
+    ASSERT_EQUAL( received, 1, "Received unexpected number of packets." );
+    ASSERT_NO_ERROR( RTPSessionPushPacket( session, &(infos[0]) ), "Could not buffer packet." );
+    ASSERT_NO_ERROR( RTPSessionPopPacket( session, &info ), "No packet was due." );
+    ASSERT_EQUAL( info.sequence_number, order[i], "Played out unexpected packet." );
+    ASSERT_ERROR( RTPSessionPopPacket( session, &info ), "Empty buffer returned a packet." );
+  }
+
+  /* the late packet was played, so another copy is a duplicate */
+  _rtp_send_raw( c, &address, RTP_PLAYOUT_SSRC + 1, order[3] );
+  usleep( 1000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( session, 4, &(infos[0]), &received ), "Could not receive packets." );
+  ASSERT_ERROR( RTPSessionPushPacket( session, &(infos[0]) ), "Duplicate packet was buffered." );
+
+  close( c );
+  RTPSessionRelease( session );
+  return 0;
+}
+
+#define RTP_HIGH_SSRC 0xdeadbeefUL
+
+/**
+ * Test that reports reach a peer that was learned from RTP data when the
+ * SSRCs have the most significant bit set.
+ */
+int test018_rtp( void ) {
+  struct RTPSession * sessions[2];
+  struct RTPPeer * peer;
+  struct RTPPacketInfo infos[8];
+  struct RTPPeerStats stats;
+  struct sockaddr_in address[2];
+  unsigned char payload[3] = { 0x77, 0x88, 0x99 };
+  size_t received;
+  int i, s;
+
+  for( i=0; i<2; i++ ) {
+    ASSERT_NO_ERROR( _rtp_address( &(address[i]), RTP_SERVER_PORT + 10 + i ), "Could not fill out address." );
+    ASSERT_NO_ERROR( _rtp_socket( &s, &(address[i]) ), "Could not create socket." );
+    sessions[i] = RTPSessionCreate( s );
+    ASSERT_NOT_EQUAL( sessions[i], NULL, "Could not create RTP session." );
+    RTPSessionSetSSRC( sessions[i], RTP_HIGH_SSRC + i );
+  }
+  peer = RTPPeerCreate( RTP_HIGH_SSRC + 1, sizeof(address[1]), (struct sockaddr *) &(address[1]) );
+  ASSERT_NOT_EQUAL( peer, NULL, "Could not create RTP peer." );
+  ASSERT_NO_ERROR( RTPSessionAddPeer( sessions[0], peer ), "Could not add peer." );
+  RTPPeerRelease( peer );
+
+  /* the receiver learns the sender from its data */
+  ASSERT_NO_ERROR( RTPSessionSend( sessions[0], sizeof(payload), &(payload[0]), NULL ), "Could not send packet." );
+  usleep( 1000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( sessions[1], 8, &(infos[0]), &received ), "Could not receive packets." );
+  ASSERT_EQUAL( received, 1, "Received unexpected number of packets." );
+  ASSERT_EQUAL( infos[0].ssrc, RTP_HIGH_SSRC, "Received packet with wrong SSRC." );
+  ASSERT_NO_ERROR( RTPSessionFindPeerBySSRC( sessions[1], &peer, RTP_HIGH_SSRC ),
+                   "Receiver did not add the sender as peer." );
+
+  /* a sender report answered by a receiver report yields the round-trip time */
+  ASSERT_NO_ERROR( RTPSessionSendReports( sessions[0] ), "Could not send sender report." );
+  usleep( 3000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( sessions[1], 8, &(infos[0]), &received ), "Could not receive report." );
+  ASSERT_NO_ERROR( RTPSessionSendReports( sessions[1] ), "Could not send receiver report." );
+  usleep( 1000 );
+  ASSERT_NO_ERROR( RTPSessionReceivePackets( sessions[0], 8, &(infos[0]), &received ), "Could not receive report." );
+  ASSERT_NO_ERROR( RTPSessionFindPeerBySSRC( sessions[0], &peer, RTP_HIGH_SSRC + 1 ), "Could not find receiver." );
+  ASSERT_NO_ERROR( RTPPeerGetStats( peer, &stats ), "Could not get sender statistics." );
+  ASSERT_GREATER_OR_EQUAL( stats.round_trip_time, 2000, "Round-trip time is too short." );
+  ASSERT_LESS( stats.round_trip_time, 100000, "Round-trip time is too long." );
+
+  RTPSessionRelease( sessions[0] );
+  RTPSessionRelease( sessions[1] );
+  return 0;
+}
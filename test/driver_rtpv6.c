@@ -5,6 +5,7 @@
 #include "driver/common/rtp.h"
 #include <netdb.h>
 #include <string.h>
+#include <net/if.h>
 
 #define RTP_ADDRESS "::1"
 static struct sockaddr_in6 server_address;
@@ -203,3 +204,35 @@ int test006_rtpv6( void ) {
 
   return 0;
 }
+
+/**
+ * Test that an RTP session can join and leave an IPv6 multicast group.
+ */
+int test007_rtpv6( void ) {
+  struct RTPSession * session;
+  struct RTPPeer * group;
+  struct sockaddr_in6 address;
+  int s;
+
+  memset( &address, 0, sizeof(address) );
+  address.sin6_family = AF_INET6;
+  address.sin6_port   = htons( 5305 );
+  ASSERT_EQUAL( inet_pton( AF_INET6, "ff15::4d49:4449", &(address.sin6_addr) ), 1,
+                "Could not create multicast address." );
+
+  s = socket( AF_INET6, SOCK_DGRAM, 0 );
+  ASSERT_GREATER_OR_EQUAL( s, 0, "Could not create socket." );
+  session = RTPSessionCreate( s );
+  ASSERT_NOT_EQUAL( session, NULL, "Could not create RTP session." );
+
+  ASSERT_NO_ERROR( RTPSessionJoinGroup( session, sizeof(address), (struct sockaddr *) &address,
+                                        if_nametoindex( "lo" ) ), "Could not join multicast group." );
+  ASSERT_NO_ERROR( RTPSessionGetGroup( session, &group ), "Could not get multicast group." );
+  ASSERT_NO_ERROR( RTPSessionSetMulticastTTL( session, 1 ), "Could not set multicast hop limit." );
+  ASSERT_NO_ERROR( RTPSessionSetMulticastLoopback( session, 0 ), "Could not disable multicast loopback." );
+  ASSERT_NO_ERROR( RTPSessionLeaveGroup( session ), "Could not leave multicast group." );
+  ASSERT_ERROR( RTPSessionLeaveGroup( session ), "Could leave multicast group twice." );
+
+  RTPSessionRelease( session );
+  return 0;
+}
@@ -110,7 +110,8 @@ static struct MIDIDeviceDelegate _test_device = {
   &_receive_ss,
   &_receive_tr,
   &_receive_eox,
-  &_receive_rt
+  &_receive_rt,
+  NULL
 };
 
 static int _send( void * implementation, struct MIDIMessage * message ) {
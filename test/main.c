@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include "midi/midi.h"
+#define NL ((char)0x0a)
+extern int test001_midi( void );
+extern int test002_midi( void );
+extern int test003_midi( void );
+extern int test001_util( void );
+extern int test002_util( void );
+extern int test003_util( void );
+extern int test004_util( void );
+extern int test001_list( void );
+extern int test002_list( void );
+extern int test001_port( void );
+extern int test001_clock( void );
+extern int test002_clock( void );
+extern int test003_clock( void );
+extern int test004_clock( void );
+extern int test005_clock( void );
+extern int test006_clock( void );
+extern int test007_clock( void );
+extern int test008_clock( void );
+extern int test009_clock( void );
+extern int test001_clock_sync( void );
+extern int test002_clock_sync( void );
+extern int test001_message_format( void );
+extern int test002_message_format( void );
+extern int test003_message_format( void );
+extern int test001_message( void );
+extern int test002_message( void );
+extern int test003_message( void );
+extern int test004_message( void );
+extern int test005_message( void );
+extern int test006_message( void );
+extern int test007_message( void );
+extern int test001_controller( void );
+extern int test002_controller( void );
+extern int test003_controller( void );
+extern int test004_controller( void );
+extern int test001_device( void );
+extern int test002_device( void );
+extern int test003_device( void );
+extern int test004_device( void );
+extern int test005_device( void );
+extern int test006_device( void );
+extern int test001_driver( void );
+extern int test002_driver( void );
+extern int test001_timer( void );
+extern int test002_timer( void );
+extern int test003_timer( void );
+extern int test004_timer( void );
+extern int test001_time_code( void );
+extern int test002_time_code( void );
+extern int test003_time_code( void );
+extern int test001_integration( void );
+extern int test001_runloop( void );
+extern int test002_runloop( void );
+extern int test003_runloop( void );
+extern int test001_rtp( void );
+extern int test002_rtp( void );
+extern int test003_rtp( void );
+extern int test004_rtp( void );
+extern int test005_rtp( void );
+extern int test006_rtp( void );
+extern int test007_rtp( void );
+extern int test008_rtp( void );
+extern int test009_rtp( void );
+extern int test010_rtp( void );
+extern int test011_rtp( void );
+extern int test012_rtp( void );
+extern int test013_rtp( void );
+extern int test014_rtp( void );
+extern int test015_rtp( void );
+extern int test016_rtp( void );
+extern int test017_rtp( void );
+extern int test018_rtp( void );
+extern int test001_applemidi( void );
+extern int test002_applemidi( void );
+extern int test003_applemidi( void );
+extern int test004_applemidi( void );
+extern int test005_applemidi( void );
+extern int test001_applemidiv6( void );
+extern int test002_applemidiv6( void );
+extern int test003_applemidiv6( void );
+extern int test004_applemidiv6( void );
+extern int test005_applemidiv6( void );
+extern int test001_rtpv6( void );
+extern int test002_rtpv6( void );
+extern int test003_rtpv6( void );
+extern int test004_rtpv6( void );
+extern int test005_rtpv6( void );
+extern int test006_rtpv6( void );
+extern int test007_rtpv6( void );
+int main( int argc, char *argv[] ) {
+  int i, failures = 0;
+  struct {
+    char * name;
+    int (*func)(void);
+  } tests[] = {
+    { "test001_midi", &test001_midi },
+    { "test002_midi", &test002_midi },
+    { "test003_midi", &test003_midi },
+    { "test001_util", &test001_util },
+    { "test002_util", &test002_util },
+    { "test003_util", &test003_util },
+    { "test004_util", &test004_util },
+    { "test001_list", &test001_list },
+    { "test002_list", &test002_list },
+    { "test001_port", &test001_port },
+    { "test001_clock", &test001_clock },
+    { "test002_clock", &test002_clock },
+    { "test003_clock", &test003_clock },
+    { "test004_clock", &test004_clock },
+    { "test005_clock", &test005_clock },
+    { "test006_clock", &test006_clock },
+    { "test007_clock", &test007_clock },
+    { "test008_clock", &test008_clock },
+    { "test009_clock", &test009_clock },
+    { "test001_clock_sync", &test001_clock_sync },
+    { "test002_clock_sync", &test002_clock_sync },
+    { "test001_message_format", &test001_message_format },
+    { "test002_message_format", &test002_message_format },
+    { "test003_message_format", &test003_message_format },
+    { "test001_message", &test001_message },
+    { "test002_message", &test002_message },
+    { "test003_message", &test003_message },
+    { "test004_message", &test004_message },
+    { "test005_message", &test005_message },
+    { "test006_message", &test006_message },
+    { "test007_message", &test007_message },
+    { "test001_controller", &test001_controller },
+    { "test002_controller", &test002_controller },
+    { "test003_controller", &test003_controller },
+    { "test004_controller", &test004_controller },
+    { "test001_device", &test001_device },
+    { "test002_device", &test002_device },
+    { "test003_device", &test003_device },
+    { "test004_device", &test004_device },
+    { "test005_device", &test005_device },
+    { "test006_device", &test006_device },
+    { "test001_driver", &test001_driver },
+    { "test002_driver", &test002_driver },
+    { "test001_timer", &test001_timer },
+    { "test002_timer", &test002_timer },
+    { "test003_timer", &test003_timer },
+    { "test004_timer", &test004_timer },
+    { "test001_time_code", &test001_time_code },
+    { "test002_time_code", &test002_time_code },
+    { "test003_time_code", &test003_time_code },
+    { "test001_integration", &test001_integration },
+    { "test001_runloop", &test001_runloop },
+    { "test002_runloop", &test002_runloop },
+    { "test003_runloop", &test003_runloop },
+    { "test001_rtp", &test001_rtp },
+    { "test002_rtp", &test002_rtp },
+    { "test003_rtp", &test003_rtp },
+    { "test004_rtp", &test004_rtp },
+    { "test005_rtp", &test005_rtp },
+    { "test006_rtp", &test006_rtp },
+    { "test007_rtp", &test007_rtp },
+    { "test008_rtp", &test008_rtp },
+    { "test009_rtp", &test009_rtp },
+    { "test010_rtp", &test010_rtp },
+    { "test011_rtp", &test011_rtp },
+    { "test012_rtp", &test012_rtp },
+    { "test013_rtp", &test013_rtp },
+    { "test014_rtp", &test014_rtp },
+    { "test015_rtp", &test015_rtp },
+    { "test016_rtp", &test016_rtp },
+    { "test017_rtp", &test017_rtp },
+    { "test018_rtp", &test018_rtp },
+    { "test001_applemidi", &test001_applemidi },
+    { "test002_applemidi", &test002_applemidi },
+    { "test003_applemidi", &test003_applemidi },
+    { "test004_applemidi", &test004_applemidi },
+    { "test005_applemidi", &test005_applemidi },
+    { "test001_applemidiv6", &test001_applemidiv6 },
+    { "test002_applemidiv6", &test002_applemidiv6 },
+    { "test003_applemidiv6", &test003_applemidiv6 },
+    { "test004_applemidiv6", &test004_applemidiv6 },
+    { "test005_applemidiv6", &test005_applemidiv6 },
+    { "test001_rtpv6", &test001_rtpv6 },
+    { "test002_rtpv6", &test002_rtpv6 },
+    { "test003_rtpv6", &test003_rtpv6 },
+    { "test004_rtpv6", &test004_rtpv6 },
+    { "test005_rtpv6", &test005_rtpv6 },
+    { "test006_rtpv6", &test006_rtpv6 },
+    { "test007_rtpv6", &test007_rtpv6 },
+  };
+  for( i=0; i<(sizeof(tests)/sizeof(tests[0])); i++ ) {
+    printf( "> Running %s%c", tests[i].name, NL );
+    if( (tests[i].func)() ) {
+      failures++;
+      printf( "> Test %s failed.%c", tests[i].name, NL );
+    } else {
+      printf( "> Test %s passed.%c", tests[i].name, NL );
+    }
+  }
+  return failures;
+}
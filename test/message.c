@@ -257,3 +257,64 @@ int test006_message( void ) {
   MIDIMessageRelease( messages[11].message );
   return 0;
 }
+
+/**
+ * Test that message batches can be iterated by status and that
+ * typed iteration decodes the message fields.
+ */
+int test007_message( void ) {
+  struct MIDIMessageBatch * batch = MIDIMessageBatchCreate( 2 );
+  struct MIDIMessage * message;
+  MIDIStatus status;
+  MIDIChannel channel = MIDI_CHANNEL_2;
+  MIDIKey key;
+  MIDIVelocity velocity = 64;
+  MIDIControl control = 1;
+  MIDIValue value = 99;
+  size_t i, n, length;
+
+  for( key=60; key<72; key++ ) {
+    message = MIDIMessageCreate( ( key % 3 ) ? MIDI_STATUS_NOTE_ON : MIDI_STATUS_NOTE_OFF );
+    MIDIMessageSet( message, MIDI_CHANNEL, sizeof(MIDIChannel), &channel );
+    MIDIMessageSet( message, MIDI_KEY, sizeof(MIDIKey), &key );
+    MIDIMessageSet( message, MIDI_VELOCITY, sizeof(MIDIVelocity), &velocity );
+    ASSERT_NO_ERROR( MIDIMessageBatchAppend( batch, message ), "Could not append message to batch." );
+    MIDIMessageRelease( message );
+    if( key == 65 ) {
+      message = MIDIMessageCreate( MIDI_STATUS_CONTROL_CHANGE );
+      MIDIMessageSet( message, MIDI_CHANNEL, sizeof(MIDIChannel), &channel );
+      MIDIMessageSet( message, MIDI_CONTROL, sizeof(MIDIControl), &control );
+      MIDIMessageSet( message, MIDI_VALUE, sizeof(MIDIValue), &value );
+      ASSERT_NO_ERROR( MIDIMessageBatchAppend( batch, message ), "Could not append message to batch." );
+      MIDIMessageRelease( message );
+    }
+  }
+  ASSERT_NO_ERROR( MIDIMessageBatchGetLength( batch, &length ), "Could not get batch length." );
+  ASSERT_EQUAL( length, 13, "Batch has wrong length." );
+
+  for( i=0, n=0; MIDIMessageBatchNext( batch, MIDI_STATUS_NOTE_OFF, &i, &message ) == 0; n++ ) {
+    ASSERT_NO_ERROR( MIDIMessageGetStatus( message, &status ), "Could not get status." );
+    ASSERT_EQUAL( status, MIDI_STATUS_NOTE_OFF, "Found message with wrong status." );
+  }
+  ASSERT_EQUAL( n, 4, "Did not find every note off message." );
+
+  for( i=0, n=0; MIDIMessageBatchNextNote( batch, &i, &status, &channel, &key, &velocity ) == 0; n++ ) {
+    ASSERT_EQUAL( key, 60 + n, "Note has wrong key." );
+    ASSERT_EQUAL( status, ( key % 3 ) ? MIDI_STATUS_NOTE_ON : MIDI_STATUS_NOTE_OFF, "Note has wrong status." );
+    ASSERT_EQUAL( channel, MIDI_CHANNEL_2, "Note has wrong channel." );
+    ASSERT_EQUAL( velocity, 64, "Note has wrong velocity." );
+  }
+  ASSERT_EQUAL( n, 12, "Did not find every note message." );
+
+  i = 0;
+  ASSERT_NO_ERROR( MIDIMessageBatchNextControlChange( batch, &i, &channel, &control, &value ), "Did not find control change." );
+  ASSERT_EQUAL( i, 7, "Control change has wrong index." );
+  ASSERT( control == 1 && value == 99, "Control change fields are wrong." );
+  ASSERT_NOT_EQUAL( MIDIMessageBatchNextControlChange( batch, &i, &channel, &control, &value ), 0, "Found second control change." );
+
+  ASSERT_NO_ERROR( MIDIMessageBatchClear( batch ), "Could not clear batch." );
+  MIDIMessageBatchGetLength( batch, &length );
+  ASSERT_EQUAL( length, 0, "Batch was not cleared." );
+  MIDIMessageBatchRelease( batch );
+  return 0;
+}
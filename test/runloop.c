@@ -1,5 +1,75 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <time.h>
 #include "test.h"
 #include "midi/util.h"
+#include "midi/runloop.h"
+
+#define WAKEUP_SAMPLES  64
+#define WAKEUP_INTERVAL 500000
+
+struct wakeup_info {
+  int  count;
+  long last;
+  long latency[WAKEUP_SAMPLES];
+};
+
+static long _usec_now( void ) {
+  struct timeval tv;
+  gettimeofday( &tv, NULL );
+  return tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static int _wakeup_timeout( void * info, struct timespec * ts ) {
+  struct wakeup_info * wakeup = info;
+  long now = _usec_now();
+  if( wakeup->count < WAKEUP_SAMPLES ) {
+    wakeup->latency[wakeup->count++] = now - wakeup->last - WAKEUP_INTERVAL / 1000;
+  }
+  wakeup->last = now;
+  return 0;
+}
+
+static int _cmp_long( const void * a, const void * b ) {
+  long lhs = *(const long *) a, rhs = *(const long *) b;
+  return ( lhs > rhs ) - ( lhs < rhs );
+}
+
+static int _measure_wakeup( struct wakeup_info * wakeup, struct timespec * window ) {
+  int fds[2], i;
+  struct timespec interval = { 0, WAKEUP_INTERVAL };
+  struct MIDIRunloopSourceDelegate delegate = { NULL, NULL, NULL, &_wakeup_timeout };
+  struct MIDIRunloopSource * source;
+  struct MIDIRunloop * runloop;
+
+  ASSERT_NO_ERROR( pipe( fds ), "Could not create pipe." );
+  delegate.info = wakeup;
+  source = MIDIRunloopSourceCreate( &delegate );
+  ASSERT_NOT_EQUAL( source, NULL, "Could not create runloop source." );
+  runloop = MIDIRunloopCreate( NULL );
+  ASSERT_NOT_EQUAL( runloop, NULL, "Could not create runloop." );
+  ASSERT_NO_ERROR( MIDIRunloopSetBusyPoll( runloop, window, 0 ), "Could not set busy poll window." );
+
+  /* the pipe is never written, it only forces the select path */
+  ASSERT_NO_ERROR( MIDIRunloopSourceScheduleRead( source, fds[0] ), "Could not schedule read." );
+  ASSERT_NO_ERROR( MIDIRunloopSourceScheduleTimeout( source, &interval ), "Could not schedule timeout." );
+  ASSERT_NO_ERROR( MIDIRunloopAddSource( runloop, source ), "Could not add source to runloop." );
+
+  wakeup->count = 0;
+  wakeup->last  = _usec_now();
+  for( i=0; i<WAKEUP_SAMPLES*4 && wakeup->count<WAKEUP_SAMPLES; i++ ) {
+    ASSERT_NO_ERROR( MIDIRunloopStep( runloop ), "Could not step through runloop." );
+  }
+  ASSERT_EQUAL( wakeup->count, WAKEUP_SAMPLES, "Timeout callback was not triggered often enough." );
+  qsort( &(wakeup->latency[0]), WAKEUP_SAMPLES, sizeof(long), &_cmp_long );
+
+  MIDIRunloopRelease( runloop );
+  MIDIRunloopSourceRelease( source );
+  close( fds[0] );
+  close( fds[1] );
+  return 0;
+}
 
 /**
  * Test that the runloop works.
@@ -7,3 +77,88 @@
 int test001_runloop( void ) {
   return 0;
 }
+
+/**
+ * Test that the busy-poll mode can be configured and compare its
+ * wake-up latency with the blocking select path.
+ */
+int test002_runloop( void ) {
+  struct wakeup_info blocking, busy;
+  struct timespec window = { 0, WAKEUP_INTERVAL * 2 };
+  struct timespec ts;
+  int usec;
+  struct MIDIRunloop * runloop = MIDIRunloopCreate( NULL );
+
+  ASSERT_NO_ERROR( MIDIRunloopSetBusyPoll( runloop, &window, 50 ), "Could not set busy poll window." );
+  ASSERT_NO_ERROR( MIDIRunloopGetBusyPoll( runloop, &ts, &usec ), "Could not get busy poll window." );
+  ASSERT_EQUAL( ts.tv_nsec, window.tv_nsec, "Busy poll window was not stored." );
+  ASSERT_EQUAL( usec, 50, "Busy poll socket option was not stored." );
+  ASSERT_ERROR( MIDIRunloopSetBusyPoll( runloop, &window, -1 ), "Accepted negative busy poll value." );
+  MIDIErrorNumber = 0;
+  ASSERT_NO_ERROR( MIDIRunloopSetRealtime( runloop, MIDI_RUNLOOP_REALTIME_SCHED, 10, 0 ),
+                   "Could not configure real-time scheduling." );
+  MIDIRunloopRelease( runloop );
+
+  ASSERT_NO_ERROR( _measure_wakeup( &blocking, NULL ), "Could not measure blocking wake-up latency." );
+  ASSERT_NO_ERROR( _measure_wakeup( &busy, &window ), "Could not measure busy-poll wake-up latency." );
+  printf( "Wake-up latency (usec)  p50    p90    p99\n" );
+  printf( "  select               %5ld  %5ld  %5ld\n", blocking.latency[WAKEUP_SAMPLES/2],
+          blocking.latency[WAKEUP_SAMPLES*9/10], blocking.latency[WAKEUP_SAMPLES-1] );
+  printf( "  busy-poll            %5ld  %5ld  %5ld\n", busy.latency[WAKEUP_SAMPLES/2],
+          busy.latency[WAKEUP_SAMPLES*9/10], busy.latency[WAKEUP_SAMPLES-1] );
+  return 0;
+}
+
+static int _slow_timeout( void * info, struct timespec * ts ) {
+  struct timespec delay = { 0, 200000 };
+  nanosleep( &delay, NULL );
+  return 0;
+}
+
+/**
+ * Test that the runloop accounts for the time spent in each source.
+ */
+int test003_runloop( void ) {
+  int i;
+  struct timespec interval = { 0, 100000 };
+  struct MIDIRunloopSourceDelegate delegate = { NULL, NULL, NULL, &_slow_timeout };
+  struct MIDIRunloopSourceStats stats;
+  struct MIDIRunloopSource * slow;
+  struct MIDIRunloopSource * idle;
+  struct MIDIRunloop * runloop;
+
+  delegate.info = &delegate;
+  slow = MIDIRunloopSourceCreate( &delegate );
+  idle = MIDIRunloopSourceCreate( NULL );
+  runloop = MIDIRunloopCreate( NULL );
+  ASSERT_NO_ERROR( MIDIRunloopSourceScheduleTimeout( slow, &interval ), "Could not schedule timeout." );
+  ASSERT_NO_ERROR( MIDIRunloopAddSource( runloop, slow ), "Could not add source to runloop." );
+  ASSERT_NO_ERROR( MIDIRunloopAddSource( runloop, idle ), "Could not add source to runloop." );
+
+  for( i=0; i<8; i++ ) {
+    ASSERT_NO_ERROR( MIDIRunloopStep( runloop ), "Could not step through runloop." );
+  }
+
+  ASSERT_NO_ERROR( MIDIRunloopSourceGetStats( slow, &stats ), "Could not get source statistics." );
+  ASSERT_GREATER( stats.timeout.count, 0, "Timeout callbacks were not counted." );
+  ASSERT_EQUAL( stats.read.count, 0, "Read callbacks were counted." );
+  ASSERT( stats.timeout.max.tv_sec > 0 || stats.timeout.max.tv_nsec >= 200000, "Maximum callback time is too short." );
+  ASSERT( stats.timeout.total.tv_sec > 0 || stats.timeout.total.tv_nsec >= stats.timeout.count * 200000,
+          "Total callback time is too short." );
+
+  ASSERT_NO_ERROR( MIDIRunloopSourceGetStats( idle, &stats ), "Could not get source statistics." );
+  ASSERT_EQUAL( stats.timeout.count, 0, "Idle source has callbacks." );
+
+  ASSERT_NO_ERROR( MIDIRunloopGetStats( runloop, &stats ), "Could not get runloop statistics." );
+  ASSERT_GREATER( stats.wait_count, 0, "Runloop did not wait." );
+  ASSERT( stats.blocked.tv_sec > 0 || stats.blocked.tv_nsec > 0, "Runloop did not block." );
+
+  ASSERT_NO_ERROR( MIDIRunloopResetStats( runloop ), "Could not reset statistics." );
+  ASSERT_NO_ERROR( MIDIRunloopSourceGetStats( slow, &stats ), "Could not get source statistics." );
+  ASSERT_EQUAL( stats.timeout.count, 0, "Statistics were not reset." );
+
+  MIDIRunloopRelease( runloop );
+  MIDIRunloopSourceRelease( slow );
+  MIDIRunloopSourceRelease( idle );
+  return 0;
+}
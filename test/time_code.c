@@ -0,0 +1,150 @@
+#include "test.h"
+#include "midi/clock.h"
+#include "midi/port.h"
+#include "midi/device.h"
+#include "midi/driver.h"
+#include "midi/time_code.h"
+
+#define TIME_CODE_RATE 48000
+
+static int _n_position = 0;
+static struct MIDITimeCodePosition _position;
+static MIDITimestamp _timestamp;
+
+static int _recv_position( struct MIDITimeCode * time_code, struct MIDITimeCodePosition * position,
+                           MIDITimestamp timestamp ) {
+  _position  = *position;
+  _timestamp = timestamp;
+  _n_position++;
+  return 0;
+}
+
+static struct MIDITimeCodeDelegate _delegate = { &_recv_position };
+
+/**
+ * Test that positions are converted to frame numbers and back,
+ * including drop-frame time code.
+ */
+int test001_time_code( void ) {
+  struct MIDITimeCodePosition p = { 1, 10, 0, 2 };
+  long frames, f;
+
+  ASSERT_NO_ERROR( MIDITimeCodePositionToFrames( MIDI_TIME_CODE_29_97_FPS, &p, &frames ), "Could not convert position." );
+  ASSERT_EQUAL( frames, 7 * 17982 + 2, "Drop-frame position was not converted correctly." );
+  ASSERT_NO_ERROR( MIDITimeCodePositionFromFrames( MIDI_TIME_CODE_29_97_FPS, &p, frames - 3 ), "Could not convert frames." );
+  ASSERT( p.hours == 1 && p.minutes == 9 && p.seconds == 59 && p.frames == 29, "Frame before minute ten is wrong." );
+
+  p.minutes = 11; p.seconds = 0; p.frames = 0;
+  ASSERT_ERROR( MIDITimeCodePositionToFrames( MIDI_TIME_CODE_29_97_FPS, &p, &frames ), "Accepted dropped frame." );
+  MIDIErrorNumber = 0;
+
+  for( f=0; f<24L*6*17982; f+=997 ) {
+    ASSERT_NO_ERROR( MIDITimeCodePositionFromFrames( MIDI_TIME_CODE_29_97_FPS, &p, f ), "Could not convert frames." );
+    ASSERT_NO_ERROR( MIDITimeCodePositionToFrames( MIDI_TIME_CODE_29_97_FPS, &p, &frames ), "Could not convert position." );
+    ASSERT_EQUAL( frames, f, "Drop-frame roundtrip failed." );
+  }
+
+  p.hours = 23; p.minutes = 59; p.seconds = 59; p.frames = 24;
+  ASSERT_NO_ERROR( MIDITimeCodePositionToFrames( MIDI_TIME_CODE_25_FPS, &p, &frames ), "Could not convert position." );
+  ASSERT_NO_ERROR( MIDITimeCodePositionFromFrames( MIDI_TIME_CODE_25_FPS, &p, frames + 1 ), "Could not convert frames." );
+  ASSERT( p.hours == 0 && p.minutes == 0 && p.seconds == 0 && p.frames == 0, "Position did not wrap at 24 hours." );
+  return 0;
+}
+
+/**
+ * Test that generated time code is reassembled by a receiving device,
+ * with one position update per two frames.
+ */
+int test002_time_code( void ) {
+  struct MIDIClock * clock = MIDIClockCreate( TIME_CODE_RATE );
+  struct MIDITimeCode * sender   = MIDITimeCodeCreate( NULL );
+  struct MIDITimeCode * receiver = MIDITimeCodeCreate( &_delegate );
+  struct MIDIDevice * out = MIDIDeviceCreate( NULL );
+  struct MIDIDevice * in  = MIDIDeviceCreate( NULL );
+  struct MIDIDriver * driver = MIDIDriverCreate( "loopback", MIDI_SAMPLING_RATE_DEFAULT );
+  struct MIDITimeCodePosition p = { 0, 59, 59, 20 }, q;
+  struct MIDIPort * port;
+  MIDITimestamp t, frame = 48000 / 25;
+  int rate, direction;
+
+  ASSERT_NO_ERROR( MIDIDriverMakeLoopback( driver ), "Could not make loopback driver." );
+  ASSERT_NO_ERROR( MIDIDriverGetPort( driver, &port ), "Could not get driver port." );
+  ASSERT_NO_ERROR( MIDIDeviceAttachOut( out, port ), "Could not attach out port." );
+  ASSERT_NO_ERROR( MIDIDeviceAttachIn( in, port ), "Could not attach in port." );
+  ASSERT_NO_ERROR( MIDIDeviceSetTimeCode( in, receiver ), "Could not set time code." );
+
+  ASSERT_NO_ERROR( MIDITimeCodeSetClock( sender, clock ), "Could not set clock." );
+  ASSERT_NO_ERROR( MIDITimeCodeSetClock( receiver, clock ), "Could not set clock." );
+  ASSERT_NO_ERROR( MIDITimeCodeSetRate( sender, MIDI_TIME_CODE_25_FPS ), "Could not set rate." );
+  ASSERT_NO_ERROR( MIDITimeCodeStart( sender, out, &p, 10000 ), "Could not start time code." );
+
+  _n_position = 0;
+  for( t=10000; t<=10000+20*frame; t+=frame/3 ) {
+    ASSERT_NO_ERROR( MIDITimeCodeSend( sender, t ), "Could not send time code." );
+  }
+  ASSERT_NO_ERROR( MIDITimeCodeStop( sender ), "Could not stop time code." );
+
+  ASSERT_EQUAL( _n_position, 10, "Expected one position per two frames." );
+  ASSERT( _position.hours == 1 && _position.minutes == 0 && _position.seconds == 0 && _position.frames == 15,
+          "Received position is wrong." );
+  ASSERT_EQUAL( _timestamp, 10000 + 20 * frame, "Predicted frame timestamp is wrong." );
+  ASSERT_NO_ERROR( MIDITimeCodeGetReceivedRate( receiver, &rate ), "Could not get received rate." );
+  ASSERT_EQUAL( rate, MIDI_TIME_CODE_25_FPS, "Rate was not received." );
+  ASSERT_NO_ERROR( MIDITimeCodeGetRate( receiver, &rate ), "Could not get rate." );
+  ASSERT_EQUAL( rate, MIDI_TIME_CODE_30_FPS, "Received time code changed the generator rate." );
+  ASSERT_NO_ERROR( MIDITimeCodeGetDirection( receiver, &direction ), "Could not get direction." );
+  ASSERT_EQUAL( direction, MIDI_TIME_CODE_FORWARD, "Direction was not detected." );
+
+  ASSERT_NO_ERROR( MIDITimeCodeGetPosition( receiver, 10000 + 30 * frame + 10, &q ), "Could not predict position." );
+  ASSERT( q.seconds == 1 && q.frames == 0, "Predicted position is wrong." );
+  ASSERT_NO_ERROR( MIDITimeCodeGetFrameTimestamp( receiver, &q, &t ), "Could not predict frame timestamp." );
+  ASSERT_EQUAL( t, 10000 + 30 * frame, "Predicted frame timestamp is wrong." );
+
+  MIDIDeviceRelease( in );
+  MIDIDeviceRelease( out );
+  MIDIDriverRelease( driver );
+  MIDITimeCodeRelease( sender );
+  MIDITimeCodeRelease( receiver );
+  MIDIClockRelease( clock );
+  return 0;
+}
+
+/**
+ * Test that reverse time code is detected and that a missing quarter
+ * frame discards the incomplete position.
+ */
+int test003_time_code( void ) {
+  struct MIDIClock * clock = MIDIClockCreate( TIME_CODE_RATE );
+  struct MIDITimeCode * time_code = MIDITimeCodeCreate( &_delegate );
+  /* 00:00:10:04 at 30 fps */
+  MIDIValue piece[8] = { 4, 0, 10, 0, 0, 0, 0, 3 << 1 };
+  MIDITimestamp t = 0, quarter = 400;
+  int i, direction;
+
+  ASSERT_NO_ERROR( MIDITimeCodeSetClock( time_code, clock ), "Could not set clock." );
+  _n_position = 0;
+
+  /* forward sequence with piece 5 missing */
+  for( i=0; i<8; i++ ) {
+    if( i != 5 ) {
+      ASSERT_NO_ERROR( MIDITimeCodeReceiveQuarterFrame( time_code, NULL, i, piece[i], t ), "Could not receive quarter frame." );
+    }
+    t += quarter;
+  }
+  ASSERT_EQUAL( _n_position, 0, "Incomplete position was reported." );
+  ASSERT_GREATER( MIDITimeCodeGetDirection( time_code, &direction ), 0, "Locked without full position." );
+
+  /* reverse sequence */
+  for( i=7; i>=0; i-- ) {
+    ASSERT_NO_ERROR( MIDITimeCodeReceiveQuarterFrame( time_code, NULL, i, piece[i], t ), "Could not receive quarter frame." );
+    t += quarter;
+  }
+  ASSERT_EQUAL( _n_position, 1, "Reverse position was not reported." );
+  ASSERT_NO_ERROR( MIDITimeCodeGetDirection( time_code, &direction ), "Could not get direction." );
+  ASSERT_EQUAL( direction, MIDI_TIME_CODE_REVERSE, "Reverse direction was not detected." );
+  ASSERT( _position.seconds == 10 && _position.frames == 2, "Reverse position is wrong." );
+
+  MIDITimeCodeRelease( time_code );
+  MIDIClockRelease( clock );
+  return 0;
+}
@@ -0,0 +1,280 @@
+#include <stdlib.h>
+#include "test.h"
+#include "midi/clock.h"
+#include "midi/message.h"
+#include "midi/port.h"
+#include "midi/device.h"
+#include "midi/driver.h"
+#include "midi/runloop.h"
+#include "midi/timer.h"
+
+#define TIMER_RATE   48000
+#define TIMER_PERIOD 1000 /* 120 bpm at 24 clocks per quarter note */
+
+static MIDITimestamp _clock_time( int k ) {
+  static const int jitter[] = { 0, 31, -17, 8, -40, 22, -5, 13, -29, 36, -11, 4 };
+  return 100000 + (MIDITimestamp) k * TIMER_PERIOD + jitter[k % 12];
+}
+
+/**
+ * Test that the timer follows the tempo of jittered timing clocks.
+ */
+int test001_timer( void ) {
+  struct MIDIClock * clock = MIDIClockCreate( TIMER_RATE );
+  struct MIDITimer * timer = MIDITimerCreate( NULL );
+  MIDITimestamp next;
+  MIDILongValue position;
+  double bpm, phase;
+  int k;
+
+  ASSERT_NOT_EQUAL( timer, NULL, "Could not create timer." );
+  ASSERT_NO_ERROR( MIDITimerSetClock( timer, clock ), "Could not set timer clock." );
+  ASSERT_GREATER( MIDITimerGetTempo( timer, &bpm ), 0, "Tempo available without clocks." );
+
+  ASSERT_NO_ERROR( MIDITimerReceiveRealTime( timer, NULL, MIDI_STATUS_START, 0 ), "Could not receive start." );
+  for( k=0; k<96; k++ ) {
+    ASSERT_NO_ERROR( MIDITimerReceiveRealTime( timer, NULL, MIDI_STATUS_TIMING_CLOCK, _clock_time( k ) ),
+                     "Could not receive timing clock." );
+  }
+
+  ASSERT_NO_ERROR( MIDITimerGetTempo( timer, &bpm ), "Could not get tempo." );
+  ASSERT( bpm > 119.5 && bpm < 120.5, "Tempo estimate is off." );
+  ASSERT_NO_ERROR( MIDITimerGetSongPosition( timer, &position ), "Could not get song position." );
+  ASSERT_EQUAL( position, 16, "Song position does not match received clocks." );
+
+  /* the 97th clock starts the fifth quarter note */
+  ASSERT_NO_ERROR( MIDITimerGetNextBeat( timer, &next ), "Could not predict next beat." );
+  ASSERT_LESS_OR_EQUAL( next - _clock_time( 96 ), 20, "Next beat prediction is off." );
+  ASSERT_GREATER_OR_EQUAL( next - _clock_time( 96 ), -20, "Next beat prediction is off." );
+
+  ASSERT_NO_ERROR( MIDITimerGetPhase( timer, 100000 + 96 * TIMER_PERIOD + 6 * TIMER_PERIOD, &phase ),
+                   "Could not get beat phase." );
+  ASSERT( phase > 0.24 && phase < 0.26, "Beat phase is off." );
+
+  MIDITimerRelease( timer );
+  MIDIClockRelease( clock );
+  return 0;
+}
+
+/**
+ * Test that dropped and duplicated clocks do not disturb the tempo.
+ */
+int test002_timer( void ) {
+  struct MIDIClock * clock = MIDIClockCreate( TIMER_RATE );
+  struct MIDITimer * timer = MIDITimerCreate( NULL );
+  MIDILongValue position;
+  double bpm;
+  int k;
+
+  ASSERT_NO_ERROR( MIDITimerSetClock( timer, clock ), "Could not set timer clock." );
+  ASSERT_NO_ERROR( MIDITimerReceiveRealTime( timer, NULL, MIDI_STATUS_START, 0 ), "Could not receive start." );
+  for( k=0; k<48; k++ ) {
+    if( k == 30 ) continue; /* dropped */
+    ASSERT_NO_ERROR( MIDITimerReceiveRealTime( timer, NULL, MIDI_STATUS_TIMING_CLOCK, _clock_time( k ) ),
+                     "Could not receive timing clock." );
+    if( k == 40 ) { /* duplicated */
+      ASSERT_NO_ERROR( MIDITimerReceiveRealTime( timer, NULL, MIDI_STATUS_TIMING_CLOCK, _clock_time( k ) + 2 ),
+                       "Could not receive timing clock." );
+    }
+  }
+
+  ASSERT_NO_ERROR( MIDITimerGetTempo( timer, &bpm ), "Could not get tempo." );
+  ASSERT( bpm > 119 && bpm < 121, "Tempo estimate is off." );
+  ASSERT_NO_ERROR( MIDITimerGetSongPosition( timer, &position ), "Could not get song position." );
+  ASSERT_EQUAL( position, 8, "Song position does not match received clocks." );
+
+  /* clocks received while stopped keep the tempo but not the position */
+  ASSERT_NO_ERROR( MIDITimerReceiveRealTime( timer, NULL, MIDI_STATUS_STOP, 0 ), "Could not receive stop." );
+  for( k=48; k<72; k++ ) {
+    ASSERT_NO_ERROR( MIDITimerReceiveRealTime( timer, NULL, MIDI_STATUS_TIMING_CLOCK, _clock_time( k ) ),
+                     "Could not receive timing clock." );
+  }
+  ASSERT_NO_ERROR( MIDITimerGetSongPosition( timer, &position ), "Could not get song position." );
+  ASSERT_EQUAL( position, 8, "Song position advanced while stopped." );
+  ASSERT_NO_ERROR( MIDITimerGetTempo( timer, &bpm ), "Could not get tempo." );
+  ASSERT( bpm > 119 && bpm < 121, "Tempo estimate is off." );
+  ASSERT_NO_ERROR( MIDITimerReceiveRealTime( timer, NULL, MIDI_STATUS_CONTINUE, 0 ), "Could not receive continue." );
+  ASSERT_NO_ERROR( MIDITimerReceiveRealTime( timer, NULL, MIDI_STATUS_TIMING_CLOCK, _clock_time( 1000 ) ),
+                   "Could not receive timing clock." );
+  ASSERT_NO_ERROR( MIDITimerGetSongPosition( timer, &position ), "Could not get song position." );
+  ASSERT_EQUAL( position, 8, "Song position was not kept on continue." );
+
+  MIDITimerRelease( timer );
+  MIDIClockRelease( clock );
+  return 0;
+}
+
+#define CLOCK_SAMPLES 96
+
+struct clock_info {
+  struct MIDIClock * clock;
+  int           count;
+  int           other;
+  MIDIStatus    status[4];
+  MIDITimestamp timestamp[CLOCK_SAMPLES];
+  MIDITimestamp arrival[CLOCK_SAMPLES];
+};
+
+static int _receive_clock( void * target, void * source, struct MIDITypeSpec * type, void * object ) {
+  struct clock_info * info = target;
+  MIDIStatus status;
+  if( type != MIDIMessageType ) return 1;
+  MIDIMessageGetStatus( object, &status );
+  if( status == MIDI_STATUS_TIMING_CLOCK ) {
+    if( info->count < CLOCK_SAMPLES ) {
+      MIDIMessageGetTimestamp( object, &(info->timestamp[info->count]) );
+      MIDIClockGetNow( info->clock, &(info->arrival[info->count]) );
+      info->count++;
+    }
+  } else if( info->other < 4 ) {
+    info->status[info->other++] = status;
+  }
+  return 0;
+}
+
+static int _cmp_timestamp( const void * a, const void * b ) {
+  MIDITimestamp lhs = *(const MIDITimestamp *) a, rhs = *(const MIDITimestamp *) b;
+  return ( lhs > rhs ) - ( lhs < rhs );
+}
+
+static struct MIDIDevice * _loopback_device( struct MIDIDriver ** driver, struct MIDIPort ** port,
+                                             struct clock_info * info ) {
+  struct MIDIDevice * device = MIDIDeviceCreate( NULL );
+  struct MIDIPort * driver_port;
+  *driver = MIDIDriverCreate( "loopback", MIDI_SAMPLING_RATE_DEFAULT );
+  *port   = MIDIPortCreate( "clock port", MIDI_PORT_IN, info, &_receive_clock );
+  MIDIDriverMakeLoopback( *driver );
+  MIDIDriverGetPort( *driver, &driver_port );
+  MIDIDeviceAttachOut( device, driver_port );
+  MIDIPortConnect( driver_port, *port );
+  return device;
+}
+
+/**
+ * Test that generated clocks are timestamped with absolute deadlines
+ * and that the transport messages are sent.
+ */
+int test003_timer( void ) {
+  struct clock_info info = { NULL, 0, 0, { 0 }, { 0 }, { 0 } };
+  struct MIDIClock * clock = MIDIClockCreate( TIMER_RATE );
+  struct MIDITimer * timer = MIDITimerCreate( NULL );
+  struct MIDIDriver * driver;
+  struct MIDIPort * port;
+  struct MIDIDevice * device = _loopback_device( &driver, &port, &info );
+  MIDILongValue position;
+  MIDITimestamp t;
+  int k;
+
+  info.clock = clock;
+  ASSERT_NO_ERROR( MIDITimerSetClock( timer, clock ), "Could not set timer clock." );
+  ASSERT_NO_ERROR( MIDITimerSetSendTempo( timer, 125 ), "Could not set tempo." );
+  ASSERT_ERROR( MIDITimerSetSendTempo( timer, 0 ), "Accepted invalid tempo." );
+  MIDIErrorNumber = 0;
+
+  ASSERT_NO_ERROR( MIDITimerSendRealTime( timer, device, MIDI_STATUS_START, 1000 ), "Could not send start." );
+  /* pump in uneven steps, deadlines must not depend on them */
+  for( t=1000; t<1000+48*960; t+=337 ) {
+    ASSERT_NO_ERROR( MIDITimerSendRealTime( timer, device, MIDI_STATUS_TIMING_CLOCK, t ), "Could not send clocks." );
+  }
+  ASSERT_EQUAL( info.count, 48, "Unexpected number of clocks sent." );
+  for( k=0; k<info.count; k++ ) {
+    ASSERT_EQUAL( info.timestamp[k], 1000 + k * 960, "Clock was not sent with its deadline." );
+  }
+  ASSERT_NO_ERROR( MIDITimerGetSendSongPosition( timer, &position ), "Could not get song position." );
+  ASSERT_EQUAL( position, 8, "Song position does not match sent clocks." );
+
+  /* following an external clock does not disturb the generator */
+  ASSERT_NO_ERROR( MIDITimerReceiveRealTime( timer, NULL, MIDI_STATUS_START, 0 ), "Could not receive start." );
+  for( k=0; k<12; k++ ) {
+    ASSERT_NO_ERROR( MIDITimerReceiveRealTime( timer, NULL, MIDI_STATUS_TIMING_CLOCK, _clock_time( k ) ),
+                     "Could not receive timing clock." );
+  }
+  ASSERT_NO_ERROR( MIDITimerGetSongPosition( timer, &position ), "Could not get song position." );
+  ASSERT_EQUAL( position, 2, "Song position does not match received clocks." );
+  ASSERT_NO_ERROR( MIDITimerGetSendSongPosition( timer, &position ), "Could not get song position." );
+  ASSERT_EQUAL( position, 8, "Received clocks moved the generator." );
+
+  ASSERT_ERROR( MIDITimerSendSongPosition( timer, device, 4 ), "Accepted song position while running." );
+  MIDIErrorNumber = 0;
+  ASSERT_NO_ERROR( MIDITimerSendRealTime( timer, device, MIDI_STATUS_STOP, t ), "Could not send stop." );
+  ASSERT_NO_ERROR( MIDITimerSendSongPosition( timer, device, 4 ), "Could not send song position." );
+  ASSERT_NO_ERROR( MIDITimerSendRealTime( timer, device, MIDI_STATUS_CONTINUE, 100000 ), "Could not send continue." );
+  ASSERT_NO_ERROR( MIDITimerSendRealTime( timer, device, MIDI_STATUS_TIMING_CLOCK, 100000 + 6 * 960 ),
+                   "Could not send clocks." );
+  ASSERT_NO_ERROR( MIDITimerGetSendSongPosition( timer, &position ), "Could not get song position." );
+  ASSERT_EQUAL( position, 5, "Generator did not continue from song position." );
+
+  ASSERT_EQUAL( info.other, 4, "Unexpected number of transport messages." );
+  ASSERT_EQUAL( info.status[0], MIDI_STATUS_START, "Start was not sent." );
+  ASSERT_EQUAL( info.status[1], MIDI_STATUS_STOP, "Stop was not sent." );
+  ASSERT_EQUAL( info.status[2], MIDI_STATUS_SONG_POSITION_POINTER, "Song position was not sent." );
+  ASSERT_EQUAL( info.status[3], MIDI_STATUS_CONTINUE, "Continue was not sent." );
+
+  MIDIDeviceRelease( device );
+  MIDIPortRelease( port );
+  MIDIDriverRelease( driver );
+  MIDITimerRelease( timer );
+  MIDIClockRelease( clock );
+  return 0;
+}
+
+/**
+ * Test the clock generator in a runloop and report the send jitter
+ * at 300 bpm over a loopback driver.
+ */
+int test004_timer( void ) {
+  struct clock_info info = { NULL, 0, 0, { 0 }, { 0 }, { 0 } };
+  struct MIDIClock * clock = MIDIClockCreate( 1000000 );
+  struct MIDITimer * timer = MIDITimerCreate( NULL );
+  struct MIDIRunloop * runloop = MIDIRunloopCreate( NULL );
+  struct MIDIRunloopSource * source;
+  struct MIDIDriver * driver;
+  struct MIDIPort * port;
+  struct MIDIDevice * device = _loopback_device( &driver, &port, &info );
+  MIDITimestamp now, late[CLOCK_SAMPLES], interval[CLOCK_SAMPLES-1];
+  int k, n;
+
+  info.clock = clock;
+  ASSERT_NO_ERROR( MIDITimerSetClock( timer, clock ), "Could not set timer clock." );
+  ASSERT_NO_ERROR( MIDITimerSetSendTempo( timer, 300 ), "Could not set tempo." );
+  ASSERT_NO_ERROR( MIDITimerSetLookahead( timer, 1000 ), "Could not set lookahead." );
+  ASSERT_NO_ERROR( MIDITimerGetRunloopSource( timer, &source ), "Could not get runloop source." );
+  ASSERT_NO_ERROR( MIDIRunloopAddSource( runloop, source ), "Could not add source to runloop." );
+
+  ASSERT_NO_ERROR( MIDIClockGetNow( clock, &now ), "Could not get current time." );
+  ASSERT_NO_ERROR( MIDITimerSendRealTime( timer, device, MIDI_STATUS_START, now + 2000 ), "Could not send start." );
+  for( k=0; k<CLOCK_SAMPLES*16 && info.count<CLOCK_SAMPLES; k++ ) {
+    ASSERT_NO_ERROR( MIDIRunloopStep( runloop ), "Could not step through runloop." );
+  }
+  ASSERT_NO_ERROR( MIDITimerSendRealTime( timer, device, MIDI_STATUS_STOP, 0 ), "Could not send stop." );
+  ASSERT_EQUAL( info.count, CLOCK_SAMPLES, "Runloop did not send enough clocks." );
+
+  /* timestamps are exact, the send time is up to the runloop */
+  for( k=0, n=0; k<CLOCK_SAMPLES; k++ ) {
+    late[k] = info.arrival[k] - ( info.timestamp[k] - 1000 );
+    if( k > 0 ) {
+      ASSERT_LESS_OR_EQUAL( info.timestamp[k] - info.timestamp[k-1] - 8333, 1, "Clock timestamp drifted." );
+      ASSERT_GREATER_OR_EQUAL( info.timestamp[k] - info.timestamp[k-1] - 8333, 0, "Clock timestamp drifted." );
+      interval[n] = info.arrival[k] - info.arrival[k-1] - 8333;
+      if( interval[n] < 0 ) interval[n] = -interval[n];
+      n++;
+    }
+  }
+  ASSERT_EQUAL( info.timestamp[CLOCK_SAMPLES-1] - info.timestamp[0], ( ( CLOCK_SAMPLES - 1 ) * 25000 + 1 ) / 3,
+                "Clock deadlines accumulated an error." );
+  qsort( &(late[0]), CLOCK_SAMPLES, sizeof(MIDITimestamp), &_cmp_timestamp );
+  qsort( &(interval[0]), n, sizeof(MIDITimestamp), &_cmp_timestamp );
+  printf( "Clock jitter at 300 bpm (usec)  p50    p90    p99\n" );
+  printf( "  send time after deadline     %5lld  %5lld  %5lld\n", late[CLOCK_SAMPLES/2],
+          late[CLOCK_SAMPLES*9/10], late[CLOCK_SAMPLES-1] );
+  printf( "  interval deviation           %5lld  %5lld  %5lld\n", interval[n/2],
+          interval[n*9/10], interval[n-1] );
+
+  MIDIRunloopRelease( runloop );
+  MIDIDeviceRelease( device );
+  MIDIPortRelease( port );
+  MIDIDriverRelease( driver );
+  MIDITimerRelease( timer );
+  MIDIClockRelease( clock );
+  return 0;
+}